@@ -0,0 +1,1248 @@
+﻿/*
+    Набор замеров производительности хэш-отображения c_hash_map
+    Каждый замер выполняется в отдельном процессе (где доступен fork), результаты выводятся
+    в формате JSON и при заданном эталонном файле сравниваются с ним.
+    Разделяемые структуры (c_hash_map_concurrent, c_hash_map_lf) замеряются при разном количестве
+    потоков.
+    Запуск: bench [--max-size N] [--filter строка] [--repeats N] [--baseline файл] [--threshold проценты]
+                  [--fail-on-regression]
+    Лицензия: GPLv3
+*/
+
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#define BENCH_FORK
+#endif
+
+#include "c_hash_map.h"
+#include "c_hash_map_hash.h"
+#include "c_hash_map_concurrent.h"
+#include "c_hash_map_lf.h"
+
+// Минимальное количество операций замера (небольшие таблицы обходятся повторно).
+#define BENCH_MIN_OPS ( (size_t) 1 << 21 )
+
+// Количество повторов замера по умолчанию, в результат идет лучший (наименее зашумленный).
+#define BENCH_REPEATS ( (size_t) 3 )
+
+// Количество запросов, генерируемых вне замера времени за один раз.
+#define BENCH_BLOCK ( (size_t) 1 << 16 )
+
+// Параметр распределения Ципфа (как в YCSB).
+#define BENCH_ZIPF_THETA 0.99
+
+// Длина ключа-строки без завершающего нуля.
+#define BENCH_STR_LENGTH ( (size_t) 18 )
+
+// Допустимое по умолчанию замедление относительно эталона, в процентах.
+#define BENCH_THRESHOLD 10.0
+
+// Количество слотов при создании и максимальный коэффициент загрузки.
+#define BENCH_SLOTS 0
+#define BENCH_MLF 0.75f
+
+#define BENCH_NAME_SIZE ( (size_t) 64 )
+
+// Размеры таблиц, замер выполняется для тех, что не больше --max-size.
+static const size_t bench_sizes[] = {1000, 10000, 100000, 1000000, 10000000, 100000000};
+#define BENCH_SIZES_COUNT ( sizeof(bench_sizes) / sizeof(bench_sizes[0]) )
+
+// Размер таблицы по умолчанию ограничен, чтобы полный прогон занимал около минуты.
+#define BENCH_MAX_SIZE_DEFAULT ( (size_t) 1000000 )
+
+// Количество шардов c_hash_map_concurrent.
+#define BENCH_SHARDS ( (size_t) 64 )
+
+// В смешанном замере каждая BENCH_MIXED_WRITE-я операция потока - удаление и вставка ключа.
+#define BENCH_MIXED_WRITE ( (size_t) 10 )
+
+// Количество потоков замеров разделяемых структур.
+static const size_t bench_threads[] = {1, 2, 4, 8};
+#define BENCH_THREADS_COUNT ( sizeof(bench_threads) / sizeof(bench_threads[0]) )
+
+typedef struct s_bench_memory bench_memory;
+typedef struct s_bench_keys bench_keys;
+typedef struct s_bench_zipf bench_zipf;
+typedef struct s_bench_result bench_result;
+typedef struct s_bench_case bench_case;
+typedef struct s_bench_task bench_task;
+typedef struct s_bench_gate bench_gate;
+typedef struct s_bench_worker bench_worker;
+
+// Счетчики распределителя памяти, передаваемого хэш-отображению.
+struct s_bench_memory
+{
+    size_t allocs_count,
+           live_bytes,
+           peak_bytes;
+};
+
+// Ключи замера: size ключей, находящихся в хэш-отображении.
+struct s_bench_keys
+{
+    size_t is_str;
+    size_t size;
+    // Целые ключи.
+    uint64_t *ints;
+    // Ключи-строки фиксированной длины в одном блоке.
+    char *strs;
+    // Указатели на ключи (передаются хэш-отображению).
+    void **ptrs;
+    // Буфер ключа, которого нет в хэш-отображении (для промахов).
+    uint64_t miss_int;
+    char miss_str[BENCH_STR_LENGTH + 1];
+};
+
+// Генератор рангов по распределению Ципфа (Gray et al., "Quickly generating billion-record
+// synthetic databases").
+struct s_bench_zipf
+{
+    size_t n;
+    double alpha,
+           eta,
+           zeta_n,
+           half_pow_theta;
+};
+
+struct s_bench_result
+{
+    size_t ops;
+    double ns_per_op;
+    double allocs_per_op;
+    size_t peak_rss_kb;
+    size_t peak_map_bytes;
+    size_t checksum;
+};
+
+// Тип замера.
+enum
+{
+    BENCH_GROW,
+    BENCH_HIT_UNIFORM,
+    BENCH_HIT_ZIPF,
+    BENCH_MISS,
+    BENCH_CHURN,
+    BENCH_SCAN,
+    BENCH_MIXED
+};
+
+struct s_bench_case
+{
+    const char *name;
+    size_t kind;
+    size_t is_str;
+};
+
+static const bench_case bench_cases[] =
+{
+    {"grow_int",        BENCH_GROW,        0},
+    {"grow_str",        BENCH_GROW,        1},
+    {"hit_uniform_int", BENCH_HIT_UNIFORM, 0},
+    {"hit_zipf_int",    BENCH_HIT_ZIPF,    0},
+    {"miss_int",        BENCH_MISS,        0},
+    {"hit_uniform_str", BENCH_HIT_UNIFORM, 1},
+    {"hit_zipf_str",    BENCH_HIT_ZIPF,    1},
+    {"miss_str",        BENCH_MISS,        1},
+    {"churn_int",       BENCH_CHURN,       0},
+    {"churn_str",       BENCH_CHURN,       1},
+    {"scan_int",        BENCH_SCAN,        0}
+};
+#define BENCH_CASES_COUNT ( sizeof(bench_cases) / sizeof(bench_cases[0]) )
+
+static const struct
+{
+    const char *name;
+    size_t engine;
+} bench_engines[] =
+{
+    {"chain", C_HASH_MAP_ENGINE_CHAIN},
+    {"swiss", C_HASH_MAP_ENGINE_SWISS},
+    {"dense", C_HASH_MAP_ENGINE_DENSE},
+    {"cuckoo", C_HASH_MAP_ENGINE_CUCKOO}
+};
+#define BENCH_ENGINES_COUNT ( sizeof(bench_engines) / sizeof(bench_engines[0]) )
+
+// Разделяемая структура.
+enum
+{
+    BENCH_SHARED_CONCURRENT,
+    BENCH_SHARED_LF
+};
+
+static const struct
+{
+    const char *name;
+    size_t structure;
+} bench_shared[] =
+{
+    {"concurrent", BENCH_SHARED_CONCURRENT},
+    {"lf",         BENCH_SHARED_LF}
+};
+#define BENCH_SHARED_COUNT ( sizeof(bench_shared) / sizeof(bench_shared[0]) )
+
+static const bench_case bench_shared_cases[] =
+{
+    {"hit_uniform_int", BENCH_HIT_UNIFORM, 0},
+    {"mixed_int",       BENCH_MIXED,       0}
+};
+#define BENCH_SHARED_CASES_COUNT ( sizeof(bench_shared_cases) / sizeof(bench_shared_cases[0]) )
+
+// Замер, выполняемый в отдельном процессе.
+struct s_bench_task
+{
+    // Движок c_hash_map (при threads_count == 0) или разделяемая структура (BENCH_SHARED_*).
+    size_t engine;
+    const bench_case *bench_case;
+    size_t size;
+    // Количество потоков (0 - однопоточный замер c_hash_map).
+    size_t threads_count;
+};
+
+// Одновременный старт потоков замера.
+struct s_bench_gate
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    size_t ready_count;
+    size_t open;
+};
+
+// Поток замера разделяемой структуры.
+struct s_bench_worker
+{
+    size_t structure;
+    void *hash_map;
+    const bench_keys *keys;
+    size_t kind;
+    // Номера ключей запросов потока (генерируются вне замера времени).
+    size_t *block;
+    size_t count;
+    bench_gate *gate;
+    size_t checksum;
+    int status;
+};
+
+// Заголовок блока памяти, хранящий его размер (выровнен как max_align_t).
+#define BENCH_HEADER ( (size_t) 16 )
+
+static void *bench_alloc(void *const _context,
+                         const size_t _size)
+{
+    bench_memory *const memory = _context;
+
+    uint8_t *const block = malloc(BENCH_HEADER + _size);
+    if (block == NULL)
+    {
+        return NULL;
+    }
+    memcpy(block, &_size, sizeof(size_t));
+
+    ++memory->allocs_count;
+    memory->live_bytes += _size;
+    if (memory->live_bytes > memory->peak_bytes)
+    {
+        memory->peak_bytes = memory->live_bytes;
+    }
+
+    return block + BENCH_HEADER;
+}
+
+static void bench_free(void *const _context,
+                       void *const _memory)
+{
+    if (_memory == NULL) return;
+
+    bench_memory *const memory = _context;
+    uint8_t *const block = (uint8_t*)_memory - BENCH_HEADER;
+
+    size_t size;
+    memcpy(&size, block, sizeof(size_t));
+    memory->live_bytes -= size;
+
+    free(block);
+}
+
+static uint64_t bench_time_ns(void)
+{
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#else
+    return (uint64_t)clock() * (1000000000ULL / CLOCKS_PER_SEC);
+#endif
+}
+
+// Генератор псевдослучайных чисел splitmix64 (фиксированное зерно - воспроизводимые прогоны).
+static uint64_t bench_random(uint64_t *const _state)
+{
+    *_state += 0x9E3779B97F4A7C15ULL;
+    return c_hash_map_hash_mix64(*_state);
+}
+
+static size_t comp_key_int(const void *const _key_a,
+                           const void *const _key_b)
+{
+    return *(const uint64_t*)_key_a == *(const uint64_t*)_key_b;
+}
+
+static size_t comp_key_str(const void *const _key_a,
+                           const void *const _key_b)
+{
+    return strcmp(_key_a, _key_b) == 0;
+}
+
+// Записывает значение ключа номер _value в ключ-строку.
+static void bench_str_write(char *const _str,
+                            const uint64_t _value)
+{
+    static const char digits[] = "0123456789abcdef";
+    _str[0] = 'k';
+    _str[1] = ':';
+    for (size_t i = 0; i < 16; ++i)
+    {
+        _str[2 + i] = digits[(_value >> (60 - 4 * i)) & 15];
+    }
+    _str[BENCH_STR_LENGTH] = '\0';
+}
+
+// Значение ключа номер _index: перемешивание взаимно однозначно, поэтому ключи различны.
+static uint64_t bench_key_value(const size_t _index)
+{
+    return c_hash_map_hash_mix64((uint64_t)_index + 1);
+}
+
+static void bench_key_set(bench_keys *const _keys,
+                          const size_t _slot,
+                          const size_t _index)
+{
+    if (_keys->is_str)
+    {
+        bench_str_write(_keys->strs + _slot * (BENCH_STR_LENGTH + 1), bench_key_value(_index));
+    } else {
+        _keys->ints[_slot] = bench_key_value(_index);
+    }
+}
+
+static int bench_keys_init(bench_keys *const _keys,
+                           const size_t _size,
+                           const size_t _is_str)
+{
+    memset(_keys, 0, sizeof(bench_keys));
+    _keys->is_str = _is_str;
+    _keys->size = _size;
+
+    _keys->ptrs = malloc(_size * sizeof(void*));
+    if (_is_str)
+    {
+        _keys->strs = malloc(_size * (BENCH_STR_LENGTH + 1));
+    } else {
+        _keys->ints = malloc(_size * sizeof(uint64_t));
+    }
+    if ( (_keys->ptrs == NULL) || ( (_keys->strs == NULL) && (_keys->ints == NULL) ) )
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i < _size; ++i)
+    {
+        bench_key_set(_keys, i, i);
+        _keys->ptrs[i] = _is_str ? (void*)(_keys->strs + i * (BENCH_STR_LENGTH + 1)) : (void*)&_keys->ints[i];
+    }
+
+    return 0;
+}
+
+static void bench_keys_free(bench_keys *const _keys)
+{
+    free(_keys->ptrs);
+    free(_keys->strs);
+    free(_keys->ints);
+}
+
+static void bench_zipf_init(bench_zipf *const _zipf,
+                            const size_t _n)
+{
+    double zeta_n = 0;
+    for (size_t i = 1; i <= _n; ++i)
+    {
+        zeta_n += 1.0 / pow((double)i, BENCH_ZIPF_THETA);
+    }
+    const double zeta_2 = 1.0 + 1.0 / pow(2.0, BENCH_ZIPF_THETA);
+
+    _zipf->n = _n;
+    _zipf->zeta_n = zeta_n;
+    _zipf->alpha = 1.0 / (1.0 - BENCH_ZIPF_THETA);
+    _zipf->eta = (1.0 - pow(2.0 / _n, 1.0 - BENCH_ZIPF_THETA)) / (1.0 - zeta_2 / zeta_n);
+    _zipf->half_pow_theta = 1.0 + pow(0.5, BENCH_ZIPF_THETA);
+}
+
+// Номер ключа по распределению Ципфа.
+// Ранги перемешиваются, чтобы частые ключи не оказывались рядом в памяти.
+static size_t bench_zipf_next(const bench_zipf *const _zipf,
+                              uint64_t *const _state)
+{
+    const double u = (double)(bench_random(_state) >> 11) * (1.0 / 9007199254740992.0);
+    const double uz = u * _zipf->zeta_n;
+
+    size_t rank;
+    if (uz < 1.0)
+    {
+        rank = 0;
+    } else if (uz < _zipf->half_pow_theta) {
+        rank = 1;
+    } else {
+        rank = (size_t)(_zipf->n * pow(_zipf->eta * u - _zipf->eta + 1.0, _zipf->alpha));
+        if (rank >= _zipf->n)
+        {
+            rank = _zipf->n - 1;
+        }
+    }
+
+    return (size_t)(c_hash_map_hash_mix64(rank) % _zipf->n);
+}
+
+static c_hash_map *bench_map_create(const size_t _engine,
+                                    const size_t _is_str,
+                                    bench_memory *const _memory)
+{
+    c_hash_map_options options;
+    c_hash_map_options_init(&options);
+    options.engine = _engine;
+    options.mem_alloc = bench_alloc;
+    options.mem_free = bench_free;
+    options.mem_context = _memory;
+
+    size_t error;
+    c_hash_map *const hash_map = c_hash_map_create_ex(_is_str ? c_hash_map_hash_str : c_hash_map_hash_u64,
+                                                      _is_str ? comp_key_str : comp_key_int,
+                                                      BENCH_SLOTS, BENCH_MLF, &options, &error);
+    if (hash_map == NULL)
+    {
+        fprintf(stderr, "bench: create error: %lu\n", (unsigned long)error);
+    }
+    return hash_map;
+}
+
+static int bench_map_fill(c_hash_map *const _hash_map,
+                          const bench_keys *const _keys)
+{
+    for (size_t i = 0; i < _keys->size; ++i)
+    {
+        if (c_hash_map_insert(_hash_map, _keys->ptrs[i], _keys->ptrs[i]) <= 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static size_t bench_scan_count;
+
+static void bench_scan_action(const void *const _key)
+{
+    (void)_key;
+    ++bench_scan_count;
+}
+
+// Выполняет один замер.
+// В случае успеха возвращает 0, в случае ошибки возвращает < 0.
+static int bench_run(const size_t _engine,
+                     const bench_case *const _case,
+                     const size_t _size,
+                     bench_result *const _result)
+{
+    memset(_result, 0, sizeof(bench_result));
+
+    bench_keys keys;
+    if (bench_keys_init(&keys, _size, _case->is_str) < 0)
+    {
+        bench_keys_free(&keys);
+        return -1;
+    }
+
+    bench_memory memory = {0, 0, 0};
+    c_hash_map *hash_map = NULL;
+
+    const size_t rounds = (_size < BENCH_MIN_OPS) ? (BENCH_MIN_OPS + _size - 1) / _size : 1;
+    const size_t ops = (_size > BENCH_MIN_OPS) ? _size : BENCH_MIN_OPS;
+
+    size_t allocs_count = 0;
+    uint64_t elapsed = 0;
+    size_t checksum = 0;
+    int status = 0;
+
+    if (_case->kind == BENCH_GROW)
+    {
+        // Время создания и удаления входит в замер.
+        for (size_t r = 0; (r < rounds) && (status == 0); ++r)
+        {
+            const size_t allocs_begin = memory.allocs_count;
+            const uint64_t begin = bench_time_ns();
+
+            hash_map = bench_map_create(_engine, _case->is_str, &memory);
+            if ( (hash_map == NULL) || (bench_map_fill(hash_map, &keys) < 0) )
+            {
+                status = -1;
+            }
+            if (hash_map != NULL)
+            {
+                checksum += c_hash_map_pairs_count(hash_map, NULL);
+                c_hash_map_delete(hash_map, NULL, NULL);
+                hash_map = NULL;
+            }
+
+            elapsed += bench_time_ns() - begin;
+            allocs_count += memory.allocs_count - allocs_begin;
+        }
+        _result->ops = rounds * _size;
+    } else {
+        hash_map = bench_map_create(_engine, _case->is_str, &memory);
+        if ( (hash_map == NULL) || (bench_map_fill(hash_map, &keys) < 0) )
+        {
+            status = -1;
+        }
+    }
+
+    if ( (status == 0) && (_case->kind == BENCH_SCAN) )
+    {
+        const size_t allocs_begin = memory.allocs_count;
+        const uint64_t begin = bench_time_ns();
+        for (size_t r = 0; r < rounds; ++r)
+        {
+            c_hash_map_for_each(hash_map, bench_scan_action, NULL);
+        }
+        elapsed = bench_time_ns() - begin;
+        allocs_count = memory.allocs_count - allocs_begin;
+
+        checksum = bench_scan_count;
+        _result->ops = rounds * _size;
+        if (checksum != _result->ops)
+        {
+            status = -2;
+        }
+    }
+
+    if ( (status == 0) &&
+         ( (_case->kind == BENCH_HIT_UNIFORM) || (_case->kind == BENCH_HIT_ZIPF) ||
+           (_case->kind == BENCH_MISS) || (_case->kind == BENCH_CHURN) ) )
+    {
+        bench_zipf zipf = {0, 0, 0, 0, 0};
+        if (_case->kind == BENCH_HIT_ZIPF)
+        {
+            bench_zipf_init(&zipf, _size);
+        }
+
+        size_t *const block = malloc(BENCH_BLOCK * sizeof(size_t));
+        if (block == NULL)
+        {
+            status = -1;
+        }
+
+        uint64_t state = 0x2545F4914F6CDD1DULL;
+        size_t next_key = _size;
+        for (size_t done = 0; (done < ops) && (status == 0); )
+        {
+            const size_t count = (ops - done < BENCH_BLOCK) ? ops - done : BENCH_BLOCK;
+
+            // Запросы генерируются вне замера времени.
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (_case->kind == BENCH_HIT_ZIPF)
+                {
+                    block[i] = bench_zipf_next(&zipf, &state);
+                } else if (_case->kind == BENCH_CHURN) {
+                    block[i] = (done + i) % _size;
+                } else {
+                    block[i] = (size_t)(bench_random(&state) % _size);
+                }
+            }
+
+            const size_t allocs_begin = memory.allocs_count;
+            const uint64_t begin = bench_time_ns();
+
+            if (_case->kind == BENCH_MISS)
+            {
+                // Промахи: ключи с номерами от _size ни разу не вставлялись.
+                for (size_t i = 0; i < count; ++i)
+                {
+                    const uint64_t value = bench_key_value(_size + block[i]);
+                    if (keys.is_str)
+                    {
+                        bench_str_write(keys.miss_str, value);
+                        checksum += (c_hash_map_at(hash_map, keys.miss_str, NULL) == NULL);
+                    } else {
+                        keys.miss_int = value;
+                        checksum += (c_hash_map_at(hash_map, &keys.miss_int, NULL) == NULL);
+                    }
+                }
+            } else if (_case->kind == BENCH_CHURN) {
+                // Удаление ключа и вставка нового на его место: размер таблицы постоянен.
+                for (size_t i = 0; i < count; ++i)
+                {
+                    const size_t slot = block[i];
+                    checksum += (c_hash_map_erase(hash_map, keys.ptrs[slot], NULL, NULL) > 0);
+                    bench_key_set(&keys, slot, next_key++);
+                    checksum += (c_hash_map_insert(hash_map, keys.ptrs[slot], keys.ptrs[slot]) > 0);
+                }
+            } else {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    checksum += (c_hash_map_at(hash_map, keys.ptrs[block[i]], NULL) != NULL);
+                }
+            }
+
+            elapsed += bench_time_ns() - begin;
+            allocs_count += memory.allocs_count - allocs_begin;
+            done += count;
+        }
+        free(block);
+
+        _result->ops = ops;
+        const size_t expected = (_case->kind == BENCH_CHURN) ? 2 * ops : ops;
+        if ( (status == 0) && (checksum != expected) )
+        {
+            status = -2;
+        }
+    }
+
+    if (hash_map != NULL)
+    {
+        c_hash_map_delete(hash_map, NULL, NULL);
+    }
+    bench_keys_free(&keys);
+
+    if (status < 0)
+    {
+        return status;
+    }
+
+    _result->ns_per_op = (double)elapsed / _result->ops;
+    _result->allocs_per_op = (double)allocs_count / _result->ops;
+    _result->peak_map_bytes = memory.peak_bytes;
+    _result->checksum = checksum;
+#if defined(BENCH_FORK)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        // В Linux ru_maxrss - в килобайтах.
+        _result->peak_rss_kb = (size_t)usage.ru_maxrss;
+    }
+#endif
+
+    return 0;
+}
+
+// Ожидает открытия старта.
+static void bench_gate_wait(bench_gate *const _gate)
+{
+    pthread_mutex_lock(&_gate->mutex);
+    ++_gate->ready_count;
+    pthread_cond_broadcast(&_gate->cond);
+    while (_gate->open == 0)
+    {
+        pthread_cond_wait(&_gate->cond, &_gate->mutex);
+    }
+    pthread_mutex_unlock(&_gate->mutex);
+}
+
+// Дожидается готовности _count потоков и открывает старт.
+static void bench_gate_open(bench_gate *const _gate,
+                            const size_t _count)
+{
+    pthread_mutex_lock(&_gate->mutex);
+    while (_gate->ready_count < _count)
+    {
+        pthread_cond_wait(&_gate->cond, &_gate->mutex);
+    }
+    _gate->open = 1;
+    pthread_cond_broadcast(&_gate->cond);
+    pthread_mutex_unlock(&_gate->mutex);
+}
+
+static ptrdiff_t bench_shared_insert(const size_t _structure,
+                                     void *const _hash_map,
+                                     void *const _key)
+{
+    if (_structure == BENCH_SHARED_LF)
+    {
+        return c_hash_map_lf_insert(_hash_map, _key, _key);
+    }
+    return c_hash_map_concurrent_insert(_hash_map, _key, _key);
+}
+
+static ptrdiff_t bench_shared_erase(const size_t _structure,
+                                    void *const _hash_map,
+                                    void *const _key)
+{
+    if (_structure == BENCH_SHARED_LF)
+    {
+        return c_hash_map_lf_erase(_hash_map, _key, NULL, NULL);
+    }
+    return c_hash_map_concurrent_erase(_hash_map, _key, NULL, NULL);
+}
+
+static void *bench_worker_run(void *const _worker)
+{
+    bench_worker *const worker = _worker;
+    const bench_keys *const keys = worker->keys;
+
+    // Читатель c_hash_map_lf регистрируется до старта, вне замера времени.
+    c_hash_map_lf_reader *reader = NULL;
+    if (worker->structure == BENCH_SHARED_LF)
+    {
+        reader = c_hash_map_lf_reader_register(worker->hash_map, NULL);
+        if (reader == NULL)
+        {
+            worker->status = -1;
+        }
+    }
+
+    bench_gate_wait(worker->gate);
+
+    for (size_t i = 0; (i < worker->count) && (worker->status == 0); ++i)
+    {
+        void *const key = keys->ptrs[worker->block[i]];
+        if ( (worker->kind == BENCH_MIXED) && (i % BENCH_MIXED_WRITE == 0) )
+        {
+            // Ключи записи принадлежат только этому потоку, поэтому удаление и вставка успешны.
+            worker->checksum += (bench_shared_erase(worker->structure, worker->hash_map, key) > 0);
+            worker->checksum += (bench_shared_insert(worker->structure, worker->hash_map, key) > 0);
+        } else {
+            const void *const data = (reader != NULL) ? c_hash_map_lf_at(worker->hash_map, reader, key, NULL) :
+                                                        c_hash_map_concurrent_at(worker->hash_map, key, NULL);
+            // Чтение в смешанном замере может попасть между удалением и вставкой другого потока.
+            worker->checksum += (worker->kind == BENCH_MIXED) ? 0 : (data != NULL);
+        }
+    }
+
+    if (reader != NULL)
+    {
+        c_hash_map_lf_reader_unregister(worker->hash_map, reader);
+    }
+
+    return NULL;
+}
+
+// Выполняет замер разделяемой структуры несколькими потоками.
+// Время замера - от одновременного старта потоков до завершения последнего, ns_per_op
+// относится к суммарному количеству операций всех потоков.
+// В случае успеха возвращает 0, в случае ошибки возвращает < 0.
+static int bench_run_shared(const size_t _structure,
+                            const bench_case *const _case,
+                            const size_t _size,
+                            const size_t _threads_count,
+                            bench_result *const _result)
+{
+    memset(_result, 0, sizeof(bench_result));
+
+    bench_keys keys;
+    if (bench_keys_init(&keys, _size, _case->is_str) < 0)
+    {
+        bench_keys_free(&keys);
+        return -1;
+    }
+
+    int status = 0;
+
+    void *hash_map = NULL;
+    if (_structure == BENCH_SHARED_CONCURRENT)
+    {
+        hash_map = c_hash_map_concurrent_create(c_hash_map_hash_u64, comp_key_int, BENCH_SHARDS,
+                                                BENCH_SLOTS, BENCH_MLF, NULL, NULL);
+    } else {
+        hash_map = c_hash_map_lf_create(c_hash_map_hash_u64, comp_key_int, BENCH_SLOTS, BENCH_MLF, NULL);
+    }
+    if (hash_map == NULL)
+    {
+        status = -1;
+    }
+    for (size_t i = 0; (i < _size) && (status == 0); ++i)
+    {
+        if (bench_shared_insert(_structure, hash_map, keys.ptrs[i]) <= 0)
+        {
+            status = -1;
+        }
+    }
+
+    const size_t ops = (_size > BENCH_MIN_OPS) ? _size : BENCH_MIN_OPS;
+    const size_t count = ops / _threads_count;
+
+    bench_worker *const workers = calloc(_threads_count, sizeof(bench_worker));
+    pthread_t *const threads = malloc(_threads_count * sizeof(pthread_t));
+    if ( (workers == NULL) || (threads == NULL) )
+    {
+        status = -1;
+    }
+
+    bench_gate gate;
+    pthread_mutex_init(&gate.mutex, NULL);
+    pthread_cond_init(&gate.cond, NULL);
+    gate.ready_count = 0;
+    gate.open = 0;
+
+    // Запросы потоков. Ключи записи потока t - номера, дающие остаток t от деления на
+    // количество потоков, поэтому потоки не удаляют ключи друг друга.
+    uint64_t state = 0x2545F4914F6CDD1DULL;
+    const size_t part = _size / _threads_count;
+    size_t writes_count = 0;
+    for (size_t t = 0; (t < _threads_count) && (status == 0); ++t)
+    {
+        bench_worker *const worker = &workers[t];
+        worker->structure = _structure;
+        worker->hash_map = hash_map;
+        worker->keys = &keys;
+        worker->kind = _case->kind;
+        worker->count = count;
+        worker->gate = &gate;
+        worker->block = malloc(count * sizeof(size_t));
+        if (worker->block == NULL)
+        {
+            status = -1;
+            break;
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            if ( (_case->kind == BENCH_MIXED) && (i % BENCH_MIXED_WRITE == 0) )
+            {
+                worker->block[i] = (size_t)(bench_random(&state) % part) * _threads_count + t;
+                ++writes_count;
+            } else {
+                worker->block[i] = (size_t)(bench_random(&state) % _size);
+            }
+        }
+    }
+
+    size_t started = 0;
+    for (; (started < _threads_count) && (status == 0); ++started)
+    {
+        if (pthread_create(&threads[started], NULL, bench_worker_run, &workers[started]) != 0)
+        {
+            status = -1;
+        }
+    }
+
+    uint64_t elapsed = 0;
+    if (status == 0)
+    {
+        bench_gate_open(&gate, _threads_count);
+        const uint64_t begin = bench_time_ns();
+        for (size_t t = 0; t < started; ++t)
+        {
+            pthread_join(threads[t], NULL);
+        }
+        elapsed = bench_time_ns() - begin;
+    } else {
+        // Запущенные потоки ждут старта, открываем его, чтобы их дождаться.
+        bench_gate_open(&gate, started);
+        for (size_t t = 0; t < started; ++t)
+        {
+            pthread_join(threads[t], NULL);
+        }
+    }
+
+    size_t checksum = 0;
+    for (size_t t = 0; (workers != NULL) && (t < _threads_count); ++t)
+    {
+        checksum += workers[t].checksum;
+        if (workers[t].status < 0)
+        {
+            status = workers[t].status;
+        }
+        free(workers[t].block);
+    }
+    free(workers);
+    free(threads);
+    pthread_cond_destroy(&gate.cond);
+    pthread_mutex_destroy(&gate.mutex);
+
+    _result->ops = count * _threads_count;
+    const size_t expected = (_case->kind == BENCH_MIXED) ? 2 * writes_count : _result->ops;
+    if ( (status == 0) && (checksum != expected) )
+    {
+        status = -2;
+    }
+
+    if (hash_map != NULL)
+    {
+        if (_structure == BENCH_SHARED_LF)
+        {
+            c_hash_map_lf_delete(hash_map, NULL, NULL);
+        } else {
+            c_hash_map_concurrent_delete(hash_map, NULL, NULL);
+        }
+    }
+    bench_keys_free(&keys);
+
+    if (status < 0)
+    {
+        return status;
+    }
+
+    _result->ns_per_op = (double)elapsed / _result->ops;
+    _result->checksum = checksum;
+#if defined(BENCH_FORK)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        _result->peak_rss_kb = (size_t)usage.ru_maxrss;
+    }
+#endif
+
+    return 0;
+}
+
+// Выполняет замер задачи в текущем процессе.
+static int bench_run_task(const bench_task *const _task,
+                          bench_result *const _result)
+{
+    if (_task->threads_count > 0)
+    {
+        return bench_run_shared(_task->engine, _task->bench_case, _task->size, _task->threads_count, _result);
+    }
+    return bench_run(_task->engine, _task->bench_case, _task->size, _result);
+}
+
+// Выполняет замер в отдельном процессе, чтобы пиковый RSS и состояние malloc не зависели
+// от предыдущих замеров.
+static int bench_run_isolated(const bench_task *const _task,
+                              bench_result *const _result)
+{
+#if defined(BENCH_FORK)
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        return bench_run_task(_task, _result);
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    const pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return bench_run_task(_task, _result);
+    }
+    if (pid == 0)
+    {
+        close(fds[0]);
+        bench_result result;
+        const int status = bench_run_task(_task, &result);
+        if (status == 0)
+        {
+            if (write(fds[1], &result, sizeof(bench_result)) != (ssize_t)sizeof(bench_result))
+            {
+                _exit(2);
+            }
+        }
+        close(fds[1]);
+        _exit( (status == 0) ? 0 : 1 );
+    }
+
+    close(fds[1]);
+    size_t received = 0;
+    while (received < sizeof(bench_result))
+    {
+        const ssize_t r = read(fds[0], (char*)_result + received, sizeof(bench_result) - received);
+        if (r <= 0)
+        {
+            break;
+        }
+        received += (size_t)r;
+    }
+    close(fds[0]);
+
+    int wstatus;
+    if ( (waitpid(pid, &wstatus, 0) != pid) || !WIFEXITED(wstatus) || (WEXITSTATUS(wstatus) != 0) ||
+         (received != sizeof(bench_result)) )
+    {
+        return -1;
+    }
+    return 0;
+#else
+    return bench_run_task(_task, _result);
+#endif
+}
+
+typedef struct s_bench_baseline bench_baseline;
+
+// Запись эталонного файла.
+struct s_bench_baseline
+{
+    char name[BENCH_NAME_SIZE];
+    size_t size;
+    double ns_per_op;
+};
+
+// Читает результаты из эталонного файла (по одному результату в строке, как выводит bench).
+// Возвращает количество прочитанных записей, в случае ошибки возвращает < 0.
+static ptrdiff_t bench_baseline_load(const char *const _path,
+                                     bench_baseline **const _records)
+{
+    FILE *const file = fopen(_path, "r");
+    if (file == NULL)
+    {
+        return -1;
+    }
+
+    size_t count = 0,
+           capacity = 0;
+    bench_baseline *records = NULL;
+
+    char line[512];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        bench_baseline record;
+        unsigned long size;
+        if (sscanf(line, " {\"name\": \"%63[^\"]\", \"size\": %lu, \"ns_per_op\": %lf",
+                   record.name, &size, &record.ns_per_op) != 3)
+        {
+            continue;
+        }
+        record.size = size;
+
+        if (count == capacity)
+        {
+            capacity = (capacity == 0) ? 64 : capacity * 2;
+            bench_baseline *const grown = realloc(records, capacity * sizeof(bench_baseline));
+            if (grown == NULL)
+            {
+                free(records);
+                fclose(file);
+                return -2;
+            }
+            records = grown;
+        }
+        records[count++] = record;
+    }
+
+    fclose(file);
+    *_records = records;
+    return (ptrdiff_t)count;
+}
+
+static const bench_baseline *bench_baseline_find(const bench_baseline *const _records,
+                                                 const size_t _count,
+                                                 const char *const _name,
+                                                 const size_t _size)
+{
+    for (size_t i = 0; i < _count; ++i)
+    {
+        if ( (_records[i].size == _size) && (strcmp(_records[i].name, _name) == 0) )
+        {
+            return &_records[i];
+        }
+    }
+    return NULL;
+}
+
+// Выполняет замер _repeats раз, выводит лучший результат и сравнивает его с эталоном.
+// Возвращает 1, если результат хуже эталона больше чем на _threshold процентов, иначе 0.
+// В случае ошибки замера возвращает < 0.
+static int bench_report(const char *const _name,
+                        const bench_task *const _task,
+                        const size_t _repeats,
+                        const bench_baseline *const _baseline,
+                        const size_t _baseline_count,
+                        const double _threshold,
+                        size_t *const _printed)
+{
+    bench_result result;
+    memset(&result, 0, sizeof(bench_result));
+    int status = 0;
+    for (size_t r = 0; (r < _repeats) && (status == 0); ++r)
+    {
+        bench_result attempt;
+        status = bench_run_isolated(_task, &attempt);
+        if ( (status == 0) && ( (r == 0) || (attempt.ns_per_op < result.ns_per_op) ) )
+        {
+            result = attempt;
+        }
+    }
+    if (status < 0)
+    {
+        fprintf(stderr, "bench: %s size %lu failed\n", _name, (unsigned long)_task->size);
+        return -1;
+    }
+
+    printf("%s    {\"name\": \"%s\", \"size\": %lu, \"ns_per_op\": %.3f, \"mops_per_s\": %.3f, "
+           "\"allocs_per_op\": %.4f, \"peak_rss_kb\": %lu, \"peak_map_bytes\": %lu, \"ops\": %lu}",
+           (*_printed > 0) ? ",\n" : "", _name, (unsigned long)_task->size, result.ns_per_op,
+           1e3 / result.ns_per_op, result.allocs_per_op, (unsigned long)result.peak_rss_kb,
+           (unsigned long)result.peak_map_bytes, (unsigned long)result.ops);
+    fflush(stdout);
+    ++*_printed;
+
+    const bench_baseline *const base = bench_baseline_find(_baseline, _baseline_count, _name, _task->size);
+    if (base == NULL)
+    {
+        return 0;
+    }
+
+    const double delta = (result.ns_per_op / base->ns_per_op - 1.0) * 100.0;
+    const int regressed = (delta > _threshold);
+    fprintf(stderr, "%-32s %10lu %10.3f -> %10.3f ns/op %+7.1f%%%s\n", _name,
+            (unsigned long)_task->size, base->ns_per_op, result.ns_per_op, delta,
+            regressed ? "  REGRESSION" : "");
+    return regressed;
+}
+
+static void bench_usage(void)
+{
+    fprintf(stderr,
+            "usage: bench [--max-size N] [--filter SUBSTRING] [--repeats N] [--baseline FILE]\n"
+            "             [--threshold PERCENT] [--fail-on-regression]\n");
+}
+
+int main(int argc, char **argv)
+{
+    size_t max_size = BENCH_MAX_SIZE_DEFAULT;
+    const char *filter = NULL;
+    const char *baseline_path = NULL;
+    size_t repeats = BENCH_REPEATS;
+    double threshold = BENCH_THRESHOLD;
+    int fail_on_regression = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if ( (strcmp(argv[i], "--max-size") == 0) && (i + 1 < argc) )
+        {
+            max_size = (size_t)strtoull(argv[++i], NULL, 10);
+        } else if ( (strcmp(argv[i], "--filter") == 0) && (i + 1 < argc) ) {
+            filter = argv[++i];
+        } else if ( (strcmp(argv[i], "--repeats") == 0) && (i + 1 < argc) ) {
+            repeats = (size_t)strtoull(argv[++i], NULL, 10);
+            if (repeats == 0)
+            {
+                repeats = 1;
+            }
+        } else if ( (strcmp(argv[i], "--baseline") == 0) && (i + 1 < argc) ) {
+            baseline_path = argv[++i];
+        } else if ( (strcmp(argv[i], "--threshold") == 0) && (i + 1 < argc) ) {
+            threshold = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--fail-on-regression") == 0) {
+            fail_on_regression = 1;
+        } else {
+            bench_usage();
+            return 2;
+        }
+    }
+
+    bench_baseline *baseline = NULL;
+    size_t baseline_count = 0;
+    if (baseline_path != NULL)
+    {
+        const ptrdiff_t r_code = bench_baseline_load(baseline_path, &baseline);
+        if (r_code < 0)
+        {
+            fprintf(stderr, "bench: cannot read baseline %s\n", baseline_path);
+            return 2;
+        }
+        baseline_count = (size_t)r_code;
+    }
+
+    printf("{\n");
+    printf("  \"suite\": \"c_hash_map\",\n");
+#if defined(__VERSION__)
+    printf("  \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+    printf("  \"min_ops\": %lu,\n", (unsigned long)BENCH_MIN_OPS);
+    printf("  \"repeats\": %lu,\n", (unsigned long)repeats);
+    printf("  \"max_load_factor\": %.3f,\n", (double)BENCH_MLF);
+    printf("  \"results\": [\n");
+
+    size_t failures = 0,
+           regressions = 0,
+           printed = 0;
+
+    for (size_t e = 0; e < BENCH_ENGINES_COUNT; ++e)
+    {
+        for (size_t c = 0; c < BENCH_CASES_COUNT; ++c)
+        {
+            char name[BENCH_NAME_SIZE];
+            snprintf(name, sizeof(name), "%s/%s", bench_engines[e].name, bench_cases[c].name);
+            if ( (filter != NULL) && (strstr(name, filter) == NULL) )
+            {
+                continue;
+            }
+
+            for (size_t s = 0; (s < BENCH_SIZES_COUNT) && (bench_sizes[s] <= max_size); ++s)
+            {
+                const bench_task task = {bench_engines[e].engine, &bench_cases[c], bench_sizes[s], 0};
+                const int r_code = bench_report(name, &task, repeats, baseline, baseline_count, threshold, &printed);
+                if (r_code < 0)
+                {
+                    ++failures;
+                } else {
+                    regressions += (size_t)r_code;
+                }
+            }
+        }
+    }
+
+    for (size_t h = 0; h < BENCH_SHARED_COUNT; ++h)
+    {
+        for (size_t c = 0; c < BENCH_SHARED_CASES_COUNT; ++c)
+        {
+            for (size_t t = 0; t < BENCH_THREADS_COUNT; ++t)
+            {
+                char name[BENCH_NAME_SIZE];
+                snprintf(name, sizeof(name), "%s/%s_t%lu", bench_shared[h].name, bench_shared_cases[c].name,
+                         (unsigned long)bench_threads[t]);
+                if ( (filter != NULL) && (strstr(name, filter) == NULL) )
+                {
+                    continue;
+                }
+
+                for (size_t s = 0; (s < BENCH_SIZES_COUNT) && (bench_sizes[s] <= max_size); ++s)
+                {
+                    const bench_task task = {bench_shared[h].structure, &bench_shared_cases[c], bench_sizes[s],
+                                             bench_threads[t]};
+                    const int r_code = bench_report(name, &task, repeats, baseline, baseline_count, threshold,
+                                                    &printed);
+                    if (r_code < 0)
+                    {
+                        ++failures;
+                    } else {
+                        regressions += (size_t)r_code;
+                    }
+                }
+            }
+        }
+    }
+
+    printf("\n  ]\n}\n");
+
+    if (baseline_path != NULL)
+    {
+        fprintf(stderr, "bench: %lu regression(s) above %.1f%% against %s\n",
+                (unsigned long)regressions, threshold, baseline_path);
+    }
+    free(baseline);
+
+    if (failures > 0)
+    {
+        return 1;
+    }
+    if ( fail_on_regression && (regressions > 0) )
+    {
+        return 3;
+    }
+    return 0;
+}
@@ -12,12 +12,23 @@
     Лицензия: GPLv3
 */
 
+// clock_gettime и потоки POSIX.
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <memory.h>
+#include <time.h>
+
+#if !defined(C_HASH_MAP_NO_THREADS)
+#include <pthread.h>
+#endif
 
 #include "c_hash_map.h"
+#include "c_hash_map_group.h"
 
 // Количество слотов, задаваемое хэш-отображению с нулем слотов при автоматическом расширении.
 #define C_HASH_MAP_0 ( (size_t) 1024 )
@@ -28,8 +39,73 @@
 // Минимально допустимое значение max_load_factor.
 #define C_HASH_MAP_MLF_MAX ( (float) 1.f )
 
+// Максимально допустимая верхняя граница max_load_factor, задаваемая параметрами создания.
+#define C_HASH_MAP_MLF_CAP_MAX ( (float) 64.f )
+
+// Во сколько раз увеличивается количество слотов при автоматическом расширении по умолчанию.
+#define C_HASH_MAP_GROWTH ( (float) 1.75f )
+
+// Максимально допустимый коэф. расширения.
+#define C_HASH_MAP_GROWTH_MAX ( (float) 16.f )
+
+// Максимально допустимое значение max_load_factor для движка SWISS.
+#define C_HASH_MAP_SWISS_MLF_MAX ( (float) 0.875f )
+
+// Максимально допустимое значение max_load_factor для движка CUCKOO.
+#define C_HASH_MAP_CUCKOO_MLF_MAX ( (float) 0.97f )
+
+// Максимальное количество вершин поиска в ширину пути вытеснения движка CUCKOO
+// (пути до 3 переносов при корзинах по 8 слотов).
+#define C_HASH_MAP_CUCKOO_BFS ( (size_t) 512 )
+
+// Загрузка движка CUCKOO, ниже которой отсутствие пути вытеснения означает вырожденные хэши
+// (у множества пар одни и те же корзины): вместо расширения вставка завершается ошибкой.
+#define C_HASH_MAP_CUCKOO_MIN_LOAD ( (float) 0.5f )
+
+// Максимальное количество пар движка DENSE (номера пар в индексе 32-битные).
+#define C_HASH_MAP_DENSE_MAX ( (size_t) UINT32_MAX )
+
+// Размер искомого ключа, означающий, что ключ задан объектом, а не байтовым представлением.
+#define C_HASH_MAP_KEY_OBJECT ( (size_t) SIZE_MAX )
+
+// Иерархическое колесо сроков жизни: количество уровней и слотов уровня (слот уровня k
+// охватывает 64^k тиков, колесо целиком - 2^36 тиков, более поздние сроки ждут в списке переполнения).
+#define C_HASH_MAP_WHEEL_LEVELS ( (size_t) 6 )
+#define C_HASH_MAP_WHEEL_BITS ( (size_t) 6 )
+#define C_HASH_MAP_WHEEL_SLOTS ( (size_t) 1 << C_HASH_MAP_WHEEL_BITS )
+// Номер списка переполнения и признак узла без срока жизни.
+#define C_HASH_MAP_WHEEL_OVERFLOW ( C_HASH_MAP_WHEEL_LEVELS * C_HASH_MAP_WHEEL_SLOTS )
+#define C_HASH_MAP_WHEEL_NONE ( (size_t) SIZE_MAX )
+
+// Количество ключей, обрабатываемых пакетными функциями за один проход по этапам.
+#define C_HASH_MAP_BATCH ( (size_t) 32 )
+
+// Предвыборка строки кэша для чтения.
+#if defined(__GNUC__)
+#define C_HASH_MAP_PREFETCH(_address) __builtin_prefetch((_address), 0, 3)
+#else
+#define C_HASH_MAP_PREFETCH(_address) ( (void)(_address) )
+#endif
+
+// Максимальное количество потоков, используемых одной операцией.
+#define C_HASH_MAP_THREADS_MAX ( (size_t) 64 )
+
+// Минимальное количество пар, приходящееся на один поток c_hash_map_build.
+#define C_HASH_MAP_BUILD_PART ( (size_t) 65536 )
+
+// Минимальное количество слотов (или пар движка DENSE), приходящееся на один поток
+// параллельных обхода, очистки и перестроения.
+#define C_HASH_MAP_PARALLEL_PART ( (size_t) 65536 )
+
+// Количество узлов в блоке slab-распределителя по умолчанию.
+#define C_HASH_MAP_SLAB_NODES ( (size_t) 256 )
+
+// Размер заголовка блока slab-распределителя (с выравниванием узлов).
+#define C_HASH_MAP_CHUNK_HEADER ( (sizeof(c_hash_map_chunk) + 15) & ~(size_t)15 )
+
 typedef struct s_c_hash_map_node c_hash_map_node;
 
+// При встроенном хранении за узлом следуют копии ключа и данных.
 struct s_c_hash_map_node
 {
     struct s_c_hash_map_node *next_node;
@@ -38,6 +114,218 @@ struct s_c_hash_map_node
          *data;
 };
 
+typedef struct s_c_hash_map_chunk c_hash_map_chunk;
+
+// Заголовок блока узлов slab-распределителя, за ним следуют capacity узлов.
+struct s_c_hash_map_chunk
+{
+    struct s_c_hash_map_chunk *next_chunk;
+    size_t capacity;
+};
+
+typedef struct s_c_hash_map_slab c_hash_map_slab;
+
+// Slab-распределитель узлов.
+// Узлы выдаются последовательно из блоков, освобожденные узлы попадают в список свободных.
+// Блоки освобождаются только при удалении хэш-отображения.
+struct s_c_hash_map_slab
+{
+    // Количество узлов в новом блоке.
+    size_t chunk_nodes;
+    c_hash_map_chunk *first_chunk,
+                     *last_chunk,
+                     *current_chunk;
+    // Количество выданных узлов текущего блока.
+    size_t used;
+    // Список свободных узлов (связан через next_node).
+    c_hash_map_node *free_nodes;
+};
+
+typedef struct s_c_hash_map_index c_hash_map_index;
+
+// Параметры приведения хэша к номеру слота движка CHAIN.
+struct s_c_hash_map_index
+{
+    // Способ приведения (C_HASH_MAP_INDEX_*).
+    size_t policy;
+    // Сдвиг для C_HASH_MAP_INDEX_POW2.
+    unsigned int shift;
+    // Обратная величина количества слотов для C_HASH_MAP_INDEX_PRIME.
+    uint64_t magic;
+};
+
+typedef struct s_c_hash_map_entry c_hash_map_entry;
+
+// Слот движка SWISS.
+// При встроенном хранении за слотом следуют копии ключа и данных.
+struct s_c_hash_map_entry
+{
+    size_t hash;
+    void *key,
+         *data;
+};
+
+typedef struct s_c_hash_map_probes c_hash_map_probes;
+
+// Счетчики поисков (при C_HASH_MAP_STATS_PROBES).
+// Хранятся отдельно от хэш-отображения, так как изменяются и функциями, принимающими его как const.
+struct s_c_hash_map_probes
+{
+    size_t hits_count,
+           hit_probes,
+           misses_count,
+           miss_probes;
+};
+
+typedef struct s_c_hash_map_cache c_hash_map_cache;
+
+// Состояние режима кэша.
+// Хранится отдельно от хэш-отображения, так как счетчики и признаки обращения изменяются
+// и функциями поиска, принимающими его как const.
+struct s_c_hash_map_cache
+{
+    // Пределы количества пар и их суммарной стоимости (0 - предел не задан).
+    size_t capacity,
+           bytes;
+    // Суммарная стоимость пар.
+    size_t used;
+    // Стрелка CLOCK - номер слота, с которого продолжается вытеснение.
+    size_t hand;
+    size_t (*cost)(const void *const _key,
+                   const void *const _data);
+    void (*del_key)(void *const _key);
+    void (*del_data)(void *const _data);
+    // Счетчики успешных и неуспешных поисков и вытесненных пар.
+    size_t hits_count,
+           misses_count,
+           evictions_count;
+};
+
+typedef struct s_c_hash_map_cache_meta c_hash_map_cache_meta;
+
+// Сведения пары режима кэша, хранятся в конце узла.
+struct s_c_hash_map_cache_meta
+{
+    // Стоимость пары, учтенная в used.
+    size_t cost;
+    // Признак обращения к паре после последнего прохода стрелки.
+    size_t referenced;
+};
+
+typedef struct s_c_hash_map_ttl_meta c_hash_map_ttl_meta;
+
+// Сведения пары режима срока жизни, хранятся в узле за встроенной памятью пары.
+struct s_c_hash_map_ttl_meta
+{
+    // Соседние узлы в списке колеса.
+    struct s_c_hash_map_node *prev,
+                             *next;
+    // Момент истечения срока жизни.
+    uint64_t expire;
+    // Номер списка колеса (уровень * C_HASH_MAP_WHEEL_SLOTS + слот, C_HASH_MAP_WHEEL_OVERFLOW)
+    // или C_HASH_MAP_WHEEL_NONE, если срок жизни не задан.
+    size_t list;
+};
+
+typedef struct s_c_hash_map_wheel c_hash_map_wheel;
+
+// Иерархическое колесо сроков жизни.
+// Узел находится на нижнем уровне k, на котором срок и текущий момент попадают в одно окно
+// уровня k + 1, в слоте (срок >> 6k) & 63. Поэтому все узлы уровня находятся в слотах не раньше
+// текущего, а при переходе текущего момента в новое окно уровня k узлы его слота переносятся
+// на нижние уровни. Узлы нулевого слота текущего момента просрочены.
+// Узлы, срок которых лежит за окном верхнего уровня, находятся в списке переполнения; он
+// переносится на уровни только при переходе текущего момента в окно ближайшего из этих сроков.
+struct s_c_hash_map_wheel
+{
+    // Текущий момент колеса.
+    uint64_t current;
+    // Нижняя граница сроков узлов списка переполнения (UINT64_MAX, если список пуст).
+    uint64_t overflow_min;
+    // Количество узлов в колесе.
+    size_t count;
+    // Маски непустых слотов уровней.
+    uint64_t occupied[C_HASH_MAP_WHEEL_LEVELS];
+    // Списки слотов всех уровней и список переполнения.
+    struct s_c_hash_map_node *lists[C_HASH_MAP_WHEEL_OVERFLOW + 1];
+};
+
+typedef struct s_c_hash_map_list c_hash_map_list;
+
+// Список узлов движка CHAIN (связан через next_node).
+struct s_c_hash_map_list
+{
+    c_hash_map_node *head,
+                    *tail;
+};
+
+typedef struct s_c_hash_map_build_task c_hash_map_build_task;
+
+// Задание одного потока c_hash_map_build для движка CHAIN.
+// На первом этапе поток заполняет узлы своего диапазона пар и раскладывает их по спискам частей,
+// на втором - связывает со слотами узлы своей части (непересекающегося диапазона слотов).
+struct s_c_hash_map_build_task
+{
+    c_hash_map *hash_map;
+    const void *const *keys;
+    void *const *datas;
+    // Блок узлов всех пар.
+    uint8_t *nodes;
+    // Диапазон пар первого этапа.
+    size_t first,
+           last;
+    // Номер потока (и части второго этапа), количество частей и слотов в части.
+    size_t part,
+           parts_count,
+           part_slots;
+    // Списки узлов: lists[поток * parts_count + часть].
+    c_hash_map_list *lists;
+    size_t unique;
+    // Результаты второго этапа: количество вставленных пар и список узлов-дубликатов.
+    size_t inserted;
+    c_hash_map_list duplicates;
+};
+
+typedef struct s_c_hash_map_cuckoo_step c_hash_map_cuckoo_step;
+
+// Вершина поиска пути вытеснения движка CUCKOO: корзина, номер вершины-родителя (SIZE_MAX у двух
+// корзин вставляемой пары) и слот родителя, пара которого переносится в эту корзину.
+struct s_c_hash_map_cuckoo_step
+{
+    size_t bucket,
+           parent,
+           slot;
+};
+
+typedef struct s_c_hash_map_range_task c_hash_map_range_task;
+
+// Задание одного потока параллельных обхода, очистки и перестроения: непересекающийся диапазон
+// слотов (для обхода и очистки движка DENSE - диапазон пар).
+struct s_c_hash_map_range_task
+{
+    c_hash_map *hash_map;
+    size_t first,
+           last;
+    // Действие обхода и его контекст.
+    void (*action)(const void *const _key,
+                   void *const _data,
+                   void *const _context);
+    void *context;
+    // Функции удаления очистки и признак обнуления слотов диапазона.
+    void (*del_key)(void *const _key);
+    void (*del_data)(void *const _data);
+    size_t zero;
+    // Перестроение движка CHAIN: номер потока (и части новых слотов), количество частей и слотов
+    // в части, списки узлов lists[поток * parts_count + часть], новые слоты и приведение хэша к ним.
+    size_t part,
+           parts_count,
+           part_slots;
+    c_hash_map_list *lists;
+    c_hash_map_node **new_slots;
+    size_t new_slots_count;
+    const c_hash_map_index *new_index;
+};
+
 struct s_c_hash_map
 {
     // Функция, генерирующая хэш на основе ключа.
@@ -46,13 +334,102 @@ struct s_c_hash_map
     // В случае идентичности ключей должна возвращать > 0, иначе 0.
     size_t (*comp_key)(const void *const _key_a,
                        const void *const _key_b);
+    // Функция сравнения хранимого ключа с байтовым представлением ключа (NULL - не задана).
+    size_t (*comp_key_view)(const void *const _key,
+                            const void *const _bytes,
+                            const size_t _size);
+
+    // Движок хранения (C_HASH_MAP_ENGINE_*).
+    size_t engine;
+
+    // Функции выделения и освобождения памяти.
+    void *(*mem_alloc)(void *const _context,
+                       const size_t _size);
+    void (*mem_free)(void *const _context,
+                     void *const _memory);
+    void *mem_context;
 
     size_t slots_count,
            nodes_count;
 
     float max_load_factor;
+    // Коэф. загрузки, ниже которого хэш-отображение уменьшается после удаления (0 - не уменьшается).
+    float min_load_factor;
 
+    // Коэф. автоматического расширения.
+    float growth_factor;
+    // Количество слотов при первом автоматическом расширении.
+    size_t initial_slots;
+
+    // Приведение хэша к номеру слота движка CHAIN.
+    c_hash_map_index index;
+
+    // Слоты движка CHAIN.
     c_hash_map_node **slots;
+    // Незавершенное постепенное перестроение движка CHAIN: старые слоты, их количество,
+    // приведение хэша к ним и номер первого неперенесенного старого слота.
+    c_hash_map_node **old_slots;
+    size_t old_slots_count;
+    c_hash_map_index old_index;
+    size_t rehash_pos;
+    // Количество старых слотов, переносимых за одну вставку или удаление (0 - перестроение сразу).
+    size_t rehash_step;
+    // Сброс поколением движка CHAIN: текущее поколение (0 - режим выключен) и поколения слотов
+    // (в одном блоке памяти за slots). Слот с другим поколением считается пустым.
+    uint32_t generation;
+    uint32_t *slot_gens;
+    // Количество потоков переноса узлов при перестроении движка CHAIN (0 и 1 - без потоков).
+    size_t rehash_threads;
+
+    // Пользовательский запуск заданий в нескольких потоках (NULL - потоки создаются map_parallel).
+    void (*run_tasks)(void *const _context,
+                      void *(*const _task)(void *_arg),
+                      void *const _tasks,
+                      const size_t _task_size,
+                      const size_t _count);
+    void *run_context;
+
+    // Размеры ключа и данных, копируемых в пару (0 - хранится указатель пользователя),
+    // и смещение данных от начала встроенной памяти пары.
+    size_t key_size,
+           value_size,
+           key_stride;
+
+    // Размер узла движка CHAIN.
+    size_t node_size;
+    // Распределитель узлов движка CHAIN.
+    c_hash_map_slab slab;
+
+    // Управляющие байты движка SWISS (начало единого блока памяти, за ними следуют entries).
+    uint8_t *ctrl;
+    // Слоты движка SWISS (размером entry_size).
+    uint8_t *entries;
+    size_t entry_size;
+    // Количество слотов движка SWISS, помеченных как удаленные.
+    size_t deleted_count;
+    // Версия слотов движка CUCKOO: нечетна, пока пары переносятся по пути вытеснения или слот
+    // освобождается. Позволяет добавить оптимистичное чтение без блокировок (читатель повторяет
+    // поиск, если версия была нечетной или изменилась за время поиска).
+    size_t cuckoo_version;
+
+    // Движок DENSE: индекс - управляющие байты ctrl и номера пар offsets (в том же блоке памяти),
+    // пары хранятся в entries в порядке вставки.
+    uint32_t *offsets;
+    // Количество занятых пар entries (включая удаленные, у которых key == NULL) и их емкость.
+    size_t dense_count,
+           dense_capacity;
+
+    // Количество перестроений слотов и суммарное время перестроений (нс).
+    size_t resizes_count;
+    uint64_t resize_time;
+#if defined(C_HASH_MAP_STATS_PROBES)
+    c_hash_map_probes *probes;
+#endif
+    // Режим кэша (NULL - выключен).
+    c_hash_map_cache *cache;
+    // Режим срока жизни (NULL - выключен) и смещение сведений пары от начала узла.
+    c_hash_map_wheel *wheel;
+    size_t ttl_offset;
 };
 
 // Если расположение задано, в него помещается код.
@@ -65,506 +442,5263 @@ static void error_set(size_t *const _error,
     }
 }
 
-// Создание пустого хэш-отображения.
-// В случае ошибки возвращает NULL, и если _error != NULL, в заданное расположение помещается
-// код причины ошибки (> 0).
-// Позволяет создать хэш-отображение с нулем слотов.
-c_hash_map *c_hash_map_create(size_t (*const _hash_key)(const void *const _key),
-                              size_t (*const _comp_key)(const void *const _a_key,
-                                                         const void *const _b_key),
-                              const size_t _slots_count,
-                              const float _max_load_factor,
-                              size_t *const _error)
+// Функция выделения памяти по умолчанию.
+static void *mem_alloc_default(void *const _context,
+                               const size_t _size)
 {
-    if (_hash_key == NULL)
-    {
-        error_set(_error, 1);
-        return NULL;
-    }
-    if (_comp_key == NULL)
-    {
-        error_set(_error, 2);
-        return NULL;
-    }
-    if  ( (_max_load_factor < C_HASH_MAP_MLF_MIN) ||
-          (_max_load_factor > C_HASH_MAP_MLF_MAX) )
-    {
-        error_set(_error, 3);
-        return NULL;
-    }
+    (void)_context;
+    return malloc(_size);
+}
 
-    c_hash_map_node **new_slots = NULL;
+// Функция освобождения памяти по умолчанию.
+static void mem_free_default(void *const _context,
+                             void *const _memory)
+{
+    (void)_context;
+    free(_memory);
+}
 
-    if (_slots_count > 0)
-    {
-        // Определим размер новых слотов.
-        const size_t new_slots_size = _slots_count * sizeof(c_hash_map_node*);
-        if ( (new_slots_size == 0) ||
-             (new_slots_size / _slots_count != sizeof(c_hash_map_node*)) )
-        {
-            error_set(_error, 4);
-            return NULL;
-        }
+// Выделение памяти функцией хэш-отображения.
+static inline void *map_alloc(const c_hash_map *const _hash_map,
+                              const size_t _size)
+{
+    return _hash_map->mem_alloc(_hash_map->mem_context, _size);
+}
 
-        // Попытаемся выделить память под новые слоты.
-        new_slots = malloc(new_slots_size);
-        if (new_slots == NULL)
-        {
-            error_set(_error, 5);
-            return NULL;
-        }
-        // Обнулим слоты.
-        memset(new_slots, 0, new_slots_size);
+// Выделение обнуленной памяти функцией хэш-отображения.
+// Функция по умолчанию использует calloc, чтобы большие массивы слотов обнулялись системой
+// постранично при первом обращении, а не одним проходом в момент расширения.
+static void *map_alloc_zero(const c_hash_map *const _hash_map,
+                            const size_t _size)
+{
+    if (_hash_map->mem_alloc == mem_alloc_default)
+    {
+        return calloc(1, _size);
     }
 
-    // Попытаемся создать хэш-отображение.
-    c_hash_map *const new_hash_map = malloc(sizeof(c_hash_map));
-    if (new_hash_map == NULL)
+    void *const memory = map_alloc(_hash_map, _size);
+    if (memory != NULL)
     {
-        free(new_slots);
-        error_set(_error, 6);
-        return NULL;
+        memset(memory, 0, _size);
     }
 
-    new_hash_map->hash_key = _hash_key;
-    new_hash_map->comp_key = _comp_key;
-
-    new_hash_map->slots_count = _slots_count;
-    new_hash_map->nodes_count = 0;
-
-    new_hash_map->max_load_factor = _max_load_factor;
-
-    new_hash_map->slots = new_slots;
-
-    return new_hash_map;
+    return memory;
 }
 
-// Удаляет хэш-отображение.
-// В случае успеха возвращает > 0.
-// В случае ошибки возвращает < 0.
-ptrdiff_t c_hash_map_delete(c_hash_map *const _hash_map,
-                            void (*const _del_key)(void *const _key),
-                            void (*const _del_data)(void *const _data))
+// Освобождение памяти функцией хэш-отображения.
+// NULL допускается.
+static inline void map_free(const c_hash_map *const _hash_map,
+                            void *const _memory)
 {
-    if (c_hash_map_clear(_hash_map, _del_key, _del_data) < 0)
+    if (_memory != NULL)
     {
-        return -1;
+        _hash_map->mem_free(_hash_map->mem_context, _memory);
     }
-    free(_hash_map->slots);
-
-    free(_hash_map);
-
-    return 1;
 }
 
-// Вставка данных в хэш-отображение.
-// В случае успешной вставки возвращает > 0, ключ и данные захватываются хэш-отображением.
-// Если данные с указанным ключом уже есть в хэш-отображении, функция возвращает 0,
-// ключ и данные не захватываются хэш-отображением.
-// В случае ошибки возвращает < 0, ключ и данные не захватываются хэш-отображением.
-ptrdiff_t c_hash_map_insert(c_hash_map *const _hash_map,
-                            const void *const _key,
-                            const void *const _data)
+// Монотонное время в наносекундах.
+static uint64_t time_ns(void)
 {
-    if (_hash_map == NULL) return -1;
-    if (_key == NULL) return -2;
-    if (_data == NULL) return -3;
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#else
+    return (uint64_t)clock() * (1000000000u / CLOCKS_PER_SEC);
+#endif
+}
 
-    // Проверим, имеются ли в хэш-отображении данные с заданным ключом.
-    ptrdiff_t r_code = c_hash_map_check(_hash_map, _key);
+// Учитывает перестроение слотов, начатое в момент _begin.
+static void resize_account(c_hash_map *const _hash_map,
+                           const uint64_t _begin)
+{
+    ++_hash_map->resizes_count;
+    _hash_map->resize_time += time_ns() - _begin;
+}
 
-    // Ошибка.
-    if (r_code < 0) return -4;
+// Учет поиска с заданным количеством просмотров (узлов движка CHAIN или групп движка SWISS).
+// Счетчики увеличиваются атомарно, так как поиск может выполняться несколькими потоками.
+#if defined(C_HASH_MAP_STATS_PROBES)
+static inline void probes_account(const c_hash_map *const _hash_map,
+                                  const size_t _found,
+                                  const size_t _probes)
+{
+    c_hash_map_probes *const probes = _hash_map->probes;
+#if defined(__GNUC__)
+    if (_found != 0)
+    {
+        __atomic_fetch_add(&probes->hits_count, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&probes->hit_probes, _probes, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_add(&probes->misses_count, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&probes->miss_probes, _probes, __ATOMIC_RELAXED);
+    }
+#else
+    if (_found != 0)
+    {
+        ++probes->hits_count;
+        probes->hit_probes += _probes;
+    } else {
+        ++probes->misses_count;
+        probes->miss_probes += _probes;
+    }
+#endif
+}
+#define C_HASH_MAP_PROBES(_hash_map, _found, _probes) probes_account((_hash_map), (_found), (_probes))
+#else
+#define C_HASH_MAP_PROBES(_hash_map, _found, _probes) ( (void)(_probes) )
+#endif
+
+// Выделяет узел движка CHAIN.
+// В случае ошибки возвращает NULL.
+static c_hash_map_node *node_alloc(c_hash_map *const _hash_map)
+{
+    c_hash_map_slab *const slab = &_hash_map->slab;
 
-    // Данные уже имеются.
-    if (r_code > 0) return 0;
+    if (slab->chunk_nodes == 1)
+    {
+        return map_alloc(_hash_map, _hash_map->node_size);
+    }
 
-    // Начинаем вставлять.
+    // Сначала используем освобожденные узлы.
+    if (slab->free_nodes != NULL)
+    {
+        c_hash_map_node *const node = slab->free_nodes;
+        slab->free_nodes = node->next_node;
+        return node;
+    }
 
-    // Если слотов нет вообще.
-    if (_hash_map->slots_count == 0)
+    // Если текущий блок исчерпан, переходим к следующему (сохраненному после сброса) или выделяем новый.
+    if ( (slab->current_chunk == NULL) ||
+         (slab->used == slab->current_chunk->capacity) )
     {
-        // Попытаемся расширить слоты.
-        if (c_hash_map_resize(_hash_map, C_HASH_MAP_0) <= 0)
+        if ( (slab->current_chunk != NULL) && (slab->current_chunk->next_chunk != NULL) )
         {
-            return -5;
-        }
-    } else {
-        // Если слоты есть, то при достижении предела загруженности увеличиваем количество слотов.
-        const float load_factor = (float)_hash_map->nodes_count / _hash_map->slots_count;
-        if (load_factor >= _hash_map->max_load_factor)
-        {
-            // Определим новое количество слотов.
-            size_t new_slots_count = (size_t)(_hash_map->slots_count * 1.75f);
-            if (new_slots_count < _hash_map->slots_count)
+            slab->current_chunk = slab->current_chunk->next_chunk;
+        } else {
+            const size_t nodes_size = slab->chunk_nodes * _hash_map->node_size;
+            if ( (nodes_size / slab->chunk_nodes != _hash_map->node_size) ||
+                 (nodes_size + C_HASH_MAP_CHUNK_HEADER < nodes_size) )
             {
-                return -6;
+                return NULL;
             }
-            new_slots_count += 1;
-            if (new_slots_count == 0)
+
+            c_hash_map_chunk *const new_chunk = map_alloc(_hash_map, C_HASH_MAP_CHUNK_HEADER + nodes_size);
+            if (new_chunk == NULL)
             {
-                return -7;
+                return NULL;
             }
 
-            // Попытаемся расширить слоты.
-            if (c_hash_map_resize(_hash_map, new_slots_count) < 0)
+            new_chunk->next_chunk = NULL;
+            new_chunk->capacity = slab->chunk_nodes;
+
+            if (slab->last_chunk != NULL)
             {
-                return -8;
+                slab->last_chunk->next_chunk = new_chunk;
+            } else {
+                slab->first_chunk = new_chunk;
             }
+            slab->last_chunk = new_chunk;
+            slab->current_chunk = new_chunk;
         }
+        slab->used = 0;
     }
 
-    // Попытаемся выделить память под узел.
-    c_hash_map_node *const new_node = malloc(sizeof(c_hash_map_node));
-    if (new_node == NULL)
-    {
-        return -9;
-    }
-
-    // Неприведенный хэш ключа вставляемых данных.
-    const size_t hash = _hash_map->hash_key(_key);
-
-    // Приведенный хэш ключа вставляемых данных.
-    const size_t presented_hash = hash % _hash_map->slots_count;
+    uint8_t *const nodes = (uint8_t*)slab->current_chunk + C_HASH_MAP_CHUNK_HEADER;
+    c_hash_map_node *const node = (c_hash_map_node*)(nodes + slab->used * _hash_map->node_size);
+    ++slab->used;
 
-    // Заносим в узел непрвиеденный хэш ключа вставляемых данных.
-    new_node->hash = hash;
+    return node;
+}
 
-    // Связываем узел с ключем.
-    new_node->key = (void*)_key;
+// Освобождает узел движка CHAIN.
+static void node_free(c_hash_map *const _hash_map,
+                      c_hash_map_node *const _node)
+{
+    c_hash_map_slab *const slab = &_hash_map->slab;
 
-    // Связываем узел с данными.
-    new_node->data = (void*)_data;
+    if (slab->chunk_nodes == 1)
+    {
+        map_free(_hash_map, _node);
+        return;
+    }
 
-    // Добавляем узел в слот.
-    new_node->next_node = _hash_map->slots[presented_hash];
-    _hash_map->slots[presented_hash] = new_node;
+    _node->next_node = slab->free_nodes;
+    slab->free_nodes = _node;
+}
 
-    ++_hash_map->nodes_count;
+// Возвращает сведения режима кэша узла.
+static inline c_hash_map_cache_meta *node_cache_meta(const c_hash_map *const _hash_map,
+                                                     const c_hash_map_node *const _node)
+{
+    return (c_hash_map_cache_meta*)((uint8_t*)_node + _hash_map->node_size - sizeof(c_hash_map_cache_meta));
+}
 
-    return 1;
+// Возвращает узел по расположению его данных.
+static inline c_hash_map_node *node_of_data(void **const _data_field)
+{
+    return (c_hash_map_node*)((uint8_t*)_data_field - offsetof(c_hash_map_node, data));
 }
 
-// Удаление из хэш-отображения данных с заданным ключом.
-// В случае успешного удаления возвращает > 0.
-// В случае, если данные с заданным ключом отсутствуют, возвращает 0.
-// В случае ошибки возвращает < 0.
-ptrdiff_t c_hash_map_erase(c_hash_map *const _hash_map,
-                           const void *const _key,
-                           void (*const _del_key)(void *const _key),
-                           void (*const _del_data)(void *const _data))
+// Учет поиска в режиме кэша: найденной паре ставится признак обращения.
+// Поиск может выполняться несколькими потоками, поэтому признак и счетчики изменяются атомарно,
+// а признак записывается, только если еще не поставлен.
+static inline void cache_lookup(const c_hash_map *const _hash_map,
+                                c_hash_map_node *const _node)
 {
-    if (_hash_map == NULL) return -1;
-    if (_key == NULL) return -2;
+    c_hash_map_cache *const cache = _hash_map->cache;
+#if defined(__GNUC__)
+    if (_node != NULL)
+    {
+        c_hash_map_cache_meta *const meta = node_cache_meta(_hash_map, _node);
+        if (__atomic_load_n(&meta->referenced, __ATOMIC_RELAXED) == 0)
+        {
+            __atomic_store_n(&meta->referenced, 1, __ATOMIC_RELAXED);
+        }
+        __atomic_fetch_add(&cache->hits_count, 1, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_add(&cache->misses_count, 1, __ATOMIC_RELAXED);
+    }
+#else
+    if (_node != NULL)
+    {
+        node_cache_meta(_hash_map, _node)->referenced = 1;
+        ++cache->hits_count;
+    } else {
+        ++cache->misses_count;
+    }
+#endif
+}
 
-    if (_hash_map->nodes_count == 0) return 0;
+// Превышен ли в режиме кэша хотя бы один из пределов.
+static inline size_t cache_over(const c_hash_map *const _hash_map)
+{
+    const c_hash_map_cache *const cache = _hash_map->cache;
 
-    // Вычислим неприведенный хэш ключа удаляемых данных.
-    const size_t hash = _hash_map->hash_key(_key);
+    return ( ( (cache->capacity > 0) && (_hash_map->nodes_count > cache->capacity) ) ||
+             ( (cache->bytes > 0) && (cache->used > cache->bytes) ) ) ? 1 : 0;
+}
 
-    // Вычислим приведенный хэш ключа удаляемых данных.
-    const size_t presented_hash = hash % _hash_map->slots_count;
+// Возвращает сведения режима срока жизни узла.
+static inline c_hash_map_ttl_meta *node_ttl_meta(const c_hash_map *const _hash_map,
+                                                 const c_hash_map_node *const _node)
+{
+    return (c_hash_map_ttl_meta*)((uint8_t*)_node + _hash_map->ttl_offset);
+}
 
-    // Если требуемый слот пуст, значит данных с таким ключом в хэш-отображении нет.
-    if (_hash_map->slots[presented_hash] == NULL)
+// Возвращает номер списка колеса для заданного срока (см. c_hash_map_wheel).
+// Просроченный узел помещается в нулевой слот текущего момента.
+static size_t wheel_list_of(const c_hash_map_wheel *const _wheel,
+                            const uint64_t _expire)
+{
+    if (_expire <= _wheel->current)
     {
-        return 0;
+        return (size_t)(_wheel->current & (C_HASH_MAP_WHEEL_SLOTS - 1));
     }
 
-    // Просмотр слота на наличие данных с заданным ключом.
-    c_hash_map_node *select_node = _hash_map->slots[presented_hash],
-                    *prev_node = NULL;
-
-    while (select_node != NULL)
+    for (size_t k = 0; k < C_HASH_MAP_WHEEL_LEVELS; ++k)
     {
-        if (hash == select_node->hash)
+        const size_t shift = C_HASH_MAP_WHEEL_BITS * (k + 1);
+        if ( (_expire >> shift) == (_wheel->current >> shift) )
         {
-            if (_hash_map->comp_key(_key, select_node->key) > 0)
-            {
-                // Удаляем данный узел.
-
-                // Ампутация узла из слота.
-                if (prev_node != NULL)
-                {
-                    prev_node->next_node = select_node->next_node;
-                } else {
-                    _hash_map->slots[presented_hash] = select_node->next_node;
-                }
+            return k * C_HASH_MAP_WHEEL_SLOTS +
+                   (size_t)((_expire >> (C_HASH_MAP_WHEEL_BITS * k)) & (C_HASH_MAP_WHEEL_SLOTS - 1));
+        }
+    }
 
-                // Если для ключа задана функция удаления, вызываем ее.
-                if (_del_key != NULL)
-                {
-                    _del_key( select_node->key );
-                }
+    return C_HASH_MAP_WHEEL_OVERFLOW;
+}
 
-                // Если для данных задана функция удаления, вызываем ее.
-                if (_del_data != NULL)
-                {
-                    _del_data( select_node->data );
-                }
+// Добавляет узел в список колеса по сроку, записанному в его сведениях.
+static void wheel_link(const c_hash_map *const _hash_map,
+                       c_hash_map_node *const _node)
+{
+    c_hash_map_wheel *const wheel = _hash_map->wheel;
+    c_hash_map_ttl_meta *const meta = node_ttl_meta(_hash_map, _node);
 
-                // Удаляем узел.
-                free(select_node);
+    const size_t list = wheel_list_of(wheel, meta->expire);
 
-                --_hash_map->nodes_count;
+    meta->list = list;
+    meta->prev = NULL;
+    meta->next = wheel->lists[list];
+    if (meta->next != NULL)
+    {
+        node_ttl_meta(_hash_map, meta->next)->prev = _node;
+    }
+    wheel->lists[list] = _node;
 
-                return 1;
+    if (list < C_HASH_MAP_WHEEL_OVERFLOW)
+    {
+        wheel->occupied[list / C_HASH_MAP_WHEEL_SLOTS] |= (uint64_t)1 << (list % C_HASH_MAP_WHEEL_SLOTS);
+    } else if (meta->expire < wheel->overflow_min) {
+        wheel->overflow_min = meta->expire;
+    }
+
+    ++wheel->count;
+}
+
+// Исключает узел из списка колеса (если у него задан срок жизни).
+static void wheel_unlink(const c_hash_map *const _hash_map,
+                         c_hash_map_node *const _node)
+{
+    c_hash_map_wheel *const wheel = _hash_map->wheel;
+    c_hash_map_ttl_meta *const meta = node_ttl_meta(_hash_map, _node);
+
+    const size_t list = meta->list;
+    if (list == C_HASH_MAP_WHEEL_NONE)
+    {
+        return;
+    }
+
+    if (meta->prev != NULL)
+    {
+        node_ttl_meta(_hash_map, meta->prev)->next = meta->next;
+    } else {
+        wheel->lists[list] = meta->next;
+    }
+    if (meta->next != NULL)
+    {
+        node_ttl_meta(_hash_map, meta->next)->prev = meta->prev;
+    }
+
+    if (wheel->lists[list] == NULL)
+    {
+        if (list < C_HASH_MAP_WHEEL_OVERFLOW)
+        {
+            wheel->occupied[list / C_HASH_MAP_WHEEL_SLOTS] &= ~((uint64_t)1 << (list % C_HASH_MAP_WHEEL_SLOTS));
+        } else {
+            wheel->overflow_min = UINT64_MAX;
+        }
+    }
+
+    meta->list = C_HASH_MAP_WHEEL_NONE;
+    --wheel->count;
+}
+
+// Переводит ссылки колеса на узел, скопированный по новому адресу (соседи по списку и начало
+// списка продолжают указывать на прежний адрес).
+static void wheel_relocate(const c_hash_map *const _hash_map,
+                           c_hash_map_node *const _node)
+{
+    const c_hash_map_ttl_meta *const meta = node_ttl_meta(_hash_map, _node);
+
+    if (meta->list == C_HASH_MAP_WHEEL_NONE)
+    {
+        return;
+    }
+
+    if (meta->prev != NULL)
+    {
+        node_ttl_meta(_hash_map, meta->prev)->next = _node;
+    } else {
+        _hash_map->wheel->lists[meta->list] = _node;
+    }
+    if (meta->next != NULL)
+    {
+        node_ttl_meta(_hash_map, meta->next)->prev = _node;
+    }
+}
+
+// Переносит все узлы списка колеса заново по их срокам (относительно текущего момента).
+static void wheel_cascade(const c_hash_map *const _hash_map,
+                          const size_t _list)
+{
+    c_hash_map_wheel *const wheel = _hash_map->wheel;
+
+    c_hash_map_node *select_node = wheel->lists[_list],
+                    *cascade_node;
+
+    wheel->lists[_list] = NULL;
+    if (_list < C_HASH_MAP_WHEEL_OVERFLOW)
+    {
+        wheel->occupied[_list / C_HASH_MAP_WHEEL_SLOTS] &= ~((uint64_t)1 << (_list % C_HASH_MAP_WHEEL_SLOTS));
+    } else {
+        // Граница вычисляется заново по узлам, оставшимся в списке.
+        wheel->overflow_min = UINT64_MAX;
+    }
+
+    while (select_node != NULL)
+    {
+        cascade_node = select_node;
+        select_node = node_ttl_meta(_hash_map, select_node)->next;
+
+        --wheel->count;
+        wheel_link(_hash_map, cascade_node);
+    }
+}
+
+// Возвращает ближайший момент после текущего, но не позже _now, в который колесу есть что
+// делать: наступает срок узлов нулевого уровня или узлы слота верхнего уровня (или списка
+// переполнения, начиная с окна его ближайшего срока) нужно перенести вниз.
+// Если такого момента нет, возвращает _now.
+static uint64_t wheel_next(const c_hash_map_wheel *const _wheel,
+                           const uint64_t _now)
+{
+    uint64_t next = _now;
+
+    for (size_t k = 0; k < C_HASH_MAP_WHEEL_LEVELS; ++k)
+    {
+        const size_t shift = C_HASH_MAP_WHEEL_BITS * k;
+        const size_t index = (size_t)((_wheel->current >> shift) & (C_HASH_MAP_WHEEL_SLOTS - 1));
+
+        // Непустые слоты после текущего.
+        const uint64_t later = (index + 1 < C_HASH_MAP_WHEEL_SLOTS) ?
+                               _wheel->occupied[k] & (~(uint64_t)0 << (index + 1)) : 0;
+        if (later != 0)
+        {
+            const size_t window = shift + C_HASH_MAP_WHEEL_BITS;
+            const uint64_t moment = ((_wheel->current >> window) << window) |
+                                    ((uint64_t)c_hash_map_ctz64(later) << shift);
+            if (moment < next)
+            {
+                next = moment;
+            }
+        }
+    }
+
+    if (_wheel->lists[C_HASH_MAP_WHEEL_OVERFLOW] != NULL)
+    {
+        // Окна верхнего уровня до окна ближайшего срока пропускаются целиком.
+        const size_t window = C_HASH_MAP_WHEEL_BITS * C_HASH_MAP_WHEEL_LEVELS;
+        const uint64_t moment = (_wheel->overflow_min >> window) << window;
+        if (moment < next)
+        {
+            next = moment;
+        }
+    }
+
+    return next;
+}
+
+// Переводит колесо в момент _moment (не раньше текущего, промежуточные моменты колесу не нужны,
+// см. wheel_next): узлы слотов, окна которых начались, переносятся на нижние уровни.
+static void wheel_advance(const c_hash_map *const _hash_map,
+                          const uint64_t _moment)
+{
+    c_hash_map_wheel *const wheel = _hash_map->wheel;
+
+    const uint64_t previous = wheel->current;
+    wheel->current = _moment;
+
+    // Список переполнения переносится, только когда наступило окно его ближайшего срока.
+    const size_t window = C_HASH_MAP_WHEEL_BITS * C_HASH_MAP_WHEEL_LEVELS;
+    if ( (wheel->lists[C_HASH_MAP_WHEEL_OVERFLOW] != NULL) &&
+         ((_moment >> window) >= (wheel->overflow_min >> window)) )
+    {
+        wheel_cascade(_hash_map, C_HASH_MAP_WHEEL_OVERFLOW);
+    }
+
+    for (size_t k = C_HASH_MAP_WHEEL_LEVELS - 1; k > 0; --k)
+    {
+        const size_t shift = C_HASH_MAP_WHEEL_BITS * k;
+        if ( (_moment >> shift) != (previous >> shift) )
+        {
+            wheel_cascade(_hash_map, k * C_HASH_MAP_WHEEL_SLOTS +
+                                     (size_t)((_moment >> shift) & (C_HASH_MAP_WHEEL_SLOTS - 1)));
+        }
+    }
+}
+
+// Опустошает колесо (все узлы удаляются разом), текущий момент сохраняется.
+static void wheel_reset(c_hash_map_wheel *const _wheel)
+{
+    memset(_wheel->occupied, 0, sizeof(_wheel->occupied));
+    memset(_wheel->lists, 0, sizeof(_wheel->lists));
+    _wheel->overflow_min = UINT64_MAX;
+    _wheel->count = 0;
+}
+
+// Снимает удаляемый узел с учета режимов кэша и срока жизни.
+static inline void node_detach(c_hash_map *const _hash_map,
+                               c_hash_map_node *const _node)
+{
+    if (_hash_map->cache != NULL)
+    {
+        _hash_map->cache->used -= node_cache_meta(_hash_map, _node)->cost;
+    }
+    if (_hash_map->wheel != NULL)
+    {
+        wheel_unlink(_hash_map, _node);
+    }
+}
+
+// Возвращает все узлы в распределитель разом, сохраняя выделенные блоки для повторного использования.
+// Допустимо, только если ни один узел больше не используется.
+static void slab_reset(c_hash_map *const _hash_map)
+{
+    c_hash_map_slab *const slab = &_hash_map->slab;
+
+    slab->current_chunk = slab->first_chunk;
+    slab->used = 0;
+    slab->free_nodes = NULL;
+}
+
+// Освобождает все блоки распределителя.
+static void slab_release(c_hash_map *const _hash_map)
+{
+    c_hash_map_slab *const slab = &_hash_map->slab;
+
+    c_hash_map_chunk *select_chunk = slab->first_chunk,
+                     *delete_chunk;
+    while (select_chunk != NULL)
+    {
+        delete_chunk = select_chunk;
+        select_chunk = select_chunk->next_chunk;
+        map_free(_hash_map, delete_chunk);
+    }
+
+    slab->first_chunk = NULL;
+    slab->last_chunk = NULL;
+    slab_reset(_hash_map);
+}
+
+// Выделяет блок из _count узлов движка CHAIN и делает его текущим блоком распределителя,
+// все узлы блока считаются выданными.
+// Невыданные узлы прежнего текущего блока переносятся в список свободных.
+// В случае ошибки возвращает NULL.
+static uint8_t *slab_reserve(c_hash_map *const _hash_map,
+                             const size_t _count)
+{
+    c_hash_map_slab *const slab = &_hash_map->slab;
+
+    const size_t nodes_size = _count * _hash_map->node_size;
+    if ( (nodes_size / _count != _hash_map->node_size) ||
+         (nodes_size + C_HASH_MAP_CHUNK_HEADER < nodes_size) )
+    {
+        return NULL;
+    }
+
+    c_hash_map_chunk *const new_chunk = map_alloc(_hash_map, C_HASH_MAP_CHUNK_HEADER + nodes_size);
+    if (new_chunk == NULL)
+    {
+        return NULL;
+    }
+    new_chunk->capacity = _count;
+
+    if (slab->current_chunk != NULL)
+    {
+        uint8_t *const nodes = (uint8_t*)slab->current_chunk + C_HASH_MAP_CHUNK_HEADER;
+        for (size_t i = slab->used; i < slab->current_chunk->capacity; ++i)
+        {
+            c_hash_map_node *const node = (c_hash_map_node*)(nodes + i * _hash_map->node_size);
+            node->next_node = slab->free_nodes;
+            slab->free_nodes = node;
+        }
+
+        // Блоки после текущего еще не использовались, новый блок ставится перед ними.
+        new_chunk->next_chunk = slab->current_chunk->next_chunk;
+        slab->current_chunk->next_chunk = new_chunk;
+        if (slab->last_chunk == slab->current_chunk)
+        {
+            slab->last_chunk = new_chunk;
+        }
+    } else {
+        new_chunk->next_chunk = NULL;
+        slab->first_chunk = new_chunk;
+        slab->last_chunk = new_chunk;
+    }
+
+    slab->current_chunk = new_chunk;
+    slab->used = _count;
+
+    return (uint8_t*)new_chunk + C_HASH_MAP_CHUNK_HEADER;
+}
+
+// Выполняет _task над каждым из _count элементов массива _tasks (размер элемента _task_size).
+// Если задан пользовательский запуск заданий (run_tasks), элементы передаются ему.
+// Иначе все элементы, кроме первого, обрабатываются в отдельных потоках, первый - в вызывающем потоке.
+// Если поток создать не удалось (или потоки недоступны), элемент обрабатывается в вызывающем потоке.
+// Функция возвращается после обработки всех элементов.
+static void map_parallel(const c_hash_map *const _hash_map,
+                         void *(*const _task)(void *_arg),
+                         void *const _tasks,
+                         const size_t _task_size,
+                         const size_t _count)
+{
+    uint8_t *const tasks = _tasks;
+
+    if (_count == 1)
+    {
+        _task(tasks);
+        return;
+    }
+    if (_hash_map->run_tasks != NULL)
+    {
+        _hash_map->run_tasks(_hash_map->run_context, _task, _tasks, _task_size, _count);
+        return;
+    }
+
+#if !defined(C_HASH_MAP_NO_THREADS)
+    pthread_t threads[C_HASH_MAP_THREADS_MAX];
+    size_t started[C_HASH_MAP_THREADS_MAX];
+
+    for (size_t t = 1; t < _count; ++t)
+    {
+        started[t] = (pthread_create(&threads[t], NULL, _task, tasks + t * _task_size) == 0) ? 1 : 0;
+    }
+
+    _task(tasks);
+
+    for (size_t t = 1; t < _count; ++t)
+    {
+        if (started[t] == 1)
+        {
+            pthread_join(threads[t], NULL);
+        } else {
+            _task(tasks + t * _task_size);
+        }
+    }
+#else
+    for (size_t t = 0; t < _count; ++t)
+    {
+        _task(tasks + t * _task_size);
+    }
+#endif
+}
+
+// Старшая половина 128-битного произведения.
+static inline uint64_t mulhi64(const uint64_t _a,
+                               const uint64_t _b)
+{
+#if defined(__SIZEOF_INT128__)
+    return (uint64_t)( ((unsigned __int128)_a * _b) >> 64 );
+#else
+    const uint64_t a_lo = (uint32_t)_a,
+                   a_hi = _a >> 32,
+                   b_lo = (uint32_t)_b,
+                   b_hi = _b >> 32;
+    const uint64_t lo_lo = a_lo * b_lo,
+                   hi_lo = a_hi * b_lo,
+                   lo_hi = a_lo * b_hi,
+                   hi_hi = a_hi * b_hi;
+    const uint64_t cross = (lo_lo >> 32) + (uint32_t)hi_lo + lo_hi;
+    return hi_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+// Проверка числа на простоту.
+static size_t is_prime(const size_t _n)
+{
+    if (_n < 2) return 0;
+    if (_n < 4) return 1;
+    if ( (_n % 2) == 0 ) return 0;
+
+    for (size_t d = 3; d <= _n / d; d += 2)
+    {
+        if ( (_n % d) == 0 )
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// Приводит количество слотов к допустимому для заданного способа приведения хэша.
+// В случае переполнения возвращает 0.
+static size_t index_round(const size_t _policy,
+                          const size_t _slots_count)
+{
+    switch (_policy)
+    {
+        case C_HASH_MAP_INDEX_POW2:
+        {
+            size_t count = 2;
+            while (count < _slots_count)
+            {
+                if (count > SIZE_MAX / 2)
+                {
+                    return 0;
+                }
+                count *= 2;
+            }
+            return count;
+        }
+        case C_HASH_MAP_INDEX_PRIME:
+        {
+            size_t count = (_slots_count < 2) ? 2 : _slots_count;
+            while (is_prime(count) == 0)
+            {
+                ++count;
+            }
+            if ( (uint64_t)count > UINT32_MAX )
+            {
+                return 0;
+            }
+            return count;
+        }
+        default:
+        {
+            return _slots_count;
+        }
+    }
+}
+
+// Вычисляет параметры приведения хэша для заданного (допустимого) количества слотов.
+static void index_setup(c_hash_map_index *const _index,
+                        const size_t _slots_count)
+{
+    _index->shift = 64;
+    _index->magic = 0;
+
+    if (_slots_count == 0)
+    {
+        return;
+    }
+
+    if (_index->policy == C_HASH_MAP_INDEX_POW2)
+    {
+        for (size_t count = _slots_count; count > 1; count >>= 1)
+        {
+            --_index->shift;
+        }
+    }
+
+    if (_index->policy == C_HASH_MAP_INDEX_PRIME)
+    {
+        _index->magic = UINT64_MAX / _slots_count + 1;
+    }
+}
+
+// Приводит хэш к номеру слота движка CHAIN.
+static inline size_t index_of(const c_hash_map_index *const _index,
+                              const size_t _slots_count,
+                              const size_t _hash)
+{
+    switch (_index->policy)
+    {
+        case C_HASH_MAP_INDEX_POW2:
+        {
+            return (size_t)( ((uint64_t)_hash * C_HASH_MAP_FIB) >> _index->shift );
+        }
+        case C_HASH_MAP_INDEX_FASTRANGE:
+        {
+            return (size_t)mulhi64(c_hash_map_mix(_hash), (uint64_t)_slots_count);
+        }
+        case C_HASH_MAP_INDEX_PRIME:
+        {
+            const uint32_t folded = (uint32_t)( (uint64_t)_hash ^ ((uint64_t)_hash >> 32) );
+            return (size_t)mulhi64(_index->magic * folded, (uint64_t)_slots_count);
+        }
+        default:
+        {
+            return _hash % _slots_count;
+        }
+    }
+}
+
+// Размер памяти под заданное количество слотов движка CHAIN (в режиме сброса поколением
+// вместе с поколениями слотов).
+// В случае переполнения возвращает 0.
+static size_t chain_slots_size(const c_hash_map *const _hash_map,
+                               const size_t _slots_count)
+{
+    const size_t slot_size = sizeof(c_hash_map_node*) + ((_hash_map->generation > 0) ? sizeof(uint32_t) : 0);
+    if ( (_slots_count == 0) || (_slots_count > SIZE_MAX / slot_size) )
+    {
+        return 0;
+    }
+
+    return _slots_count * slot_size;
+}
+
+// Помечает новые слоты движка CHAIN текущим поколением.
+// Возвращает расположение поколений слотов (NULL, если режим сброса поколением выключен).
+static uint32_t *chain_slots_stamp(const c_hash_map *const _hash_map,
+                                   c_hash_map_node **const _slots,
+                                   const size_t _slots_count)
+{
+    if (_hash_map->generation == 0)
+    {
+        return NULL;
+    }
+
+    uint32_t *const slot_gens = (uint32_t*)(_slots + _slots_count);
+    for (size_t s = 0; s < _slots_count; ++s)
+    {
+        slot_gens[s] = _hash_map->generation;
+    }
+
+    return slot_gens;
+}
+
+// Первый узел цепочки слота движка CHAIN (слот прошлого поколения пуст).
+static inline c_hash_map_node *chain_head(const c_hash_map *const _hash_map,
+                                          const size_t _slot)
+{
+    if ( (_hash_map->generation != 0) && (_hash_map->slot_gens[_slot] != _hash_map->generation) )
+    {
+        return NULL;
+    }
+
+    return _hash_map->slots[_slot];
+}
+
+// Расположение указателя на первый узел цепочки слота движка CHAIN для изменения цепочки.
+// Слот прошлого поколения перед этим очищается и переводится в текущее поколение.
+static inline c_hash_map_node **chain_head_link(const c_hash_map *const _hash_map,
+                                                const size_t _slot)
+{
+    if ( (_hash_map->generation != 0) && (_hash_map->slot_gens[_slot] != _hash_map->generation) )
+    {
+        _hash_map->slots[_slot] = NULL;
+        _hash_map->slot_gens[_slot] = _hash_map->generation;
+    }
+
+    return &_hash_map->slots[_slot];
+}
+
+// Сравнение ключей функцией comp_key или, если она не задана, побайтно (встроенные ключи).
+// В случае идентичности ключей возвращает > 0, иначе 0.
+static inline size_t key_equal(const c_hash_map *const _hash_map,
+                               const void *const _key_a,
+                               const void *const _key_b)
+{
+    if (_hash_map->comp_key != NULL)
+    {
+        return (_hash_map->comp_key(_key_a, _key_b) > 0) ? 1 : 0;
+    }
+
+    // Ключи размером в одно и два машинных слова сравниваются словами.
+    uint64_t a[2],
+             b[2];
+    switch (_hash_map->key_size)
+    {
+    case 8:
+        memcpy(a, _key_a, 8);
+        memcpy(b, _key_b, 8);
+        return (a[0] == b[0]) ? 1 : 0;
+    case 16:
+        memcpy(a, _key_a, 16);
+        memcpy(b, _key_b, 16);
+        return ( ((a[0] ^ b[0]) | (a[1] ^ b[1])) == 0 ) ? 1 : 0;
+    default:
+        return (memcmp(_key_a, _key_b, _hash_map->key_size) == 0) ? 1 : 0;
+    }
+}
+
+// Сравнение искомого ключа с хранимым.
+// Искомый ключ задан объектом (_key_size == C_HASH_MAP_KEY_OBJECT) или байтовым представлением
+// размером _key_size: оно сравнивается функцией comp_key_view или, если она не задана, побайтно
+// со встроенным ключом.
+// В случае идентичности ключей возвращает > 0, иначе 0.
+static inline size_t key_match(const c_hash_map *const _hash_map,
+                               const void *const _key,
+                               const size_t _key_size,
+                               const void *const _stored_key)
+{
+    if (_key_size == C_HASH_MAP_KEY_OBJECT)
+    {
+        return key_equal(_hash_map, _key, _stored_key);
+    }
+
+    if (_hash_map->comp_key_view != NULL)
+    {
+        return (_hash_map->comp_key_view(_stored_key, _key, _key_size) > 0) ? 1 : 0;
+    }
+
+    return ( (_key_size == _hash_map->key_size) &&
+             (memcmp(_key, _stored_key, _key_size) == 0) ) ? 1 : 0;
+}
+
+// Заносит ключ новой пары и обнуляет ее данные.
+// При встроенном хранении ключ копируется во встроенную память пары _inline, а данные
+// указывают на обнуленную встроенную память за ключом.
+static inline void pair_init(const c_hash_map *const _hash_map,
+                             void **const _key_field,
+                             void **const _data_field,
+                             uint8_t *const _inline,
+                             const void *const _key)
+{
+    if (_hash_map->key_size > 0)
+    {
+        memcpy(_inline, _key, _hash_map->key_size);
+        *_key_field = _inline;
+    } else {
+        *_key_field = (void*)_key;
+    }
+
+    if (_hash_map->value_size > 0)
+    {
+        memset(_inline + _hash_map->key_stride, 0, _hash_map->value_size);
+        *_data_field = _inline + _hash_map->key_stride;
+    } else {
+        *_data_field = NULL;
+    }
+}
+
+// Заносит данные пары (при встроенном хранении копирует их).
+static inline void pair_set_data(const c_hash_map *const _hash_map,
+                                 void **const _data_field,
+                                 const void *const _data)
+{
+    if (_hash_map->value_size > 0)
+    {
+        memcpy(*_data_field, _data, _hash_map->value_size);
+    } else {
+        *_data_field = (void*)_data;
+    }
+}
+
+// Возвращает слот движка SWISS с заданным номером.
+static inline c_hash_map_entry *swiss_entry(const c_hash_map *const _hash_map,
+                                            const size_t _s)
+{
+    return (c_hash_map_entry*)(_hash_map->entries + _s * _hash_map->entry_size);
+}
+
+// Выделяет единый блок памяти под управляющие байты и слоты движка SWISS.
+// Все управляющие байты помечаются как пустые.
+// В случае ошибки возвращает NULL.
+static uint8_t *swiss_alloc(const c_hash_map *const _hash_map,
+                            const size_t _capacity)
+{
+    const size_t entries_size = _capacity * _hash_map->entry_size;
+    if ( (entries_size / _capacity != _hash_map->entry_size) ||
+         (entries_size + _capacity < entries_size) )
+    {
+        return NULL;
+    }
+
+    uint8_t *const new_ctrl = map_alloc(_hash_map, _capacity + entries_size);
+    if (new_ctrl == NULL)
+    {
+        return NULL;
+    }
+
+    memset(new_ctrl, C_HASH_MAP_CTRL_EMPTY, _capacity);
+
+    return new_ctrl;
+}
+
+// Искомый ключ пробирования движков SWISS и DENSE (см. index_eq).
+typedef struct s_c_hash_map_probe
+{
+    const c_hash_map *hash_map;
+    size_t hash;
+    const void *key;
+    size_t key_size,
+           dense;
+} c_hash_map_probe;
+
+// Проверка слота-кандидата движка SWISS (или слота индекса движка DENSE) для c_hash_map_group_find.
+static inline size_t index_eq(const void *const _context,
+                              const size_t _s)
+{
+    const c_hash_map_probe *const probe = (const c_hash_map_probe*)_context;
+    const c_hash_map *const hash_map = probe->hash_map;
+
+    const c_hash_map_entry *const entry = swiss_entry(hash_map, probe->dense ? hash_map->offsets[_s] : _s);
+
+    return ( (entry->hash == probe->hash) &&
+             (key_match(hash_map, probe->key, probe->key_size, entry->key) > 0) ) ? 1 : 0;
+}
+
+// Ищет слот движка SWISS (или слот индекса движка DENSE при _dense != 0) с заданным ключом
+// (объектом или байтовым представлением, см. key_match).
+// Если слот не найден, возвращает SIZE_MAX.
+// Если _free_slot != NULL, в него помещается первый свободный слот, встреченный на пути поиска
+// (или SIZE_MAX, если такого нет).
+static inline size_t index_find(const c_hash_map *const _hash_map,
+                                const size_t _hash,
+                                const void *const _key,
+                                const size_t _key_size,
+                                size_t *const _free_slot,
+                                const size_t _dense)
+{
+    const c_hash_map_probe probe = {_hash_map, _hash, _key, _key_size, _dense};
+
+    size_t probes;
+    const size_t s = c_hash_map_group_find(_hash_map->ctrl, _hash_map->slots_count, c_hash_map_mix(_hash),
+                                           index_eq, &probe, _free_slot, &probes);
+    if (probes > 0)
+    {
+        C_HASH_MAP_PROBES(_hash_map, (s != SIZE_MAX) ? 1 : 0, probes);
+    }
+
+    return s;
+}
+
+// Ищет слот движка SWISS с заданным ключом (см. index_find).
+static size_t swiss_find(const c_hash_map *const _hash_map,
+                         const size_t _hash,
+                         const void *const _key,
+                         size_t *const _free_slot)
+{
+    return index_find(_hash_map, _hash, _key, C_HASH_MAP_KEY_OBJECT, _free_slot, 0);
+}
+
+// Ищет слот индекса движка DENSE с заданным ключом (см. index_find).
+static size_t dense_find(const c_hash_map *const _hash_map,
+                         const size_t _hash,
+                         const void *const _key,
+                         size_t *const _free_slot)
+{
+    return index_find(_hash_map, _hash, _key, C_HASH_MAP_KEY_OBJECT, _free_slot, 1);
+}
+
+// Направляет ключ и данные перемещенного слота на его встроенную память.
+static inline void entry_retarget(const c_hash_map *const _hash_map,
+                                  c_hash_map_entry *const _entry)
+{
+    if (_hash_map->key_size > 0)
+    {
+        _entry->key = _entry + 1;
+    }
+    if (_hash_map->value_size > 0)
+    {
+        _entry->data = (uint8_t*)(_entry + 1) + _hash_map->key_stride;
+    }
+}
+
+// Перестраивает слоты движка SWISS под заданное количество слотов (степень двойки).
+// Удаленные слоты при этом исчезают.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+static ptrdiff_t swiss_rehash(c_hash_map *const _hash_map,
+                              const size_t _capacity)
+{
+    const uint64_t begin = time_ns();
+
+    uint8_t *const new_ctrl = swiss_alloc(_hash_map, _capacity);
+    if (new_ctrl == NULL)
+    {
+        return -1;
+    }
+    uint8_t *const new_entries = new_ctrl + _capacity;
+
+    size_t count = _hash_map->nodes_count;
+    for (size_t s = 0; (s < _hash_map->slots_count)&&(count > 0); ++s)
+    {
+        if ( (_hash_map->ctrl[s] & 0x80) == 0 )
+        {
+            const c_hash_map_entry *const entry = swiss_entry(_hash_map, s);
+            const uint64_t mixed = c_hash_map_mix(entry->hash);
+            const size_t new_s = c_hash_map_group_find_free(new_ctrl, _capacity, mixed);
+
+            new_ctrl[new_s] = c_hash_map_h2(mixed);
+
+            c_hash_map_entry *const new_entry = (c_hash_map_entry*)(new_entries + new_s * _hash_map->entry_size);
+            memcpy(new_entry, entry, _hash_map->entry_size);
+
+            // Встроенные ключ и данные переместились вместе со слотом.
+            entry_retarget(_hash_map, new_entry);
+
+            --count;
+        }
+    }
+
+    map_free(_hash_map, _hash_map->ctrl);
+
+    _hash_map->ctrl = new_ctrl;
+    _hash_map->entries = new_entries;
+    _hash_map->slots_count = _capacity;
+    _hash_map->deleted_count = 0;
+
+    resize_account(_hash_map, begin);
+
+    return 1;
+}
+
+// Обеспечивает наличие места под еще одну пару в движке SWISS.
+// Если место было обеспечено перестройкой слотов, возвращает > 0.
+// Если перестройка не потребовалась, возвращает 0.
+// В случае ошибки возвращает < 0.
+static ptrdiff_t swiss_reserve_one(c_hash_map *const _hash_map)
+{
+    if (_hash_map->slots_count == 0)
+    {
+        const size_t capacity = c_hash_map_group_capacity(_hash_map->initial_slots);
+        if (capacity == 0)
+        {
+            return -1;
+        }
+        return (swiss_rehash(_hash_map, capacity) > 0) ? 1 : -1;
+    }
+
+    if (c_hash_map_group_overloaded(_hash_map->slots_count, _hash_map->nodes_count,
+                                    _hash_map->deleted_count, _hash_map->max_load_factor) == 0)
+    {
+        return 0;
+    }
+
+    size_t new_capacity = _hash_map->slots_count;
+    if (c_hash_map_group_grow(_hash_map->slots_count, _hash_map->nodes_count, _hash_map->max_load_factor) != 0)
+    {
+        const double grown = (double)_hash_map->slots_count * _hash_map->growth_factor + 1;
+        if (grown >= (double)SIZE_MAX)
+        {
+            return -2;
+        }
+        new_capacity = c_hash_map_group_capacity((size_t)grown);
+        if (new_capacity == 0)
+        {
+            return -2;
+        }
+    }
+
+    return (swiss_rehash(_hash_map, new_capacity) > 0) ? 1 : -3;
+}
+
+// Поиск ключа в движке SWISS с вставкой при его отсутствии (за одно пробирование).
+// Если ключ вставлен, возвращает > 0, в слот заносятся хэш и ключ, данные обнуляются.
+// Если ключ уже есть, возвращает 0.
+// В обоих случаях в _slot помещается номер слота ключа.
+// В случае ошибки возвращает < 0.
+static ptrdiff_t swiss_emplace(c_hash_map *const _hash_map,
+                               const void *const _key,
+                               const size_t _hash,
+                               size_t *const _slot)
+{
+    size_t free_slot;
+    const size_t s = swiss_find(_hash_map, _hash, _key, &free_slot);
+    if (s != SIZE_MAX)
+    {
+        *_slot = s;
+        return 0;
+    }
+
+    const ptrdiff_t r_code = swiss_reserve_one(_hash_map);
+    if (r_code < 0)
+    {
+        return -5;
+    }
+
+    const uint64_t mixed = c_hash_map_mix(_hash);
+
+    // Если слоты были перестроены, найденный ранее свободный слот недействителен.
+    if ( (r_code > 0) || (free_slot == SIZE_MAX) )
+    {
+        free_slot = c_hash_map_group_find_free(_hash_map->ctrl, _hash_map->slots_count, mixed);
+    }
+
+    _hash_map->deleted_count -= c_hash_map_group_occupy(_hash_map->ctrl, free_slot, mixed);
+
+    c_hash_map_entry *const entry = swiss_entry(_hash_map, free_slot);
+    entry->hash = _hash;
+    pair_init(_hash_map, &entry->key, &entry->data, (uint8_t*)(entry + 1), _key);
+
+    ++_hash_map->nodes_count;
+
+    *_slot = free_slot;
+
+    return 1;
+}
+
+// Освобождает слот движка SWISS (см. c_hash_map_group_release).
+static void swiss_release(c_hash_map *const _hash_map,
+                          const size_t _s)
+{
+    _hash_map->deleted_count += c_hash_map_group_release(_hash_map->ctrl, _s);
+
+    --_hash_map->nodes_count;
+}
+
+// Удаление из движка SWISS.
+// Коды возврата аналогичны c_hash_map_erase.
+static ptrdiff_t swiss_erase(c_hash_map *const _hash_map,
+                             const void *const _key,
+                             const size_t _hash,
+                             void (*const _del_key)(void *const _key),
+                             void (*const _del_data)(void *const _data))
+{
+    const size_t s = swiss_find(_hash_map, _hash, _key, NULL);
+    if (s == SIZE_MAX)
+    {
+        return 0;
+    }
+
+    c_hash_map_entry *const entry = swiss_entry(_hash_map, s);
+
+    // Если для ключа задана функция удаления, вызываем ее.
+    if (_del_key != NULL)
+    {
+        _del_key(entry->key);
+    }
+
+    // Если для данных задана функция удаления, вызываем ее.
+    if (_del_data != NULL)
+    {
+        _del_data(entry->data);
+    }
+
+    swiss_release(_hash_map, s);
+
+    return 1;
+}
+
+// Задает движку SWISS новое количество слотов.
+// Количество слотов округляется вверх до степени двойки и увеличивается, если при нем
+// был бы превышен max_load_factor.
+// Коды возврата аналогичны c_hash_map_resize.
+static ptrdiff_t swiss_resize(c_hash_map *const _hash_map,
+                              const size_t _slots_count)
+{
+    size_t capacity = c_hash_map_group_capacity(_slots_count);
+    if (capacity == 0)
+    {
+        return -3;
+    }
+
+    while ( (float)_hash_map->nodes_count / capacity > _hash_map->max_load_factor )
+    {
+        if (capacity > SIZE_MAX / 2)
+        {
+            return -3;
+        }
+        capacity *= 2;
+    }
+
+    if ( (capacity == _hash_map->slots_count) && (_hash_map->deleted_count == 0) )
+    {
+        return 0;
+    }
+
+    if (swiss_rehash(_hash_map, capacity) < 0)
+    {
+        return -4;
+    }
+
+    return 2;
+}
+
+// Обход всех пар движка SWISS.
+static void swiss_for_each(c_hash_map *const _hash_map,
+                           void (*const _action_key)(const void *const _key),
+                           void (*const _action_data)(void *const _data))
+{
+    size_t count = _hash_map->nodes_count;
+    for (size_t s = 0; (s < _hash_map->slots_count)&&(count > 0); ++s)
+    {
+        if ( (_hash_map->ctrl[s] & 0x80) == 0 )
+        {
+            if (_action_key != NULL)
+            {
+                _action_key(swiss_entry(_hash_map, s)->key);
+            }
+            if (_action_data != NULL)
+            {
+                _action_data(swiss_entry(_hash_map, s)->data);
+            }
+            --count;
+        }
+    }
+}
+
+// Очистка движка SWISS.
+static void swiss_clear(c_hash_map *const _hash_map,
+                        void (*const _del_key)(void *const _key),
+                        void (*const _del_data)(void *const _data))
+{
+    if ( (_del_key != NULL) || (_del_data != NULL) )
+    {
+        size_t count = _hash_map->nodes_count;
+        for (size_t s = 0; (s < _hash_map->slots_count)&&(count > 0); ++s)
+        {
+            if ( (_hash_map->ctrl[s] & 0x80) == 0 )
+            {
+                if (_del_key != NULL)
+                {
+                    _del_key(swiss_entry(_hash_map, s)->key);
+                }
+                if (_del_data != NULL)
+                {
+                    _del_data(swiss_entry(_hash_map, s)->data);
+                }
+                --count;
+            }
+        }
+    }
+
+    memset(_hash_map->ctrl, C_HASH_MAP_CTRL_EMPTY, _hash_map->slots_count);
+
+    _hash_map->deleted_count = 0;
+}
+
+// Перестраивает индекс движка DENSE под заданное количество слотов (степень двойки).
+// Пары переносятся в новый массив подряд, удаленные пары при этом исчезают, порядок
+// вставки сохраняется. Емкость массива пар - max_load_factor от количества слотов.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+static ptrdiff_t dense_rehash(c_hash_map *const _hash_map,
+                              const size_t _capacity)
+{
+    const uint64_t begin = time_ns();
+
+    // Свободный слот индекса должен оставаться всегда.
+    size_t pairs_capacity = (size_t)((double)_capacity * _hash_map->max_load_factor);
+    if (pairs_capacity < _hash_map->nodes_count + 1)
+    {
+        pairs_capacity = _hash_map->nodes_count + 1;
+    }
+    if (pairs_capacity > _capacity - 1)
+    {
+        pairs_capacity = _capacity - 1;
+    }
+    if (pairs_capacity > C_HASH_MAP_DENSE_MAX)
+    {
+        pairs_capacity = C_HASH_MAP_DENSE_MAX;
+    }
+    if (pairs_capacity < _hash_map->nodes_count)
+    {
+        return -1;
+    }
+
+    const size_t offsets_size = _capacity * sizeof(uint32_t);
+    const size_t entries_size = pairs_capacity * _hash_map->entry_size;
+    if ( (offsets_size / sizeof(uint32_t) != _capacity) ||
+         (offsets_size + _capacity < offsets_size) ||
+         ( (pairs_capacity > 0) && (entries_size / pairs_capacity != _hash_map->entry_size) ) )
+    {
+        return -1;
+    }
+
+    uint8_t *const new_ctrl = map_alloc(_hash_map, _capacity + offsets_size);
+    if (new_ctrl == NULL)
+    {
+        return -2;
+    }
+    uint8_t *const new_entries = map_alloc(_hash_map, entries_size);
+    if ( (new_entries == NULL) && (entries_size > 0) )
+    {
+        map_free(_hash_map, new_ctrl);
+        return -2;
+    }
+
+    memset(new_ctrl, C_HASH_MAP_CTRL_EMPTY, _capacity);
+    uint32_t *const new_offsets = (uint32_t*)(new_ctrl + _capacity);
+
+    size_t count = 0;
+    for (size_t i = 0; i < _hash_map->dense_count; ++i)
+    {
+        const c_hash_map_entry *const entry = swiss_entry(_hash_map, i);
+        if (entry->key == NULL)
+        {
+            continue;
+        }
+
+        c_hash_map_entry *const new_entry = (c_hash_map_entry*)(new_entries + count * _hash_map->entry_size);
+        memcpy(new_entry, entry, _hash_map->entry_size);
+        entry_retarget(_hash_map, new_entry);
+
+        const uint64_t mixed = c_hash_map_mix(entry->hash);
+        const size_t s = c_hash_map_group_find_free(new_ctrl, _capacity, mixed);
+        new_ctrl[s] = c_hash_map_h2(mixed);
+        new_offsets[s] = (uint32_t)count;
+
+        ++count;
+    }
+
+    map_free(_hash_map, _hash_map->ctrl);
+    map_free(_hash_map, _hash_map->entries);
+
+    _hash_map->ctrl = new_ctrl;
+    _hash_map->offsets = new_offsets;
+    _hash_map->entries = new_entries;
+    _hash_map->slots_count = _capacity;
+    _hash_map->deleted_count = 0;
+    _hash_map->dense_count = count;
+    _hash_map->dense_capacity = pairs_capacity;
+
+    resize_account(_hash_map, begin);
+
+    return 1;
+}
+
+// Обеспечивает наличие места под еще одну пару в движке DENSE.
+// Индекс расширяется, когда заполнен массив пар; если большую часть массива занимают
+// удаленные пары, массив только уплотняется.
+// Если место было обеспечено перестройкой, возвращает > 0.
+// Если перестройка не потребовалась, возвращает 0.
+// В случае ошибки возвращает < 0.
+static ptrdiff_t dense_reserve_one(c_hash_map *const _hash_map)
+{
+    if (_hash_map->dense_count < _hash_map->dense_capacity)
+    {
+        return 0;
+    }
+
+    size_t new_capacity = _hash_map->slots_count;
+    if (_hash_map->slots_count == 0)
+    {
+        new_capacity = c_hash_map_group_capacity(_hash_map->initial_slots);
+    } else if (c_hash_map_group_grow(_hash_map->slots_count, _hash_map->nodes_count, _hash_map->max_load_factor) != 0) {
+        const double grown = (double)_hash_map->slots_count * _hash_map->growth_factor + 1;
+        if (grown >= (double)SIZE_MAX)
+        {
+            return -1;
+        }
+        new_capacity = c_hash_map_group_capacity((size_t)grown);
+    }
+    if (new_capacity == 0)
+    {
+        return -1;
+    }
+
+    if (dense_rehash(_hash_map, new_capacity) < 0)
+    {
+        return -2;
+    }
+
+    // Достигнуто максимальное количество пар.
+    if (_hash_map->dense_count == _hash_map->dense_capacity)
+    {
+        return -3;
+    }
+
+    return 1;
+}
+
+// Поиск ключа в движке DENSE с вставкой при его отсутствии (новая пара добавляется в конец).
+// Если ключ вставлен, возвращает > 0, в пару заносятся хэш и ключ, данные обнуляются.
+// Если ключ уже есть, возвращает 0.
+// В обоих случаях в _pair помещается номер пары ключа.
+// В случае ошибки возвращает < 0.
+static ptrdiff_t dense_emplace(c_hash_map *const _hash_map,
+                               const void *const _key,
+                               const size_t _hash,
+                               size_t *const _pair)
+{
+    size_t free_slot;
+    const size_t s = dense_find(_hash_map, _hash, _key, &free_slot);
+    if (s != SIZE_MAX)
+    {
+        *_pair = _hash_map->offsets[s];
+        return 0;
+    }
+
+    const ptrdiff_t r_code = dense_reserve_one(_hash_map);
+    if (r_code < 0)
+    {
+        return -5;
+    }
+
+    const uint64_t mixed = c_hash_map_mix(_hash);
+
+    // Если индекс был перестроен, найденный ранее свободный слот недействителен.
+    if ( (r_code > 0) || (free_slot == SIZE_MAX) )
+    {
+        free_slot = c_hash_map_group_find_free(_hash_map->ctrl, _hash_map->slots_count, mixed);
+    }
+
+    _hash_map->deleted_count -= c_hash_map_group_occupy(_hash_map->ctrl, free_slot, mixed);
+
+    const size_t pair = _hash_map->dense_count++;
+
+    _hash_map->offsets[free_slot] = (uint32_t)pair;
+
+    c_hash_map_entry *const entry = swiss_entry(_hash_map, pair);
+    entry->hash = _hash;
+    pair_init(_hash_map, &entry->key, &entry->data, (uint8_t*)(entry + 1), _key);
+
+    ++_hash_map->nodes_count;
+
+    *_pair = pair;
+
+    return 1;
+}
+
+// Искомая пара для dense_slot_eq.
+typedef struct s_c_hash_map_dense_probe
+{
+    const c_hash_map *hash_map;
+    size_t pair;
+} c_hash_map_dense_probe;
+
+// Проверка слота-кандидата индекса движка DENSE по номеру пары для c_hash_map_group_find.
+static inline size_t dense_slot_eq(const void *const _context,
+                                   const size_t _s)
+{
+    const c_hash_map_dense_probe *const probe = (const c_hash_map_dense_probe*)_context;
+    return (probe->hash_map->offsets[_s] == probe->pair) ? 1 : 0;
+}
+
+// Ищет слот индекса движка DENSE, ссылающийся на пару с заданным номером (ключи не сравниваются).
+static size_t dense_slot_of(const c_hash_map *const _hash_map,
+                            const size_t _pair)
+{
+    const c_hash_map_dense_probe probe = {_hash_map, _pair};
+
+    return c_hash_map_group_find(_hash_map->ctrl, _hash_map->slots_count,
+                                 c_hash_map_mix(swiss_entry(_hash_map, _pair)->hash),
+                                 dense_slot_eq, &probe, NULL, NULL);
+}
+
+// Удаляет из движка DENSE пару с заданным номером, на которую ссылается слот индекса _s.
+// Пара становится удаленной (key == NULL) и исчезает при следующем перестроении.
+static void dense_remove(c_hash_map *const _hash_map,
+                         const size_t _s,
+                         const size_t _pair,
+                         void (*const _del_key)(void *const _key),
+                         void (*const _del_data)(void *const _data))
+{
+    c_hash_map_entry *const entry = swiss_entry(_hash_map, _pair);
+
+    if (_del_key != NULL)
+    {
+        _del_key(entry->key);
+    }
+    if (_del_data != NULL)
+    {
+        _del_data(entry->data);
+    }
+
+    entry->key = NULL;
+
+    swiss_release(_hash_map, _s);
+
+    if (_hash_map->nodes_count == 0)
+    {
+        // Последняя пара: индекс и массив пар освобождаются разом.
+        memset(_hash_map->ctrl, C_HASH_MAP_CTRL_EMPTY, _hash_map->slots_count);
+        _hash_map->deleted_count = 0;
+        _hash_map->dense_count = 0;
+    } else if (_pair + 1 == _hash_map->dense_count) {
+        --_hash_map->dense_count;
+    }
+}
+
+// Удаление из движка DENSE.
+// Коды возврата аналогичны c_hash_map_erase.
+static ptrdiff_t dense_erase(c_hash_map *const _hash_map,
+                             const void *const _key,
+                             const size_t _hash,
+                             void (*const _del_key)(void *const _key),
+                             void (*const _del_data)(void *const _data))
+{
+    const size_t s = dense_find(_hash_map, _hash, _key, NULL);
+    if (s == SIZE_MAX)
+    {
+        return 0;
+    }
+
+    dense_remove(_hash_map, s, _hash_map->offsets[s], _del_key, _del_data);
+
+    return 1;
+}
+
+// Задает индексу движка DENSE новое количество слотов.
+// Количество слотов округляется вверх до степени двойки и увеличивается, если при нем
+// был бы превышен max_load_factor.
+// Коды возврата аналогичны c_hash_map_resize.
+static ptrdiff_t dense_resize(c_hash_map *const _hash_map,
+                              const size_t _slots_count)
+{
+    size_t capacity = c_hash_map_group_capacity(_slots_count);
+    if (capacity == 0)
+    {
+        return -3;
+    }
+
+    while ( (float)_hash_map->nodes_count / capacity > _hash_map->max_load_factor )
+    {
+        if (capacity > SIZE_MAX / 2)
+        {
+            return -3;
+        }
+        capacity *= 2;
+    }
+
+    if ( (capacity == _hash_map->slots_count) && (_hash_map->dense_count == _hash_map->nodes_count) )
+    {
+        return 0;
+    }
+
+    if (dense_rehash(_hash_map, capacity) < 0)
+    {
+        return -4;
+    }
+
+    return 2;
+}
+
+// Очистка движка DENSE.
+static void dense_clear(c_hash_map *const _hash_map,
+                        void (*const _del_key)(void *const _key),
+                        void (*const _del_data)(void *const _data))
+{
+    if ( (_del_key != NULL) || (_del_data != NULL) )
+    {
+        for (size_t i = 0; i < _hash_map->dense_count; ++i)
+        {
+            c_hash_map_entry *const entry = swiss_entry(_hash_map, i);
+            if (entry->key == NULL)
+            {
+                continue;
+            }
+            if (_del_key != NULL)
+            {
+                _del_key(entry->key);
+            }
+            if (_del_data != NULL)
+            {
+                _del_data(entry->data);
+            }
+        }
+    }
+
+    memset(_hash_map->ctrl, C_HASH_MAP_CTRL_EMPTY, _hash_map->slots_count);
+
+    _hash_map->deleted_count = 0;
+    _hash_map->dense_count = 0;
+}
+
+// Номера двух корзин пары движка CUCKOO по перемешанному хэшу.
+// Первая корзина берется из младших битов, вторая - из битов, начиная с 29-го (при совпадении
+// с первой - соседняя корзина), поэтому корзины пары всегда различны.
+static inline void cuckoo_buckets(const size_t _slots_count,
+                                  const uint64_t _mixed,
+                                  size_t *const _first,
+                                  size_t *const _second)
+{
+    const size_t buckets_mask = _slots_count / C_HASH_MAP_BUCKET - 1;
+
+    *_first = (size_t)_mixed & buckets_mask;
+    *_second = (size_t)(_mixed >> 29) & buckets_mask;
+    if (*_second == *_first)
+    {
+        *_second = *_first ^ 1;
+    }
+}
+
+// Альтернативная корзина пары движка CUCKOO с заданным хэшем, находящейся в корзине _bucket.
+static inline size_t cuckoo_other(const c_hash_map *const _hash_map,
+                                  const size_t _hash,
+                                  const size_t _bucket)
+{
+    size_t first,
+           second;
+    cuckoo_buckets(_hash_map->slots_count, c_hash_map_mix(_hash), &first, &second);
+
+    return (first == _bucket) ? second : first;
+}
+
+// Ищет слот движка CUCKOO с заданным ключом (объектом или байтовым представлением, см. key_match).
+// Просматриваются только две корзины ключа, предвыборка второй выполняется до просмотра первой.
+// Если слот не найден, возвращает SIZE_MAX.
+static size_t cuckoo_find_key(const c_hash_map *const _hash_map,
+                              const size_t _hash,
+                              const void *const _key,
+                              const size_t _key_size)
+{
+    if (_hash_map->slots_count == 0)
+    {
+        return SIZE_MAX;
+    }
+
+    const uint64_t mixed = c_hash_map_mix(_hash);
+    const uint8_t h2 = c_hash_map_h2(mixed);
+
+    size_t buckets[2];
+    cuckoo_buckets(_hash_map->slots_count, mixed, &buckets[0], &buckets[1]);
+
+    C_HASH_MAP_PREFETCH(_hash_map->ctrl + buckets[1] * C_HASH_MAP_BUCKET);
+
+    for (size_t b = 0; b < 2; ++b)
+    {
+        const size_t first_slot = buckets[b] * C_HASH_MAP_BUCKET;
+
+        uint32_t match = c_hash_map_bucket_match(_hash_map->ctrl + first_slot, h2);
+        while (match != 0)
+        {
+            const size_t s = first_slot + c_hash_map_ctz32(match);
+            const c_hash_map_entry *const entry = swiss_entry(_hash_map, s);
+            if ( (entry->hash == _hash) &&
+                 (key_match(_hash_map, _key, _key_size, entry->key) > 0) )
+            {
+                C_HASH_MAP_PROBES(_hash_map, 1, b + 1);
+                return s;
+            }
+            match &= match - 1;
+        }
+    }
+
+    C_HASH_MAP_PROBES(_hash_map, 0, 2);
+
+    return SIZE_MAX;
+}
+
+// Ищет слот движка CUCKOO с заданным ключом (см. cuckoo_find_key).
+static size_t cuckoo_find(const c_hash_map *const _hash_map,
+                          const size_t _hash,
+                          const void *const _key)
+{
+    return cuckoo_find_key(_hash_map, _hash, _key, C_HASH_MAP_KEY_OBJECT);
+}
+
+// Переносит пару движка CUCKOO в пустой слот: сначала пара копируется, затем старый слот
+// освобождается, поэтому пара все время находится хотя бы в одном слоте.
+static inline void cuckoo_move(c_hash_map *const _hash_map,
+                               const size_t _from,
+                               const size_t _to)
+{
+    c_hash_map_entry *const entry = swiss_entry(_hash_map, _to);
+    memcpy(entry, swiss_entry(_hash_map, _from), _hash_map->entry_size);
+
+    // Встроенные ключ и данные переместились вместе со слотом.
+    entry_retarget(_hash_map, entry);
+
+    _hash_map->ctrl[_to] = _hash_map->ctrl[_from];
+    _hash_map->ctrl[_from] = C_HASH_MAP_CTRL_EMPTY;
+}
+
+// Проверяет, есть ли корзина _bucket на пути от вершины _step к корзинам вставляемой пары.
+static size_t cuckoo_on_path(const c_hash_map_cuckoo_step *const _steps,
+                             const size_t _step,
+                             const size_t _bucket)
+{
+    for (size_t step = _step; step != SIZE_MAX; step = _steps[step].parent)
+    {
+        if (_steps[step].bucket == _bucket)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// Находит пустой слот для пары с заданным хэшем в одной из двух ее корзин движка CUCKOO.
+// Если обе корзины заполнены, поиском в ширину (не больше C_HASH_MAP_CUCKOO_BFS вершин) ищется
+// кратчайший путь вытеснения: цепочка пар, каждая из которых переносится в свою альтернативную
+// корзину, а последняя - в корзину с пустым слотом. Корзины на пути не повторяются. Пары пути
+// переносятся с его конца, так что каждый перенос выполняется в только что освобожденный слот.
+// Возвращает номер пустого слота.
+// Если путь не найден, возвращает SIZE_MAX (пары при этом не переносятся).
+static size_t cuckoo_place(c_hash_map *const _hash_map,
+                           const size_t _hash)
+{
+    size_t first,
+           second;
+    cuckoo_buckets(_hash_map->slots_count, c_hash_map_mix(_hash), &first, &second);
+
+    uint32_t free_mask = c_hash_map_bucket_match_free(_hash_map->ctrl + first * C_HASH_MAP_BUCKET);
+    if (free_mask != 0)
+    {
+        return first * C_HASH_MAP_BUCKET + c_hash_map_ctz32(free_mask);
+    }
+    free_mask = c_hash_map_bucket_match_free(_hash_map->ctrl + second * C_HASH_MAP_BUCKET);
+    if (free_mask != 0)
+    {
+        return second * C_HASH_MAP_BUCKET + c_hash_map_ctz32(free_mask);
+    }
+
+    c_hash_map_cuckoo_step steps[C_HASH_MAP_CUCKOO_BFS];
+    steps[0].bucket = first;
+    steps[0].parent = SIZE_MAX;
+    steps[1].bucket = second;
+    steps[1].parent = SIZE_MAX;
+    size_t steps_count = 2;
+
+    for (size_t step = 0; step < steps_count; ++step)
+    {
+        const size_t bucket = steps[step].bucket;
+
+        for (size_t i = 0; i < C_HASH_MAP_BUCKET; ++i)
+        {
+            const size_t s = bucket * C_HASH_MAP_BUCKET + i;
+            const size_t other = cuckoo_other(_hash_map, swiss_entry(_hash_map, s)->hash, bucket);
+
+            free_mask = c_hash_map_bucket_match_free(_hash_map->ctrl + other * C_HASH_MAP_BUCKET);
+            if (free_mask != 0)
+            {
+                // Путь найден, переносим пары с его конца.
+                ++_hash_map->cuckoo_version;
+
+                size_t from = s,
+                       to = other * C_HASH_MAP_BUCKET + c_hash_map_ctz32(free_mask),
+                       path_step = step;
+                for (;;)
+                {
+                    cuckoo_move(_hash_map, from, to);
+                    if (steps[path_step].parent == SIZE_MAX)
+                    {
+                        break;
+                    }
+                    to = from;
+                    from = steps[path_step].slot;
+                    path_step = steps[path_step].parent;
+                }
+
+                ++_hash_map->cuckoo_version;
+
+                return from;
+            }
+
+            if ( (steps_count < C_HASH_MAP_CUCKOO_BFS) &&
+                 (cuckoo_on_path(steps, step, other) == 0) )
+            {
+                steps[steps_count].bucket = other;
+                steps[steps_count].parent = step;
+                steps[steps_count].slot = s;
+                ++steps_count;
+            }
+        }
+    }
+
+    return SIZE_MAX;
+}
+
+// Перестраивает слоты движка CUCKOO под заданное количество слотов (степень двойки).
+// Если при этом количестве для какой-либо пары не нашлось пути вытеснения, количество слотов
+// удваивается и перестроение повторяется.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0 (слоты остаются прежними).
+static ptrdiff_t cuckoo_rehash(c_hash_map *const _hash_map,
+                               const size_t _capacity)
+{
+    const uint64_t begin = time_ns();
+
+    uint8_t *const old_ctrl = _hash_map->ctrl;
+    uint8_t *const old_entries = _hash_map->entries;
+    const size_t old_slots_count = _hash_map->slots_count;
+
+    size_t capacity = _capacity;
+    for (;;)
+    {
+        uint8_t *const new_ctrl = swiss_alloc(_hash_map, capacity);
+        if (new_ctrl == NULL)
+        {
+            return -1;
+        }
+
+        _hash_map->ctrl = new_ctrl;
+        _hash_map->entries = new_ctrl + capacity;
+        _hash_map->slots_count = capacity;
+
+        size_t count = _hash_map->nodes_count;
+        for (size_t s = 0; (s < old_slots_count)&&(count > 0); ++s)
+        {
+            if ( (old_ctrl[s] & 0x80) != 0 )
+            {
+                continue;
+            }
+
+            const c_hash_map_entry *const entry = (const c_hash_map_entry*)(old_entries + s * _hash_map->entry_size);
+            const size_t new_s = cuckoo_place(_hash_map, entry->hash);
+            if (new_s == SIZE_MAX)
+            {
+                break;
+            }
+
+            _hash_map->ctrl[new_s] = old_ctrl[s];
+
+            c_hash_map_entry *const new_entry = swiss_entry(_hash_map, new_s);
+            memcpy(new_entry, entry, _hash_map->entry_size);
+
+            // Встроенные ключ и данные переместились вместе со слотом.
+            entry_retarget(_hash_map, new_entry);
+
+            --count;
+        }
+
+        if (count == 0)
+        {
+            break;
+        }
+
+        // Пары не поместились, пробуем вдвое больше слотов (если хэши не вырождены).
+        map_free(_hash_map, new_ctrl);
+
+        _hash_map->ctrl = old_ctrl;
+        _hash_map->entries = old_entries;
+        _hash_map->slots_count = old_slots_count;
+
+        if ( (capacity > SIZE_MAX / 2) ||
+             ( (float)_hash_map->nodes_count / capacity < C_HASH_MAP_CUCKOO_MIN_LOAD ) )
+        {
+            return -2;
+        }
+        capacity *= 2;
+    }
+
+    map_free(_hash_map, old_ctrl);
+
+    resize_account(_hash_map, begin);
+
+    return 1;
+}
+
+// Расширяет движок CUCKOO в growth_factor раз.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+static ptrdiff_t cuckoo_grow(c_hash_map *const _hash_map)
+{
+    const double grown = (double)_hash_map->slots_count * _hash_map->growth_factor + 1;
+    if (grown >= (double)SIZE_MAX)
+    {
+        return -1;
+    }
+    const size_t capacity = c_hash_map_group_capacity((size_t)grown);
+    if (capacity == 0)
+    {
+        return -1;
+    }
+
+    return (cuckoo_rehash(_hash_map, capacity) > 0) ? 1 : -2;
+}
+
+// Поиск ключа в движке CUCKOO с вставкой при его отсутствии.
+// Если max_load_factor был бы превышен или путь вытеснения не найден, слоты расширяются
+// (при загрузке ниже C_HASH_MAP_CUCKOO_MIN_LOAD отсутствие пути считается ошибкой).
+// Если ключ вставлен, возвращает > 0, в слот заносятся хэш и ключ, данные обнуляются.
+// Если ключ уже есть, возвращает 0.
+// В обоих случаях в _slot помещается номер слота ключа.
+// В случае ошибки возвращает < 0.
+static ptrdiff_t cuckoo_emplace(c_hash_map *const _hash_map,
+                                const void *const _key,
+                                const size_t _hash,
+                                size_t *const _slot)
+{
+    const size_t s = cuckoo_find(_hash_map, _hash, _key);
+    if (s != SIZE_MAX)
+    {
+        *_slot = s;
+        return 0;
+    }
+
+    if (_hash_map->slots_count == 0)
+    {
+        const size_t capacity = c_hash_map_group_capacity(_hash_map->initial_slots);
+        if ( (capacity == 0) || (cuckoo_rehash(_hash_map, capacity) < 0) )
+        {
+            return -5;
+        }
+    } else if ( (float)(_hash_map->nodes_count + 1) / _hash_map->slots_count > _hash_map->max_load_factor ) {
+        if (cuckoo_grow(_hash_map) < 0)
+        {
+            return -5;
+        }
+    }
+
+    size_t free_slot = cuckoo_place(_hash_map, _hash);
+    while (free_slot == SIZE_MAX)
+    {
+        if ( ( (float)(_hash_map->nodes_count + 1) / _hash_map->slots_count < C_HASH_MAP_CUCKOO_MIN_LOAD ) ||
+             (cuckoo_grow(_hash_map) < 0) )
+        {
+            return -5;
+        }
+        free_slot = cuckoo_place(_hash_map, _hash);
+    }
+
+    _hash_map->ctrl[free_slot] = c_hash_map_h2(c_hash_map_mix(_hash));
+
+    c_hash_map_entry *const entry = swiss_entry(_hash_map, free_slot);
+    entry->hash = _hash;
+    pair_init(_hash_map, &entry->key, &entry->data, (uint8_t*)(entry + 1), _key);
+
+    ++_hash_map->nodes_count;
+
+    *_slot = free_slot;
+
+    return 1;
+}
+
+// Освобождает слот движка CUCKOO (пробирования нет, поэтому слот сразу становится пустым).
+static void cuckoo_release(c_hash_map *const _hash_map,
+                           const size_t _s)
+{
+    ++_hash_map->cuckoo_version;
+    _hash_map->ctrl[_s] = C_HASH_MAP_CTRL_EMPTY;
+    ++_hash_map->cuckoo_version;
+
+    --_hash_map->nodes_count;
+}
+
+// Удаление из движка CUCKOO.
+// Коды возврата аналогичны c_hash_map_erase.
+static ptrdiff_t cuckoo_erase(c_hash_map *const _hash_map,
+                              const void *const _key,
+                              const size_t _hash,
+                              void (*const _del_key)(void *const _key),
+                              void (*const _del_data)(void *const _data))
+{
+    const size_t s = cuckoo_find(_hash_map, _hash, _key);
+    if (s == SIZE_MAX)
+    {
+        return 0;
+    }
+
+    c_hash_map_entry *const entry = swiss_entry(_hash_map, s);
+
+    if (_del_key != NULL)
+    {
+        _del_key(entry->key);
+    }
+    if (_del_data != NULL)
+    {
+        _del_data(entry->data);
+    }
+
+    cuckoo_release(_hash_map, s);
+
+    return 1;
+}
+
+// Задает движку CUCKOO новое количество слотов.
+// Количество слотов округляется вверх до степени двойки и увеличивается, если при нем
+// был бы превышен max_load_factor или пары не удалось бы разместить.
+// Коды возврата аналогичны c_hash_map_resize.
+static ptrdiff_t cuckoo_resize(c_hash_map *const _hash_map,
+                               const size_t _slots_count)
+{
+    size_t capacity = c_hash_map_group_capacity(_slots_count);
+    if (capacity == 0)
+    {
+        return -3;
+    }
+
+    while ( (float)_hash_map->nodes_count / capacity > _hash_map->max_load_factor )
+    {
+        if (capacity > SIZE_MAX / 2)
+        {
+            return -3;
+        }
+        capacity *= 2;
+    }
+
+    if (capacity == _hash_map->slots_count)
+    {
+        return 0;
+    }
+
+    if (cuckoo_rehash(_hash_map, capacity) < 0)
+    {
+        return -4;
+    }
+
+    return 2;
+}
+
+// Пакетный поиск в движке CUCKOO: сначала вычисляются хэши и запрашиваются обе корзины
+// всех ключей пакета, затем выполняется поиск.
+// Возвращает количество найденных ключей, в случае ошибки возвращает < 0.
+static ptrdiff_t cuckoo_at_batch(const c_hash_map *const _hash_map,
+                                 const void *const *const _keys,
+                                 const size_t _count,
+                                 void **const _datas)
+{
+    size_t hashes[C_HASH_MAP_BATCH];
+
+    ptrdiff_t found = 0;
+
+    for (size_t b = 0; b < _count; b += C_HASH_MAP_BATCH)
+    {
+        const size_t count = (_count - b < C_HASH_MAP_BATCH) ? _count - b : C_HASH_MAP_BATCH;
+        const void *const *const keys = _keys + b;
+        void **const datas = _datas + b;
+
+        // Этап 1: хэши и предвыборка обеих корзин.
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (keys[i] == NULL) return -3;
+
+            hashes[i] = _hash_map->hash_key(keys[i]);
+
+            size_t first,
+                   second;
+            cuckoo_buckets(_hash_map->slots_count, c_hash_map_mix(hashes[i]), &first, &second);
+            C_HASH_MAP_PREFETCH(_hash_map->ctrl + first * C_HASH_MAP_BUCKET);
+            C_HASH_MAP_PREFETCH(_hash_map->ctrl + second * C_HASH_MAP_BUCKET);
+        }
+
+        // Этап 2: поиск.
+        for (size_t i = 0; i < count; ++i)
+        {
+            const size_t s = cuckoo_find(_hash_map, hashes[i], keys[i]);
+            if (s != SIZE_MAX)
+            {
+                datas[i] = swiss_entry(_hash_map, s)->data;
+                ++found;
+            } else {
+                datas[i] = NULL;
+            }
+        }
+    }
+
+    return found;
+}
+
+// Создание пустого хэш-отображения.
+// В случае ошибки возвращает NULL, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+// Позволяет создать хэш-отображение с нулем слотов.
+c_hash_map *c_hash_map_create(size_t (*const _hash_key)(const void *const _key),
+                              size_t (*const _comp_key)(const void *const _a_key,
+                                                         const void *const _b_key),
+                              const size_t _slots_count,
+                              const float _max_load_factor,
+                              size_t *const _error)
+{
+    return c_hash_map_create_ex(_hash_key, _comp_key, _slots_count, _max_load_factor, NULL, _error);
+}
+
+// Заполняет дополнительные параметры создания значениями по умолчанию
+// (которые соответствуют c_hash_map_create).
+void c_hash_map_options_init(c_hash_map_options *const _options)
+{
+    if (_options == NULL)
+    {
+        return;
+    }
+
+    memset(_options, 0, sizeof(c_hash_map_options));
+
+    _options->engine = C_HASH_MAP_ENGINE_CHAIN;
+}
+
+// Создание пустого хэш-отображения с дополнительными параметрами.
+// Если _options == NULL, используются параметры по умолчанию.
+// В случае ошибки возвращает NULL, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+// Позволяет создать хэш-отображение с нулем слотов.
+c_hash_map *c_hash_map_create_ex(size_t (*const _hash_key)(const void *const _key),
+                                 size_t (*const _comp_key)(const void *const _a_key,
+                                                            const void *const _b_key),
+                                 const size_t _slots_count,
+                                 const float _max_load_factor,
+                                 const c_hash_map_options *const _options,
+                                 size_t *const _error)
+{
+    c_hash_map_options options;
+    if (_options != NULL)
+    {
+        options = *_options;
+    } else {
+        c_hash_map_options_init(&options);
+    }
+
+    if (_hash_key == NULL)
+    {
+        error_set(_error, 1);
+        return NULL;
+    }
+    if ( (_comp_key == NULL) && (options.key_size == 0) )
+    {
+        error_set(_error, 2);
+        return NULL;
+    }
+    if ( (options.key_size > SIZE_MAX / 4) || (options.value_size > SIZE_MAX / 4) )
+    {
+        error_set(_error, 13);
+        return NULL;
+    }
+    // Уменьшение оставляет загрузку равной половине max_load_factor, поэтому до следующего
+    // уменьшения количество пар должно сократиться еще минимум вдвое.
+    if ( !(options.min_load_factor >= 0.f) || (options.min_load_factor * 4 > _max_load_factor) )
+    {
+        error_set(_error, 14);
+        return NULL;
+    }
+    if ( (options.max_load_factor_cap != 0.f) &&
+         ( (options.max_load_factor_cap < C_HASH_MAP_MLF_MIN) ||
+           (options.max_load_factor_cap > C_HASH_MAP_MLF_CAP_MAX) ) )
+    {
+        error_set(_error, 11);
+        return NULL;
+    }
+    const float mlf_max = (options.max_load_factor_cap != 0.f) ? options.max_load_factor_cap : C_HASH_MAP_MLF_MAX;
+    if  ( (_max_load_factor < C_HASH_MAP_MLF_MIN) ||
+          (_max_load_factor > mlf_max) )
+    {
+        error_set(_error, 3);
+        return NULL;
+    }
+    if ( (options.engine != C_HASH_MAP_ENGINE_CHAIN) &&
+         (options.engine != C_HASH_MAP_ENGINE_SWISS) &&
+         (options.engine != C_HASH_MAP_ENGINE_DENSE) &&
+         (options.engine != C_HASH_MAP_ENGINE_CUCKOO) )
+    {
+        error_set(_error, 7);
+        return NULL;
+    }
+    if ( ( (options.engine == C_HASH_MAP_ENGINE_SWISS) || (options.engine == C_HASH_MAP_ENGINE_DENSE) ) &&
+         (_max_load_factor > C_HASH_MAP_SWISS_MLF_MAX) )
+    {
+        error_set(_error, 3);
+        return NULL;
+    }
+    if ( (options.engine == C_HASH_MAP_ENGINE_CUCKOO) &&
+         (_max_load_factor > C_HASH_MAP_CUCKOO_MLF_MAX) )
+    {
+        error_set(_error, 3);
+        return NULL;
+    }
+
+    if ( (options.growth_factor != 0.f) &&
+         ( !(options.growth_factor > 1.f) || (options.growth_factor > C_HASH_MAP_GROWTH_MAX) ) )
+    {
+        error_set(_error, 9);
+        return NULL;
+    }
+    if (options.index_policy > C_HASH_MAP_INDEX_PRIME)
+    {
+        error_set(_error, 10);
+        return NULL;
+    }
+    if ( (options.engine != C_HASH_MAP_ENGINE_CHAIN) &&
+         (options.rehash_step > 0) )
+    {
+        error_set(_error, 12);
+        return NULL;
+    }
+    // Сброс поколением возвращает узлы в распределитель разом и не учитывает старые слоты.
+    if ( (options.generation_reset != 0) &&
+         ( (options.engine != C_HASH_MAP_ENGINE_CHAIN) || (options.slab_nodes == 1) || (options.rehash_step > 0) ) )
+    {
+        error_set(_error, 15);
+        return NULL;
+    }
+    if (options.rehash_threads > C_HASH_MAP_THREADS_MAX)
+    {
+        error_set(_error, 16);
+        return NULL;
+    }
+    // Стрелка режима кэша обходит только текущие слоты, сведения пар хранятся в узлах.
+    const size_t cache_mode = ( (options.cache_capacity > 0) || (options.cache_bytes > 0) ) ? 1 : 0;
+    if ( (cache_mode != 0) &&
+         ( (options.engine != C_HASH_MAP_ENGINE_CHAIN) || (options.rehash_step > 0) ) )
+    {
+        error_set(_error, 17);
+        return NULL;
+    }
+    // Колесо сроков жизни связывает узлы, а удаление истекших пар ищет их только в текущих слотах.
+    if ( (options.ttl_mode != 0) &&
+         ( (options.engine != C_HASH_MAP_ENGINE_CHAIN) || (options.rehash_step > 0) ) )
+    {
+        error_set(_error, 18);
+        return NULL;
+    }
+    if ( (options.mem_alloc == NULL) != (options.mem_free == NULL) )
+    {
+        error_set(_error, 8);
+        return NULL;
+    }
+    if (options.mem_alloc == NULL)
+    {
+        options.mem_alloc = mem_alloc_default;
+        options.mem_free = mem_free_default;
+        options.mem_context = NULL;
+    }
+
+    // Попытаемся создать хэш-отображение.
+    c_hash_map *const new_hash_map = options.mem_alloc(options.mem_context, sizeof(c_hash_map));
+    if (new_hash_map == NULL)
+    {
+        error_set(_error, 6);
+        return NULL;
+    }
+
+    new_hash_map->hash_key = _hash_key;
+    new_hash_map->comp_key = _comp_key;
+    new_hash_map->comp_key_view = options.comp_key_view;
+
+    new_hash_map->engine = options.engine;
+
+    new_hash_map->mem_alloc = options.mem_alloc;
+    new_hash_map->mem_free = options.mem_free;
+    new_hash_map->mem_context = options.mem_context;
+
+    new_hash_map->slots_count = 0;
+    new_hash_map->nodes_count = 0;
+
+    new_hash_map->max_load_factor = _max_load_factor;
+    new_hash_map->min_load_factor = options.min_load_factor;
+
+    new_hash_map->growth_factor = (options.growth_factor != 0.f) ? options.growth_factor : C_HASH_MAP_GROWTH;
+    new_hash_map->initial_slots = (options.initial_slots > 0) ? options.initial_slots : C_HASH_MAP_0;
+
+    new_hash_map->index.policy = options.index_policy;
+    index_setup(&new_hash_map->index, 0);
+
+    new_hash_map->slots = NULL;
+
+    new_hash_map->old_slots = NULL;
+    new_hash_map->old_slots_count = 0;
+    new_hash_map->old_index = new_hash_map->index;
+    new_hash_map->rehash_pos = 0;
+    new_hash_map->rehash_step = options.rehash_step;
+    new_hash_map->generation = (options.generation_reset != 0) ? 1 : 0;
+    new_hash_map->slot_gens = NULL;
+    new_hash_map->rehash_threads = options.rehash_threads;
+    new_hash_map->run_tasks = options.run_tasks;
+    new_hash_map->run_context = options.run_context;
+
+    // Встроенная память пары выравнивается по 8 байт.
+    new_hash_map->key_size = options.key_size;
+    new_hash_map->value_size = options.value_size;
+    new_hash_map->key_stride = (options.key_size + 7) & ~(size_t)7;
+    const size_t inline_size = new_hash_map->key_stride + ((options.value_size + 7) & ~(size_t)7);
+
+    new_hash_map->node_size = sizeof(c_hash_map_node) + inline_size;
+    new_hash_map->ttl_offset = new_hash_map->node_size;
+    if (options.ttl_mode != 0)
+    {
+        new_hash_map->node_size += sizeof(c_hash_map_ttl_meta);
+    }
+    if (cache_mode != 0)
+    {
+        new_hash_map->node_size += sizeof(c_hash_map_cache_meta);
+    }
+    memset(&new_hash_map->slab, 0, sizeof(c_hash_map_slab));
+    new_hash_map->slab.chunk_nodes = (options.slab_nodes > 0) ? options.slab_nodes : C_HASH_MAP_SLAB_NODES;
+
+    new_hash_map->ctrl = NULL;
+    new_hash_map->entries = NULL;
+    new_hash_map->entry_size = sizeof(c_hash_map_entry) + inline_size;
+    new_hash_map->deleted_count = 0;
+    new_hash_map->cuckoo_version = 0;
+
+    new_hash_map->resizes_count = 0;
+    new_hash_map->resize_time = 0;
+
+    new_hash_map->offsets = NULL;
+    new_hash_map->dense_count = 0;
+    new_hash_map->dense_capacity = 0;
+
+    new_hash_map->cache = NULL;
+    new_hash_map->wheel = NULL;
+
+    if (_slots_count > 0)
+    {
+        if (options.engine == C_HASH_MAP_ENGINE_DENSE)
+        {
+            // Определим допустимое количество слотов индекса.
+            const size_t new_slots_count = c_hash_map_group_capacity(_slots_count);
+            if (new_slots_count == 0)
+            {
+                map_free(new_hash_map, new_hash_map);
+                error_set(_error, 4);
+                return NULL;
+            }
+
+            // Попытаемся выделить память под индекс и пары.
+            if (dense_rehash(new_hash_map, new_slots_count) < 0)
+            {
+                map_free(new_hash_map, new_hash_map);
+                error_set(_error, 5);
+                return NULL;
+            }
+        } else if ( (options.engine == C_HASH_MAP_ENGINE_SWISS) || (options.engine == C_HASH_MAP_ENGINE_CUCKOO) ) {
+            // Определим допустимое количество слотов.
+            const size_t new_slots_count = c_hash_map_group_capacity(_slots_count);
+            if (new_slots_count == 0)
+            {
+                map_free(new_hash_map, new_hash_map);
+                error_set(_error, 4);
+                return NULL;
+            }
+
+            // Попытаемся выделить память под управляющие байты и слоты.
+            uint8_t *const new_ctrl = swiss_alloc(new_hash_map, new_slots_count);
+            if (new_ctrl == NULL)
+            {
+                map_free(new_hash_map, new_hash_map);
+                error_set(_error, 5);
+                return NULL;
+            }
+
+            new_hash_map->ctrl = new_ctrl;
+            new_hash_map->entries = new_ctrl + new_slots_count;
+            new_hash_map->slots_count = new_slots_count;
+        } else {
+            // Определим допустимое количество слотов.
+            const size_t new_slots_count = index_round(options.index_policy, _slots_count);
+
+            // Определим размер новых слотов.
+            const size_t new_slots_size = chain_slots_size(new_hash_map, new_slots_count);
+            if (new_slots_size == 0)
+            {
+                map_free(new_hash_map, new_hash_map);
+                error_set(_error, 4);
+                return NULL;
+            }
+
+            // Попытаемся выделить память под новые слоты.
+            c_hash_map_node **const new_slots = map_alloc_zero(new_hash_map, new_slots_size);
+            if (new_slots == NULL)
+            {
+                map_free(new_hash_map, new_hash_map);
+                error_set(_error, 5);
+                return NULL;
+            }
+
+            new_hash_map->slots = new_slots;
+            new_hash_map->slot_gens = chain_slots_stamp(new_hash_map, new_slots, new_slots_count);
+            new_hash_map->slots_count = new_slots_count;
+            index_setup(&new_hash_map->index, new_slots_count);
+        }
+    }
+
+    // Начальное выделение слотов перестроением не считается.
+    new_hash_map->resizes_count = 0;
+    new_hash_map->resize_time = 0;
+
+#if defined(C_HASH_MAP_STATS_PROBES)
+    new_hash_map->probes = map_alloc_zero(new_hash_map, sizeof(c_hash_map_probes));
+    if (new_hash_map->probes == NULL)
+    {
+        map_free(new_hash_map, new_hash_map->slots);
+        map_free(new_hash_map, new_hash_map->ctrl);
+        if (options.engine == C_HASH_MAP_ENGINE_DENSE)
+        {
+            map_free(new_hash_map, new_hash_map->entries);
+        }
+        map_free(new_hash_map, new_hash_map);
+        error_set(_error, 6);
+        return NULL;
+    }
+#endif
+
+    if (cache_mode != 0)
+    {
+        c_hash_map_cache *const cache = map_alloc_zero(new_hash_map, sizeof(c_hash_map_cache));
+        if (cache == NULL)
+        {
+#if defined(C_HASH_MAP_STATS_PROBES)
+            map_free(new_hash_map, new_hash_map->probes);
+#endif
+            map_free(new_hash_map, new_hash_map->slots);
+            map_free(new_hash_map, new_hash_map);
+            error_set(_error, 6);
+            return NULL;
+        }
+
+        cache->capacity = options.cache_capacity;
+        cache->bytes = options.cache_bytes;
+        cache->cost = options.cache_cost;
+        cache->del_key = options.cache_del_key;
+        cache->del_data = options.cache_del_data;
+
+        new_hash_map->cache = cache;
+    }
+
+    if (options.ttl_mode != 0)
+    {
+        new_hash_map->wheel = map_alloc_zero(new_hash_map, sizeof(c_hash_map_wheel));
+        if (new_hash_map->wheel == NULL)
+        {
+#if defined(C_HASH_MAP_STATS_PROBES)
+            map_free(new_hash_map, new_hash_map->probes);
+#endif
+            map_free(new_hash_map, new_hash_map->cache);
+            map_free(new_hash_map, new_hash_map->slots);
+            map_free(new_hash_map, new_hash_map);
+            error_set(_error, 6);
+            return NULL;
+        }
+        new_hash_map->wheel->overflow_min = UINT64_MAX;
+    }
+
+    return new_hash_map;
+}
+
+// Удаляет хэш-отображение.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_delete(c_hash_map *const _hash_map,
+                            void (*const _del_key)(void *const _key),
+                            void (*const _del_data)(void *const _data))
+{
+    if (c_hash_map_clear(_hash_map, _del_key, _del_data) < 0)
+    {
+        return -1;
+    }
+    map_free(_hash_map, _hash_map->slots);
+    map_free(_hash_map, _hash_map->old_slots);
+    map_free(_hash_map, _hash_map->ctrl);
+    // Пары движка SWISS находятся в одном блоке с управляющими байтами.
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_DENSE)
+    {
+        map_free(_hash_map, _hash_map->entries);
+    }
+
+    slab_release(_hash_map);
+
+#if defined(C_HASH_MAP_STATS_PROBES)
+    map_free(_hash_map, _hash_map->probes);
+#endif
+    map_free(_hash_map, _hash_map->cache);
+    map_free(_hash_map, _hash_map->wheel);
+
+    map_free(_hash_map, _hash_map);
+
+    return 1;
+}
+
+// Ищет узел с заданным ключом (объектом или байтовым представлением, см. key_match) в движке
+// CHAIN, в том числе в еще не перенесенных старых слотах.
+// Возвращает расположение указателя на найденный узел (в слоте или в предыдущем узле).
+// Если узел не найден, возвращает NULL.
+static c_hash_map_node **chain_find_key(const c_hash_map *const _hash_map,
+                                        const size_t _hash,
+                                        const void *const _key,
+                                        const size_t _key_size)
+{
+    const size_t presented_hash = index_of(&_hash_map->index, _hash_map->slots_count, _hash);
+
+    c_hash_map_node **link = &_hash_map->slots[presented_hash];
+    size_t probes = 0;
+
+    // Цепочка слота прошлого поколения не просматривается.
+    if (chain_head(_hash_map, presented_hash) != NULL)
+    {
+        while (*link != NULL)
+        {
+            ++probes;
+            if (_hash == (*link)->hash)
+            {
+                if (key_match(_hash_map, _key, _key_size, (*link)->key) > 0)
+                {
+                    C_HASH_MAP_PROBES(_hash_map, 1, probes);
+                    return link;
+                }
+            }
+
+            link = &(*link)->next_node;
+        }
+    }
+
+    if (_hash_map->old_slots != NULL)
+    {
+        const size_t old_presented_hash = index_of(&_hash_map->old_index, _hash_map->old_slots_count, _hash);
+
+        // Перенесенные старые слоты пусты.
+        if (old_presented_hash >= _hash_map->rehash_pos)
+        {
+            link = &_hash_map->old_slots[old_presented_hash];
+
+            while (*link != NULL)
+            {
+                ++probes;
+                if (_hash == (*link)->hash)
+                {
+                    if (key_match(_hash_map, _key, _key_size, (*link)->key) > 0)
+                    {
+                        C_HASH_MAP_PROBES(_hash_map, 1, probes);
+                        return link;
+                    }
+                }
+
+                link = &(*link)->next_node;
+            }
+        }
+    }
+
+    C_HASH_MAP_PROBES(_hash_map, 0, probes);
+
+    return NULL;
+}
+
+// Ищет узел с заданным ключом в движке CHAIN (см. chain_find_key).
+static c_hash_map_node **chain_find(const c_hash_map *const _hash_map,
+                                    const size_t _hash,
+                                    const void *const _key)
+{
+    return chain_find_key(_hash_map, _hash, _key, C_HASH_MAP_KEY_OBJECT);
+}
+
+// Переносит в текущие слоты узлы не более чем _budget старых слотов.
+// По окончании переноса старые слоты освобождаются.
+// Если перенос еще не окончен, возвращает > 0, иначе 0.
+static ptrdiff_t chain_rehash_advance(c_hash_map *const _hash_map,
+                                      const size_t _budget)
+{
+    if (_hash_map->old_slots == NULL)
+    {
+        return 0;
+    }
+
+    size_t budget = _budget;
+    while ( (budget > 0) && (_hash_map->rehash_pos < _hash_map->old_slots_count) )
+    {
+        c_hash_map_node *select_node = _hash_map->old_slots[_hash_map->rehash_pos],
+                        *relocate_node;
+
+        while (select_node != NULL)
+        {
+            relocate_node = select_node;
+            select_node = select_node->next_node;
+
+            const size_t presented_hash = index_of(&_hash_map->index, _hash_map->slots_count, relocate_node->hash);
+
+            relocate_node->next_node = _hash_map->slots[presented_hash];
+            _hash_map->slots[presented_hash] = relocate_node;
+        }
+
+        _hash_map->old_slots[_hash_map->rehash_pos] = NULL;
+
+        ++_hash_map->rehash_pos;
+        --budget;
+    }
+
+    if (_hash_map->rehash_pos < _hash_map->old_slots_count)
+    {
+        return 1;
+    }
+
+    map_free(_hash_map, _hash_map->old_slots);
+
+    _hash_map->old_slots = NULL;
+    _hash_map->old_slots_count = 0;
+    _hash_map->rehash_pos = 0;
+
+    return 0;
+}
+
+// Начинает постепенное перестроение движка CHAIN под новое количество слотов.
+// Узлы остаются в старых слотах и переносятся вставками, удалениями и c_hash_map_rehash_step.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+static ptrdiff_t chain_rehash_begin(c_hash_map *const _hash_map,
+                                    const size_t _slots_count)
+{
+    // Незавершенное перестроение необходимо закончить.
+    chain_rehash_advance(_hash_map, SIZE_MAX);
+
+    const size_t new_slots_count = index_round(_hash_map->index.policy, _slots_count);
+
+    const size_t new_slots_size = chain_slots_size(_hash_map, new_slots_count);
+    if (new_slots_size == 0)
+    {
+        return -1;
+    }
+
+    c_hash_map_node **const new_slots = map_alloc_zero(_hash_map, new_slots_size);
+    if (new_slots == NULL)
+    {
+        return -2;
+    }
+
+    _hash_map->old_slots = _hash_map->slots;
+    _hash_map->old_slots_count = _hash_map->slots_count;
+    _hash_map->old_index = _hash_map->index;
+    _hash_map->rehash_pos = 0;
+
+    _hash_map->slots = new_slots;
+    _hash_map->slot_gens = chain_slots_stamp(_hash_map, new_slots, new_slots_count);
+    _hash_map->slots_count = new_slots_count;
+    index_setup(&_hash_map->index, new_slots_count);
+
+    // Учитывается только начало перестроения, перенос узлов распределен по операциям.
+    ++_hash_map->resizes_count;
+
+    return 1;
+}
+
+// Вытесняет пары режима кэша по алгоритму CLOCK, пока превышен хотя бы один из пределов.
+// Стрелка обходит слоты по кругу: пара с признаком обращения получает второй шанс (признак
+// снимается), пара без него вытесняется с вызовом функций удаления режима кэша.
+// Пара _keep (только что вставленная) не вытесняется, поэтому если не помещается только она,
+// вытеснение прекращается.
+static void cache_evict(c_hash_map *const _hash_map,
+                        const c_hash_map_node *const _keep)
+{
+    c_hash_map_cache *const cache = _hash_map->cache;
+
+    // Пока есть пара, кроме _keep, не больше двух оборотов стрелки вытесняют ее.
+    while ( (cache_over(_hash_map) > 0) && (_hash_map->nodes_count > 1) )
+    {
+        if (cache->hand >= _hash_map->slots_count)
+        {
+            cache->hand = 0;
+        }
+
+        c_hash_map_node **link = chain_head_link(_hash_map, cache->hand);
+        while ( (*link != NULL) && (cache_over(_hash_map) > 0) )
+        {
+            c_hash_map_node *const select_node = *link;
+            c_hash_map_cache_meta *const meta = node_cache_meta(_hash_map, select_node);
+
+            if ( (select_node == _keep) || (meta->referenced != 0) )
+            {
+                meta->referenced = 0;
+                link = &select_node->next_node;
+                continue;
+            }
+
+            // Ампутация узла из слота.
+            *link = select_node->next_node;
+
+            if (cache->del_key != NULL)
+            {
+                cache->del_key(select_node->key);
+            }
+            if (cache->del_data != NULL)
+            {
+                cache->del_data(select_node->data);
+            }
+
+            node_detach(_hash_map, select_node);
+            ++cache->evictions_count;
+
+            node_free(_hash_map, select_node);
+
+            --_hash_map->nodes_count;
+        }
+
+        // Стрелка уходит со слота даже после вытеснения: иначе следующее вытеснение снова
+        // начнется с его начала и снимет только что сброшенный признак обращения.
+        ++cache->hand;
+    }
+}
+
+// Учет пары в режиме кэша после функции вставки.
+// Вставленной паре (_r_code > 0) или паре с замененными данными (_assigned != 0) заново
+// вычисляется стоимость, затем при превышении пределов вытесняются другие пары.
+// Существующей паре ставится признак обращения.
+static void cache_admit(c_hash_map *const _hash_map,
+                        void **const _data_field,
+                        const ptrdiff_t _r_code,
+                        const size_t _assigned)
+{
+    c_hash_map_cache *const cache = _hash_map->cache;
+    c_hash_map_node *const node = node_of_data(_data_field);
+    c_hash_map_cache_meta *const meta = node_cache_meta(_hash_map, node);
+
+    if ( (_r_code > 0) || (_assigned != 0) )
+    {
+        if (_r_code > 0)
+        {
+            meta->referenced = 0;
+        } else {
+            cache->used -= meta->cost;
+            meta->referenced = 1;
+        }
+
+        meta->cost = (cache->cost != NULL) ? cache->cost(node->key, node->data) : _hash_map->node_size;
+        cache->used += meta->cost;
+
+        cache_evict(_hash_map, node);
+    } else {
+        meta->referenced = 1;
+    }
+}
+
+// Поиск ключа в движке CHAIN с вставкой при его отсутствии (за один проход по цепочке).
+// Если ключ вставлен, возвращает > 0, в узел заносятся хэш и ключ, данные обнуляются.
+// Если ключ уже есть, возвращает 0.
+// В обоих случаях в _node помещается узел ключа.
+// В случае ошибки возвращает < 0.
+static ptrdiff_t chain_emplace(c_hash_map *const _hash_map,
+                               const void *const _key,
+                               const size_t _hash,
+                               c_hash_map_node **const _node)
+{
+    // Проверим, имеются ли в хэш-отображении данные с заданным ключом.
+    if (_hash_map->nodes_count > 0)
+    {
+        c_hash_map_node **const link = chain_find(_hash_map, _hash, _key);
+        if (link != NULL)
+        {
+            *_node = *link;
+            return 0;
+        }
+    }
+
+    // Начинаем вставлять.
+
+    // Если слотов нет вообще.
+    if (_hash_map->slots_count == 0)
+    {
+        // Попытаемся расширить слоты.
+        if (c_hash_map_resize(_hash_map, _hash_map->initial_slots) <= 0)
+        {
+            return -5;
+        }
+    } else {
+        // Если слоты есть, то при достижении предела загруженности увеличиваем количество слотов.
+        const float load_factor = (float)_hash_map->nodes_count / _hash_map->slots_count;
+        if (load_factor >= _hash_map->max_load_factor)
+        {
+            // Определим новое количество слотов.
+            const double grown = (double)_hash_map->slots_count * _hash_map->growth_factor;
+            if (grown >= (double)SIZE_MAX)
+            {
+                return -6;
+            }
+            size_t new_slots_count = (size_t)grown;
+            new_slots_count += 1;
+            if (new_slots_count == 0)
+            {
+                return -7;
+            }
+
+            // Попытаемся расширить слоты (сразу или постепенно).
+            if (_hash_map->rehash_step > 0)
+            {
+                if (chain_rehash_begin(_hash_map, new_slots_count) < 0)
+                {
+                    return -8;
+                }
+            } else {
+                if (c_hash_map_resize(_hash_map, new_slots_count) < 0)
+                {
+                    return -8;
+                }
+            }
+        }
+    }
+
+    // Попытаемся выделить память под узел.
+    c_hash_map_node *const new_node = node_alloc(_hash_map);
+    if (new_node == NULL)
+    {
+        return -9;
+    }
+
+    // Приведенный хэш ключа вставляемых данных.
+    const size_t presented_hash = index_of(&_hash_map->index, _hash_map->slots_count, _hash);
+
+    // Заносим в узел неприведенный хэш ключа вставляемых данных.
+    new_node->hash = _hash;
+
+    // Связываем узел с ключем.
+    pair_init(_hash_map, &new_node->key, &new_node->data, (uint8_t*)(new_node + 1), _key);
+
+    // Срок жизни задается отдельно (c_hash_map_insert_ttl, c_hash_map_touch).
+    if (_hash_map->wheel != NULL)
+    {
+        node_ttl_meta(_hash_map, new_node)->list = C_HASH_MAP_WHEEL_NONE;
+    }
+
+    // Добавляем узел в слот.
+    c_hash_map_node **const head = chain_head_link(_hash_map, presented_hash);
+    new_node->next_node = *head;
+    *head = new_node;
+
+    ++_hash_map->nodes_count;
+
+    *_node = new_node;
+
+    chain_rehash_advance(_hash_map, _hash_map->rehash_step);
+
+    return 1;
+}
+
+// Поиск ключа с вставкой при его отсутствии.
+// Возвращает расположение данных пары с заданным ключом, в _r_code помещается код:
+// > 0 - ключ вставлен (данные равны NULL), 0 - ключ уже был, < 0 - ошибка (функция возвращает NULL).
+static void **map_emplace(c_hash_map *const _hash_map,
+                          const void *const _key,
+                          const size_t _hash,
+                          ptrdiff_t *const _r_code)
+{
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_SWISS)
+    {
+        size_t s;
+        *_r_code = swiss_emplace(_hash_map, _key, _hash, &s);
+        return (*_r_code >= 0) ? &swiss_entry(_hash_map, s)->data : NULL;
+    }
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_DENSE)
+    {
+        size_t pair;
+        *_r_code = dense_emplace(_hash_map, _key, _hash, &pair);
+        return (*_r_code >= 0) ? &swiss_entry(_hash_map, pair)->data : NULL;
+    }
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_CUCKOO)
+    {
+        size_t s;
+        *_r_code = cuckoo_emplace(_hash_map, _key, _hash, &s);
+        return (*_r_code >= 0) ? &swiss_entry(_hash_map, s)->data : NULL;
+    }
+
+    c_hash_map_node *node;
+    *_r_code = chain_emplace(_hash_map, _key, _hash, &node);
+    return (*_r_code >= 0) ? &node->data : NULL;
+}
+
+// Вставка данных в хэш-отображение.
+// В случае успешной вставки возвращает > 0, ключ и данные захватываются хэш-отображением.
+// Если данные с указанным ключом уже есть в хэш-отображении, функция возвращает 0,
+// ключ и данные не захватываются хэш-отображением.
+// В случае ошибки возвращает < 0, ключ и данные не захватываются хэш-отображением.
+ptrdiff_t c_hash_map_insert(c_hash_map *const _hash_map,
+                            const void *const _key,
+                            const void *const _data)
+{
+    if (_hash_map == NULL) return -1;
+    if (_key == NULL) return -2;
+
+    return c_hash_map_insert_hashed(_hash_map, _key, _hash_map->hash_key(_key), _data);
+}
+
+// Вставка данных в хэш-отображение с ключом, неприведенный хэш которого уже вычислен
+// (например, при маршрутизации ключа).
+// _hash должен быть равен hash_key(_key): он сохраняется в паре и используется при поиске
+// и перестроении, hash_key для пары не вызывается.
+// Коды возврата и захват ключа и данных аналогичны c_hash_map_insert.
+ptrdiff_t c_hash_map_insert_hashed(c_hash_map *const _hash_map,
+                                   const void *const _key,
+                                   const size_t _hash,
+                                   const void *const _data)
+{
+    if (_hash_map == NULL) return -1;
+    if (_key == NULL) return -2;
+    if (_data == NULL) return -3;
+
+    ptrdiff_t r_code;
+    void **const data = map_emplace(_hash_map, _key, _hash, &r_code);
+
+    // Ошибка.
+    if (r_code < 0) return r_code;
+
+    // Связываем узел с данными, если данных еще не было.
+    if (r_code > 0)
+    {
+        pair_set_data(_hash_map, data, _data);
+    }
+
+    if (_hash_map->cache != NULL)
+    {
+        cache_admit(_hash_map, data, r_code, 0);
+    }
+
+    return (r_code > 0) ? 1 : 0;
+}
+
+// Вставка данных в хэш-отображение с заменой данных существующей пары.
+// Хэш ключа вычисляется один раз, хэш-отображение просматривается один раз.
+// В случае вставки новой пары возвращает > 0, ключ и данные захватываются хэш-отображением.
+// Если пара с заданным ключом уже есть, ее данные заменяются заданными и функция возвращает 0:
+// данные захватываются, ключ не захватывается, к старым данным применяется _del_data (если задана).
+// В случае ошибки возвращает < 0, ключ и данные не захватываются хэш-отображением.
+ptrdiff_t c_hash_map_insert_or_assign(c_hash_map *const _hash_map,
+                                      const void *const _key,
+                                      const void *const _data,
+                                      void (*const _del_data)(void *const _data))
+{
+    if (_hash_map == NULL) return -1;
+    if (_key == NULL) return -2;
+
+    return c_hash_map_insert_or_assign_hashed(_hash_map, _key, _hash_map->hash_key(_key), _data, _del_data);
+}
+
+// c_hash_map_insert_or_assign с уже вычисленным хэшем ключа (см. c_hash_map_insert_hashed).
+ptrdiff_t c_hash_map_insert_or_assign_hashed(c_hash_map *const _hash_map,
+                                             const void *const _key,
+                                             const size_t _hash,
+                                             const void *const _data,
+                                             void (*const _del_data)(void *const _data))
+{
+    if (_hash_map == NULL) return -1;
+    if (_key == NULL) return -2;
+    if (_data == NULL) return -3;
+
+    ptrdiff_t r_code;
+    void **const data = map_emplace(_hash_map, _key, _hash, &r_code);
+
+    // Ошибка.
+    if (r_code < 0) return r_code;
+
+    // Если заменяются существующие данные и для них задана функция удаления, вызываем ее.
+    if ( (r_code == 0) && (_del_data != NULL) && (*data != _data) )
+    {
+        _del_data(*data);
+    }
+
+    pair_set_data(_hash_map, data, _data);
+
+    if (_hash_map->cache != NULL)
+    {
+        cache_admit(_hash_map, data, r_code, 1);
+    }
+
+    return r_code;
+}
+
+// Вставка данных в хэш-отображение, если пары с заданным ключом еще нет.
+// В случае вставки возвращает > 0, ключ и данные захватываются хэш-отображением.
+// Если пара с заданным ключом уже есть, возвращает 0, ключ и данные не захватываются,
+// а если _exist_data != NULL, в заданное расположение помещаются данные существующей пары.
+// В случае ошибки возвращает < 0, ключ и данные не захватываются хэш-отображением.
+ptrdiff_t c_hash_map_try_emplace(c_hash_map *const _hash_map,
+                                 const void *const _key,
+                                 const void *const _data,
+                                 void **const _exist_data)
+{
+    if (_hash_map == NULL) return -1;
+    if (_key == NULL) return -2;
+
+    return c_hash_map_try_emplace_hashed(_hash_map, _key, _hash_map->hash_key(_key), _data, _exist_data);
+}
+
+// c_hash_map_try_emplace с уже вычисленным хэшем ключа (см. c_hash_map_insert_hashed).
+ptrdiff_t c_hash_map_try_emplace_hashed(c_hash_map *const _hash_map,
+                                        const void *const _key,
+                                        const size_t _hash,
+                                        const void *const _data,
+                                        void **const _exist_data)
+{
+    if (_hash_map == NULL) return -1;
+    if (_key == NULL) return -2;
+    if (_data == NULL) return -3;
+
+    ptrdiff_t r_code;
+    void **const data = map_emplace(_hash_map, _key, _hash, &r_code);
+
+    // Ошибка.
+    if (r_code < 0) return r_code;
+
+    if (r_code > 0)
+    {
+        pair_set_data(_hash_map, data, _data);
+    } else {
+        if (_exist_data != NULL)
+        {
+            *_exist_data = *data;
+        }
+    }
+
+    if (_hash_map->cache != NULL)
+    {
+        cache_admit(_hash_map, data, r_code, 0);
+    }
+
+    return r_code;
+}
+
+// Поиск пары с заданным ключом с вставкой новой пары при ее отсутствии.
+// В случае успеха возвращает расположение данных пары, через которое данные можно заменить на месте.
+// Если пара была вставлена, ключ захватывается хэш-отображением, данные равны NULL, и в
+// _inserted (если != NULL) помещается 1; до любой другой операции над хэш-отображением
+// в расположение необходимо занести данные (не NULL).
+// Если пара уже была, в _inserted (если != NULL) помещается 0.
+// При встроенном хранении данных расположение содержит указатель на копию данных (у новой пары
+// обнуленную), данные заносятся через него, сам указатель изменять нельзя.
+// В случае ошибки возвращает NULL, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+void **c_hash_map_find_or_insert(c_hash_map *const _hash_map,
+                                 const void *const _key,
+                                 size_t *const _inserted,
+                                 size_t *const _error)
+{
+    if (_hash_map == NULL)
+    {
+        error_set(_error, 1);
+        return NULL;
+    }
+    if (_key == NULL)
+    {
+        error_set(_error, 2);
+        return NULL;
+    }
+
+    return c_hash_map_find_or_insert_hashed(_hash_map, _key, _hash_map->hash_key(_key), _inserted, _error);
+}
+
+// c_hash_map_find_or_insert с уже вычисленным хэшем ключа (см. c_hash_map_insert_hashed).
+void **c_hash_map_find_or_insert_hashed(c_hash_map *const _hash_map,
+                                        const void *const _key,
+                                        const size_t _hash,
+                                        size_t *const _inserted,
+                                        size_t *const _error)
+{
+    if (_hash_map == NULL)
+    {
+        error_set(_error, 1);
+        return NULL;
+    }
+    if (_key == NULL)
+    {
+        error_set(_error, 2);
+        return NULL;
+    }
+
+    ptrdiff_t r_code;
+    void **const data = map_emplace(_hash_map, _key, _hash, &r_code);
+
+    if (r_code < 0)
+    {
+        error_set(_error, 3);
+        return NULL;
+    }
+
+    if (_inserted != NULL)
+    {
+        *_inserted = (r_code > 0) ? 1 : 0;
+    }
+
+    if (_hash_map->cache != NULL)
+    {
+        cache_lookup(_hash_map, (r_code == 0) ? node_of_data(data) : NULL);
+        cache_admit(_hash_map, data, r_code, 0);
+    }
+
+    return data;
+}
+
+// Добавляет узел в конец списка.
+static inline void list_append(c_hash_map_list *const _list,
+                               c_hash_map_node *const _node)
+{
+    _node->next_node = NULL;
+    if (_list->tail != NULL)
+    {
+        _list->tail->next_node = _node;
+    } else {
+        _list->head = _node;
+    }
+    _list->tail = _node;
+}
+
+// Первый этап построения движка CHAIN: заполнение узлов диапазона пар и раскладка их по частям.
+static void *chain_build_fill(void *_arg)
+{
+    c_hash_map_build_task *const task = _arg;
+    const c_hash_map *const hash_map = task->hash_map;
+    c_hash_map_list *const lists = task->lists + task->part * task->parts_count;
+
+    for (size_t i = task->first; i < task->last; ++i)
+    {
+        c_hash_map_node *const node = (c_hash_map_node*)(task->nodes + i * hash_map->node_size);
+
+        pair_init(hash_map, &node->key, &node->data, (uint8_t*)(node + 1), task->keys[i]);
+        pair_set_data(hash_map, &node->data, task->datas[i]);
+        node->hash = hash_map->hash_key(node->key);
+        if (hash_map->wheel != NULL)
+        {
+            node_ttl_meta(hash_map, node)->list = C_HASH_MAP_WHEEL_NONE;
+        }
+
+        const size_t presented_hash = index_of(&hash_map->index, hash_map->slots_count, node->hash);
+
+        list_append(&lists[presented_hash / task->part_slots], node);
+    }
+
+    return NULL;
+}
+
+// Второй этап построения движка CHAIN: связывание со слотами узлов своей части.
+// Списки потоков обходятся по порядку, поэтому из пар с одинаковым ключом вставляется первая.
+static void *chain_build_link(void *_arg)
+{
+    c_hash_map_build_task *const task = _arg;
+    const c_hash_map *const hash_map = task->hash_map;
+
+    for (size_t t = 0; t < task->parts_count; ++t)
+    {
+        c_hash_map_node *select_node = task->lists[t * task->parts_count + task->part].head,
+                        *link_node;
+
+        while (select_node != NULL)
+        {
+            link_node = select_node;
+            select_node = select_node->next_node;
+
+            const size_t presented_hash = index_of(&hash_map->index, hash_map->slots_count, link_node->hash);
+
+            size_t exists = 0;
+            if (task->unique == 0)
+            {
+                for (const c_hash_map_node *node = chain_head(hash_map, presented_hash); node != NULL; node = node->next_node)
+                {
+                    if ( (node->hash == link_node->hash) &&
+                         (key_equal(hash_map, link_node->key, node->key) > 0) )
+                    {
+                        exists = 1;
+                        break;
+                    }
+                }
+            }
+
+            if (exists == 1)
+            {
+                list_append(&task->duplicates, link_node);
+            } else {
+                c_hash_map_node **const head = chain_head_link(hash_map, presented_hash);
+                link_node->next_node = *head;
+                *head = link_node;
+                ++task->inserted;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// Построение движка CHAIN из единого блока узлов.
+// Коды возврата аналогичны c_hash_map_build.
+static ptrdiff_t chain_build(c_hash_map *const _hash_map,
+                             const void *const *const _keys,
+                             void *const *const _datas,
+                             const size_t _count,
+                             const size_t _flags,
+                             void (*const _del_key)(void *const _key),
+                             void (*const _del_data)(void *const _data))
+{
+    size_t threads_count = _flags >> 8;
+    if (threads_count > C_HASH_MAP_THREADS_MAX)
+    {
+        threads_count = C_HASH_MAP_THREADS_MAX;
+    }
+    if (threads_count > _count / C_HASH_MAP_BUILD_PART)
+    {
+        threads_count = _count / C_HASH_MAP_BUILD_PART;
+    }
+    if (threads_count == 0)
+    {
+        threads_count = 1;
+    }
+
+    c_hash_map_list *const lists = map_alloc_zero(_hash_map, threads_count * threads_count * sizeof(c_hash_map_list));
+    if (lists == NULL)
+    {
+        return -7;
+    }
+
+    uint8_t *const nodes = slab_reserve(_hash_map, _count);
+    if (nodes == NULL)
+    {
+        map_free(_hash_map, lists);
+        return -7;
+    }
+
+    c_hash_map_build_task tasks[C_HASH_MAP_THREADS_MAX];
+    for (size_t t = 0; t < threads_count; ++t)
+    {
+        c_hash_map_build_task *const task = &tasks[t];
+
+        task->hash_map = _hash_map;
+        task->keys = _keys;
+        task->datas = _datas;
+        task->nodes = nodes;
+        task->first = _count / threads_count * t;
+        task->last = (t + 1 < threads_count) ? _count / threads_count * (t + 1) : _count;
+        task->part = t;
+        task->parts_count = threads_count;
+        task->part_slots = (_hash_map->slots_count + threads_count - 1) / threads_count;
+        task->lists = lists;
+        task->unique = ( (_flags & C_HASH_MAP_BUILD_UNIQUE) != 0 ) ? 1 : 0;
+        task->inserted = 0;
+        task->duplicates.head = NULL;
+        task->duplicates.tail = NULL;
+    }
+
+    map_parallel(_hash_map, chain_build_fill, tasks, sizeof(c_hash_map_build_task), threads_count);
+    map_parallel(_hash_map, chain_build_link, tasks, sizeof(c_hash_map_build_task), threads_count);
+
+    map_free(_hash_map, lists);
+
+    size_t inserted = 0;
+    for (size_t t = 0; t < threads_count; ++t)
+    {
+        inserted += tasks[t].inserted;
+
+        c_hash_map_node *select_node = tasks[t].duplicates.head,
+                        *delete_node;
+        while (select_node != NULL)
+        {
+            delete_node = select_node;
+            select_node = select_node->next_node;
+
+            if (_del_key != NULL)
+            {
+                _del_key(delete_node->key);
+            }
+            if (_del_data != NULL)
+            {
+                _del_data(delete_node->data);
+            }
+
+            node_free(_hash_map, delete_node);
+        }
+    }
+
+    _hash_map->nodes_count += inserted;
+
+    return (ptrdiff_t)inserted;
+}
+
+// Количество потоков, на которые делятся _count слотов (или пар): не больше запрошенного,
+// C_HASH_MAP_THREADS_MAX и количества частей по C_HASH_MAP_PARALLEL_PART, не меньше 1.
+static size_t parallel_threads(const size_t _threads_count,
+                               const size_t _count)
+{
+    size_t threads_count = _threads_count;
+    if (threads_count > C_HASH_MAP_THREADS_MAX)
+    {
+        threads_count = C_HASH_MAP_THREADS_MAX;
+    }
+    if (threads_count > _count / C_HASH_MAP_PARALLEL_PART)
+    {
+        threads_count = _count / C_HASH_MAP_PARALLEL_PART;
+    }
+    if (threads_count == 0)
+    {
+        threads_count = 1;
+    }
+
+    return threads_count;
+}
+
+// Делит _count слотов (или пар) между _threads_count заданиями на непрерывные диапазоны.
+static void parallel_split(c_hash_map *const _hash_map,
+                           c_hash_map_range_task *const _tasks,
+                           const size_t _threads_count,
+                           const size_t _count)
+{
+    memset(_tasks, 0, _threads_count * sizeof(c_hash_map_range_task));
+    for (size_t t = 0; t < _threads_count; ++t)
+    {
+        _tasks[t].hash_map = _hash_map;
+        _tasks[t].first = _count / _threads_count * t;
+        _tasks[t].last = (t + 1 < _threads_count) ? _count / _threads_count * (t + 1) : _count;
+        _tasks[t].part = t;
+        _tasks[t].parts_count = _threads_count;
+    }
+}
+
+// Обход диапазона для c_hash_map_for_each_parallel.
+static void *range_for_each(void *_arg)
+{
+    const c_hash_map_range_task *const task = _arg;
+    const c_hash_map *const hash_map = task->hash_map;
+
+    switch (hash_map->engine)
+    {
+        case C_HASH_MAP_ENGINE_SWISS:
+        case C_HASH_MAP_ENGINE_CUCKOO:
+        {
+            for (size_t s = task->first; s < task->last; ++s)
+            {
+                if ( (hash_map->ctrl[s] & 0x80) == 0 )
+                {
+                    const c_hash_map_entry *const entry = swiss_entry(hash_map, s);
+                    task->action(entry->key, entry->data, task->context);
+                }
+            }
+            break;
+        }
+        case C_HASH_MAP_ENGINE_DENSE:
+        {
+            for (size_t i = task->first; i < task->last; ++i)
+            {
+                const c_hash_map_entry *const entry = swiss_entry(hash_map, i);
+                if (entry->key != NULL)
+                {
+                    task->action(entry->key, entry->data, task->context);
+                }
+            }
+            break;
+        }
+        default:
+        {
+            for (size_t s = task->first; s < task->last; ++s)
+            {
+                for (const c_hash_map_node *node = chain_head(hash_map, s); node != NULL; node = node->next_node)
+                {
+                    task->action(node->key, node->data, task->context);
+                }
+            }
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+// Очистка диапазона для c_hash_map_clear_parallel: вызов функций удаления и, если задан zero,
+// обнуление слотов диапазона (узлы движка CHAIN при этом не освобождаются).
+static void *range_clear(void *_arg)
+{
+    const c_hash_map_range_task *const task = _arg;
+    c_hash_map *const hash_map = task->hash_map;
+
+    switch (hash_map->engine)
+    {
+        case C_HASH_MAP_ENGINE_SWISS:
+        case C_HASH_MAP_ENGINE_CUCKOO:
+        {
+            if ( (task->del_key != NULL) || (task->del_data != NULL) )
+            {
+                for (size_t s = task->first; s < task->last; ++s)
+                {
+                    if ( (hash_map->ctrl[s] & 0x80) == 0 )
+                    {
+                        const c_hash_map_entry *const entry = swiss_entry(hash_map, s);
+                        if (task->del_key != NULL)
+                        {
+                            task->del_key(entry->key);
+                        }
+                        if (task->del_data != NULL)
+                        {
+                            task->del_data(entry->data);
+                        }
+                    }
+                }
+            }
+            if (task->zero == 1)
+            {
+                memset(hash_map->ctrl + task->first, C_HASH_MAP_CTRL_EMPTY, task->last - task->first);
+            }
+            break;
+        }
+        case C_HASH_MAP_ENGINE_DENSE:
+        {
+            for (size_t i = task->first; i < task->last; ++i)
+            {
+                const c_hash_map_entry *const entry = swiss_entry(hash_map, i);
+                if (entry->key == NULL)
+                {
+                    continue;
+                }
+                if (task->del_key != NULL)
+                {
+                    task->del_key(entry->key);
+                }
+                if (task->del_data != NULL)
+                {
+                    task->del_data(entry->data);
+                }
+            }
+            break;
+        }
+        default:
+        {
+            if ( (task->del_key != NULL) || (task->del_data != NULL) )
+            {
+                for (size_t s = task->first; s < task->last; ++s)
+                {
+                    for (const c_hash_map_node *node = chain_head(hash_map, s); node != NULL; node = node->next_node)
+                    {
+                        if (task->del_key != NULL)
+                        {
+                            task->del_key(node->key);
+                        }
+                        if (task->del_data != NULL)
+                        {
+                            task->del_data(node->data);
+                        }
+                    }
+                }
+            }
+            if (task->zero == 1)
+            {
+                memset(hash_map->slots + task->first, 0, (task->last - task->first) * sizeof(c_hash_map_node*));
+            }
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+// Первый проход параллельного перестроения движка CHAIN: узлы своего диапазона старых слотов
+// раскладываются по спискам частей новых слотов.
+static void *chain_relink_split(void *_arg)
+{
+    c_hash_map_range_task *const task = _arg;
+    const c_hash_map *const hash_map = task->hash_map;
+    c_hash_map_list *const lists = task->lists + task->part * task->parts_count;
+
+    for (size_t s = task->first; s < task->last; ++s)
+    {
+        c_hash_map_node *select_node = chain_head(hash_map, s),
+                        *relocate_node;
+
+        while (select_node != NULL)
+        {
+            relocate_node = select_node;
+            select_node = select_node->next_node;
+
+            const size_t presented_hash = index_of(task->new_index, task->new_slots_count, relocate_node->hash);
+
+            list_append(&lists[presented_hash / task->part_slots], relocate_node);
+        }
+    }
+
+    return NULL;
+}
+
+// Второй проход параллельного перестроения движка CHAIN: связывание со слотами своей части
+// узлов, разложенных в нее всеми потоками.
+static void *chain_relink_link(void *_arg)
+{
+    c_hash_map_range_task *const task = _arg;
+
+    for (size_t t = 0; t < task->parts_count; ++t)
+    {
+        c_hash_map_node *select_node = task->lists[t * task->parts_count + task->part].head,
+                        *relocate_node;
+
+        while (select_node != NULL)
+        {
+            relocate_node = select_node;
+            select_node = select_node->next_node;
+
+            const size_t presented_hash = index_of(task->new_index, task->new_slots_count, relocate_node->hash);
+
+            relocate_node->next_node = task->new_slots[presented_hash];
+            task->new_slots[presented_hash] = relocate_node;
+        }
+    }
+
+    return NULL;
+}
+
+// Переносит узлы движка CHAIN в новые слоты в rehash_threads потоков.
+// Если перенос выполнен, возвращает 1.
+// Если потоков недостаточно или не удалось выделить память под списки, узлы не переносятся,
+// возвращает 0.
+static size_t chain_relink_parallel(c_hash_map *const _hash_map,
+                                    c_hash_map_node **const _new_slots,
+                                    const size_t _new_slots_count,
+                                    const c_hash_map_index *const _new_index)
+{
+    const size_t threads_count = parallel_threads(_hash_map->rehash_threads, _hash_map->slots_count);
+    if (threads_count == 1)
+    {
+        return 0;
+    }
+
+    c_hash_map_list *const lists = map_alloc_zero(_hash_map, threads_count * threads_count * sizeof(c_hash_map_list));
+    if (lists == NULL)
+    {
+        return 0;
+    }
+
+    c_hash_map_range_task tasks[C_HASH_MAP_THREADS_MAX];
+    parallel_split(_hash_map, tasks, threads_count, _hash_map->slots_count);
+    for (size_t t = 0; t < threads_count; ++t)
+    {
+        tasks[t].part_slots = (_new_slots_count + threads_count - 1) / threads_count;
+        tasks[t].lists = lists;
+        tasks[t].new_slots = _new_slots;
+        tasks[t].new_slots_count = _new_slots_count;
+        tasks[t].new_index = _new_index;
+    }
+
+    map_parallel(_hash_map, chain_relink_split, tasks, sizeof(c_hash_map_range_task), threads_count);
+    map_parallel(_hash_map, chain_relink_link, tasks, sizeof(c_hash_map_range_task), threads_count);
+
+    map_free(_hash_map, lists);
+
+    return 1;
+}
+
+// Вставка массива пар с однократным расширением хэш-отображения.
+// Ключи и данные не могут быть равны NULL.
+// Пары, ключ которых уже есть в хэш-отображении или встречался раньше в массиве, не вставляются,
+// к их ключам и данным применяются _del_key и _del_data (если заданы).
+// Флаги (C_HASH_MAP_BUILD_*): _UNIQUE отключает проверку ключей, _THREADS задает количество потоков.
+// Движок CHAIN выделяет узлы всех пар одним блоком, заполняет их и связывает со слотами в несколько
+// потоков (каждый поток связывает свой диапазон слотов), поэтому hash_key и comp_key должны допускать
+// одновременный вызов из разных потоков. Движки SWISS, DENSE и CUCKOO, движок CHAIN с отдельным
+// выделением каждого узла (slab_nodes = 1) и режим кэша вставляют пары последовательно
+// (в режиме кэша вставленные пары могут быть вытеснены следующими).
+// В случае успеха возвращает количество вставленных пар.
+// В случае ошибки возвращает < 0. Ошибки аргументов и расширения (-1...-6) возникают до вставки,
+// и ни одна пара не захватывается хэш-отображением. Ошибка вставки (-7) движка CHAIN с выделением
+// узлов одним блоком тоже возникает до связывания узлов. При последовательной вставке пары,
+// вставленные до ошибки вставки (-7), остаются в хэш-отображении и захвачены им, остальные
+// пары не захватываются.
+ptrdiff_t c_hash_map_build(c_hash_map *const _hash_map,
+                           const void *const *const _keys,
+                           void *const *const _datas,
+                           const size_t _count,
+                           const size_t _flags,
+                           void (*const _del_key)(void *const _key),
+                           void (*const _del_data)(void *const _data))
+{
+    if (_hash_map == NULL) return -1;
+    if (_count == 0) return 0;
+    if (_keys == NULL) return -2;
+    if (_datas == NULL) return -3;
+
+    for (size_t i = 0; i < _count; ++i)
+    {
+        if ( (_keys[i] == NULL) || (_datas[i] == NULL) )
+        {
+            return -4;
+        }
+    }
+
+    // Однократно расширяем хэш-отображение под все пары.
+    if (_count > SIZE_MAX - _hash_map->nodes_count)
+    {
+        return -5;
+    }
+    size_t pairs_count = _hash_map->nodes_count + _count;
+    // В режиме кэша пар не может стать больше предела.
+    if ( (_hash_map->cache != NULL) && (_hash_map->cache->capacity > 0) &&
+         (pairs_count > _hash_map->cache->capacity) )
+    {
+        pairs_count = _hash_map->cache->capacity;
+    }
+    const double needed = (double)pairs_count / _hash_map->max_load_factor + 1;
+    if (needed >= (double)SIZE_MAX)
+    {
+        return -5;
+    }
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_SWISS)
+    {
+        // Удаленные слоты тоже занимают место, при их избытке слоты перестраиваются на месте.
+        if ( (float)(_hash_map->nodes_count + _hash_map->deleted_count + _count) >
+             _hash_map->max_load_factor * _hash_map->slots_count )
+        {
+            const size_t slots_count = ((size_t)needed > _hash_map->slots_count) ? (size_t)needed : _hash_map->slots_count;
+            if (swiss_resize(_hash_map, slots_count) < 0)
+            {
+                return -6;
+            }
+        }
+    } else if (_hash_map->engine == C_HASH_MAP_ENGINE_CUCKOO) {
+        if ((size_t)needed > _hash_map->slots_count)
+        {
+            if (cuckoo_resize(_hash_map, (size_t)needed) < 0)
+            {
+                return -6;
+            }
+        }
+    } else if (_hash_map->engine == C_HASH_MAP_ENGINE_DENSE) {
+        // Емкость массива пар следует из количества слотов индекса.
+        if (_hash_map->dense_count + _count > _hash_map->dense_capacity)
+        {
+            const size_t slots_count = ((size_t)needed > _hash_map->slots_count) ? (size_t)needed : _hash_map->slots_count;
+            if (dense_rehash(_hash_map, c_hash_map_group_capacity(slots_count)) < 0)
+            {
+                return -6;
+            }
+        }
+    } else {
+        if ((size_t)needed > _hash_map->slots_count)
+        {
+            if (c_hash_map_resize(_hash_map, (size_t)needed) < 0)
+            {
+                return -6;
+            }
+        }
+        chain_rehash_advance(_hash_map, SIZE_MAX);
+    }
+
+    if ( (_hash_map->engine == C_HASH_MAP_ENGINE_CHAIN) && (_hash_map->slab.chunk_nodes != 1) &&
+         (_hash_map->cache == NULL) )
+    {
+        return chain_build(_hash_map, _keys, _datas, _count, _flags, _del_key, _del_data);
+    }
+
+    // Последовательная вставка, расширение при этом уже не требуется.
+    size_t inserted = 0;
+    for (size_t i = 0; i < _count; ++i)
+    {
+        const size_t hash = _hash_map->hash_key(_keys[i]);
+
+        ptrdiff_t r_code;
+        void **data;
+        if ( ((_flags & C_HASH_MAP_BUILD_UNIQUE) != 0) && (_hash_map->engine == C_HASH_MAP_ENGINE_SWISS) )
+        {
+            const uint64_t mixed = c_hash_map_mix(hash);
+            const size_t s = c_hash_map_group_find_free(_hash_map->ctrl, _hash_map->slots_count, mixed);
+
+            _hash_map->deleted_count -= c_hash_map_group_occupy(_hash_map->ctrl, s, mixed);
+
+            c_hash_map_entry *const entry = swiss_entry(_hash_map, s);
+            entry->hash = hash;
+            pair_init(_hash_map, &entry->key, &entry->data, (uint8_t*)(entry + 1), _keys[i]);
+            ++_hash_map->nodes_count;
+
+            r_code = 1;
+            data = &entry->data;
+        } else {
+            data = map_emplace(_hash_map, _keys[i], hash, &r_code);
+        }
+
+        if (r_code < 0)
+        {
+            return -7;
+        }
+
+        if (r_code > 0)
+        {
+            pair_set_data(_hash_map, data, _datas[i]);
+            ++inserted;
+
+            if (_hash_map->cache != NULL)
+            {
+                cache_admit(_hash_map, data, r_code, 0);
+            }
+        } else {
+            if (_del_key != NULL)
+            {
+                _del_key((void*)_keys[i]);
+            }
+            if (_del_data != NULL)
+            {
+                _del_data(_datas[i]);
+            }
+        }
+    }
+
+    return (ptrdiff_t)inserted;
+}
+
+// Уменьшает количество слотов, если после удаления загрузка опустилась ниже min_load_factor.
+// Загрузка становится равной половине max_load_factor, количество слотов - не меньше initial_slots.
+// Нехватка памяти при уменьшении не считается ошибкой: слоты остаются прежними.
+static void map_shrink(c_hash_map *const _hash_map)
+{
+    if ( (_hash_map->min_load_factor == 0.f) ||
+         (_hash_map->slots_count <= _hash_map->initial_slots) ||
+         ( (float)_hash_map->nodes_count >= _hash_map->min_load_factor * _hash_map->slots_count ) )
+    {
+        return;
+    }
+
+    size_t slots_count = (size_t)((double)_hash_map->nodes_count / (_hash_map->max_load_factor / 2)) + 1;
+    if (slots_count < _hash_map->initial_slots)
+    {
+        slots_count = _hash_map->initial_slots;
+    }
+
+    c_hash_map_resize(_hash_map, slots_count);
+}
+
+// Удаление из хэш-отображения данных с заданным ключом.
+// В случае успешного удаления возвращает > 0.
+// В случае, если данные с заданным ключом отсутствуют, возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_erase(c_hash_map *const _hash_map,
+                           const void *const _key,
+                           void (*const _del_key)(void *const _key),
+                           void (*const _del_data)(void *const _data))
+{
+    if (_hash_map == NULL) return -1;
+    if (_key == NULL) return -2;
+
+    return c_hash_map_erase_hashed(_hash_map, _key, _hash_map->hash_key(_key), _del_key, _del_data);
+}
+
+// Удаление из хэш-отображения данных с заданным ключом, хэш которого уже вычислен.
+// _hash должен быть равен hash_key(_key), иначе пара не будет найдена.
+// Коды возврата аналогичны c_hash_map_erase.
+ptrdiff_t c_hash_map_erase_hashed(c_hash_map *const _hash_map,
+                                  const void *const _key,
+                                  const size_t _hash,
+                                  void (*const _del_key)(void *const _key),
+                                  void (*const _del_data)(void *const _data))
+{
+    if (_hash_map == NULL) return -1;
+    if (_key == NULL) return -2;
+
+    if (_hash_map->nodes_count == 0) return 0;
+
+    if (_hash_map->engine != C_HASH_MAP_ENGINE_CHAIN)
+    {
+        ptrdiff_t r_code;
+        if (_hash_map->engine == C_HASH_MAP_ENGINE_SWISS)
+        {
+            r_code = swiss_erase(_hash_map, _key, _hash, _del_key, _del_data);
+        } else if (_hash_map->engine == C_HASH_MAP_ENGINE_CUCKOO) {
+            r_code = cuckoo_erase(_hash_map, _key, _hash, _del_key, _del_data);
+        } else {
+            r_code = dense_erase(_hash_map, _key, _hash, _del_key, _del_data);
+        }
+        if (r_code > 0)
+        {
+            map_shrink(_hash_map);
+        }
+        return r_code;
+    }
+
+    // Найдем узел с заданным ключом.
+    c_hash_map_node **const link = chain_find(_hash_map, _hash, _key);
+    if (link == NULL)
+    {
+        return 0;
+    }
+
+    c_hash_map_node *const delete_node = *link;
+
+    // Ампутация узла из слота.
+    *link = delete_node->next_node;
+
+    node_detach(_hash_map, delete_node);
+
+    // Если для ключа задана функция удаления, вызываем ее.
+    if (_del_key != NULL)
+    {
+        _del_key( delete_node->key );
+    }
+
+    // Если для данных задана функция удаления, вызываем ее.
+    if (_del_data != NULL)
+    {
+        _del_data( delete_node->data );
+    }
+
+    // Удаляем узел.
+    node_free(_hash_map, delete_node);
+
+    --_hash_map->nodes_count;
+
+    chain_rehash_advance(_hash_map, _hash_map->rehash_step);
+
+    map_shrink(_hash_map);
+
+    return 1;
+}
+
+// Момент истечения срока жизни _ttl, отсчитанного от _now (без переполнения).
+static inline uint64_t ttl_expire(const uint64_t _now,
+                                  const uint64_t _ttl)
+{
+    return (_ttl > UINT64_MAX - _now) ? UINT64_MAX : _now + _ttl;
+}
+
+// Задает узлу срок жизни.
+// Если колесо пусто, его текущий момент переводится в _now без просмотра слотов.
+static void ttl_set(c_hash_map *const _hash_map,
+                    c_hash_map_node *const _node,
+                    const uint64_t _now,
+                    const uint64_t _ttl)
+{
+    c_hash_map_wheel *const wheel = _hash_map->wheel;
+
+    wheel_unlink(_hash_map, _node);
+
+    if ( (wheel->count == 0) && (_now > wheel->current) )
+    {
+        wheel->current = _now;
+    }
+
+    node_ttl_meta(_hash_map, _node)->expire = ttl_expire(_now, _ttl);
+    wheel_link(_hash_map, _node);
+}
+
+// Вставка данных со сроком жизни _ttl, отсчитанным от момента _now (режим ttl_mode).
+// Моменты задаются в произвольных единицах (тиках), одинаковых для всех функций срока жизни.
+// Если пары с заданным ключом еще нет, она вставляется и истекает в момент _now + _ttl
+// (см. c_hash_map_expire). Если пара уже есть, ни она, ни ее срок не меняются.
+// Коды возврата и захват ключа и данных аналогичны c_hash_map_insert; если режим срока жизни
+// выключен, возвращает -4.
+ptrdiff_t c_hash_map_insert_ttl(c_hash_map *const _hash_map,
+                                const void *const _key,
+                                const void *const _data,
+                                const uint64_t _now,
+                                const uint64_t _ttl)
+{
+    if (_hash_map == NULL) return -1;
+    if (_key == NULL) return -2;
+    if (_data == NULL) return -3;
+    if (_hash_map->wheel == NULL) return -4;
+
+    ptrdiff_t r_code;
+    void **const data = map_emplace(_hash_map, _key, _hash_map->hash_key(_key), &r_code);
+
+    if (r_code < 0) return r_code;
+
+    if (r_code > 0)
+    {
+        pair_set_data(_hash_map, data, _data);
+        ttl_set(_hash_map, node_of_data(data), _now, _ttl);
+    }
+
+    if (_hash_map->cache != NULL)
+    {
+        cache_admit(_hash_map, data, r_code, 0);
+    }
+
+    return (r_code > 0) ? 1 : 0;
+}
+
+// Продление срока жизни пары с заданным ключом: пара истекает в момент _now + _ttl
+// (в том числе пара, вставленная без срока жизни).
+// В случае успеха возвращает > 0.
+// Если пары с заданным ключом нет, возвращает 0.
+// В случае ошибки возвращает < 0 (-3 - режим срока жизни выключен).
+ptrdiff_t c_hash_map_touch(c_hash_map *const _hash_map,
+                           const void *const _key,
+                           const uint64_t _now,
+                           const uint64_t _ttl)
+{
+    if (_hash_map == NULL) return -1;
+    if (_key == NULL) return -2;
+    if (_hash_map->wheel == NULL) return -3;
+
+    if (_hash_map->nodes_count == 0) return 0;
+
+    c_hash_map_node **const link = chain_find(_hash_map, _hash_map->hash_key(_key), _key);
+    if (link == NULL)
+    {
+        return 0;
+    }
+
+    ttl_set(_hash_map, *link, _now, _ttl);
+
+    if (_hash_map->cache != NULL)
+    {
+        node_cache_meta(_hash_map, *link)->referenced = 1;
+    }
+
+    return 1;
+}
+
+// Удаление истекших пар: удаляет не больше _budget пар, срок жизни которых наступил к моменту
+// _now, применяя к их ключам и данным _del_key и _del_data (если заданы).
+// Колесо сроков переходит только к моментам, в которые в нем есть пары, поэтому время работы
+// пропорционально количеству удаленных пар, а не размеру хэш-отображения. Если бюджет исчерпан,
+// оставшиеся истекшие пары удаляются следующими вызовами.
+// Пары удаляются из слотов по сохраненному хэшу, hash_key и comp_key не вызываются.
+// В случае успеха возвращает количество удаленных пар (>= 0).
+// В случае ошибки возвращает < 0 (-2 - режим срока жизни выключен).
+ptrdiff_t c_hash_map_expire(c_hash_map *const _hash_map,
+                            const uint64_t _now,
+                            const size_t _budget,
+                            void (*const _del_key)(void *const _key),
+                            void (*const _del_data)(void *const _data))
+{
+    if (_hash_map == NULL) return -1;
+    if (_hash_map->wheel == NULL) return -2;
+
+    c_hash_map_wheel *const wheel = _hash_map->wheel;
+
+    size_t removed = 0;
+    for (;;)
+    {
+        if (wheel->count == 0)
+        {
+            if (_now > wheel->current)
+            {
+                wheel->current = _now;
+            }
+            break;
+        }
+
+        // Пары нулевого слота текущего момента просрочены (если момент не позже _now).
+        c_hash_map_node *select_node = wheel->lists[wheel->current & (C_HASH_MAP_WHEEL_SLOTS - 1)],
+                        *expire_node;
+        while ( (select_node != NULL) && (removed < _budget) )
+        {
+            expire_node = select_node;
+            select_node = node_ttl_meta(_hash_map, select_node)->next;
+
+            if (node_ttl_meta(_hash_map, expire_node)->expire > _now)
+            {
+                continue;
+            }
+
+            // Найдем ссылку на узел в его слоте.
+            const size_t presented_hash = index_of(&_hash_map->index, _hash_map->slots_count, expire_node->hash);
+            c_hash_map_node **link = chain_head_link(_hash_map, presented_hash);
+            while (*link != expire_node)
+            {
+                link = &(*link)->next_node;
+            }
+
+            // Ампутация узла из слота.
+            *link = expire_node->next_node;
+
+            node_detach(_hash_map, expire_node);
+
+            if (_del_key != NULL)
+            {
+                _del_key(expire_node->key);
+            }
+            if (_del_data != NULL)
+            {
+                _del_data(expire_node->data);
+            }
+
+            node_free(_hash_map, expire_node);
+
+            --_hash_map->nodes_count;
+            ++removed;
+        }
+
+        if ( (removed >= _budget) || (wheel->current >= _now) )
+        {
+            break;
+        }
+
+        wheel_advance(_hash_map, wheel_next(wheel, _now));
+    }
+
+    if (removed > 0)
+    {
+        map_shrink(_hash_map);
+    }
+
+    return (ptrdiff_t)removed;
+}
+
+// Задает хэш-отображению новое количество слотов.
+// Позволяет расширить хэш-отображение с нулем слотов.
+// Пустому хэш-отображению можно задать нулевое количество слотов (память слотов освобождается).
+// Если в хэш-отображении есть хотя бы один элемент, то попытка задать нулевое количество слотов считается ошибкой.
+// Если хэш-отображение перестраивается, функция возвращает > 0.
+// Если хэш-отображение не перестраивается, функция возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_resize(c_hash_map *const _hash_map,
+                            const size_t _slots_count)
+{
+    if (_hash_map == NULL) return -1;
+
+    if (_hash_map->slots_count == _slots_count) return 0;
+
+    if ( (_slots_count == 0) && (_hash_map->nodes_count != 0) )
+    {
+        return -2;
+    }
+
+    if ( (_slots_count == 0) && (_hash_map->engine != C_HASH_MAP_ENGINE_CHAIN) )
+    {
+        map_free(_hash_map, _hash_map->ctrl);
+        if (_hash_map->engine == C_HASH_MAP_ENGINE_DENSE)
+        {
+            map_free(_hash_map, _hash_map->entries);
+        }
+
+        _hash_map->ctrl = NULL;
+        _hash_map->entries = NULL;
+        _hash_map->offsets = NULL;
+        _hash_map->slots_count = 0;
+        _hash_map->deleted_count = 0;
+        _hash_map->dense_count = 0;
+        _hash_map->dense_capacity = 0;
+
+        return 1;
+    }
+
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_SWISS)
+    {
+        return swiss_resize(_hash_map, _slots_count);
+    }
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_DENSE)
+    {
+        return dense_resize(_hash_map, _slots_count);
+    }
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_CUCKOO)
+    {
+        return cuckoo_resize(_hash_map, _slots_count);
+    }
+
+    // Незавершенное постепенное перестроение заканчиваем сразу.
+    chain_rehash_advance(_hash_map, SIZE_MAX);
+
+    if (_slots_count == 0)
+    {
+
+        map_free(_hash_map, _hash_map->slots);
+        _hash_map->slots = NULL;
+        _hash_map->slot_gens = NULL;
+
+        _hash_map->slots_count = 0;
+
+        return 1;
+    } else {
+        // Приводим количество слотов к допустимому для способа приведения хэша.
+        const size_t new_slots_count = index_round(_hash_map->index.policy, _slots_count);
+        if (new_slots_count == _hash_map->slots_count)
+        {
+            return 0;
+        }
+
+        const uint64_t begin = time_ns();
+
+        // Определяем новый размер, необходимый под slots.
+        const size_t new_slots_size = chain_slots_size(_hash_map, new_slots_count);
+        if (new_slots_size == 0)
+        {
+            return -3;
+        }
+
+        // Параметры приведения хэша к новому количеству слотов.
+        c_hash_map_index new_index = _hash_map->index;
+        index_setup(&new_index, new_slots_count);
+
+        // Попытаемся выделить память под новые слоты.
+        c_hash_map_node **const new_slots = map_alloc_zero(_hash_map, new_slots_size);
+        if (new_slots == NULL)
+        {
+            return -4;
+        }
+        uint32_t *const new_slot_gens = chain_slots_stamp(_hash_map, new_slots, new_slots_count);
+
+        // Если есть узлы, которые необходимо перенести из старых слотов в новые
+        // (при заданном rehash_threads - сначала пытаемся в нескольких потоках).
+        if ( (_hash_map->nodes_count > 0) &&
+             (chain_relink_parallel(_hash_map, new_slots, new_slots_count, &new_index) == 0) )
+        {
+            size_t count = _hash_map->nodes_count;
+            for (size_t s = 0; (s < _hash_map->slots_count)&&(count > 0); ++s)
+            {
+                if (chain_head(_hash_map, s) != NULL)
+                {
+                    c_hash_map_node *select_node = _hash_map->slots[s],
+                                    *relocate_node;
+
+                    while (select_node != NULL)
+                    {
+                        relocate_node = select_node;
+                        select_node = select_node->next_node;
+
+                        // Хэш ключа переносимого узла, приведенный к новому количеству слотов.
+                        const size_t presented_hash = index_of(&new_index, new_slots_count, relocate_node->hash);
+
+                        relocate_node->next_node = new_slots[presented_hash];
+                        new_slots[presented_hash] = relocate_node;
+
+                        --count;
+                    }
+                }
+            }
+
+        }
+
+        map_free(_hash_map, _hash_map->slots);
+
+        // Используем новые слоты.
+        _hash_map->slots = new_slots;
+        _hash_map->slot_gens = new_slot_gens;
+        _hash_map->slots_count = new_slots_count;
+        _hash_map->index = new_index;
+
+        resize_account(_hash_map, begin);
+
+        return 2;
+    }
+}
+
+// Переносит узлы не более чем _budget старых слотов незавершенного постепенного перестроения.
+// Позволяет продвигать перестроение в периоды простоя.
+// Если после вызова перестроение еще не окончено, возвращает > 0.
+// Если перестроения нет (в том числе оно окончилось этим вызовом), возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_rehash_step(c_hash_map *const _hash_map,
+                                 const size_t _budget)
+{
+    if (_hash_map == NULL) return -1;
+
+    if (_hash_map->engine != C_HASH_MAP_ENGINE_CHAIN) return 0;
+
+    return chain_rehash_advance(_hash_map, _budget);
+}
+
+// Задает хэш-отображению количество слотов, достаточное для _pairs_count пар без превышения
+// max_load_factor (для движка DENSE также выделяется место под пары).
+// Если хэш-отображение перестраивается, функция возвращает > 0.
+// Если слотов уже достаточно, возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_reserve(c_hash_map *const _hash_map,
+                             const size_t _pairs_count)
+{
+    if (_hash_map == NULL) return -1;
+
+    if (_pairs_count == 0) return 0;
+
+    const double needed = (double)_pairs_count / _hash_map->max_load_factor;
+    if (needed >= (double)SIZE_MAX)
+    {
+        return -2;
+    }
+    size_t slots_count = (size_t)needed;
+    if ((double)slots_count < needed)
+    {
+        ++slots_count;
+    }
+
+    if ( (slots_count <= _hash_map->slots_count) &&
+         ( (_hash_map->engine != C_HASH_MAP_ENGINE_DENSE) || (_pairs_count <= _hash_map->dense_capacity) ) )
+    {
+        return 0;
+    }
+
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_DENSE)
+    {
+        // Емкость массива пар округляется вниз, поэтому индекс может потребоваться больше.
+        size_t capacity = c_hash_map_group_capacity( (slots_count > _hash_map->slots_count) ? slots_count :
+                                                                                              _hash_map->slots_count );
+        while ( (capacity != 0) && ((double)capacity * _hash_map->max_load_factor < (double)_pairs_count) )
+        {
+            capacity = (capacity <= SIZE_MAX / 2) ? capacity * 2 : 0;
+        }
+        if (capacity == 0)
+        {
+            return -2;
+        }
+        return (dense_rehash(_hash_map, capacity) > 0) ? 1 : -3;
+    }
+
+    const ptrdiff_t r_code = c_hash_map_resize(_hash_map, slots_count);
+    if (r_code < 0)
+    {
+        return (r_code == -3) ? -2 : -3;
+    }
+
+    return r_code;
+}
+
+// Переносит узлы движка CHAIN в один блок ровно по их количеству и освобождает прежние блоки.
+// Постепенное перестроение должно быть закончено.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0 (узлы остаются на месте).
+static ptrdiff_t chain_compact(c_hash_map *const _hash_map)
+{
+    const c_hash_map_slab old_slab = _hash_map->slab;
+
+    memset(&_hash_map->slab, 0, sizeof(c_hash_map_slab));
+    _hash_map->slab.chunk_nodes = old_slab.chunk_nodes;
+
+    uint8_t *const nodes = slab_reserve(_hash_map, _hash_map->nodes_count);
+    if (nodes == NULL)
+    {
+        _hash_map->slab = old_slab;
+        return -1;
+    }
+
+    size_t n = 0;
+    for (size_t s = 0; s < _hash_map->slots_count; ++s)
+    {
+        c_hash_map_node **link = chain_head_link(_hash_map, s);
+        while (*link != NULL)
+        {
+            c_hash_map_node *const new_node = (c_hash_map_node*)(nodes + n * _hash_map->node_size);
+            memcpy(new_node, *link, _hash_map->node_size);
+
+            // Встроенные ключ и данные переместились вместе с узлом.
+            if (_hash_map->key_size > 0)
+            {
+                new_node->key = new_node + 1;
+            }
+            if (_hash_map->value_size > 0)
+            {
+                new_node->data = (uint8_t*)(new_node + 1) + _hash_map->key_stride;
+            }
+            if (_hash_map->wheel != NULL)
+            {
+                wheel_relocate(_hash_map, new_node);
+            }
+
+            *link = new_node;
+            link = &new_node->next_node;
+            ++n;
+        }
+    }
+
+    c_hash_map_chunk *select_chunk = old_slab.first_chunk,
+                     *delete_chunk;
+    while (select_chunk != NULL)
+    {
+        delete_chunk = select_chunk;
+        select_chunk = select_chunk->next_chunk;
+        map_free(_hash_map, delete_chunk);
+    }
+
+    return 1;
+}
+
+// Уменьшает хэш-отображение до минимального количества слотов, при котором не превышается
+// max_load_factor, и освобождает неиспользуемую память пар (узлы движка CHAIN переносятся
+// в один блок, удаленные пары движков SWISS и DENSE исчезают).
+// Пустое хэш-отображение освобождает всю память слотов и пар.
+// Если память была освобождена, функция возвращает > 0.
+// Если уменьшать нечего, возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_shrink_to_fit(c_hash_map *const _hash_map)
+{
+    if (_hash_map == NULL) return -1;
+
+    ptrdiff_t r_code = 0;
+
+    if (_hash_map->nodes_count == 0)
+    {
+        if (_hash_map->engine == C_HASH_MAP_ENGINE_CHAIN)
+        {
+            chain_rehash_advance(_hash_map, SIZE_MAX);
+            if (_hash_map->slab.first_chunk != NULL)
+            {
+                slab_release(_hash_map);
+                r_code = 1;
+            }
+        }
+        if (_hash_map->slots_count > 0)
+        {
+            r_code = c_hash_map_resize(_hash_map, 0);
+        }
+        return r_code;
+    }
+
+    const double needed = (double)_hash_map->nodes_count / _hash_map->max_load_factor;
+    size_t slots_count = (size_t)needed;
+    if ((double)slots_count < needed)
+    {
+        ++slots_count;
+    }
+
+    r_code = c_hash_map_resize(_hash_map, slots_count);
+    if (r_code < 0)
+    {
+        return -2;
+    }
+
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_CHAIN)
+    {
+        chain_rehash_advance(_hash_map, SIZE_MAX);
+
+        size_t capacity = 0;
+        for (const c_hash_map_chunk *chunk = _hash_map->slab.first_chunk; chunk != NULL; chunk = chunk->next_chunk)
+        {
+            capacity += chunk->capacity;
+        }
+
+        if ( (_hash_map->slab.chunk_nodes != 1) && (capacity > _hash_map->nodes_count) )
+        {
+            if (chain_compact(_hash_map) < 0)
+            {
+                return -3;
+            }
+            r_code = 1;
+        }
+    }
+
+    return r_code;
+}
+
+// Ищет пару с заданным ключом (объектом или байтовым представлением, см. key_match) в любом движке.
+// Возвращает расположение данных пары или NULL, если пары нет.
+static void *const *map_find(const c_hash_map *const _hash_map,
+                             const size_t _hash,
+                             const void *const _key,
+                             const size_t _key_size)
+{
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_SWISS)
+    {
+        const size_t s = index_find(_hash_map, _hash, _key, _key_size, NULL, 0);
+        return (s != SIZE_MAX) ? &swiss_entry(_hash_map, s)->data : NULL;
+    }
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_DENSE)
+    {
+        const size_t s = index_find(_hash_map, _hash, _key, _key_size, NULL, 1);
+        return (s != SIZE_MAX) ? &swiss_entry(_hash_map, _hash_map->offsets[s])->data : NULL;
+    }
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_CUCKOO)
+    {
+        const size_t s = cuckoo_find_key(_hash_map, _hash, _key, _key_size);
+        return (s != SIZE_MAX) ? &swiss_entry(_hash_map, s)->data : NULL;
+    }
+
+    c_hash_map_node *const *const link = chain_find_key(_hash_map, _hash, _key, _key_size);
+
+    if (_hash_map->cache != NULL)
+    {
+        cache_lookup(_hash_map, (link != NULL) ? *link : NULL);
+    }
+
+    return (link != NULL) ? &(*link)->data : NULL;
+}
+
+// Проверка на наличие в хэш-отображении данных с заданным ключом.
+// В случае наличия данных с заданным ключом возвращает > 0.
+// В случае отсутствия данных с заданным ключом возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_check(const c_hash_map *const _hash_map,
+                           const void *const _key)
+{
+    if (_hash_map == NULL) return -1;
+    if (_key == NULL) return -2;
+
+    if (_hash_map->nodes_count == 0) return 0;
+
+    return (map_find(_hash_map, _hash_map->hash_key(_key), _key, C_HASH_MAP_KEY_OBJECT) != NULL) ? 1 : 0;
+}
+
+// Проверка на наличие в хэш-отображении данных с заданным ключом, хэш которого уже вычислен.
+// _hash должен быть равен hash_key(_key), иначе пара не будет найдена.
+// Коды возврата аналогичны c_hash_map_check.
+ptrdiff_t c_hash_map_check_hashed(const c_hash_map *const _hash_map,
+                                  const void *const _key,
+                                  const size_t _hash)
+{
+    if (_hash_map == NULL) return -1;
+    if (_key == NULL) return -2;
+
+    if (_hash_map->nodes_count == 0) return 0;
+
+    return (map_find(_hash_map, _hash, _key, C_HASH_MAP_KEY_OBJECT) != NULL) ? 1 : 0;
+}
+
+// Проверка на наличие в хэш-отображении данных с ключом, заданным байтовым представлением
+// _bytes размером _size (например, подстрокой буфера без копирования и завершающего нуля).
+// _hash должен быть равен hash_key от ключа-объекта с таким представлением.
+// Представление сравнивается с хранимыми ключами функцией comp_key_view, а если она не задана,
+// побайтно со встроенными ключами (key_size).
+// Коды возврата аналогичны c_hash_map_check; если comp_key_view не задана и ключи не встроены,
+// возвращает -3.
+ptrdiff_t c_hash_map_check_view(const c_hash_map *const _hash_map,
+                                const void *const _bytes,
+                                const size_t _size,
+                                const size_t _hash)
+{
+    if (_hash_map == NULL) return -1;
+    if ( (_bytes == NULL) && (_size > 0) ) return -2;
+    if ( (_hash_map->comp_key_view == NULL) && (_hash_map->key_size == 0) ) return -3;
+
+    if ( (_hash_map->nodes_count == 0) || (_size == C_HASH_MAP_KEY_OBJECT) ) return 0;
+
+    return (map_find(_hash_map, _hash, _bytes, _size) != NULL) ? 1 : 0;
+}
+
+// Обращение к данным с заданным ключом.
+// В случае успеха возвращает указатель на данные, которые связаны с заданным ключом.
+// Если данных нет, функция возвращает NULL, это не считается ошибкой.
+// В случае ошибки функция возвращает NULL, и если _error != NULL, то в заданное расположение помещается
+// код причины ошибки (> 0).
+// Так как функция может возвращать NULL и в случае успеха, и в случае ошибки, для детектирования ошибки
+// перед вызовом функции необходимо поместить 0 в заданное расположение ошибки.
+void *c_hash_map_at(const c_hash_map *const _hash_map,
+                    const void *const _key,
+                    size_t *const _error)
+{
+    if (_hash_map == NULL)
+    {
+        error_set(_error, 1);
+        return NULL;
+    }
+    if (_key == NULL)
+    {
+        error_set(_error, 2);
+        return NULL;
+    }
+
+    if (_hash_map->nodes_count == 0) return NULL;
+
+    void *const *const data = map_find(_hash_map, _hash_map->hash_key(_key), _key, C_HASH_MAP_KEY_OBJECT);
+
+    return (data != NULL) ? *data : NULL;
+}
+
+// Обращение к данным с заданным ключом, хэш которого уже вычислен.
+// _hash должен быть равен hash_key(_key), иначе пара не будет найдена.
+// Возвращаемое значение и коды ошибок аналогичны c_hash_map_at.
+void *c_hash_map_at_hashed(const c_hash_map *const _hash_map,
+                           const void *const _key,
+                           const size_t _hash,
+                           size_t *const _error)
+{
+    if (_hash_map == NULL)
+    {
+        error_set(_error, 1);
+        return NULL;
+    }
+    if (_key == NULL)
+    {
+        error_set(_error, 2);
+        return NULL;
+    }
+
+    if (_hash_map->nodes_count == 0) return NULL;
+
+    void *const *const data = map_find(_hash_map, _hash, _key, C_HASH_MAP_KEY_OBJECT);
+
+    return (data != NULL) ? *data : NULL;
+}
+
+// Обращение к данным с ключом, заданным байтовым представлением _bytes размером _size
+// (см. c_hash_map_check_view).
+// Возвращаемое значение и коды ошибок аналогичны c_hash_map_at; если comp_key_view не задана
+// и ключи не встроены, код ошибки равен 3.
+void *c_hash_map_at_view(const c_hash_map *const _hash_map,
+                         const void *const _bytes,
+                         const size_t _size,
+                         const size_t _hash,
+                         size_t *const _error)
+{
+    if (_hash_map == NULL)
+    {
+        error_set(_error, 1);
+        return NULL;
+    }
+    if ( (_bytes == NULL) && (_size > 0) )
+    {
+        error_set(_error, 2);
+        return NULL;
+    }
+    if ( (_hash_map->comp_key_view == NULL) && (_hash_map->key_size == 0) )
+    {
+        error_set(_error, 3);
+        return NULL;
+    }
+
+    if ( (_hash_map->nodes_count == 0) || (_size == C_HASH_MAP_KEY_OBJECT) ) return NULL;
+
+    void *const *const data = map_find(_hash_map, _hash, _bytes, _size);
+
+    return (data != NULL) ? *data : NULL;
+}
+
+// Пакетный поиск в движке CHAIN.
+// Ключи обрабатываются по C_HASH_MAP_BATCH этапами: вычисление хэшей с предвыборкой слотов,
+// чтение слотов с предвыборкой первых узлов, предвыборка хранимых ключей, сравнение ключей.
+// Так промахи кэша одного этапа перекрываются между собой, а не следуют друг за другом.
+// Возвращает количество найденных ключей, в случае ошибки возвращает < 0.
+static ptrdiff_t chain_at_batch(const c_hash_map *const _hash_map,
+                                const void *const *const _keys,
+                                const size_t _count,
+                                void **const _datas)
+{
+    size_t hashes[C_HASH_MAP_BATCH],
+           slots[C_HASH_MAP_BATCH];
+    c_hash_map_node *heads[C_HASH_MAP_BATCH];
+
+    ptrdiff_t found = 0;
+
+    for (size_t b = 0; b < _count; b += C_HASH_MAP_BATCH)
+    {
+        const size_t count = (_count - b < C_HASH_MAP_BATCH) ? _count - b : C_HASH_MAP_BATCH;
+        const void *const *const keys = _keys + b;
+        void **const datas = _datas + b;
+
+        // Этап 1: хэши и предвыборка слотов.
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (keys[i] == NULL) return -3;
+
+            hashes[i] = _hash_map->hash_key(keys[i]);
+            slots[i] = index_of(&_hash_map->index, _hash_map->slots_count, hashes[i]);
+            C_HASH_MAP_PREFETCH(&_hash_map->slots[slots[i]]);
+        }
+
+        // Этап 2: предвыборка первых узлов.
+        for (size_t i = 0; i < count; ++i)
+        {
+            heads[i] = chain_head(_hash_map, slots[i]);
+            if (heads[i] != NULL)
+            {
+                C_HASH_MAP_PREFETCH(heads[i]);
+            }
+        }
+
+        // Этап 3: предвыборка ключей первых узлов с совпавшим хэшем.
+        for (size_t i = 0; i < count; ++i)
+        {
+            if ( (heads[i] != NULL) && (heads[i]->hash == hashes[i]) )
+            {
+                C_HASH_MAP_PREFETCH(heads[i]->key);
+            }
+        }
+
+        // Этап 4: сравнение ключей.
+        for (size_t i = 0; i < count; ++i)
+        {
+            datas[i] = NULL;
+
+            c_hash_map_node *select_node = heads[i];
+            size_t probes = 0;
+            while (select_node != NULL)
+            {
+                ++probes;
+                if (hashes[i] == select_node->hash)
+                {
+                    if (key_equal(_hash_map, keys[i], select_node->key) > 0)
+                    {
+                        datas[i] = select_node->data;
+                        ++found;
+                        break;
+                    }
+                }
+
+                select_node = select_node->next_node;
+            }
+
+            // Поиск в старых слотах учитывается chain_find.
+            if ( (datas[i] != NULL) || (_hash_map->old_slots == NULL) )
+            {
+                C_HASH_MAP_PROBES(_hash_map, (datas[i] != NULL) ? 1 : 0, probes);
+            }
+
+            // В режиме кэша старых слотов нет.
+            if (_hash_map->cache != NULL)
+            {
+                cache_lookup(_hash_map, select_node);
+            }
+
+            // Ключ может находиться в еще не перенесенном старом слоте.
+            if ( (datas[i] == NULL) && (_hash_map->old_slots != NULL) )
+            {
+                c_hash_map_node **const link = chain_find(_hash_map, hashes[i], keys[i]);
+                if (link != NULL)
+                {
+                    datas[i] = (*link)->data;
+                    ++found;
+                }
+            }
+        }
+    }
+
+    return found;
+}
+
+// Пакетный поиск в движке SWISS.
+// Этапы: вычисление хэшей с предвыборкой первых групп управляющих байтов, сравнение фрагментов хэша
+// в группах с предвыборкой первых совпавших слотов, предвыборка хранимых ключей, полный поиск.
+// Возвращает количество найденных ключей, в случае ошибки возвращает < 0.
+static ptrdiff_t swiss_at_batch(const c_hash_map *const _hash_map,
+                                const void *const *const _keys,
+                                const size_t _count,
+                                void **const _datas)
+{
+    size_t hashes[C_HASH_MAP_BATCH];
+    const uint8_t *groups[C_HASH_MAP_BATCH];
+    size_t slots[C_HASH_MAP_BATCH];
+
+    const size_t groups_mask = _hash_map->slots_count / C_HASH_MAP_GROUP - 1;
+
+    ptrdiff_t found = 0;
+
+    for (size_t b = 0; b < _count; b += C_HASH_MAP_BATCH)
+    {
+        const size_t count = (_count - b < C_HASH_MAP_BATCH) ? _count - b : C_HASH_MAP_BATCH;
+        const void *const *const keys = _keys + b;
+        void **const datas = _datas + b;
+
+        // Этап 1: хэши и предвыборка первых групп.
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (keys[i] == NULL) return -3;
+
+            hashes[i] = _hash_map->hash_key(keys[i]);
+            groups[i] = _hash_map->ctrl + ((size_t)c_hash_map_mix(hashes[i]) & groups_mask) * C_HASH_MAP_GROUP;
+            C_HASH_MAP_PREFETCH(groups[i]);
+        }
+
+        // Этап 2: предвыборка первых слотов, фрагмент хэша которых совпал.
+        for (size_t i = 0; i < count; ++i)
+        {
+            const uint32_t match = c_hash_map_group_match(groups[i], c_hash_map_h2(c_hash_map_mix(hashes[i])));
+            if (match != 0)
+            {
+                slots[i] = (size_t)(groups[i] - _hash_map->ctrl) + c_hash_map_ctz32(match);
+                C_HASH_MAP_PREFETCH(swiss_entry(_hash_map, slots[i]));
+            } else {
+                slots[i] = SIZE_MAX;
+            }
+        }
+
+        // Этап 3: предвыборка хранимых ключей этих слотов.
+        for (size_t i = 0; i < count; ++i)
+        {
+            if ( (slots[i] != SIZE_MAX) && (swiss_entry(_hash_map, slots[i])->hash == hashes[i]) )
+            {
+                C_HASH_MAP_PREFETCH(swiss_entry(_hash_map, slots[i])->key);
+            }
+        }
+
+        // Этап 4: полный поиск.
+        for (size_t i = 0; i < count; ++i)
+        {
+            const size_t s = swiss_find(_hash_map, hashes[i], keys[i], NULL);
+            if (s != SIZE_MAX)
+            {
+                datas[i] = swiss_entry(_hash_map, s)->data;
+                ++found;
+            } else {
+                datas[i] = NULL;
+            }
+        }
+    }
+
+    return found;
+}
+
+// Пакетный поиск в движке DENSE.
+// Этапы те же, что у swiss_at_batch, но между слотом индекса и парой есть еще одно обращение:
+// после сравнения фрагментов хэша предвыбирается номер пары в offsets, затем сама пара
+// в массиве пар и ее ключ.
+// Возвращает количество найденных ключей, в случае ошибки возвращает < 0.
+static ptrdiff_t dense_at_batch(const c_hash_map *const _hash_map,
+                                const void *const *const _keys,
+                                const size_t _count,
+                                void **const _datas)
+{
+    size_t hashes[C_HASH_MAP_BATCH];
+    const uint8_t *groups[C_HASH_MAP_BATCH];
+    size_t slots[C_HASH_MAP_BATCH];
+
+    const size_t groups_mask = _hash_map->slots_count / C_HASH_MAP_GROUP - 1;
+
+    ptrdiff_t found = 0;
+
+    for (size_t b = 0; b < _count; b += C_HASH_MAP_BATCH)
+    {
+        const size_t count = (_count - b < C_HASH_MAP_BATCH) ? _count - b : C_HASH_MAP_BATCH;
+        const void *const *const keys = _keys + b;
+        void **const datas = _datas + b;
+
+        // Этап 1: хэши и предвыборка первых групп.
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (keys[i] == NULL) return -3;
+
+            hashes[i] = _hash_map->hash_key(keys[i]);
+            groups[i] = _hash_map->ctrl + ((size_t)c_hash_map_mix(hashes[i]) & groups_mask) * C_HASH_MAP_GROUP;
+            C_HASH_MAP_PREFETCH(groups[i]);
+        }
+
+        // Этап 2: предвыборка номеров пар первых слотов, фрагмент хэша которых совпал.
+        for (size_t i = 0; i < count; ++i)
+        {
+            const uint32_t match = c_hash_map_group_match(groups[i], c_hash_map_h2(c_hash_map_mix(hashes[i])));
+            if (match != 0)
+            {
+                slots[i] = (size_t)(groups[i] - _hash_map->ctrl) + c_hash_map_ctz32(match);
+                C_HASH_MAP_PREFETCH(&_hash_map->offsets[slots[i]]);
+            } else {
+                slots[i] = SIZE_MAX;
+            }
+        }
+
+        // Этап 3: предвыборка пар этих слотов.
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (slots[i] != SIZE_MAX)
+            {
+                C_HASH_MAP_PREFETCH(swiss_entry(_hash_map, _hash_map->offsets[slots[i]]));
+            }
+        }
+
+        // Этап 4: предвыборка хранимых ключей пар.
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (slots[i] != SIZE_MAX)
+            {
+                const c_hash_map_entry *const entry = swiss_entry(_hash_map, _hash_map->offsets[slots[i]]);
+                if (entry->hash == hashes[i])
+                {
+                    C_HASH_MAP_PREFETCH(entry->key);
+                }
             }
         }
 
-        prev_node = select_node;
-        select_node = select_node->next_node;
+        // Этап 5: полный поиск.
+        for (size_t i = 0; i < count; ++i)
+        {
+            const size_t s = dense_find(_hash_map, hashes[i], keys[i], NULL);
+            if (s != SIZE_MAX)
+            {
+                datas[i] = swiss_entry(_hash_map, _hash_map->offsets[s])->data;
+                ++found;
+            } else {
+                datas[i] = NULL;
+            }
+        }
     }
 
-    return 0;
+    return found;
 }
 
-// Задает хэш-отображению новое количество слотов.
-// Позволяет расширить хэш-отображение с нулем слотов.
-// Если в хэш-отображении есть хотя бы один элемент, то попытка задать нулевое количество слотов считается ошибкой.
-// Если хэш-отображение перестраивается, функция возвращает > 0.
-// Если хэш-отображение не перестраивается, функция возвращает 0.
-// В случае ошибки возвращает < 0.
-ptrdiff_t c_hash_map_resize(c_hash_map *const _hash_map,
-                            const size_t _slots_count)
+// Пакетное обращение к данным с заданными ключами.
+// Для каждого ключа _keys[i] в _datas[i] помещаются связанные с ним данные или NULL, если данных нет.
+// На больших хэш-отображениях значительно быстрее последовательных вызовов c_hash_map_at,
+// так как промахи кэша разных ключей обрабатываются одновременно.
+// В случае успеха возвращает количество найденных ключей (>= 0).
+// В случае ошибки возвращает < 0, содержимое _datas не определено.
+ptrdiff_t c_hash_map_at_batch(const c_hash_map *const _hash_map,
+                              const void *const *const _keys,
+                              const size_t _count,
+                              void **const _datas)
 {
     if (_hash_map == NULL) return -1;
+    if ( (_count > 0) && ( (_keys == NULL) || (_datas == NULL) ) ) return -2;
 
-    if (_hash_map->slots_count == _slots_count) return 0;
-
-    if (_slots_count == 0)
+    if (_hash_map->nodes_count == 0)
     {
-        if (_hash_map->slots_count != 0)
+        for (size_t i = 0; i < _count; ++i)
         {
-            return -2;
+            if (_keys[i] == NULL) return -3;
+            _datas[i] = NULL;
         }
+        return 0;
+    }
 
-        free(_hash_map->slots);
-        _hash_map->slots = NULL;
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_SWISS)
+    {
+        return swiss_at_batch(_hash_map, _keys, _count, _datas);
+    }
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_CUCKOO)
+    {
+        return cuckoo_at_batch(_hash_map, _keys, _count, _datas);
+    }
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_DENSE)
+    {
+        return dense_at_batch(_hash_map, _keys, _count, _datas);
+    }
 
-        _hash_map->slots_count = 0;
+    return chain_at_batch(_hash_map, _keys, _count, _datas);
+}
 
-        return 1;
-    } else {
-        // Определяем новый размер, необходимый под slots.
-        const size_t new_slots_size = _slots_count * sizeof(c_hash_map_node*);
-        if ( (new_slots_size == 0) ||
-             (new_slots_size / _slots_count != sizeof(c_hash_map_node*)) )
+// Пакетная проверка наличия данных с заданными ключами.
+// Для каждого ключа _keys[i] в _results[i] помещается 1, если данные с ним есть, иначе 0.
+// В случае успеха возвращает количество найденных ключей (>= 0).
+// В случае ошибки возвращает < 0, содержимое _results не определено.
+ptrdiff_t c_hash_map_check_batch(const c_hash_map *const _hash_map,
+                                 const void *const *const _keys,
+                                 const size_t _count,
+                                 size_t *const _results)
+{
+    if (_hash_map == NULL) return -1;
+    if ( (_count > 0) && ( (_keys == NULL) || (_results == NULL) ) ) return -2;
+
+    void *datas[C_HASH_MAP_BATCH];
+
+    ptrdiff_t found = 0;
+
+    for (size_t b = 0; b < _count; b += C_HASH_MAP_BATCH)
+    {
+        const size_t count = (_count - b < C_HASH_MAP_BATCH) ? _count - b : C_HASH_MAP_BATCH;
+
+        const ptrdiff_t r_code = c_hash_map_at_batch(_hash_map, _keys + b, count, datas);
+        if (r_code < 0)
         {
-            return -3;
+            return r_code;
         }
 
-        // Попытаемся выделить память под новые слоты.
-        c_hash_map_node **const new_slots = malloc(new_slots_size);
-        if (new_slots == NULL)
+        for (size_t i = 0; i < count; ++i)
         {
-            return -4;
+            _results[b + i] = (datas[i] != NULL) ? 1 : 0;
         }
 
-        // Обнулим новые слоты.
-        memset(new_slots, 0, new_slots_size);
+        found += r_code;
+    }
 
-        // Если есть узлы, которые необходимо перенести из старых слотов в новые.
-        if (_hash_map->nodes_count > 0)
+    return found;
+}
+
+// Проходит по всем элементам хэш-отображения и выполняет над ключами и данными заданные действия.
+// Ключи нельзя удалять или менять.
+// Данные нельзя удалять, но можно менять.
+// Должно быть задано действие хотя бы для ключа или хотя бы для данных.
+// В случае успешного выполнения возвращает > 0.
+// В случае, если в хэш-отображении нет элементов, возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_for_each(c_hash_map *const _hash_map,
+                              void (*const _action_key)(const void *const _key),
+                              void (*const _action_data)(void *const _data))
+{
+    if (_hash_map == NULL) return -1;
+    if ( (_action_key == NULL) &&
+         (_action_data == NULL) )
+    {
+        return -2;
+    }
+
+    if (_hash_map->nodes_count == 0) return 0;
+
+    if ( (_hash_map->engine == C_HASH_MAP_ENGINE_SWISS) || (_hash_map->engine == C_HASH_MAP_ENGINE_CUCKOO) )
+    {
+        swiss_for_each(_hash_map, _action_key, _action_data);
+        return 1;
+    }
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_DENSE)
+    {
+        // Пары обходятся подряд в порядке вставки.
+        for (size_t i = 0; i < _hash_map->dense_count; ++i)
         {
-            size_t count = _hash_map->nodes_count;
-            for (size_t s = 0; (s < _hash_map->slots_count)&&(count > 0); ++s)
+            const c_hash_map_entry *const entry = swiss_entry(_hash_map, i);
+            if (entry->key == NULL)
             {
-                if (_hash_map->slots[s] != NULL)
-                {
-                    c_hash_map_node *select_node = _hash_map->slots[s],
-                                    *relocate_node;
+                continue;
+            }
+            if (_action_key != NULL)
+            {
+                _action_key(entry->key);
+            }
+            if (_action_data != NULL)
+            {
+                _action_data(entry->data);
+            }
+        }
+        return 1;
+    }
 
-                    while (select_node != NULL)
-                    {
-                        relocate_node = select_node;
-                        select_node = select_node->next_node;
+    // Незавершенное постепенное перестроение заканчиваем сразу.
+    chain_rehash_advance(_hash_map, SIZE_MAX);
 
-                        // Хэш ключа переносимого узла, приведенный к новому количеству слотов.
-                        const size_t presented_hash = relocate_node->hash % _slots_count;
+    size_t count = _hash_map->nodes_count;
 
-                        relocate_node->next_node = new_slots[presented_hash];
-                        new_slots[presented_hash] = relocate_node;
+    // Макросы дублирования кода для избавления от проверок внутри циклов.
 
-                        --count;
-                    }
-                }
-            }
+    // Открытие циклов.
+    #define C_HASH_MAP_FOR_EACH_BEGIN\
+    for (size_t s = 0; (s < _hash_map->slots_count)&&(count > 0); ++s) \
+    {\
+        if (chain_head(_hash_map, s) != NULL)\
+        {\
+            c_hash_map_node *select_node = _hash_map->slots[s];\
+            while (select_node != NULL)\
+            {
+
+    // Закрытие циклов.
+    #define C_HASH_MAP_FOR_EACH_END\
+                select_node = select_node->next_node;\
+                --count;\
+            }\
+        }\
+    }
+
+    // Заданы действия и для ключей, и для данных.
+    if ( (_action_key != NULL) && (_action_data != NULL) )
+    {
+        C_HASH_MAP_FOR_EACH_BEGIN
+
+        _action_key( select_node->key );
+        _action_data( select_node->data );
+
+        C_HASH_MAP_FOR_EACH_END
+    } else {
+        // Задано действие только для ключей.
+        if (_action_key != NULL)
+        {
+            C_HASH_MAP_FOR_EACH_BEGIN
+
+            _action_key( select_node->key );
+
+            C_HASH_MAP_FOR_EACH_END
+        } else {
+            // Задано действие только для данных.
 
+            C_HASH_MAP_FOR_EACH_BEGIN
+
+            _action_data( select_node->data );
+
+            C_HASH_MAP_FOR_EACH_END
         }
+    }
 
-        free(_hash_map->slots);
+    #undef C_HASH_MAP_FOR_EACH_BEGIN
+    #undef C_HASH_MAP_FOR_EACH_END
 
-        // Используем новые слоты.
-        _hash_map->slots = new_slots;
-        _hash_map->slots_count = _slots_count;
+    return 1;
+}
 
-        return 2;
+// Проходит по элементам хэш-отображения и вызывает для каждого действие с заданным контекстом.
+// Ключи нельзя удалять или менять.
+// Данные нельзя удалять, но можно менять.
+// Если действие возвращает > 0, обход прекращается.
+// Если обход пройден полностью, возвращает 1.
+// Если обход прекращен действием, возвращает 2.
+// В случае, если в хэш-отображении нет элементов, возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_for_each_ex(c_hash_map *const _hash_map,
+                                 size_t (*const _action)(const void *const _key,
+                                                         void *const _data,
+                                                         void *const _context),
+                                 void *const _context)
+{
+    if (_hash_map == NULL) return -1;
+    if (_action == NULL) return -2;
+
+    if (_hash_map->nodes_count == 0) return 0;
+
+    size_t count = _hash_map->nodes_count;
+
+    if ( (_hash_map->engine == C_HASH_MAP_ENGINE_SWISS) || (_hash_map->engine == C_HASH_MAP_ENGINE_CUCKOO) )
+    {
+        for (size_t s = 0; (s < _hash_map->slots_count)&&(count > 0); ++s)
+        {
+            if ( (_hash_map->ctrl[s] & 0x80) == 0 )
+            {
+                const c_hash_map_entry *const entry = swiss_entry(_hash_map, s);
+                if (_action(entry->key, entry->data, _context) > 0)
+                {
+                    return 2;
+                }
+                --count;
+            }
+        }
+        return 1;
     }
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_DENSE)
+    {
+        for (size_t i = 0; i < _hash_map->dense_count; ++i)
+        {
+            const c_hash_map_entry *const entry = swiss_entry(_hash_map, i);
+            if ( (entry->key != NULL) && (_action(entry->key, entry->data, _context) > 0) )
+            {
+                return 2;
+            }
+        }
+        return 1;
+    }
+
+    // Незавершенное постепенное перестроение заканчиваем сразу.
+    chain_rehash_advance(_hash_map, SIZE_MAX);
+
+    for (size_t s = 0; (s < _hash_map->slots_count)&&(count > 0); ++s)
+    {
+        for (const c_hash_map_node *node = chain_head(_hash_map, s); node != NULL; node = node->next_node)
+        {
+            if (_action(node->key, node->data, _context) > 0)
+            {
+                return 2;
+            }
+            --count;
+        }
+    }
+
+    return 1;
 }
 
-// Проверка на наличие в хэш-отображении данных с заданным ключом.
-// В случае наличия данных с заданным ключом возвращает > 0.
-// В случае отсутствия данных с заданным ключом возвращает 0.
+// Проходит по элементам хэш-отображения в нескольких потоках и вызывает для каждого действие
+// с заданным контекстом. Слоты (для движка DENSE - пары) делятся между потоками на непрерывные
+// диапазоны, количество потоков ограничено 64 и размером хэш-отображения (0 и 1 - обход в
+// вызывающем потоке). Порядок вызовов не определен, действие вызывается одновременно из разных
+// потоков. До окончания обхода хэш-отображение нельзя изменять.
+// Ключи нельзя удалять или менять.
+// Данные нельзя удалять, но можно менять.
+// В случае успешного выполнения возвращает > 0.
+// В случае, если в хэш-отображении нет элементов, возвращает 0.
 // В случае ошибки возвращает < 0.
-ptrdiff_t c_hash_map_check(const c_hash_map *const _hash_map,
-                           const void *const _key)
+ptrdiff_t c_hash_map_for_each_parallel(c_hash_map *const _hash_map,
+                                       const size_t _threads_count,
+                                       void (*const _action)(const void *const _key,
+                                                             void *const _data,
+                                                             void *const _context),
+                                       void *const _context)
 {
     if (_hash_map == NULL) return -1;
-    if (_key == NULL) return -2;
+    if (_action == NULL) return -2;
 
     if (_hash_map->nodes_count == 0) return 0;
 
-    // Неприведенный хэш искомого ключа.
-    const size_t hash = _hash_map->hash_key(_key);
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_CHAIN)
+    {
+        // Незавершенное постепенное перестроение заканчиваем сразу.
+        chain_rehash_advance(_hash_map, SIZE_MAX);
+    }
 
-    // Приведенный хэш искомого ключа.
-    const size_t presented_hash = hash % _hash_map->slots_count;
+    const size_t count = (_hash_map->engine == C_HASH_MAP_ENGINE_DENSE) ? _hash_map->dense_count : _hash_map->slots_count;
+    const size_t threads_count = parallel_threads(_threads_count, count);
 
-    c_hash_map_node *select_node = _hash_map->slots[presented_hash];
+    c_hash_map_range_task tasks[C_HASH_MAP_THREADS_MAX];
+    parallel_split(_hash_map, tasks, threads_count, count);
+    for (size_t t = 0; t < threads_count; ++t)
+    {
+        tasks[t].action = _action;
+        tasks[t].context = _context;
+    }
 
-    while (select_node != NULL)
+    map_parallel(_hash_map, range_for_each, tasks, sizeof(c_hash_map_range_task), threads_count);
+
+    return 1;
+}
+
+// Устанавливает итератор на первую пару, начиная со слота _slot.
+static ptrdiff_t iter_seek(c_hash_map_iter *const _iter,
+                           const size_t _slot)
+{
+    c_hash_map *const hash_map = _iter->hash_map;
+
+    if (hash_map->engine == C_HASH_MAP_ENGINE_DENSE)
     {
-        if (hash == select_node->hash)
+        // Номер слота итератора движка DENSE - номер пары.
+        for (size_t i = _slot; i < hash_map->dense_count; ++i)
         {
-            if (_hash_map->comp_key(_key, select_node->key) > 0)
+            if (swiss_entry(hash_map, i)->key != NULL)
             {
+                _iter->slot = i;
+                _iter->pair = swiss_entry(hash_map, i);
                 return 1;
             }
         }
 
-        select_node = select_node->next_node;
+        _iter->slot = hash_map->dense_count;
+        _iter->pair = NULL;
+        _iter->link = NULL;
+
+        return 0;
+    }
+
+    for (size_t s = _slot; s < hash_map->slots_count; ++s)
+    {
+        if (hash_map->engine != C_HASH_MAP_ENGINE_CHAIN)
+        {
+            if ( (hash_map->ctrl[s] & 0x80) == 0 )
+            {
+                _iter->slot = s;
+                _iter->pair = swiss_entry(hash_map, s);
+                return 1;
+            }
+        } else {
+            if (chain_head(hash_map, s) != NULL)
+            {
+                _iter->slot = s;
+                _iter->pair = hash_map->slots[s];
+                _iter->link = &hash_map->slots[s];
+                return 1;
+            }
+        }
     }
 
+    _iter->slot = hash_map->slots_count;
+    _iter->pair = NULL;
+    _iter->link = NULL;
+
     return 0;
 }
 
-// Обращение к данным с заданным ключом.
-// В случае успеха возвращает указатель на данные, которые связаны с заданным ключом.
-// Если данных нет, функция возвращает NULL, это не считается ошибкой.
-// В случае ошибки функция возвращает NULL, и если _error != NULL, то в заданное расположение помещается
-// код причины ошибки (> 0).
-// Так как функция может возвращать NULL и в случае успеха, и в случае ошибки, для детектирования ошибки
-// перед вызовом функции необходимо поместить 0 в заданное расположение ошибки.
-void *c_hash_map_at(const c_hash_map *const _hash_map,
-                    const void *const _key,
-                    size_t *const _error)
+// Устанавливает итератор на первую пару хэш-отображения.
+// Во время обхода хэш-отображение можно менять только через c_hash_map_iter_erase_current.
+// Если итератор установлен на пару, возвращает > 0.
+// Если в хэш-отображении нет элементов, возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_iter_begin(c_hash_map *const _hash_map,
+                                c_hash_map_iter *const _iter)
 {
-    if (_hash_map == NULL)
-    {
-        error_set(_error, 1);
-        return NULL;
-    }
-    if (_key == NULL)
+    if (_hash_map == NULL) return -1;
+    if (_iter == NULL) return -2;
+
+    _iter->hash_map = _hash_map;
+
+    // Незавершенное постепенное перестроение заканчиваем сразу.
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_CHAIN)
     {
-        error_set(_error, 2);
-        return NULL;
+        chain_rehash_advance(_hash_map, SIZE_MAX);
     }
 
-    if (_hash_map->nodes_count == 0) return NULL;
-
-    // Неприведенный хэш искомого ключа.
-    const size_t hash = _hash_map->hash_key(_key);
+    return iter_seek(_iter, 0);
+}
 
-    // Приведенный хэш искомого ключа.
-    const size_t presented_hash = hash % _hash_map->slots_count;
+// Перемещает итератор на следующую пару.
+// После c_hash_map_iter_erase_current перемещает на пару, следовавшую за удаленной.
+// Если итератор установлен на пару, возвращает > 0.
+// Если пары закончились, возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_iter_next(c_hash_map_iter *const _iter)
+{
+    if (_iter == NULL) return -1;
+    if (_iter->hash_map == NULL) return -2;
 
-    c_hash_map_node *select_node = _hash_map->slots[presented_hash];
+    const size_t slots_count = (_iter->hash_map->engine == C_HASH_MAP_ENGINE_DENSE) ? _iter->hash_map->dense_count :
+                                                                                       _iter->hash_map->slots_count;
+    if (_iter->slot >= slots_count) return 0;
 
-    while (select_node != NULL)
+    if (_iter->hash_map->engine == C_HASH_MAP_ENGINE_CHAIN)
     {
-        if (hash == select_node->hash)
+        // Если текущая пара удалена, ссылка на нее уже указывает на следующую.
+        if (_iter->pair != NULL)
         {
-            if (_hash_map->comp_key(_key, select_node->key) > 0)
-            {
-                return select_node->data;
-            }
+            _iter->link = &((c_hash_map_node*)_iter->pair)->next_node;
         }
 
-        select_node = select_node->next_node;
+        c_hash_map_node *const next_node = *(c_hash_map_node**)_iter->link;
+        if (next_node != NULL)
+        {
+            _iter->pair = next_node;
+            return 1;
+        }
     }
 
-    return NULL;
+    return iter_seek(_iter, _iter->slot + 1);
 }
 
-// Проходит по всем элементам хэш-отображения и выполняет над ключами и данными заданные действия.
-// Ключи нельзя удалять или менять.
-// Данные нельзя удалять, но можно менять.
-// Должно быть задано действие хотя бы для ключа или хотя бы для данных.
-// В случае успешного выполнения возвращает > 0.
-// В случае, если в хэш-отображении нет элементов, возвращает 0.
-// В случае ошибки возвращает < 0.
-ptrdiff_t c_hash_map_for_each(c_hash_map *const _hash_map,
-                              void (*const _action_key)(const void *const _key),
-                              void (*const _action_data)(void *const _data))
+// Возвращает ключ пары, на которую установлен итератор.
+// Если итератор не установлен на пару, возвращает NULL.
+const void *c_hash_map_iter_key(const c_hash_map_iter *const _iter)
 {
-    if (_hash_map == NULL) return -1;
-    if ( (_action_key == NULL) &&
-         (_action_data == NULL) )
+    if ( (_iter == NULL) || (_iter->pair == NULL) ) return NULL;
+
+    if (_iter->hash_map->engine != C_HASH_MAP_ENGINE_CHAIN)
     {
-        return -2;
+        return ((const c_hash_map_entry*)_iter->pair)->key;
     }
+    return ((const c_hash_map_node*)_iter->pair)->key;
+}
 
-    if (_hash_map->nodes_count == 0) return 0;
-
-    size_t count = _hash_map->nodes_count;
+// Возвращает данные пары, на которую установлен итератор.
+// Если итератор не установлен на пару, возвращает NULL.
+void *c_hash_map_iter_data(const c_hash_map_iter *const _iter)
+{
+    if ( (_iter == NULL) || (_iter->pair == NULL) ) return NULL;
 
-    // Макросы дублирования кода для избавления от проверок внутри циклов.
+    if (_iter->hash_map->engine != C_HASH_MAP_ENGINE_CHAIN)
+    {
+        return ((const c_hash_map_entry*)_iter->pair)->data;
+    }
+    return ((const c_hash_map_node*)_iter->pair)->data;
+}
 
-    // Открытие циклов.
-    #define C_HASH_MAP_FOR_EACH_BEGIN\
-    for (size_t s = 0; (s < _hash_map->slots_count)&&(count > 0); ++s) \
-    {\
-        if (_hash_map->slots[s] != NULL)\
-        {\
-            c_hash_map_node *select_node = _hash_map->slots[s];\
-            while (select_node != NULL)\
-            {
+// Возвращает хэш ключа пары, на которую установлен итератор (сохраненный при вставке,
+// hash_key не вызывается).
+// Если итератор не установлен на пару, возвращает 0.
+size_t c_hash_map_iter_hash(const c_hash_map_iter *const _iter)
+{
+    if ( (_iter == NULL) || (_iter->pair == NULL) ) return 0;
 
-    // Закрытие циклов.
-    #define C_HASH_MAP_FOR_EACH_END\
-                select_node = select_node->next_node;\
-                --count;\
-            }\
-        }\
+    if (_iter->hash_map->engine != C_HASH_MAP_ENGINE_CHAIN)
+    {
+        return ((const c_hash_map_entry*)_iter->pair)->hash;
     }
+    return ((const c_hash_map_node*)_iter->pair)->hash;
+}
 
-    // Заданы действия и для ключей, и для данных.
-    if ( (_action_key != NULL) && (_action_data != NULL) )
-    {
-        C_HASH_MAP_FOR_EACH_BEGIN
+// Удаляет пару, на которую установлен итератор, без повторного поиска.
+// Обход продолжается вызовом c_hash_map_iter_next.
+// В случае успешного удаления возвращает > 0.
+// Если итератор не установлен на пару, возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_iter_erase_current(c_hash_map_iter *const _iter,
+                                        void (*const _del_key)(void *const _key),
+                                        void (*const _del_data)(void *const _data))
+{
+    if (_iter == NULL) return -1;
+    if (_iter->hash_map == NULL) return -2;
 
-        _action_key( select_node->key );
-        _action_data( select_node->data );
+    if (_iter->pair == NULL) return 0;
 
-        C_HASH_MAP_FOR_EACH_END
-    } else {
-        // Задано действие только для ключей.
-        if (_action_key != NULL)
-        {
-            C_HASH_MAP_FOR_EACH_BEGIN
+    c_hash_map *const hash_map = _iter->hash_map;
 
-            _action_key( select_node->key );
+    if (hash_map->engine == C_HASH_MAP_ENGINE_DENSE)
+    {
+        dense_remove(hash_map, dense_slot_of(hash_map, _iter->slot), _iter->slot, _del_key, _del_data);
+    } else if (hash_map->engine != C_HASH_MAP_ENGINE_CHAIN) {
+        c_hash_map_entry *const entry = _iter->pair;
 
-            C_HASH_MAP_FOR_EACH_END
+        if (_del_key != NULL)
+        {
+            _del_key(entry->key);
+        }
+        if (_del_data != NULL)
+        {
+            _del_data(entry->data);
+        }
+
+        if (hash_map->engine == C_HASH_MAP_ENGINE_CUCKOO)
+        {
+            cuckoo_release(hash_map, _iter->slot);
         } else {
-            // Задано действие только для данных.
+            swiss_release(hash_map, _iter->slot);
+        }
+    } else {
+        c_hash_map_node *const delete_node = _iter->pair;
 
-            C_HASH_MAP_FOR_EACH_BEGIN
+        // Ампутация узла из слота.
+        *(c_hash_map_node**)_iter->link = delete_node->next_node;
 
-            _action_data( select_node->data );
+        node_detach(hash_map, delete_node);
 
-            C_HASH_MAP_FOR_EACH_END
+        if (_del_key != NULL)
+        {
+            _del_key(delete_node->key);
+        }
+        if (_del_data != NULL)
+        {
+            _del_data(delete_node->data);
         }
+
+        node_free(hash_map, delete_node);
+
+        --hash_map->nodes_count;
     }
 
-    #undef C_HASH_MAP_FOR_EACH_BEGIN
-    #undef C_HASH_MAP_FOR_EACH_END
+    _iter->pair = NULL;
 
     return 1;
 }
 
 // Очищает хэш-отображение ото всех элементов, сохраняя количество слотов.
+// В режиме сброса поколением (generation_reset) без функций удаления выполняется за постоянное время.
 // В случае успешной очистки возвращает > 0.
 // Если в хэш-отображении не было элементов, возвращает 0.
 // В случае ошибки возвращает < 0.
@@ -576,8 +5710,72 @@ ptrdiff_t c_hash_map_clear(c_hash_map *const _hash_map,
 
     if (_hash_map->nodes_count == 0) return 0;
 
+    if (_hash_map->cache != NULL)
+    {
+        _hash_map->cache->used = 0;
+    }
+    if (_hash_map->wheel != NULL)
+    {
+        wheel_reset(_hash_map->wheel);
+    }
+
+    if ( (_hash_map->engine == C_HASH_MAP_ENGINE_SWISS) || (_hash_map->engine == C_HASH_MAP_ENGINE_CUCKOO) )
+    {
+        swiss_clear(_hash_map, _del_key_func, _del_data_func);
+        _hash_map->nodes_count = 0;
+        return 1;
+    }
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_DENSE)
+    {
+        dense_clear(_hash_map, _del_key_func, _del_data_func);
+        _hash_map->nodes_count = 0;
+        return 1;
+    }
+
     size_t count = _hash_map->nodes_count;
 
+    // Сброс поколением: слоты прошлого поколения считаются пустыми (очищаются при следующей
+    // вставке в них), узлы возвращаются в распределитель разом.
+    if (_hash_map->generation != 0)
+    {
+        // Функции удаления вызываются для всех пар, иначе слоты и узлы не просматриваются.
+        if ( (_del_key_func != NULL) || (_del_data_func != NULL) )
+        {
+            for (size_t s = 0; (s < _hash_map->slots_count)&&(count > 0); ++s)
+            {
+                for (c_hash_map_node *node = chain_head(_hash_map, s); node != NULL; node = node->next_node)
+                {
+                    if (_del_key_func != NULL)
+                    {
+                        _del_key_func(node->key);
+                    }
+                    if (_del_data_func != NULL)
+                    {
+                        _del_data_func(node->data);
+                    }
+                    --count;
+                }
+            }
+        }
+
+        ++_hash_map->generation;
+        if (_hash_map->generation == 0)
+        {
+            // Поколения закончились: все слоты переводятся в нулевое поколение.
+            memset(_hash_map->slot_gens, 0, _hash_map->slots_count * sizeof(uint32_t));
+            _hash_map->generation = 1;
+        }
+
+        slab_reset(_hash_map);
+
+        _hash_map->nodes_count = 0;
+
+        return 1;
+    }
+
+    // Незавершенное постепенное перестроение заканчиваем сразу.
+    chain_rehash_advance(_hash_map, SIZE_MAX);
+
     // Макросы дублирования кода для избавленияот проверок внутри циклов.
 
     // Открытие циклов.
@@ -595,7 +5793,7 @@ ptrdiff_t c_hash_map_clear(c_hash_map *const _hash_map,
 
     // Закрытие циклов.
     #define C_HASH_MAP_CLEAR_END \
-                free(delete_node);\
+                node_free(_hash_map, delete_node);\
                 --count;\
             }\
             _hash_map->slots[s] = NULL;\
@@ -629,6 +5827,16 @@ ptrdiff_t c_hash_map_clear(c_hash_map *const _hash_map,
                 _del_data_func( delete_node->data );
 
                 C_HASH_MAP_CLEAR_END
+            } else {
+                // Функции удаления не заданы.
+                if (_hash_map->slab.chunk_nodes > 1)
+                {
+                    // Узлы вернутся в распределитель разом, достаточно обнулить слоты.
+                    memset(_hash_map->slots, 0, _hash_map->slots_count * sizeof(c_hash_map_node*));
+                } else {
+                    C_HASH_MAP_CLEAR_BEGIN
+                    C_HASH_MAP_CLEAR_END
+                }
             }
         }
     }
@@ -636,6 +5844,84 @@ ptrdiff_t c_hash_map_clear(c_hash_map *const _hash_map,
     #undef C_HASH_MAP_CLEAR_BEGIN
     #undef C_HASH_MAP_CLEAR_END
 
+    // Все узлы свободны, возвращаем их в распределитель разом.
+    slab_reset(_hash_map);
+
+    _hash_map->nodes_count = 0;
+
+    return 1;
+}
+
+// Очищает хэш-отображение ото всех элементов в нескольких потоках, сохраняя количество слотов.
+// Функции удаления вызываются одновременно из разных потоков для пар непересекающихся диапазонов
+// слотов (для движка DENSE - пар), количество потоков ограничено 64 и размером хэш-отображения
+// (0 и 1 - очистка в вызывающем потоке). Слоты движков CHAIN и SWISS обнуляются теми же потоками.
+// Если каждый узел движка CHAIN выделяется отдельно (slab_nodes = 1), узлы освобождаются в
+// вызывающем потоке.
+// В случае успешной очистки возвращает > 0.
+// Если в хэш-отображении не было элементов, возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_clear_parallel(c_hash_map *const _hash_map,
+                                    const size_t _threads_count,
+                                    void (*const _del_key)(void *const _key),
+                                    void (*const _del_data)(void *const _data))
+{
+    if (_hash_map == NULL) return -1;
+
+    if (_hash_map->nodes_count == 0) return 0;
+
+    if (_hash_map->cache != NULL)
+    {
+        _hash_map->cache->used = 0;
+    }
+    if (_hash_map->wheel != NULL)
+    {
+        wheel_reset(_hash_map->wheel);
+    }
+
+    // Слоты обнуляются потоками, если после этого достаточно вернуть узлы в распределитель разом.
+    size_t zero = 0;
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_CHAIN)
+    {
+        // Незавершенное постепенное перестроение заканчиваем сразу.
+        chain_rehash_advance(_hash_map, SIZE_MAX);
+
+        zero = ( (_hash_map->generation == 0) && (_hash_map->slab.chunk_nodes > 1) ) ? 1 : 0;
+    }
+    if ( (_hash_map->engine == C_HASH_MAP_ENGINE_SWISS) || (_hash_map->engine == C_HASH_MAP_ENGINE_CUCKOO) )
+    {
+        zero = 1;
+    }
+
+    const size_t count = (_hash_map->engine == C_HASH_MAP_ENGINE_DENSE) ? _hash_map->dense_count : _hash_map->slots_count;
+    const size_t threads_count = parallel_threads(_threads_count, count);
+
+    c_hash_map_range_task tasks[C_HASH_MAP_THREADS_MAX];
+    parallel_split(_hash_map, tasks, threads_count, count);
+    for (size_t t = 0; t < threads_count; ++t)
+    {
+        tasks[t].del_key = _del_key;
+        tasks[t].del_data = _del_data;
+        tasks[t].zero = zero;
+    }
+
+    map_parallel(_hash_map, range_clear, tasks, sizeof(c_hash_map_range_task), threads_count);
+
+    if (zero == 0)
+    {
+        // Пары уже удалены функциями удаления, остается очистка без них
+        // (сброс поколением, освобождение отдельных узлов, индекс движка DENSE).
+        return c_hash_map_clear(_hash_map, NULL, NULL);
+    }
+
+    if (_hash_map->engine == C_HASH_MAP_ENGINE_CHAIN)
+    {
+        // Все узлы свободны, возвращаем их в распределитель разом.
+        slab_reset(_hash_map);
+    } else {
+        _hash_map->deleted_count = 0;
+    }
+
     _hash_map->nodes_count = 0;
 
     return 1;
@@ -686,3 +5972,199 @@ float c_hash_map_max_load_factor(const c_hash_map *const _hash_map)
 
     return _hash_map->max_load_factor;
 }
+
+// Учитывает в статистике цепочки слотов движка CHAIN: текущих (_old == 0) или еще не
+// перенесенных старых (_old != 0).
+// Возвращает количество непустых слотов.
+static size_t stats_chain(const c_hash_map *const _hash_map,
+                          const size_t _old,
+                          c_hash_map_statistics *const _stats)
+{
+    const size_t first = (_old != 0) ? _hash_map->rehash_pos : 0;
+    const size_t slots_count = (_old != 0) ? _hash_map->old_slots_count : _hash_map->slots_count;
+
+    size_t used = 0;
+    for (size_t s = first; s < slots_count; ++s)
+    {
+        size_t chain = 0;
+        const c_hash_map_node *const head = (_old != 0) ? _hash_map->old_slots[s] : chain_head(_hash_map, s);
+        for (const c_hash_map_node *node = head; node != NULL; node = node->next_node)
+        {
+            ++chain;
+        }
+
+        if (chain == 0)
+        {
+            ++_stats->empty_slots;
+        } else {
+            ++used;
+        }
+        if (chain > _stats->max_chain)
+        {
+            _stats->max_chain = chain;
+        }
+        ++_stats->histogram[(chain < C_HASH_MAP_STATS_HISTOGRAM) ? chain : C_HASH_MAP_STATS_HISTOGRAM - 1];
+    }
+    return used;
+}
+
+// Собирает статистику хэш-отображения.
+// Структурная часть вычисляется обходом всех слотов (и узлов движка CHAIN).
+// В случае успеха возвращает > 0, статистика помещается в _stats.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_stats(const c_hash_map *const _hash_map,
+                           c_hash_map_statistics *const _stats)
+{
+    if (_hash_map == NULL) return -1;
+    if (_stats == NULL) return -2;
+
+    memset(_stats, 0, sizeof(c_hash_map_statistics));
+
+    _stats->slots_count = _hash_map->slots_count;
+    _stats->pairs_count = _hash_map->nodes_count;
+
+    if (_hash_map->engine != C_HASH_MAP_ENGINE_CHAIN)
+    {
+        const size_t dense = (_hash_map->engine == C_HASH_MAP_ENGINE_DENSE) ? 1 : 0;
+
+        _stats->deleted_slots = _hash_map->deleted_count;
+        if (dense)
+        {
+            _stats->slots_bytes = _hash_map->slots_count * (1 + sizeof(uint32_t));
+            _stats->nodes_bytes = _hash_map->dense_capacity * _hash_map->entry_size;
+        } else {
+            _stats->slots_bytes = _hash_map->slots_count * (1 + _hash_map->entry_size);
+        }
+
+        const size_t groups_mask = (_hash_map->slots_count > 0) ? _hash_map->slots_count / C_HASH_MAP_GROUP - 1 : 0;
+        size_t probes = 0;
+        for (size_t s = 0; s < _hash_map->slots_count; ++s)
+        {
+            if (_hash_map->ctrl[s] == C_HASH_MAP_CTRL_EMPTY)
+            {
+                ++_stats->empty_slots;
+            }
+            if ( (_hash_map->ctrl[s] & 0x80) != 0 )
+            {
+                continue;
+            }
+
+            const size_t pair = dense ? _hash_map->offsets[s] : s;
+            size_t chain = 1;
+            if (_hash_map->engine == C_HASH_MAP_ENGINE_CUCKOO)
+            {
+                // Пара находится в первой или во второй своей корзине.
+                size_t first,
+                       second;
+                cuckoo_buckets(_hash_map->slots_count, c_hash_map_mix(swiss_entry(_hash_map, pair)->hash), &first, &second);
+                chain = (s / C_HASH_MAP_BUCKET == first) ? 1 : 2;
+            } else {
+                // Проходим последовательность пробирования от исходной группы до группы пары.
+                const size_t group = s / C_HASH_MAP_GROUP;
+                size_t g = (size_t)c_hash_map_mix(swiss_entry(_hash_map, pair)->hash) & groups_mask;
+                while (g != group)
+                {
+                    g = (g + chain) & groups_mask;
+                    ++chain;
+                }
+            }
+
+            probes += chain;
+            if (chain > _stats->max_chain)
+            {
+                _stats->max_chain = chain;
+            }
+            ++_stats->histogram[(chain < C_HASH_MAP_STATS_HISTOGRAM) ? chain : C_HASH_MAP_STATS_HISTOGRAM - 1];
+        }
+
+        if (_hash_map->nodes_count > 0)
+        {
+            _stats->mean_chain = (double)probes / _hash_map->nodes_count;
+        }
+    } else {
+        size_t used = stats_chain(_hash_map, 0, _stats);
+        if (_hash_map->old_slots != NULL)
+        {
+            used += stats_chain(_hash_map, 1, _stats);
+        }
+        if (used > 0)
+        {
+            _stats->mean_chain = (double)_hash_map->nodes_count / used;
+        }
+
+        _stats->slots_bytes = chain_slots_size(_hash_map, _hash_map->slots_count) +
+                              _hash_map->old_slots_count * sizeof(c_hash_map_node*);
+
+        if (_hash_map->slab.chunk_nodes == 1)
+        {
+            _stats->nodes_bytes = _hash_map->nodes_count * _hash_map->node_size;
+        } else {
+            for (const c_hash_map_chunk *chunk = _hash_map->slab.first_chunk; chunk != NULL; chunk = chunk->next_chunk)
+            {
+                _stats->nodes_bytes += C_HASH_MAP_CHUNK_HEADER + chunk->capacity * _hash_map->node_size;
+            }
+        }
+    }
+
+    _stats->resizes_count = _hash_map->resizes_count;
+    _stats->resize_seconds = (double)_hash_map->resize_time / 1e9;
+
+#if defined(C_HASH_MAP_STATS_PROBES)
+    const c_hash_map_probes *const probes = _hash_map->probes;
+    _stats->hits_count = probes->hits_count;
+    _stats->misses_count = probes->misses_count;
+    if (probes->hits_count > 0)
+    {
+        _stats->hit_probes = (double)probes->hit_probes / probes->hits_count;
+    }
+    if (probes->misses_count > 0)
+    {
+        _stats->miss_probes = (double)probes->miss_probes / probes->misses_count;
+    }
+#endif
+
+    return 1;
+}
+
+// Собирает статистику режима кэша (без обхода слотов).
+// В случае успеха возвращает > 0, статистика помещается в _stats.
+// В случае ошибки возвращает < 0 (-3 - режим кэша выключен).
+ptrdiff_t c_hash_map_cache_stats(const c_hash_map *const _hash_map,
+                                 c_hash_map_cache_statistics *const _stats)
+{
+    if (_hash_map == NULL) return -1;
+    if (_stats == NULL) return -2;
+    if (_hash_map->cache == NULL) return -3;
+
+    const c_hash_map_cache *const cache = _hash_map->cache;
+
+    _stats->capacity = cache->capacity;
+    _stats->bytes = cache->bytes;
+    _stats->pairs_count = _hash_map->nodes_count;
+    _stats->used_bytes = cache->used;
+#if defined(__GNUC__)
+    _stats->hits_count = __atomic_load_n(&cache->hits_count, __ATOMIC_RELAXED);
+    _stats->misses_count = __atomic_load_n(&cache->misses_count, __ATOMIC_RELAXED);
+#else
+    _stats->hits_count = cache->hits_count;
+    _stats->misses_count = cache->misses_count;
+#endif
+    _stats->evictions_count = cache->evictions_count;
+
+    return 1;
+}
+
+// Обнуляет счетчики поисков и вытеснений режима кэша (например, в начале окна измерения).
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0 (-2 - режим кэша выключен).
+ptrdiff_t c_hash_map_cache_reset_stats(c_hash_map *const _hash_map)
+{
+    if (_hash_map == NULL) return -1;
+    if (_hash_map->cache == NULL) return -2;
+
+    _hash_map->cache->hits_count = 0;
+    _hash_map->cache->misses_count = 0;
+    _hash_map->cache->evictions_count = 0;
+
+    return 1;
+}
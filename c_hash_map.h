@@ -16,9 +16,246 @@
 #define C_HASH_MAP_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 typedef struct s_c_hash_map c_hash_map;
 
+// Движок хранения на основе цепочек узлов (используется c_hash_map_create).
+#define C_HASH_MAP_ENGINE_CHAIN ( (size_t) 0 )
+
+// Движок хранения на основе открытой адресации с управляющими байтами ("swiss table").
+// Количество слотов всегда является степенью двойки, max_load_factor не может превышать 0.875f.
+#define C_HASH_MAP_ENGINE_SWISS ( (size_t) 1 )
+
+// Движок хранения с парами в едином массиве в порядке вставки и отдельным индексом
+// (управляющие байты и 32-битные номера пар, как у движка SWISS).
+// Обход, очистка и c_hash_map_for_each проходят массив пар подряд и возвращают пары в порядке вставки.
+// Удаленные пары остаются в массиве до его уплотнения при перестроении.
+// Количество пар не может превышать 2^32 - 1, max_load_factor не может превышать 0.875f.
+#define C_HASH_MAP_ENGINE_DENSE ( (size_t) 2 )
+
+// Движок хранения на основе кукушкиного хэширования с корзинами: у каждой пары две корзины
+// по 8 слотов, управляющие байты слотов содержат фрагмент хэша (как у движка SWISS).
+// Поиск просматривает не больше двух корзин (две строки кэша управляющих байтов) независимо
+// от распределения хэшей, вставка при заполненных корзинах освобождает слот переносом пар
+// в их альтернативные корзины (путь ищется поиском в ширину). Пары с одинаковым хэшем занимают
+// одни и те же две корзины, поэтому при вырожденном хэше вставка может завершиться ошибкой.
+// Количество слотов всегда является степенью двойки, max_load_factor не может превышать 0.97f.
+#define C_HASH_MAP_ENGINE_CUCKOO ( (size_t) 3 )
+
+// Способы приведения хэша к номеру слота движка CHAIN.
+// Остаток от деления на произвольное количество слотов (используется c_hash_map_create).
+#define C_HASH_MAP_INDEX_MOD ( (size_t) 0 )
+// Количество слотов - степень двойки, номер слота - старшие биты фибоначчиева произведения хэша.
+#define C_HASH_MAP_INDEX_POW2 ( (size_t) 1 )
+// Произвольное количество слотов, номер слота - старшая половина произведения перемешанного
+// хэша на количество слотов (метод Лемира).
+#define C_HASH_MAP_INDEX_FASTRANGE ( (size_t) 2 )
+// Количество слотов - простое число (не больше 2^32), остаток вычисляется умножением на
+// заранее вычисленную обратную величину.
+#define C_HASH_MAP_INDEX_PRIME ( (size_t) 3 )
+
+// Флаги c_hash_map_build.
+// Ключи заведомо уникальны (между собой и с уже имеющимися в хэш-отображении), проверка не выполняется.
+#define C_HASH_MAP_BUILD_UNIQUE ( (size_t) 1 )
+// Количество потоков, по которым распределяется построение движка CHAIN (не больше 64).
+#define C_HASH_MAP_BUILD_THREADS(_threads_count) ( (size_t)(_threads_count) << 8 )
+
+// Количество элементов гистограммы c_hash_map_statistics (последний - длины этой и больше).
+#define C_HASH_MAP_STATS_HISTOGRAM ( (size_t) 16 )
+
+typedef struct s_c_hash_map_statistics c_hash_map_statistics;
+
+// Статистика хэш-отображения (c_hash_map_stats).
+// Для движка CHAIN длина цепочки - количество узлов в слоте, гистограмма содержит количество
+// слотов с цепочкой заданной длины, среднее считается по непустым слотам.
+// Для движков SWISS и DENSE длина цепочки - количество групп, просматриваемых при поиске пары, гистограмма
+// содержит количество пар с заданной длиной, среднее считается по парам. Для движка CUCKOO длина
+// цепочки - номер корзины пары (1 или 2).
+// Просмотр при поиске - узел движка CHAIN, группа движка SWISS или корзина движка CUCKOO; средние
+// количества просмотров считаются, только если библиотека собрана с C_HASH_MAP_STATS_PROBES (иначе равны 0).
+struct s_c_hash_map_statistics
+{
+    size_t slots_count,
+           pairs_count,
+           empty_slots,
+           deleted_slots;
+    size_t max_chain;
+    double mean_chain;
+    size_t histogram[C_HASH_MAP_STATS_HISTOGRAM];
+
+    // Количество перестроений слотов и суммарное время перестроений в секундах
+    // (время постепенного переноса узлов не учитывается).
+    size_t resizes_count;
+    double resize_seconds;
+
+    // Количество успешных и неуспешных поисков и среднее количество просмотров в них.
+    size_t hits_count,
+           misses_count;
+    double hit_probes,
+           miss_probes;
+
+    // Память под слоты (включая управляющие байты) и под узлы.
+    size_t slots_bytes,
+           nodes_bytes;
+};
+
+typedef struct s_c_hash_map_iter c_hash_map_iter;
+
+// Итератор хэш-отображения (c_hash_map_iter_*).
+// Размещается пользователем, поля служебные и не должны меняться.
+struct s_c_hash_map_iter
+{
+    c_hash_map *hash_map;
+    // Номер текущего слота.
+    size_t slot;
+    // Текущая пара (NULL - пары закончились или текущая пара удалена).
+    void *pair;
+    // Ссылка на текущую пару в цепочке движка CHAIN.
+    void *link;
+};
+
+typedef struct s_c_hash_map_cache_statistics c_hash_map_cache_statistics;
+
+// Статистика режима кэша (c_hash_map_cache_stats).
+// Поиск считается успешным (hits_count) или неуспешным (misses_count) для функций,
+// ставящих признак обращения (см. cache_capacity в c_hash_map_options).
+struct s_c_hash_map_cache_statistics
+{
+    size_t capacity,
+           bytes;
+    size_t pairs_count,
+           used_bytes;
+    size_t hits_count,
+           misses_count,
+           evictions_count;
+};
+
+typedef struct s_c_hash_map_options c_hash_map_options;
+
+// Дополнительные параметры создания хэш-отображения.
+// Перед заполнением структуру необходимо инициализировать при помощи c_hash_map_options_init.
+struct s_c_hash_map_options
+{
+    // Движок хранения (C_HASH_MAP_ENGINE_*).
+    size_t engine;
+
+    // Пользовательские функции выделения и освобождения памяти.
+    // Должны быть заданы либо обе, либо ни одной (тогда используются malloc и free).
+    // Через них выделяется вся память хэш-отображения, включая само хэш-отображение.
+    void *(*mem_alloc)(void *const _context,
+                       const size_t _size);
+    void (*mem_free)(void *const _context,
+                     void *const _memory);
+    // Контекст, передаваемый в mem_alloc и mem_free.
+    void *mem_context;
+
+    // Способ приведения хэша к номеру слота движка CHAIN (C_HASH_MAP_INDEX_*).
+    // Количество слотов, задаваемое при создании и в c_hash_map_resize, округляется вверх до
+    // допустимого для выбранного способа.
+    size_t index_policy;
+
+    // Во сколько раз увеличивается количество слотов при автоматическом расширении (> 1).
+    // 0 - значение по умолчанию (1.75).
+    float growth_factor;
+
+    // Количество слотов, задаваемое хэш-отображению с нулем слотов при автоматическом расширении.
+    // 0 - значение по умолчанию (1024).
+    size_t initial_slots;
+
+    // Коэффициент загрузки, при падении ниже которого после удаления количество слотов
+    // уменьшается (загрузка становится равной половине max_load_factor, но слотов остается
+    // не меньше initial_slots). Не больше четверти max_load_factor, чтобы уменьшения и
+    // расширения не чередовались. c_hash_map_iter_erase_current количество слотов не уменьшает.
+    // 0 - количество слотов не уменьшается.
+    float min_load_factor;
+
+    // Верхняя граница допустимого max_load_factor (для движка CHAIN - не больше 64).
+    // 0 - значение по умолчанию (1.0).
+    float max_load_factor_cap;
+
+    // Количество старых слотов, переносимых каждой вставкой и удалением при постепенном
+    // перестроении движка CHAIN после автоматического расширения.
+    // 0 - перестроение выполняется сразу целиком.
+    size_t rehash_step;
+
+    // Количество узлов в одном блоке slab-распределителя узлов движка CHAIN.
+    // 0 - значение по умолчанию, 1 - каждый узел выделяется отдельно.
+    size_t slab_nodes;
+
+    // Сброс поколением (только движок CHAIN, slab_nodes != 1, rehash_step = 0).
+    // Каждый слот помечается поколением, c_hash_map_clear увеличивает текущее поколение и
+    // возвращает узлы в распределитель разом, слоты прошлых поколений считаются пустыми.
+    // Очистка без функций удаления выполняется за постоянное время, количество слотов и
+    // память узлов сохраняются для повторного заполнения. Слоты занимают на 4 байта больше.
+    // 0 - режим выключен.
+    size_t generation_reset;
+
+    // Количество потоков, по которым распределяется перенос узлов при перестроении движка CHAIN
+    // (c_hash_map_resize и автоматическое расширение без постепенного перестроения, не больше 64).
+    // Перенос выполняется в два прохода: сначала потоки раскладывают узлы своих диапазонов старых
+    // слотов по частям новых слотов, затем каждый поток связывает узлы своей части, поэтому
+    // разные потоки не пишут в одни слоты. Пользовательские функции при переносе не вызываются.
+    // 0 и 1 - перенос выполняется в вызывающем потоке.
+    size_t rehash_threads;
+
+    // Пользовательский запуск заданий в нескольких потоках (например, в пуле потоков).
+    // Должен выполнить _task(_tasks + i * _task_size) для каждого i < _count (в любых потоках)
+    // и вернуться после завершения всех заданий.
+    // NULL - для каждого задания, кроме первого, создается поток, первое выполняется в вызывающем.
+    void (*run_tasks)(void *const _context,
+                      void *(*const _task)(void *_arg),
+                      void *const _tasks,
+                      const size_t _task_size,
+                      const size_t _count);
+    // Контекст, передаваемый в run_tasks.
+    void *run_context;
+
+    // Размеры ключа и данных при встроенном хранении (0 - хранится указатель пользователя).
+    // Заданные при вставке ключ и данные копируются в узел или слот и не захватываются,
+    // c_hash_map_at и другие функции возвращают указатели на копии, функциям удаления
+    // передаются указатели на копии (освобождать их нельзя).
+    // Копии в слотах движка SWISS перемещаются при перестроении.
+    // При встроенном хранении ключей comp_key может быть NULL: ключи сравниваются побайтно.
+    size_t key_size,
+           value_size;
+
+    // Сравнение хранимого ключа с байтовым представлением ключа _bytes размером _size
+    // для c_hash_map_check_view и c_hash_map_at_view (например, c_hash_map_comp_view_str).
+    // В случае идентичности ключей должна возвращать > 0, иначе 0.
+    // NULL - представление побайтно сравнивается со встроенным ключом (только при key_size > 0).
+    size_t (*comp_key_view)(const void *const _key,
+                            const void *const _bytes,
+                            const size_t _size);
+
+    // Режим кэша (только движок CHAIN, rehash_step = 0): предельное количество пар и предельная
+    // суммарная стоимость пар (0 - предел не задан, режим включен, если задан хотя бы один).
+    // Если после вставки предел превышен, пары вытесняются по алгоритму CLOCK: признак обращения
+    // хранится в узле и ставится при поиске (c_hash_map_at, c_hash_map_check и их вариантах,
+    // пакетном поиске, c_hash_map_find_or_insert) и вставке существующего ключа, стрелка обходит
+    // слоты и вытесняет первую пару без признака, снимая признак с пройденных пар.
+    // Новая пара вставляется без признака, поэтому пары, к которым не обращались, вытесняются
+    // раньше. Только что вставленная пара не вытесняется. Узлы занимают на 16 байт больше.
+    size_t cache_capacity,
+           cache_bytes;
+    // Стоимость пары для cache_bytes, вычисляется при вставке и замене данных (для
+    // c_hash_map_find_or_insert - при вставке, когда данные еще равны NULL).
+    // NULL - стоимость равна размеру узла.
+    size_t (*cache_cost)(const void *const _key,
+                         const void *const _data);
+    // Функции удаления ключа и данных вытесняемых пар (могут быть NULL).
+    // Вызываются внутри функций вставки и не должны обращаться к хэш-отображению.
+    void (*cache_del_key)(void *const _key);
+    void (*cache_del_data)(void *const _data);
+
+    // Режим срока жизни пар (только движок CHAIN, rehash_step = 0).
+    // Пары, вставленные c_hash_map_insert_ttl или продленные c_hash_map_touch, связываются
+    // через узлы в иерархическое колесо сроков, c_hash_map_expire удаляет истекшие пары за время,
+    // пропорциональное их количеству. Узлы занимают на 32 байта больше.
+    // 0 - режим выключен.
+    size_t ttl_mode;
+};
+
 c_hash_map *c_hash_map_create(size_t (*const _hash_key)(const void *const _key),
                               size_t (*const _comp_key)(const void *const _key_a,
                                                         const void *const _key_b),
@@ -26,6 +263,16 @@ c_hash_map *c_hash_map_create(size_t (*const _hash_key)(const void *const _key),
                               const float _max_load_factor,
                               size_t *const _error);
 
+void c_hash_map_options_init(c_hash_map_options *const _options);
+
+c_hash_map *c_hash_map_create_ex(size_t (*const _hash_key)(const void *const _key),
+                                 size_t (*const _comp_key)(const void *const _key_a,
+                                                           const void *const _key_b),
+                                 const size_t _slots_count,
+                                 const float _max_load_factor,
+                                 const c_hash_map_options *const _options,
+                                 size_t *const _error);
+
 ptrdiff_t c_hash_map_delete(c_hash_map *const _hash_map,
                             void (*const _del_key)(void *const _key),
                             void (*const _del_data)(void *const _data));
@@ -34,29 +281,169 @@ ptrdiff_t c_hash_map_insert(c_hash_map *const _hash_map,
                             const void *const _key,
                             const void *const _data);
 
+ptrdiff_t c_hash_map_insert_hashed(c_hash_map *const _hash_map,
+                                   const void *const _key,
+                                   const size_t _hash,
+                                   const void *const _data);
+
+ptrdiff_t c_hash_map_insert_or_assign(c_hash_map *const _hash_map,
+                                      const void *const _key,
+                                      const void *const _data,
+                                      void (*const _del_data)(void *const _data));
+
+ptrdiff_t c_hash_map_insert_or_assign_hashed(c_hash_map *const _hash_map,
+                                             const void *const _key,
+                                             const size_t _hash,
+                                             const void *const _data,
+                                             void (*const _del_data)(void *const _data));
+
+ptrdiff_t c_hash_map_try_emplace(c_hash_map *const _hash_map,
+                                 const void *const _key,
+                                 const void *const _data,
+                                 void **const _exist_data);
+
+ptrdiff_t c_hash_map_try_emplace_hashed(c_hash_map *const _hash_map,
+                                        const void *const _key,
+                                        const size_t _hash,
+                                        const void *const _data,
+                                        void **const _exist_data);
+
+void **c_hash_map_find_or_insert(c_hash_map *const _hash_map,
+                                 const void *const _key,
+                                 size_t *const _inserted,
+                                 size_t *const _error);
+
+void **c_hash_map_find_or_insert_hashed(c_hash_map *const _hash_map,
+                                        const void *const _key,
+                                        const size_t _hash,
+                                        size_t *const _inserted,
+                                        size_t *const _error);
+
+ptrdiff_t c_hash_map_build(c_hash_map *const _hash_map,
+                           const void *const *const _keys,
+                           void *const *const _datas,
+                           const size_t _count,
+                           const size_t _flags,
+                           void (*const _del_key)(void *const _key),
+                           void (*const _del_data)(void *const _data));
+
 ptrdiff_t c_hash_map_erase(c_hash_map *const _hash_map,
                            const void *const _key,
                            void (*const _del_key)(void *const _key),
                            void (*const _del_data)(void *const _data));
 
+ptrdiff_t c_hash_map_erase_hashed(c_hash_map *const _hash_map,
+                                  const void *const _key,
+                                  const size_t _hash,
+                                  void (*const _del_key)(void *const _key),
+                                  void (*const _del_data)(void *const _data));
+
+ptrdiff_t c_hash_map_insert_ttl(c_hash_map *const _hash_map,
+                                const void *const _key,
+                                const void *const _data,
+                                const uint64_t _now,
+                                const uint64_t _ttl);
+
+ptrdiff_t c_hash_map_touch(c_hash_map *const _hash_map,
+                           const void *const _key,
+                           const uint64_t _now,
+                           const uint64_t _ttl);
+
+ptrdiff_t c_hash_map_expire(c_hash_map *const _hash_map,
+                            const uint64_t _now,
+                            const size_t _budget,
+                            void (*const _del_key)(void *const _key),
+                            void (*const _del_data)(void *const _data));
+
 ptrdiff_t c_hash_map_resize(c_hash_map *const _hash_map,
                             const size_t _slots_count);
 
+ptrdiff_t c_hash_map_reserve(c_hash_map *const _hash_map,
+                             const size_t _pairs_count);
+
+ptrdiff_t c_hash_map_shrink_to_fit(c_hash_map *const _hash_map);
+
+ptrdiff_t c_hash_map_rehash_step(c_hash_map *const _hash_map,
+                                 const size_t _budget);
+
 ptrdiff_t c_hash_map_check(const c_hash_map *const _hash_map,
                            const void *const _key);
 
+ptrdiff_t c_hash_map_check_hashed(const c_hash_map *const _hash_map,
+                                  const void *const _key,
+                                  const size_t _hash);
+
+ptrdiff_t c_hash_map_check_view(const c_hash_map *const _hash_map,
+                                const void *const _bytes,
+                                const size_t _size,
+                                const size_t _hash);
+
 void *c_hash_map_at(const c_hash_map *const _hash_map,
                     const void *const _key,
                     size_t *const _error);
 
+void *c_hash_map_at_hashed(const c_hash_map *const _hash_map,
+                           const void *const _key,
+                           const size_t _hash,
+                           size_t *const _error);
+
+void *c_hash_map_at_view(const c_hash_map *const _hash_map,
+                         const void *const _bytes,
+                         const size_t _size,
+                         const size_t _hash,
+                         size_t *const _error);
+
+ptrdiff_t c_hash_map_at_batch(const c_hash_map *const _hash_map,
+                              const void *const *const _keys,
+                              const size_t _count,
+                              void **const _datas);
+
+ptrdiff_t c_hash_map_check_batch(const c_hash_map *const _hash_map,
+                                 const void *const *const _keys,
+                                 const size_t _count,
+                                 size_t *const _results);
+
 ptrdiff_t c_hash_map_for_each(c_hash_map *const _hash_map,
                               void (*const _action_key)(const void *const _key),
                               void (*const _action_data)(void *const _data));
 
+ptrdiff_t c_hash_map_for_each_ex(c_hash_map *const _hash_map,
+                                 size_t (*const _action)(const void *const _key,
+                                                         void *const _data,
+                                                         void *const _context),
+                                 void *const _context);
+
+ptrdiff_t c_hash_map_for_each_parallel(c_hash_map *const _hash_map,
+                                       const size_t _threads_count,
+                                       void (*const _action)(const void *const _key,
+                                                             void *const _data,
+                                                             void *const _context),
+                                       void *const _context);
+
+ptrdiff_t c_hash_map_iter_begin(c_hash_map *const _hash_map,
+                                c_hash_map_iter *const _iter);
+
+ptrdiff_t c_hash_map_iter_next(c_hash_map_iter *const _iter);
+
+const void *c_hash_map_iter_key(const c_hash_map_iter *const _iter);
+
+void *c_hash_map_iter_data(const c_hash_map_iter *const _iter);
+
+size_t c_hash_map_iter_hash(const c_hash_map_iter *const _iter);
+
+ptrdiff_t c_hash_map_iter_erase_current(c_hash_map_iter *const _iter,
+                                        void (*const _del_key)(void *const _key),
+                                        void (*const _del_data)(void *const _data));
+
 ptrdiff_t c_hash_map_clear(c_hash_map *const _hash_map,
                            void (*const _del_key)(void *const _key),
                            void (*const _del_data)(void *const _data));
 
+ptrdiff_t c_hash_map_clear_parallel(c_hash_map *const _hash_map,
+                                    const size_t _threads_count,
+                                    void (*const _del_key)(void *const _key),
+                                    void (*const _del_data)(void *const _data));
+
 size_t c_hash_map_slots_count(const c_hash_map *const _hash_map,
                               size_t *const _error);
 
@@ -65,4 +452,12 @@ size_t c_hash_map_pairs_count(const c_hash_map *const _hash_map,
 
 float c_hash_map_max_load_factor(const c_hash_map *const _hash_map);
 
+ptrdiff_t c_hash_map_stats(const c_hash_map *const _hash_map,
+                           c_hash_map_statistics *const _stats);
+
+ptrdiff_t c_hash_map_cache_stats(const c_hash_map *const _hash_map,
+                                 c_hash_map_cache_statistics *const _stats);
+
+ptrdiff_t c_hash_map_cache_reset_stats(c_hash_map *const _hash_map);
+
 #endif
@@ -0,0 +1,509 @@
+﻿/*
+    Файл реализации конкурентного хэш-отображения c_hash_map_concurrent
+    Лицензия: GPLv3
+*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "c_hash_map_concurrent.h"
+
+// Максимально допустимое количество шардов.
+#define C_HASH_MAP_CONCURRENT_SHARDS_MAX ( (size_t) 65536 )
+
+// Размер, до которого дополняется шард, чтобы соседние шарды не делили строку кэша.
+#define C_HASH_MAP_CONCURRENT_SHARD_SIZE ( (size_t) 128 )
+
+typedef union u_c_hash_map_shard c_hash_map_shard;
+
+// Шард: отдельное хэш-отображение со своей блокировкой чтения-записи.
+union u_c_hash_map_shard
+{
+    struct
+    {
+        pthread_rwlock_t lock;
+        c_hash_map *hash_map;
+    } s;
+    char padding[C_HASH_MAP_CONCURRENT_SHARD_SIZE];
+};
+
+struct s_c_hash_map_concurrent
+{
+    size_t (*hash_key)(const void *const _key);
+
+    // Количество шардов (степень двойки) и количество битов хэша, выбирающих шард.
+    size_t shards_count;
+    unsigned int shard_bits;
+
+    // Размер встроенных данных шардов (0 - хранятся указатели).
+    size_t value_size;
+
+    // Функции выделения и освобождения памяти (из параметров создания или malloc и free).
+    void *(*mem_alloc)(void *const _context,
+                       const size_t _size);
+    void (*mem_free)(void *const _context,
+                     void *const _memory);
+    void *mem_context;
+
+    c_hash_map_shard *shards;
+};
+
+// Если расположение задано, в него помещается код.
+static void error_set(size_t *const _error,
+                      const size_t _code)
+{
+    if (_error != NULL)
+    {
+        *_error = _code;
+    }
+}
+
+// Функция выделения памяти по умолчанию.
+static void *mem_alloc_default(void *const _context,
+                               const size_t _size)
+{
+    (void)_context;
+    return malloc(_size);
+}
+
+// Функция освобождения памяти по умолчанию.
+static void mem_free_default(void *const _context,
+                             void *const _memory)
+{
+    (void)_context;
+    free(_memory);
+}
+
+// Выбирает шард по старшим битам перемешанного хэша ключа.
+// Множитель отличается от используемого внутри c_hash_map, чтобы выбор шарда не коррелировал
+// с приведением хэша к слоту внутри шарда. Тот же хэш передается шарду, поэтому ключ
+// хэшируется один раз.
+static c_hash_map_shard *shard_of(const c_hash_map_concurrent *const _hash_map,
+                                  const size_t _hash)
+{
+    if (_hash_map->shard_bits == 0)
+    {
+        return &_hash_map->shards[0];
+    }
+
+    uint64_t h = (uint64_t)_hash;
+    h ^= h >> 32;
+    h *= 0xC2B2AE3D27D4EB4FULL;
+
+    return &_hash_map->shards[h >> (64 - _hash_map->shard_bits)];
+}
+
+// Создание пустого конкурентного хэш-отображения.
+// Количество шардов округляется вверх до степени двойки, _slots_count и _options
+// относятся ко всему хэш-отображению и делятся между шардами.
+// Функции выделения памяти из _options используются и для самого хэш-отображения с шардами.
+// В случае ошибки возвращает NULL, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0):
+// - 1-18 - код c_hash_map_create_ex, отвергнувшей параметры шарда (например, 3 - недопустимый
+//   _max_load_factor, 17 и 18 - режим кэша или сроков жизни не на движке CHAIN);
+// - 20 - количество шардов равно 0 или больше 65536;
+// - 21 - не удалось выделить память под хэш-отображение или массив шардов;
+// - 22 - не удалось инициализировать блокировку шарда.
+c_hash_map_concurrent *c_hash_map_concurrent_create(size_t (*const _hash_key)(const void *const _key),
+                                                    size_t (*const _comp_key)(const void *const _key_a,
+                                                                              const void *const _key_b),
+                                                    const size_t _shards_count,
+                                                    const size_t _slots_count,
+                                                    const float _max_load_factor,
+                                                    const c_hash_map_options *const _options,
+                                                    size_t *const _error)
+{
+    if ( (_shards_count == 0) || (_shards_count > C_HASH_MAP_CONCURRENT_SHARDS_MAX) )
+    {
+        error_set(_error, 20);
+        return NULL;
+    }
+
+    size_t shards_count = 1;
+    unsigned int shard_bits = 0;
+    while (shards_count < _shards_count)
+    {
+        shards_count *= 2;
+        ++shard_bits;
+    }
+
+    // Несогласованные функции памяти отвергаются с тем же кодом, что и в c_hash_map_create_ex.
+    void *(*mem_alloc)(void *const _context,
+                       const size_t _size) = mem_alloc_default;
+    void (*mem_free)(void *const _context,
+                     void *const _memory) = mem_free_default;
+    void *mem_context = NULL;
+    if (_options != NULL)
+    {
+        if ( (_options->mem_alloc == NULL) != (_options->mem_free == NULL) )
+        {
+            error_set(_error, 8);
+            return NULL;
+        }
+        if (_options->mem_alloc != NULL)
+        {
+            mem_alloc = _options->mem_alloc;
+            mem_free = _options->mem_free;
+            mem_context = _options->mem_context;
+        }
+    }
+
+    c_hash_map_concurrent *const new_hash_map = mem_alloc(mem_context, sizeof(c_hash_map_concurrent));
+    if (new_hash_map == NULL)
+    {
+        error_set(_error, 21);
+        return NULL;
+    }
+
+    c_hash_map_shard *const new_shards = mem_alloc(mem_context, shards_count * sizeof(c_hash_map_shard));
+    if (new_shards == NULL)
+    {
+        mem_free(mem_context, new_hash_map);
+        error_set(_error, 21);
+        return NULL;
+    }
+
+    new_hash_map->mem_alloc = mem_alloc;
+    new_hash_map->mem_free = mem_free;
+    new_hash_map->mem_context = mem_context;
+
+    new_hash_map->hash_key = _hash_key;
+    new_hash_map->shards_count = shards_count;
+    new_hash_map->shard_bits = shard_bits;
+    new_hash_map->shards = new_shards;
+    new_hash_map->value_size = (_options != NULL) ? _options->value_size : 0;
+
+    // Количество слотов каждого шарда.
+    const size_t shard_slots = (_slots_count + shards_count - 1) / shards_count;
+
+    // Пределы режима кэша тоже делятся между шардами, каждый шард вытесняет свои пары.
+    c_hash_map_options shard_options;
+    if (_options != NULL)
+    {
+        shard_options = *_options;
+    } else {
+        c_hash_map_options_init(&shard_options);
+    }
+    shard_options.cache_capacity = (shard_options.cache_capacity + shards_count - 1) / shards_count;
+    shard_options.cache_bytes = (shard_options.cache_bytes + shards_count - 1) / shards_count;
+
+    for (size_t i = 0; i < shards_count; ++i)
+    {
+        size_t error = 0;
+        new_shards[i].s.hash_map = c_hash_map_create_ex(_hash_key, _comp_key, shard_slots,
+                                                        _max_load_factor, &shard_options, &error);
+        if (new_shards[i].s.hash_map == NULL)
+        {
+            error_set(_error, error);
+        } else {
+            if (pthread_rwlock_init(&new_shards[i].s.lock, NULL) != 0)
+            {
+                c_hash_map_delete(new_shards[i].s.hash_map, NULL, NULL);
+                error_set(_error, 22);
+            } else {
+                continue;
+            }
+        }
+
+        // Откатываем уже созданные шарды.
+        for (size_t j = 0; j < i; ++j)
+        {
+            pthread_rwlock_destroy(&new_shards[j].s.lock);
+            c_hash_map_delete(new_shards[j].s.hash_map, NULL, NULL);
+        }
+        mem_free(mem_context, new_shards);
+        mem_free(mem_context, new_hash_map);
+        return NULL;
+    }
+
+    return new_hash_map;
+}
+
+// Удаляет конкурентное хэш-отображение.
+// Вызывающий должен гарантировать, что хэш-отображение больше никем не используется.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_concurrent_delete(c_hash_map_concurrent *const _hash_map,
+                                       void (*const _del_key)(void *const _key),
+                                       void (*const _del_data)(void *const _data))
+{
+    if (_hash_map == NULL) return -1;
+
+    for (size_t i = 0; i < _hash_map->shards_count; ++i)
+    {
+        c_hash_map_delete(_hash_map->shards[i].s.hash_map, _del_key, _del_data);
+        pthread_rwlock_destroy(&_hash_map->shards[i].s.lock);
+    }
+
+    _hash_map->mem_free(_hash_map->mem_context, _hash_map->shards);
+    _hash_map->mem_free(_hash_map->mem_context, _hash_map);
+
+    return 1;
+}
+
+// Вставка данных, аналогична c_hash_map_insert.
+// Блокирует на запись только шард ключа, шард может при этом расширяться, не мешая остальным.
+ptrdiff_t c_hash_map_concurrent_insert(c_hash_map_concurrent *const _hash_map,
+                                       const void *const _key,
+                                       const void *const _data)
+{
+    if (_hash_map == NULL) return -1;
+    if (_key == NULL) return -2;
+
+    return c_hash_map_concurrent_insert_hashed(_hash_map, _key, _hash_map->hash_key(_key), _data);
+}
+
+// Вставка данных с уже вычисленным хэшем ключа, аналогична c_hash_map_insert_hashed.
+ptrdiff_t c_hash_map_concurrent_insert_hashed(c_hash_map_concurrent *const _hash_map,
+                                              const void *const _key,
+                                              const size_t _hash,
+                                              const void *const _data)
+{
+    if (_hash_map == NULL) return -1;
+    if (_key == NULL) return -2;
+    if (_data == NULL) return -3;
+
+    c_hash_map_shard *const shard = shard_of(_hash_map, _hash);
+
+    pthread_rwlock_wrlock(&shard->s.lock);
+    const ptrdiff_t r_code = c_hash_map_insert_hashed(shard->s.hash_map, _key, _hash, _data);
+    pthread_rwlock_unlock(&shard->s.lock);
+
+    return r_code;
+}
+
+// Удаление данных, аналогично c_hash_map_erase.
+// Функции удаления вызываются под блокировкой шарда.
+ptrdiff_t c_hash_map_concurrent_erase(c_hash_map_concurrent *const _hash_map,
+                                      const void *const _key,
+                                      void (*const _del_key)(void *const _key),
+                                      void (*const _del_data)(void *const _data))
+{
+    if (_hash_map == NULL) return -1;
+    if (_key == NULL) return -2;
+
+    return c_hash_map_concurrent_erase_hashed(_hash_map, _key, _hash_map->hash_key(_key), _del_key, _del_data);
+}
+
+// Удаление данных с уже вычисленным хэшем ключа, аналогично c_hash_map_erase_hashed.
+ptrdiff_t c_hash_map_concurrent_erase_hashed(c_hash_map_concurrent *const _hash_map,
+                                             const void *const _key,
+                                             const size_t _hash,
+                                             void (*const _del_key)(void *const _key),
+                                             void (*const _del_data)(void *const _data))
+{
+    if (_hash_map == NULL) return -1;
+    if (_key == NULL) return -2;
+
+    c_hash_map_shard *const shard = shard_of(_hash_map, _hash);
+
+    pthread_rwlock_wrlock(&shard->s.lock);
+    const ptrdiff_t r_code = c_hash_map_erase_hashed(shard->s.hash_map, _key, _hash, _del_key, _del_data);
+    pthread_rwlock_unlock(&shard->s.lock);
+
+    return r_code;
+}
+
+// Проверка наличия данных, аналогична c_hash_map_check.
+// Блокирует шард ключа только на чтение.
+ptrdiff_t c_hash_map_concurrent_check(c_hash_map_concurrent *const _hash_map,
+                                      const void *const _key)
+{
+    if (_hash_map == NULL) return -1;
+    if (_key == NULL) return -2;
+
+    return c_hash_map_concurrent_check_hashed(_hash_map, _key, _hash_map->hash_key(_key));
+}
+
+// Проверка наличия данных с уже вычисленным хэшем ключа, аналогична c_hash_map_check_hashed.
+ptrdiff_t c_hash_map_concurrent_check_hashed(c_hash_map_concurrent *const _hash_map,
+                                             const void *const _key,
+                                             const size_t _hash)
+{
+    if (_hash_map == NULL) return -1;
+    if (_key == NULL) return -2;
+
+    c_hash_map_shard *const shard = shard_of(_hash_map, _hash);
+
+    pthread_rwlock_rdlock(&shard->s.lock);
+    const ptrdiff_t r_code = c_hash_map_check_hashed(shard->s.hash_map, _key, _hash);
+    pthread_rwlock_unlock(&shard->s.lock);
+
+    return r_code;
+}
+
+// Обращение к данным, аналогично c_hash_map_at.
+// Блокирует шард ключа только на чтение. Возвращенные данные могут быть удалены другим потоком
+// сразу после возврата, поэтому согласованная работа с данными должна выполняться через
+// c_hash_map_concurrent_compute.
+void *c_hash_map_concurrent_at(c_hash_map_concurrent *const _hash_map,
+                               const void *const _key,
+                               size_t *const _error)
+{
+    if (_hash_map == NULL)
+    {
+        error_set(_error, 1);
+        return NULL;
+    }
+    if (_key == NULL)
+    {
+        error_set(_error, 2);
+        return NULL;
+    }
+
+    return c_hash_map_concurrent_at_hashed(_hash_map, _key, _hash_map->hash_key(_key), _error);
+}
+
+// Обращение к данным с уже вычисленным хэшем ключа, аналогично c_hash_map_at_hashed
+// (см. c_hash_map_concurrent_at).
+void *c_hash_map_concurrent_at_hashed(c_hash_map_concurrent *const _hash_map,
+                                      const void *const _key,
+                                      const size_t _hash,
+                                      size_t *const _error)
+{
+    if (_hash_map == NULL)
+    {
+        error_set(_error, 1);
+        return NULL;
+    }
+    if (_key == NULL)
+    {
+        error_set(_error, 2);
+        return NULL;
+    }
+
+    c_hash_map_shard *const shard = shard_of(_hash_map, _hash);
+
+    pthread_rwlock_rdlock(&shard->s.lock);
+    void *const data = c_hash_map_at_hashed(shard->s.hash_map, _key, _hash, _error);
+    pthread_rwlock_unlock(&shard->s.lock);
+
+    return data;
+}
+
+// Атомарное чтение-изменение-запись пары с заданным ключом под блокировкой шарда на запись.
+// В _compute передается расположение данных: данные пары или NULL, если пары нет.
+// _compute может занести в расположение новые данные:
+// - если пары не было и занесены данные (не NULL), пара вставляется, ключ и данные захватываются,
+//   функция возвращает 1;
+// - если пары не было и данные остались NULL, ничего не происходит, функция возвращает 0;
+// - если пара была и данные не NULL, они становятся данными пары, функция возвращает 2;
+// - если пара была и занесен NULL, пара удаляется (к ключу применяется _del_key, если задана,
+//   а старые данные остаются на ответственности _compute), функция возвращает 3.
+// При встроенном хранении данных (value_size > 0) договор тот же: новой паре передается NULL,
+// существующей - указатель на ее копию данных, которую можно изменять на месте. Занесенные
+// _compute данные, отличные от этой копии, копируются в пару (value_size байт), расположение
+// после возврата из _compute снова указывает на копию.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_concurrent_compute(c_hash_map_concurrent *const _hash_map,
+                                        const void *const _key,
+                                        void (*const _compute)(const void *const _key,
+                                                               void **const _data,
+                                                               void *const _context),
+                                        void *const _context,
+                                        void (*const _del_key)(void *const _key))
+{
+    if (_hash_map == NULL) return -1;
+    if (_key == NULL) return -2;
+    if (_compute == NULL) return -3;
+
+    const size_t hash = _hash_map->hash_key(_key);
+    c_hash_map_shard *const shard = shard_of(_hash_map, hash);
+
+    ptrdiff_t r_code;
+
+    pthread_rwlock_wrlock(&shard->s.lock);
+
+    size_t inserted = 0;
+    void **const data = c_hash_map_find_or_insert_hashed(shard->s.hash_map, _key, hash, &inserted, NULL);
+    if (data == NULL)
+    {
+        r_code = -4;
+    } else {
+        // Встроенная копия данных: ее адрес в расположении изменять нельзя, поэтому _compute
+        // работает с временным значением, а результат переносится в копию.
+        void *const inline_data = (_hash_map->value_size > 0) ? *data : NULL;
+        if ( (inline_data != NULL) && (inserted == 1) )
+        {
+            *data = NULL;
+        }
+
+        _compute(_key, data, _context);
+
+        const size_t present = (*data != NULL);
+        if (inline_data != NULL)
+        {
+            if ( (present != 0) && (*data != inline_data) )
+            {
+                memcpy(inline_data, *data, _hash_map->value_size);
+            }
+            *data = inline_data;
+        }
+
+        if (inserted == 1)
+        {
+            if (present != 0)
+            {
+                r_code = 1;
+            } else {
+                // Пара не нужна, ключ не захватывается.
+                c_hash_map_erase_hashed(shard->s.hash_map, _key, hash, NULL, NULL);
+                r_code = 0;
+            }
+        } else {
+            if (present != 0)
+            {
+                r_code = 2;
+            } else {
+                c_hash_map_erase_hashed(shard->s.hash_map, _key, hash, _del_key, NULL);
+                r_code = 3;
+            }
+        }
+    }
+
+    pthread_rwlock_unlock(&shard->s.lock);
+
+    return r_code;
+}
+
+// Возвращает количество шардов.
+// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+size_t c_hash_map_concurrent_shards_count(const c_hash_map_concurrent *const _hash_map,
+                                          size_t *const _error)
+{
+    if (_hash_map == NULL)
+    {
+        error_set(_error, 1);
+        return 0;
+    }
+
+    return _hash_map->shards_count;
+}
+
+// Возвращает количество пар во всех шардах.
+// Шарды блокируются на чтение поочередно, поэтому при параллельных изменениях результат
+// является приблизительным.
+// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+size_t c_hash_map_concurrent_pairs_count(c_hash_map_concurrent *const _hash_map,
+                                         size_t *const _error)
+{
+    if (_hash_map == NULL)
+    {
+        error_set(_error, 1);
+        return 0;
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < _hash_map->shards_count; ++i)
+    {
+        pthread_rwlock_rdlock(&_hash_map->shards[i].s.lock);
+        count += c_hash_map_pairs_count(_hash_map->shards[i].s.hash_map, NULL);
+        pthread_rwlock_unlock(&_hash_map->shards[i].s.lock);
+    }
+
+    return count;
+}
@@ -0,0 +1,80 @@
+﻿/*
+    Заголовочный файл конкурентного хэш-отображения c_hash_map_concurrent
+    Пространство ключей разделяется по битам хэша на независимые шарды, каждый из которых
+    является отдельным c_hash_map со своей блокировкой чтения-записи.
+    Лицензия: GPLv3
+*/
+
+#ifndef C_HASH_MAP_CONCURRENT_H
+#define C_HASH_MAP_CONCURRENT_H
+
+#include <stddef.h>
+
+#include "c_hash_map.h"
+
+typedef struct s_c_hash_map_concurrent c_hash_map_concurrent;
+
+c_hash_map_concurrent *c_hash_map_concurrent_create(size_t (*const _hash_key)(const void *const _key),
+                                                    size_t (*const _comp_key)(const void *const _key_a,
+                                                                              const void *const _key_b),
+                                                    const size_t _shards_count,
+                                                    const size_t _slots_count,
+                                                    const float _max_load_factor,
+                                                    const c_hash_map_options *const _options,
+                                                    size_t *const _error);
+
+ptrdiff_t c_hash_map_concurrent_delete(c_hash_map_concurrent *const _hash_map,
+                                       void (*const _del_key)(void *const _key),
+                                       void (*const _del_data)(void *const _data));
+
+ptrdiff_t c_hash_map_concurrent_insert(c_hash_map_concurrent *const _hash_map,
+                                       const void *const _key,
+                                       const void *const _data);
+
+ptrdiff_t c_hash_map_concurrent_insert_hashed(c_hash_map_concurrent *const _hash_map,
+                                              const void *const _key,
+                                              const size_t _hash,
+                                              const void *const _data);
+
+ptrdiff_t c_hash_map_concurrent_erase(c_hash_map_concurrent *const _hash_map,
+                                      const void *const _key,
+                                      void (*const _del_key)(void *const _key),
+                                      void (*const _del_data)(void *const _data));
+
+ptrdiff_t c_hash_map_concurrent_erase_hashed(c_hash_map_concurrent *const _hash_map,
+                                             const void *const _key,
+                                             const size_t _hash,
+                                             void (*const _del_key)(void *const _key),
+                                             void (*const _del_data)(void *const _data));
+
+ptrdiff_t c_hash_map_concurrent_check(c_hash_map_concurrent *const _hash_map,
+                                      const void *const _key);
+
+ptrdiff_t c_hash_map_concurrent_check_hashed(c_hash_map_concurrent *const _hash_map,
+                                             const void *const _key,
+                                             const size_t _hash);
+
+void *c_hash_map_concurrent_at(c_hash_map_concurrent *const _hash_map,
+                               const void *const _key,
+                               size_t *const _error);
+
+void *c_hash_map_concurrent_at_hashed(c_hash_map_concurrent *const _hash_map,
+                                      const void *const _key,
+                                      const size_t _hash,
+                                      size_t *const _error);
+
+ptrdiff_t c_hash_map_concurrent_compute(c_hash_map_concurrent *const _hash_map,
+                                        const void *const _key,
+                                        void (*const _compute)(const void *const _key,
+                                                               void **const _data,
+                                                               void *const _context),
+                                        void *const _context,
+                                        void (*const _del_key)(void *const _key));
+
+size_t c_hash_map_concurrent_shards_count(const c_hash_map_concurrent *const _hash_map,
+                                          size_t *const _error);
+
+size_t c_hash_map_concurrent_pairs_count(c_hash_map_concurrent *const _hash_map,
+                                         size_t *const _error);
+
+#endif
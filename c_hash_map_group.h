@@ -0,0 +1,346 @@
+﻿/*
+    Общие примитивы движков SWISS и CUCKOO: перемешивание хэша, группы и корзины управляющих байтов,
+    пробирование групп, правила расширения и освобождения слотов.
+    Используются c_hash_map.c и типизированными хэш-отображениями c_hash_map_typed.h.
+    Лицензия: GPLv3
+*/
+
+#ifndef C_HASH_MAP_GROUP_H
+#define C_HASH_MAP_GROUP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define C_HASH_MAP_SSE2
+#endif
+
+// Фибоначчиев множитель (2^64 / золотое сечение).
+#define C_HASH_MAP_FIB ( (uint64_t) 0x9E3779B97F4A7C15ULL )
+
+// Количество управляющих байтов (слотов) в группе движка SWISS.
+#define C_HASH_MAP_GROUP ( (size_t) 16 )
+
+// Количество управляющих байтов (слотов) в корзине движка CUCKOO.
+// Управляющие байты корзины занимают 8 байт и не пересекают строку кэша.
+#define C_HASH_MAP_BUCKET ( (size_t) 8 )
+
+// Управляющий байт пустого слота.
+#define C_HASH_MAP_CTRL_EMPTY ( (uint8_t) 0x80 )
+
+// Управляющий байт слота, из которого были удалены данные.
+#define C_HASH_MAP_CTRL_DELETED ( (uint8_t) 0xFE )
+
+// Возвращает номер младшего единичного бита маски (_mask != 0).
+static inline size_t c_hash_map_ctz32(const uint32_t _mask)
+{
+#if defined(__GNUC__)
+    return (size_t)__builtin_ctz(_mask);
+#else
+    uint32_t mask = _mask;
+    size_t n = 0;
+    while ( (mask & 1) == 0 )
+    {
+        mask >>= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+// Возвращает номер младшего единичного бита 64-битной маски (_mask != 0).
+static inline size_t c_hash_map_ctz64(const uint64_t _mask)
+{
+#if defined(__GNUC__)
+    return (size_t)__builtin_ctzll(_mask);
+#else
+    uint64_t mask = _mask;
+    size_t n = 0;
+    while ( (mask & 1) == 0 )
+    {
+        mask >>= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+// Перемешивание хэша.
+// Движок SWISS берет номер группы из младших битов, а фрагмент управляющего байта - из старших,
+// поэтому слабый пользовательский хэш необходимо перемешать.
+static inline uint64_t c_hash_map_mix(const size_t _hash)
+{
+    uint64_t h = (uint64_t)_hash;
+    h ^= h >> 32;
+    h *= C_HASH_MAP_FIB;
+    h ^= h >> 29;
+    return h;
+}
+
+// Фрагмент хэша (7 бит), хранимый в управляющем байте занятого слота.
+static inline uint8_t c_hash_map_h2(const uint64_t _mixed)
+{
+    return (uint8_t)(_mixed >> 57);
+}
+
+#ifdef C_HASH_MAP_SSE2
+
+// Маска слотов группы, управляющие байты которых равны _byte.
+static inline uint32_t c_hash_map_group_match(const uint8_t *const _ctrl,
+                                              const uint8_t _byte)
+{
+    const __m128i group = _mm_loadu_si128((const __m128i*)_ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)_byte)));
+}
+
+// Маска свободных (пустых или удаленных) слотов группы.
+static inline uint32_t c_hash_map_group_match_free(const uint8_t *const _ctrl)
+{
+    const __m128i group = _mm_loadu_si128((const __m128i*)_ctrl);
+    return (uint32_t)_mm_movemask_epi8(group);
+}
+
+// Маска слотов корзины, управляющие байты которых равны _byte.
+static inline uint32_t c_hash_map_bucket_match(const uint8_t *const _ctrl,
+                                               const uint8_t _byte)
+{
+    const __m128i bucket = _mm_loadl_epi64((const __m128i*)_ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bucket, _mm_set1_epi8((char)_byte))) & 0xFF;
+}
+
+// Маска пустых слотов корзины.
+static inline uint32_t c_hash_map_bucket_match_free(const uint8_t *const _ctrl)
+{
+    const __m128i bucket = _mm_loadl_epi64((const __m128i*)_ctrl);
+    return (uint32_t)_mm_movemask_epi8(bucket) & 0xFF;
+}
+
+#else
+
+// Маска слотов группы, управляющие байты которых равны _byte.
+static inline uint32_t c_hash_map_group_match(const uint8_t *const _ctrl,
+                                              const uint8_t _byte)
+{
+    uint32_t mask = 0;
+    for (size_t i = 0; i < C_HASH_MAP_GROUP; ++i)
+    {
+        if (_ctrl[i] == _byte)
+        {
+            mask |= (uint32_t)1 << i;
+        }
+    }
+    return mask;
+}
+
+// Маска свободных (пустых или удаленных) слотов группы.
+static inline uint32_t c_hash_map_group_match_free(const uint8_t *const _ctrl)
+{
+    uint32_t mask = 0;
+    for (size_t i = 0; i < C_HASH_MAP_GROUP; ++i)
+    {
+        if ( (_ctrl[i] & 0x80) != 0 )
+        {
+            mask |= (uint32_t)1 << i;
+        }
+    }
+    return mask;
+}
+
+// Маска слотов корзины, управляющие байты которых равны _byte.
+static inline uint32_t c_hash_map_bucket_match(const uint8_t *const _ctrl,
+                                               const uint8_t _byte)
+{
+    uint32_t mask = 0;
+    for (size_t i = 0; i < C_HASH_MAP_BUCKET; ++i)
+    {
+        if (_ctrl[i] == _byte)
+        {
+            mask |= (uint32_t)1 << i;
+        }
+    }
+    return mask;
+}
+
+// Маска пустых слотов корзины.
+static inline uint32_t c_hash_map_bucket_match_free(const uint8_t *const _ctrl)
+{
+    uint32_t mask = 0;
+    for (size_t i = 0; i < C_HASH_MAP_BUCKET; ++i)
+    {
+        if ( (_ctrl[i] & 0x80) != 0 )
+        {
+            mask |= (uint32_t)1 << i;
+        }
+    }
+    return mask;
+}
+
+#endif
+
+// Приводит заданное количество слотов к допустимому для движка SWISS (степень двойки, не меньше группы).
+// В случае переполнения возвращает 0.
+static inline size_t c_hash_map_group_capacity(const size_t _slots_count)
+{
+    size_t capacity = C_HASH_MAP_GROUP;
+    while (capacity < _slots_count)
+    {
+        if (capacity > SIZE_MAX / 2)
+        {
+            return 0;
+        }
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+// Возвращает первый свободный слот на пути пробирования заданного хэша.
+// Свободный слот обязан существовать.
+static inline size_t c_hash_map_group_find_free(const uint8_t *const _ctrl,
+                                                const size_t _capacity,
+                                                const uint64_t _mixed)
+{
+    const size_t groups_mask = _capacity / C_HASH_MAP_GROUP - 1;
+
+    size_t g = (size_t)_mixed & groups_mask;
+
+    // Квадратичное (треугольное) пробирование по группам обходит все группы.
+    for (size_t i = 1; ; ++i)
+    {
+        const uint32_t free_mask = c_hash_map_group_match_free(_ctrl + g * C_HASH_MAP_GROUP);
+        if (free_mask != 0)
+        {
+            return g * C_HASH_MAP_GROUP + c_hash_map_ctz32(free_mask);
+        }
+        g = (g + i) & groups_mask;
+    }
+}
+
+// Проверка слота-кандидата при пробировании (управляющий байт слота совпал с фрагментом хэша).
+// Возвращает != 0, если в слоте _s находится искомый ключ.
+typedef size_t (*c_hash_map_group_eq)(const void *const _context,
+                                      const size_t _s);
+
+// Ищет слот ключа на пути пробирования заданного хэша.
+// Если слот не найден, возвращает SIZE_MAX.
+// Если _free_slot != NULL, в него помещается первый свободный слот, встреченный на пути поиска
+// (или SIZE_MAX, если такого нет).
+// Если _probes != NULL, в него помещается количество просмотренных групп.
+// Функция встраивается вместе с _eq, если _eq известна в месте вызова.
+static inline size_t c_hash_map_group_find(const uint8_t *const _ctrl,
+                                           const size_t _capacity,
+                                           const uint64_t _mixed,
+                                           const c_hash_map_group_eq _eq,
+                                           const void *const _context,
+                                           size_t *const _free_slot,
+                                           size_t *const _probes)
+{
+    if (_free_slot != NULL)
+    {
+        *_free_slot = SIZE_MAX;
+    }
+    if (_probes != NULL)
+    {
+        *_probes = 0;
+    }
+
+    if (_capacity == 0)
+    {
+        return SIZE_MAX;
+    }
+
+    const uint8_t h2 = c_hash_map_h2(_mixed);
+    const size_t groups_mask = _capacity / C_HASH_MAP_GROUP - 1;
+
+    size_t g = (size_t)_mixed & groups_mask;
+
+    // Квадратичное (треугольное) пробирование по группам обходит все группы.
+    for (size_t i = 1; i <= groups_mask + 1; ++i)
+    {
+        const uint8_t *const ctrl = _ctrl + g * C_HASH_MAP_GROUP;
+
+        if (_probes != NULL)
+        {
+            *_probes = i;
+        }
+
+        uint32_t match = c_hash_map_group_match(ctrl, h2);
+        while (match != 0)
+        {
+            const size_t s = g * C_HASH_MAP_GROUP + c_hash_map_ctz32(match);
+            if (_eq(_context, s) != 0)
+            {
+                return s;
+            }
+            match &= match - 1;
+        }
+
+        if ( (_free_slot != NULL) && (*_free_slot == SIZE_MAX) )
+        {
+            const uint32_t free_mask = c_hash_map_group_match_free(ctrl);
+            if (free_mask != 0)
+            {
+                *_free_slot = g * C_HASH_MAP_GROUP + c_hash_map_ctz32(free_mask);
+            }
+        }
+
+        // Если в группе есть пустой слот, то дальше ключ находиться не может.
+        if (c_hash_map_group_match(ctrl, C_HASH_MAP_CTRL_EMPTY) != 0)
+        {
+            return SIZE_MAX;
+        }
+
+        g = (g + i) & groups_mask;
+    }
+
+    return SIZE_MAX;
+}
+
+// Возвращает != 0, если вставка еще одной пары превысит max_load_factor с учетом удаленных слотов
+// (_capacity > 0).
+static inline size_t c_hash_map_group_overloaded(const size_t _capacity,
+                                                 const size_t _pairs_count,
+                                                 const size_t _deleted_count,
+                                                 const float _max_load_factor)
+{
+    return ( (float)(_pairs_count + _deleted_count + 1) / _capacity > _max_load_factor ) ? 1 : 0;
+}
+
+// Возвращает != 0, если при перестройке слоты необходимо расширить (_capacity > 0).
+// Если большую часть загрузки составляют удаленные слоты, достаточно перестроить слоты на месте.
+static inline size_t c_hash_map_group_grow(const size_t _capacity,
+                                           const size_t _pairs_count,
+                                           const float _max_load_factor)
+{
+    return ( (float)(_pairs_count + 1) / _capacity > _max_load_factor / 2 ) ? 1 : 0;
+}
+
+// Занимает свободный слот _s под ключ с заданным хэшем.
+// Возвращает 1, если слот был удаленным (количество удаленных слотов уменьшается), иначе 0.
+static inline size_t c_hash_map_group_occupy(uint8_t *const _ctrl,
+                                             const size_t _s,
+                                             const uint64_t _mixed)
+{
+    const size_t was_deleted = (_ctrl[_s] == C_HASH_MAP_CTRL_DELETED) ? 1 : 0;
+    _ctrl[_s] = c_hash_map_h2(_mixed);
+    return was_deleted;
+}
+
+// Освобождает занятый слот _s.
+// Если в группе слота есть пустой слот, то пробирование на нем и так останавливается,
+// поэтому слот можно сделать пустым, иначе он помечается как удаленный.
+// Возвращает 1, если слот помечен как удаленный, иначе 0.
+static inline size_t c_hash_map_group_release(uint8_t *const _ctrl,
+                                              const size_t _s)
+{
+    if (c_hash_map_group_match(_ctrl + (_s & ~(C_HASH_MAP_GROUP - 1)), C_HASH_MAP_CTRL_EMPTY) != 0)
+    {
+        _ctrl[_s] = C_HASH_MAP_CTRL_EMPTY;
+        return 0;
+    }
+
+    _ctrl[_s] = C_HASH_MAP_CTRL_DELETED;
+    return 1;
+}
+
+#endif
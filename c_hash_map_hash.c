@@ -0,0 +1,350 @@
+﻿/*
+    Файл реализации библиотеки хэш-функций c_hash_map_hash
+    Хэш байтов построен по схеме wyhash (умножение 64x64->128 со сверткой половин).
+    Лицензия: GPLv3
+*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "c_hash_map_hash.h"
+#include "c_hash_map_group.h"
+
+// Константы перемешивания хэша байтов (нечетные, с равным количеством единичных битов в байтах).
+#define C_HASH_MAP_HASH_S0 ( (uint64_t) 0xA0761D6478BD642FULL )
+#define C_HASH_MAP_HASH_S1 ( (uint64_t) 0xE7037ED1A0B428DBULL )
+#define C_HASH_MAP_HASH_S2 ( (uint64_t) 0x8EBC6AF09C88C6E3ULL )
+#define C_HASH_MAP_HASH_S3 ( (uint64_t) 0x589965CC75374CC3ULL )
+
+// Чтение за пределами строки в пределах выровненного блока безопасно, но AddressSanitizer
+// о нем сообщает.
+#if defined(__GNUC__)
+#define C_HASH_MAP_HASH_NO_ASAN __attribute__((no_sanitize_address))
+#else
+#define C_HASH_MAP_HASH_NO_ASAN
+#endif
+
+// 128-битное произведение, свернутое в 64 бита.
+static inline uint64_t hash_mum(const uint64_t _a,
+                                const uint64_t _b)
+{
+#if defined(__SIZEOF_INT128__)
+    const unsigned __int128 r = (unsigned __int128)_a * _b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
+#else
+    const uint64_t a_lo = (uint32_t)_a,
+                   a_hi = _a >> 32,
+                   b_lo = (uint32_t)_b,
+                   b_hi = _b >> 32;
+    const uint64_t lo_lo = a_lo * b_lo,
+                   hi_lo = a_hi * b_lo,
+                   lo_hi = a_lo * b_hi,
+                   hi_hi = a_hi * b_hi;
+    const uint64_t cross = (lo_lo >> 32) + (uint32_t)hi_lo + lo_hi;
+    const uint64_t hi = hi_hi + (hi_lo >> 32) + (cross >> 32);
+    const uint64_t lo = (cross << 32) | (uint32_t)lo_lo;
+    return lo ^ hi;
+#endif
+}
+
+static inline uint64_t hash_read8(const uint8_t *const _p)
+{
+    uint64_t v;
+    memcpy(&v, _p, 8);
+    return v;
+}
+
+static inline uint64_t hash_read4(const uint8_t *const _p)
+{
+    uint32_t v;
+    memcpy(&v, _p, 4);
+    return v;
+}
+
+// Хэш байтов произвольной длины с заданным зерном.
+// Для _size < 4 читаются первый, средний и последний байты, до 16 байт - два перекрывающихся
+// 4-байтовых слова с каждого края, длиннее - 16-байтовые блоки (по 48 байт в три потока).
+uint64_t c_hash_map_hash_bytes(const void *const _data,
+                               const size_t _size,
+                               const uint64_t _seed)
+{
+    const uint8_t *p = _data;
+    uint64_t seed = _seed ^ hash_mum(_seed ^ C_HASH_MAP_HASH_S0, C_HASH_MAP_HASH_S1);
+    uint64_t a,
+             b;
+
+    if (_size <= 16)
+    {
+        if (_size >= 4)
+        {
+            const size_t shift = (_size >> 3) << 2;
+            a = (hash_read4(p) << 32) | hash_read4(p + shift);
+            b = (hash_read4(p + _size - 4) << 32) | hash_read4(p + _size - 4 - shift);
+        } else if (_size > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[_size >> 1] << 8) | p[_size - 1];
+            b = 0;
+        } else {
+            a = 0;
+            b = 0;
+        }
+    } else {
+        size_t i = _size;
+        if (i > 48)
+        {
+            uint64_t seed_1 = seed,
+                     seed_2 = seed;
+            do
+            {
+                seed = hash_mum(hash_read8(p) ^ C_HASH_MAP_HASH_S1, hash_read8(p + 8) ^ seed);
+                seed_1 = hash_mum(hash_read8(p + 16) ^ C_HASH_MAP_HASH_S2, hash_read8(p + 24) ^ seed_1);
+                seed_2 = hash_mum(hash_read8(p + 32) ^ C_HASH_MAP_HASH_S3, hash_read8(p + 40) ^ seed_2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= seed_1 ^ seed_2;
+        }
+        while (i > 16)
+        {
+            seed = hash_mum(hash_read8(p) ^ C_HASH_MAP_HASH_S1, hash_read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = hash_read8(p + i - 16);
+        b = hash_read8(p + i - 8);
+    }
+
+    a ^= C_HASH_MAP_HASH_S1;
+    b ^= seed;
+#if defined(__SIZEOF_INT128__)
+    const unsigned __int128 r = (unsigned __int128)a * b;
+    a = (uint64_t)r;
+    b = (uint64_t)(r >> 64);
+#else
+    const uint64_t m = hash_mum(a, b);
+    a *= b;
+    b = m ^ a;
+#endif
+
+    return hash_mum(a ^ C_HASH_MAP_HASH_S0 ^ _size, b ^ C_HASH_MAP_HASH_S1);
+}
+
+// Перемешивание 64-битного целого (финализатор splitmix64): каждый бит результата зависит
+// от всех битов значения.
+uint64_t c_hash_map_hash_mix64(const uint64_t _value)
+{
+    uint64_t x = _value;
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// Длина строки, завершенной нулем.
+// Строка просматривается выровненными 16-байтовыми блоками, которые не пересекают границу страницы.
+C_HASH_MAP_HASH_NO_ASAN
+static size_t hash_strlen(const char *const _string)
+{
+#ifdef C_HASH_MAP_SSE2
+    const uintptr_t offset = (uintptr_t)_string & 15;
+    const char *block = _string - offset;
+    const __m128i zero = _mm_setzero_si128();
+
+    uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i*)block), zero));
+    mask >>= offset;
+    if (mask != 0)
+    {
+        return c_hash_map_ctz32(mask);
+    }
+
+    for (;;)
+    {
+        block += 16;
+        mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i*)block), zero));
+        if (mask != 0)
+        {
+            return (size_t)(block - _string) + c_hash_map_ctz32(mask);
+        }
+    }
+#else
+    return strlen(_string);
+#endif
+}
+
+// Хэш ключа-строки, завершенной нулем (для c_hash_map_create).
+size_t c_hash_map_hash_str(const void *const _key)
+{
+    if (_key == NULL) return 0;
+
+    return (size_t)c_hash_map_hash_bytes(_key, hash_strlen(_key), 0);
+}
+
+// Хэш ключа uint64_t, заданного указателем (для c_hash_map_create).
+size_t c_hash_map_hash_u64(const void *const _key)
+{
+    if (_key == NULL) return 0;
+
+    uint64_t value;
+    memcpy(&value, _key, sizeof(uint64_t));
+
+    return (size_t)c_hash_map_hash_mix64(value);
+}
+
+// Сравнение ключа-строки с байтовым представлением строки _bytes длиной _size без завершающего
+// нуля (comp_key_view для ключей, хэшируемых c_hash_map_hash_str).
+// В случае идентичности строк возвращает > 0, иначе 0.
+size_t c_hash_map_comp_view_str(const void *const _key,
+                                const void *const _bytes,
+                                const size_t _size)
+{
+    if ( (_key == NULL) || ( (_bytes == NULL) && (_size > 0) ) ) return 0;
+
+    const char *const key = _key,
+               *const bytes = _bytes;
+
+    // Строка ключа не читается дальше завершающего нуля.
+    for (size_t i = 0; i < _size; ++i)
+    {
+        if ( (key[i] != bytes[i]) || (key[i] == '\0') )
+        {
+            return 0;
+        }
+    }
+
+    return (key[_size] == '\0') ? 1 : 0;
+}
+
+// Сравнение хэшей для qsort.
+static int hash_compare(const void *const _a,
+                        const void *const _b)
+{
+    const size_t a = *(const size_t*)_a,
+                 b = *(const size_t*)_b;
+    return (a > b) - (a < b);
+}
+
+// Оценка качества хэш-функции на выборке различных ключей.
+// Ключи распределяются по _slots_count слотам так же, как в c_hash_map с приведением хэша
+// остатком от деления (C_HASH_MAP_INDEX_MOD), результат сравнивается с ожидаемым для
+// равномерно распределенного хэша.
+// В случае успеха возвращает > 0, результат помещается в _report.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_hash_quality(size_t (*const _hash_key)(const void *const _key),
+                                  const void *const *const _keys,
+                                  const size_t _count,
+                                  const size_t _slots_count,
+                                  c_hash_map_hash_report *const _report)
+{
+    if (_hash_key == NULL) return -1;
+    if (_keys == NULL) return -2;
+    if ( (_count == 0) || (_slots_count == 0) ) return -3;
+    if (_report == NULL) return -4;
+
+    if ( (_count > SIZE_MAX / sizeof(size_t)) || (_slots_count > SIZE_MAX / sizeof(size_t)) )
+    {
+        return -5;
+    }
+
+    size_t *const hashes = malloc(_count * sizeof(size_t));
+    size_t *const chains = calloc(_slots_count, sizeof(size_t));
+    if ( (hashes == NULL) || (chains == NULL) )
+    {
+        free(hashes);
+        free(chains);
+        return -5;
+    }
+
+    for (size_t i = 0; i < _count; ++i)
+    {
+        hashes[i] = _hash_key(_keys[i]);
+        ++chains[hashes[i] % _slots_count];
+    }
+
+    memset(_report, 0, sizeof(c_hash_map_hash_report));
+    _report->keys_count = _count;
+    _report->slots_count = _slots_count;
+
+    const double mean = (double)_count / _slots_count;
+    double probes = 0;
+    for (size_t s = 0; s < _slots_count; ++s)
+    {
+        const size_t chain = chains[s];
+
+        if (chain == 0)
+        {
+            ++_report->empty_slots;
+        }
+        if (chain > _report->max_chain)
+        {
+            _report->max_chain = chain;
+        }
+        ++_report->histogram[(chain < C_HASH_MAP_HASH_HISTOGRAM) ? chain : C_HASH_MAP_HASH_HISTOGRAM - 1];
+
+        // Ключи цепочки длины L находятся за 1, 2, ..., L просмотров.
+        probes += (double)chain * (chain + 1) / 2;
+        _report->chi_squared += ((double)chain - mean) * ((double)chain - mean) / mean;
+    }
+
+    _report->chain_length = probes / _count;
+    _report->expected_chain_length = 1 + (double)(_count - 1) / (2.0 * _slots_count);
+    _report->expected_empty_slots = _slots_count * exp((double)_count * log1p(-1.0 / _slots_count));
+
+    // Совпадения полного хэша не устраняются никаким количеством слотов.
+    qsort(hashes, _count, sizeof(size_t), hash_compare);
+    for (size_t i = 0; i < _count; )
+    {
+        size_t j = i + 1;
+        while ( (j < _count) && (hashes[j] == hashes[i]) )
+        {
+            ++j;
+        }
+        if (j - i > 1)
+        {
+            _report->hash_collisions += j - i;
+        }
+        i = j;
+    }
+
+    free(hashes);
+    free(chains);
+
+    return 1;
+}
+
+// Печать результата c_hash_map_hash_quality.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_hash_quality_print(const c_hash_map_hash_report *const _report,
+                                        FILE *const _stream)
+{
+    if (_report == NULL) return -1;
+    if (_stream == NULL) return -2;
+
+    fprintf(_stream, "keys: %lu, slots: %lu, load factor: %.3f\n",
+            (unsigned long)_report->keys_count, (unsigned long)_report->slots_count,
+            (double)_report->keys_count / _report->slots_count);
+    fprintf(_stream, "empty slots: %lu (expected %.1f)\n",
+            (unsigned long)_report->empty_slots, _report->expected_empty_slots);
+    fprintf(_stream, "chain length on hit: %.3f (expected %.3f), max chain: %lu\n",
+            _report->chain_length, _report->expected_chain_length, (unsigned long)_report->max_chain);
+    fprintf(_stream, "chi-squared: %.1f (expected about %lu)\n",
+            _report->chi_squared, (unsigned long)_report->slots_count);
+    fprintf(_stream, "keys with colliding full hash: %lu\n",
+            (unsigned long)_report->hash_collisions);
+
+    fprintf(_stream, "chain length histogram:\n");
+    for (size_t l = 0; l < C_HASH_MAP_HASH_HISTOGRAM; ++l)
+    {
+        if (_report->histogram[l] > 0)
+        {
+            fprintf(_stream, "  %2lu%s: %lu\n", (unsigned long)l,
+                    (l + 1 == C_HASH_MAP_HASH_HISTOGRAM) ? "+" : " ",
+                    (unsigned long)_report->histogram[l]);
+        }
+    }
+
+    return 1;
+}
@@ -0,0 +1,65 @@
+﻿/*
+    Заголовочный файл библиотеки хэш-функций c_hash_map_hash
+    Хэш-функции для c_hash_map_create и средство оценки качества хэш-функции.
+    Хэш строки c_hash_map_hash_str равен c_hash_map_hash_bytes(строка, длина, 0), поэтому
+    хэш подстроки буфера для c_hash_map_at_view вычисляется без копирования.
+    Лицензия: GPLv3
+*/
+
+#ifndef C_HASH_MAP_HASH_H
+#define C_HASH_MAP_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Количество элементов гистограммы длин цепочек (последний - цепочки этой длины и длиннее).
+#define C_HASH_MAP_HASH_HISTOGRAM ( (size_t) 16 )
+
+typedef struct s_c_hash_map_hash_report c_hash_map_hash_report;
+
+// Результат c_hash_map_hash_quality.
+struct s_c_hash_map_hash_report
+{
+    size_t keys_count,
+           slots_count;
+    // Количество пустых слотов: фактическое и ожидаемое для равномерного хэша.
+    size_t empty_slots;
+    double expected_empty_slots;
+    // Длина самой длинной цепочки.
+    size_t max_chain;
+    // Средняя длина просмотра цепочки при успешном поиске: фактическая и ожидаемая.
+    double chain_length;
+    double expected_chain_length;
+    // Хи-квадрат распределения ключей по слотам (для равномерного хэша близок к slots_count).
+    double chi_squared;
+    // Количество ключей, полный хэш которых совпал с хэшем другого ключа.
+    size_t hash_collisions;
+    // Количество слотов с цепочкой заданной длины.
+    size_t histogram[C_HASH_MAP_HASH_HISTOGRAM];
+};
+
+uint64_t c_hash_map_hash_bytes(const void *const _data,
+                               const size_t _size,
+                               const uint64_t _seed);
+
+uint64_t c_hash_map_hash_mix64(const uint64_t _value);
+
+size_t c_hash_map_hash_str(const void *const _key);
+
+size_t c_hash_map_hash_u64(const void *const _key);
+
+size_t c_hash_map_comp_view_str(const void *const _key,
+                                const void *const _bytes,
+                                const size_t _size);
+
+ptrdiff_t c_hash_map_hash_quality(size_t (*const _hash_key)(const void *const _key),
+                                  const void *const *const _keys,
+                                  const size_t _count,
+                                  const size_t _slots_count,
+                                  c_hash_map_hash_report *const _report);
+
+ptrdiff_t c_hash_map_hash_quality_print(const c_hash_map_hash_report *const _report,
+                                        FILE *const _stream);
+
+#endif
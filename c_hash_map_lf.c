@@ -0,0 +1,794 @@
+﻿/*
+    Файл реализации хэш-отображения c_hash_map_lf с неблокирующим чтением
+    Лицензия: GPLv3
+*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "c_hash_map_lf.h"
+
+// Количество слотов, задаваемое хэш-отображению, созданному с нулем слотов.
+#define C_HASH_MAP_LF_0 ( (size_t) 1024 )
+
+// Минимально допустимое значение max_load_factor.
+#define C_HASH_MAP_LF_MLF_MIN ( (float) 0.01f )
+
+// Максимально допустимое значение max_load_factor.
+#define C_HASH_MAP_LF_MLF_MAX ( (float) 1.f )
+
+// Размер, до которого дополняется запись читателя, чтобы записи разных читателей не делили строку кэша.
+#define C_HASH_MAP_LF_READER_SIZE ( (size_t) 128 )
+
+// Количество списков отложенного освобождения (по эпохам).
+#define C_HASH_MAP_LF_LIMBOS ( (size_t) 3 )
+
+typedef struct s_c_hash_map_lf_node c_hash_map_lf_node;
+
+struct s_c_hash_map_lf_node
+{
+    _Atomic(c_hash_map_lf_node*) next_node;
+    size_t hash;
+    void *key,
+         *data;
+};
+
+typedef struct s_c_hash_map_lf_table c_hash_map_lf_table;
+
+// Массив слотов. Публикуется целиком, при расширении заменяется новым.
+struct s_c_hash_map_lf_table
+{
+    size_t slots_count;
+    // Сдвиг, приводящий фибоначчиево произведение хэша к номеру слота.
+    unsigned int shift;
+    _Atomic(c_hash_map_lf_node*) slots[];
+};
+
+typedef struct s_c_hash_map_lf_reader_data c_hash_map_lf_reader_data;
+
+struct s_c_hash_map_lf_reader_data
+{
+    // Эпоха читателя, сдвинутая на один бит, в младшем бите - признак нахождения в секции чтения.
+    _Atomic size_t state;
+    // Глубина вложенности секций чтения (используется только потоком-владельцем).
+    size_t depth;
+    // Признак занятости записи (изменяется под блокировкой писателя).
+    size_t in_use;
+    struct s_c_hash_map_lf_reader *next_reader;
+};
+
+struct s_c_hash_map_lf_reader
+{
+    union
+    {
+        c_hash_map_lf_reader_data r;
+        char padding[C_HASH_MAP_LF_READER_SIZE];
+    } u;
+};
+
+typedef struct s_c_hash_map_lf_retired c_hash_map_lf_retired;
+
+// Память, ожидающая освобождения.
+struct s_c_hash_map_lf_retired
+{
+    void *memory;
+    // Признак того, что память является узлом, к ключу и данным которого применяются функции удаления.
+    size_t is_node;
+    void (*del_key)(void *const _key);
+    void (*del_data)(void *const _data);
+};
+
+typedef struct s_c_hash_map_lf_limbo c_hash_map_lf_limbo;
+
+// Список памяти, исключенной из хэш-отображения в одной эпохе.
+struct s_c_hash_map_lf_limbo
+{
+    c_hash_map_lf_retired *items;
+    size_t count,
+           capacity;
+};
+
+struct s_c_hash_map_lf
+{
+    size_t (*hash_key)(const void *const _key);
+    size_t (*comp_key)(const void *const _key_a,
+                       const void *const _key_b);
+
+    float max_load_factor;
+
+    _Atomic(c_hash_map_lf_table*) table;
+
+    // Поля ниже изменяются только под блокировкой писателя.
+    pthread_mutex_t write_lock;
+
+    size_t nodes_count;
+
+    c_hash_map_lf_reader *readers;
+
+    _Atomic size_t epoch;
+
+    c_hash_map_lf_limbo limbos[C_HASH_MAP_LF_LIMBOS];
+};
+
+// Если расположение задано, в него помещается код.
+static void error_set(size_t *const _error,
+                      const size_t _code)
+{
+    if (_error != NULL)
+    {
+        *_error = _code;
+    }
+}
+
+// Приводит хэш к номеру слота.
+static inline size_t index_of(const c_hash_map_lf_table *const _table,
+                              const size_t _hash)
+{
+    return (size_t)( ((uint64_t)_hash * 0x9E3779B97F4A7C15ULL) >> _table->shift );
+}
+
+// Создает пустой массив слотов (количество - степень двойки, не меньше 2).
+// В случае ошибки возвращает NULL.
+static c_hash_map_lf_table *table_create(const size_t _slots_count)
+{
+    size_t slots_count = 2;
+    unsigned int shift = 63;
+    while (slots_count < _slots_count)
+    {
+        if (slots_count > SIZE_MAX / 2 / sizeof(c_hash_map_lf_node*))
+        {
+            return NULL;
+        }
+        slots_count *= 2;
+        --shift;
+    }
+
+    c_hash_map_lf_table *const new_table = malloc(sizeof(c_hash_map_lf_table) +
+                                                  slots_count * sizeof(_Atomic(c_hash_map_lf_node*)));
+    if (new_table == NULL)
+    {
+        return NULL;
+    }
+
+    new_table->slots_count = slots_count;
+    new_table->shift = shift;
+    for (size_t s = 0; s < slots_count; ++s)
+    {
+        atomic_init(&new_table->slots[s], NULL);
+    }
+
+    return new_table;
+}
+
+// Освобождает исключенную память, применяя функции удаления.
+static void retired_free(const c_hash_map_lf_retired *const _retired)
+{
+    if (_retired->is_node != 0)
+    {
+        c_hash_map_lf_node *const node = _retired->memory;
+        if (_retired->del_key != NULL)
+        {
+            _retired->del_key(node->key);
+        }
+        if (_retired->del_data != NULL)
+        {
+            _retired->del_data(node->data);
+        }
+    }
+
+    free(_retired->memory);
+}
+
+// Освобождает всю память списка.
+static void limbo_flush(c_hash_map_lf_limbo *const _limbo)
+{
+    for (size_t i = 0; i < _limbo->count; ++i)
+    {
+        retired_free(&_limbo->items[i]);
+    }
+    _limbo->count = 0;
+}
+
+// Пытается перевести глобальную эпоху вперед.
+// Это возможно, только если все читатели в секциях чтения уже наблюдают текущую эпоху.
+// После перевода освобождается память, исключенная две эпохи назад: ее не может видеть ни один читатель.
+// Вызывается под блокировкой писателя.
+// Если эпоха переведена, возвращает > 0, иначе 0.
+static ptrdiff_t epoch_try_advance(c_hash_map_lf *const _hash_map)
+{
+    const size_t epoch = atomic_load_explicit(&_hash_map->epoch, memory_order_relaxed);
+
+    atomic_thread_fence(memory_order_seq_cst);
+
+    for (c_hash_map_lf_reader *reader = _hash_map->readers; reader != NULL; reader = reader->u.r.next_reader)
+    {
+        const size_t state = atomic_load_explicit(&reader->u.r.state, memory_order_acquire);
+        if ( ((state & 1) != 0) && ((state >> 1) != epoch) )
+        {
+            return 0;
+        }
+    }
+
+    atomic_store_explicit(&_hash_map->epoch, epoch + 1, memory_order_seq_cst);
+
+    limbo_flush(&_hash_map->limbos[(epoch + 1) % C_HASH_MAP_LF_LIMBOS]);
+
+    return 1;
+}
+
+// Дожидается, пока вся исключенная ранее память не станет недоступна читателям, и освобождает ее.
+// Вызывается под блокировкой писателя.
+static void epoch_synchronize(c_hash_map_lf *const _hash_map)
+{
+    for (size_t i = 0; i < C_HASH_MAP_LF_LIMBOS; )
+    {
+        if (epoch_try_advance(_hash_map) > 0)
+        {
+            ++i;
+        }
+    }
+}
+
+// Откладывает освобождение памяти, исключенной из хэш-отображения, до окончания текущих секций чтения.
+// Вызывается под блокировкой писателя.
+static void retire(c_hash_map_lf *const _hash_map,
+                   void *const _memory,
+                   const size_t _is_node,
+                   void (*const _del_key)(void *const _key),
+                   void (*const _del_data)(void *const _data))
+{
+    const size_t epoch = atomic_load_explicit(&_hash_map->epoch, memory_order_relaxed);
+    c_hash_map_lf_limbo *const limbo = &_hash_map->limbos[epoch % C_HASH_MAP_LF_LIMBOS];
+
+    if (limbo->count == limbo->capacity)
+    {
+        const size_t new_capacity = (limbo->capacity > 0) ? limbo->capacity * 2 : 64;
+        c_hash_map_lf_retired *const new_items = realloc(limbo->items, new_capacity * sizeof(c_hash_map_lf_retired));
+        if (new_items == NULL)
+        {
+            // Отложить освобождение не удалось, дожидаемся окончания всех секций чтения.
+            epoch_synchronize(_hash_map);
+
+            const c_hash_map_lf_retired retired = {_memory, _is_node, _del_key, _del_data};
+            retired_free(&retired);
+            return;
+        }
+        limbo->items = new_items;
+        limbo->capacity = new_capacity;
+    }
+
+    c_hash_map_lf_retired *const retired = &limbo->items[limbo->count++];
+    retired->memory = _memory;
+    retired->is_node = _is_node;
+    retired->del_key = _del_key;
+    retired->del_data = _del_data;
+}
+
+// Создание пустого хэш-отображения с неблокирующим чтением.
+// В случае ошибки возвращает NULL, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+c_hash_map_lf *c_hash_map_lf_create(size_t (*const _hash_key)(const void *const _key),
+                                    size_t (*const _comp_key)(const void *const _key_a,
+                                                              const void *const _key_b),
+                                    const size_t _slots_count,
+                                    const float _max_load_factor,
+                                    size_t *const _error)
+{
+    if (_hash_key == NULL)
+    {
+        error_set(_error, 1);
+        return NULL;
+    }
+    if (_comp_key == NULL)
+    {
+        error_set(_error, 2);
+        return NULL;
+    }
+    if  ( (_max_load_factor < C_HASH_MAP_LF_MLF_MIN) ||
+          (_max_load_factor > C_HASH_MAP_LF_MLF_MAX) )
+    {
+        error_set(_error, 3);
+        return NULL;
+    }
+
+    c_hash_map_lf_table *const new_table = table_create((_slots_count > 0) ? _slots_count : C_HASH_MAP_LF_0);
+    if (new_table == NULL)
+    {
+        error_set(_error, 4);
+        return NULL;
+    }
+
+    c_hash_map_lf *const new_hash_map = malloc(sizeof(c_hash_map_lf));
+    if (new_hash_map == NULL)
+    {
+        free(new_table);
+        error_set(_error, 5);
+        return NULL;
+    }
+
+    if (pthread_mutex_init(&new_hash_map->write_lock, NULL) != 0)
+    {
+        free(new_hash_map);
+        free(new_table);
+        error_set(_error, 6);
+        return NULL;
+    }
+
+    new_hash_map->hash_key = _hash_key;
+    new_hash_map->comp_key = _comp_key;
+    new_hash_map->max_load_factor = _max_load_factor;
+
+    atomic_init(&new_hash_map->table, new_table);
+
+    new_hash_map->nodes_count = 0;
+    new_hash_map->readers = NULL;
+
+    atomic_init(&new_hash_map->epoch, 0);
+
+    memset(new_hash_map->limbos, 0, sizeof(new_hash_map->limbos));
+
+    return new_hash_map;
+}
+
+// Удаляет хэш-отображение.
+// Вызывающий должен гарантировать, что хэш-отображение больше никем не используется.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_lf_delete(c_hash_map_lf *const _hash_map,
+                               void (*const _del_key)(void *const _key),
+                               void (*const _del_data)(void *const _data))
+{
+    if (_hash_map == NULL) return -1;
+
+    // Читателей нет, исключенную память можно освободить сразу.
+    for (size_t i = 0; i < C_HASH_MAP_LF_LIMBOS; ++i)
+    {
+        limbo_flush(&_hash_map->limbos[i]);
+        free(_hash_map->limbos[i].items);
+    }
+
+    c_hash_map_lf_table *const table = atomic_load_explicit(&_hash_map->table, memory_order_relaxed);
+    for (size_t s = 0; s < table->slots_count; ++s)
+    {
+        c_hash_map_lf_node *select_node = atomic_load_explicit(&table->slots[s], memory_order_relaxed),
+                           *delete_node;
+        while (select_node != NULL)
+        {
+            delete_node = select_node;
+            select_node = atomic_load_explicit(&select_node->next_node, memory_order_relaxed);
+
+            const c_hash_map_lf_retired retired = {delete_node, 1, _del_key, _del_data};
+            retired_free(&retired);
+        }
+    }
+    free(table);
+
+    c_hash_map_lf_reader *select_reader = _hash_map->readers,
+                         *delete_reader;
+    while (select_reader != NULL)
+    {
+        delete_reader = select_reader;
+        select_reader = select_reader->u.r.next_reader;
+        free(delete_reader);
+    }
+
+    pthread_mutex_destroy(&_hash_map->write_lock);
+
+    free(_hash_map);
+
+    return 1;
+}
+
+// Регистрирует запись читателя для вызывающего потока.
+// Запись используется только одним потоком и передается во все функции чтения.
+// В случае ошибки возвращает NULL, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+c_hash_map_lf_reader *c_hash_map_lf_reader_register(c_hash_map_lf *const _hash_map,
+                                                    size_t *const _error)
+{
+    if (_hash_map == NULL)
+    {
+        error_set(_error, 1);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&_hash_map->write_lock);
+
+    // Сначала используем освобожденные записи.
+    c_hash_map_lf_reader *reader = _hash_map->readers;
+    while ( (reader != NULL) && (reader->u.r.in_use != 0) )
+    {
+        reader = reader->u.r.next_reader;
+    }
+
+    if (reader == NULL)
+    {
+        reader = malloc(sizeof(c_hash_map_lf_reader));
+        if (reader == NULL)
+        {
+            pthread_mutex_unlock(&_hash_map->write_lock);
+            error_set(_error, 2);
+            return NULL;
+        }
+
+        atomic_init(&reader->u.r.state, 0);
+        reader->u.r.next_reader = _hash_map->readers;
+        _hash_map->readers = reader;
+    }
+
+    reader->u.r.depth = 0;
+    reader->u.r.in_use = 1;
+
+    pthread_mutex_unlock(&_hash_map->write_lock);
+
+    return reader;
+}
+
+// Освобождает запись читателя. Поток не должен находиться в секции чтения.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_lf_reader_unregister(c_hash_map_lf *const _hash_map,
+                                          c_hash_map_lf_reader *const _reader)
+{
+    if (_hash_map == NULL) return -1;
+    if (_reader == NULL) return -2;
+    if (_reader->u.r.depth != 0) return -3;
+
+    pthread_mutex_lock(&_hash_map->write_lock);
+
+    atomic_store_explicit(&_reader->u.r.state, 0, memory_order_release);
+    _reader->u.r.in_use = 0;
+
+    pthread_mutex_unlock(&_hash_map->write_lock);
+
+    return 1;
+}
+
+// Вход в секцию чтения.
+// Пока поток находится в секции, узлы и данные, полученные из хэш-отображения, не будут освобождены.
+// Секции могут быть вложенными. Функции чтения входят в секцию сами, явный вход нужен, чтобы
+// продолжать работать с полученными данными после возврата из функции чтения.
+void c_hash_map_lf_enter(c_hash_map_lf *const _hash_map,
+                         c_hash_map_lf_reader *const _reader)
+{
+    if (_reader->u.r.depth++ > 0)
+    {
+        return;
+    }
+
+    // Объявляем эпоху, пока объявленная эпоха не совпадет с глобальной: после этого писатель
+    // не сможет продвинуть эпоху больше чем на одну, пока читатель не выйдет из секции.
+    size_t epoch;
+    do
+    {
+        epoch = atomic_load_explicit(&_hash_map->epoch, memory_order_relaxed);
+        atomic_store_explicit(&_reader->u.r.state, (epoch << 1) | 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+    } while (atomic_load_explicit(&_hash_map->epoch, memory_order_acquire) != epoch);
+}
+
+// Выход из секции чтения.
+void c_hash_map_lf_exit(c_hash_map_lf_reader *const _reader)
+{
+    if (--_reader->u.r.depth > 0)
+    {
+        return;
+    }
+
+    atomic_store_explicit(&_reader->u.r.state, 0, memory_order_release);
+}
+
+// Ищет узел с заданным ключом. Вызывается в секции чтения или под блокировкой писателя.
+static c_hash_map_lf_node *find(const c_hash_map_lf *const _hash_map,
+                                c_hash_map_lf_table *const _table,
+                                const size_t _hash,
+                                const void *const _key)
+{
+    c_hash_map_lf_node *select_node = atomic_load_explicit(&_table->slots[index_of(_table, _hash)],
+                                                           memory_order_acquire);
+    while (select_node != NULL)
+    {
+        if (_hash == select_node->hash)
+        {
+            if (_hash_map->comp_key(_key, select_node->key) > 0)
+            {
+                return select_node;
+            }
+        }
+
+        select_node = atomic_load_explicit(&select_node->next_node, memory_order_acquire);
+    }
+
+    return NULL;
+}
+
+// Заменяет массив слотов новым, вдвое большим.
+// Узлы копируются: перестановка существующих узлов сломала бы обход цепочек читателями.
+// Старые узлы и массив освобождаются после окончания текущих секций чтения.
+// Вызывается под блокировкой писателя.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+static ptrdiff_t resize(c_hash_map_lf *const _hash_map)
+{
+    c_hash_map_lf_table *const table = atomic_load_explicit(&_hash_map->table, memory_order_relaxed);
+
+    if (table->slots_count > SIZE_MAX / 2)
+    {
+        return -1;
+    }
+
+    c_hash_map_lf_table *const new_table = table_create(table->slots_count * 2);
+    if (new_table == NULL)
+    {
+        return -2;
+    }
+
+    for (size_t s = 0; s < table->slots_count; ++s)
+    {
+        c_hash_map_lf_node *select_node = atomic_load_explicit(&table->slots[s], memory_order_relaxed);
+        while (select_node != NULL)
+        {
+            c_hash_map_lf_node *const new_node = malloc(sizeof(c_hash_map_lf_node));
+            if (new_node == NULL)
+            {
+                // Новый массив еще никому не виден, освобождаем его сразу.
+                for (size_t n = 0; n < new_table->slots_count; ++n)
+                {
+                    c_hash_map_lf_node *delete_node = atomic_load_explicit(&new_table->slots[n], memory_order_relaxed);
+                    while (delete_node != NULL)
+                    {
+                        c_hash_map_lf_node *const next_node = atomic_load_explicit(&delete_node->next_node, memory_order_relaxed);
+                        free(delete_node);
+                        delete_node = next_node;
+                    }
+                }
+                free(new_table);
+                return -3;
+            }
+
+            new_node->hash = select_node->hash;
+            new_node->key = select_node->key;
+            new_node->data = select_node->data;
+
+            const size_t presented_hash = index_of(new_table, new_node->hash);
+            atomic_init(&new_node->next_node, atomic_load_explicit(&new_table->slots[presented_hash], memory_order_relaxed));
+            atomic_store_explicit(&new_table->slots[presented_hash], new_node, memory_order_relaxed);
+
+            select_node = atomic_load_explicit(&select_node->next_node, memory_order_relaxed);
+        }
+    }
+
+    // Публикуем новый массив.
+    atomic_store_explicit(&_hash_map->table, new_table, memory_order_release);
+
+    // Старые узлы (без функций удаления - ключи и данные перешли в новые узлы) и старый массив.
+    for (size_t s = 0; s < table->slots_count; ++s)
+    {
+        c_hash_map_lf_node *select_node = atomic_load_explicit(&table->slots[s], memory_order_relaxed);
+        while (select_node != NULL)
+        {
+            c_hash_map_lf_node *const next_node = atomic_load_explicit(&select_node->next_node, memory_order_relaxed);
+            retire(_hash_map, select_node, 0, NULL, NULL);
+            select_node = next_node;
+        }
+    }
+    retire(_hash_map, table, 0, NULL, NULL);
+
+    epoch_try_advance(_hash_map);
+
+    return 1;
+}
+
+// Вставка данных, аналогична c_hash_map_insert.
+// Писатели сериализуются, читатели не блокируются.
+ptrdiff_t c_hash_map_lf_insert(c_hash_map_lf *const _hash_map,
+                               const void *const _key,
+                               const void *const _data)
+{
+    if (_hash_map == NULL) return -1;
+    if (_key == NULL) return -2;
+    if (_data == NULL) return -3;
+
+    const size_t hash = _hash_map->hash_key(_key);
+
+    pthread_mutex_lock(&_hash_map->write_lock);
+
+    c_hash_map_lf_table *table = atomic_load_explicit(&_hash_map->table, memory_order_relaxed);
+
+    if (find(_hash_map, table, hash, _key) != NULL)
+    {
+        pthread_mutex_unlock(&_hash_map->write_lock);
+        return 0;
+    }
+
+    // При достижении предела загруженности расширяемся.
+    const float load_factor = (float)(_hash_map->nodes_count + 1) / table->slots_count;
+    if (load_factor > _hash_map->max_load_factor)
+    {
+        if (resize(_hash_map) < 0)
+        {
+            pthread_mutex_unlock(&_hash_map->write_lock);
+            return -4;
+        }
+        table = atomic_load_explicit(&_hash_map->table, memory_order_relaxed);
+    }
+
+    c_hash_map_lf_node *const new_node = malloc(sizeof(c_hash_map_lf_node));
+    if (new_node == NULL)
+    {
+        pthread_mutex_unlock(&_hash_map->write_lock);
+        return -5;
+    }
+
+    new_node->hash = hash;
+    new_node->key = (void*)_key;
+    new_node->data = (void*)_data;
+
+    const size_t presented_hash = index_of(table, hash);
+
+    atomic_init(&new_node->next_node, atomic_load_explicit(&table->slots[presented_hash], memory_order_relaxed));
+
+    // Публикуем полностью заполненный узел.
+    atomic_store_explicit(&table->slots[presented_hash], new_node, memory_order_release);
+
+    ++_hash_map->nodes_count;
+
+    pthread_mutex_unlock(&_hash_map->write_lock);
+
+    return 1;
+}
+
+// Удаление данных, аналогично c_hash_map_erase.
+// Функции удаления вызываются отложенно, когда ни один читатель уже не может видеть узел.
+ptrdiff_t c_hash_map_lf_erase(c_hash_map_lf *const _hash_map,
+                              const void *const _key,
+                              void (*const _del_key)(void *const _key),
+                              void (*const _del_data)(void *const _data))
+{
+    if (_hash_map == NULL) return -1;
+    if (_key == NULL) return -2;
+
+    const size_t hash = _hash_map->hash_key(_key);
+
+    pthread_mutex_lock(&_hash_map->write_lock);
+
+    c_hash_map_lf_table *const table = atomic_load_explicit(&_hash_map->table, memory_order_relaxed);
+
+    _Atomic(c_hash_map_lf_node*) *link = &table->slots[index_of(table, hash)];
+    c_hash_map_lf_node *select_node = atomic_load_explicit(link, memory_order_relaxed);
+
+    while (select_node != NULL)
+    {
+        if (hash == select_node->hash)
+        {
+            if (_hash_map->comp_key(_key, select_node->key) > 0)
+            {
+                // Ампутация узла: читатели, уже стоящие на узле, продолжат обход по его next_node.
+                atomic_store_explicit(link, atomic_load_explicit(&select_node->next_node, memory_order_relaxed),
+                                      memory_order_release);
+
+                --_hash_map->nodes_count;
+
+                retire(_hash_map, select_node, 1, _del_key, _del_data);
+                epoch_try_advance(_hash_map);
+
+                pthread_mutex_unlock(&_hash_map->write_lock);
+
+                return 1;
+            }
+        }
+
+        link = &select_node->next_node;
+        select_node = atomic_load_explicit(link, memory_order_relaxed);
+    }
+
+    pthread_mutex_unlock(&_hash_map->write_lock);
+
+    return 0;
+}
+
+// Проверка наличия данных, аналогична c_hash_map_check.
+// Не берет блокировок и не пишет в общую память.
+ptrdiff_t c_hash_map_lf_check(c_hash_map_lf *const _hash_map,
+                              c_hash_map_lf_reader *const _reader,
+                              const void *const _key)
+{
+    if (_hash_map == NULL) return -1;
+    if (_reader == NULL) return -2;
+    if (_key == NULL) return -3;
+
+    const size_t hash = _hash_map->hash_key(_key);
+
+    c_hash_map_lf_enter(_hash_map, _reader);
+
+    c_hash_map_lf_table *const table = atomic_load_explicit(&_hash_map->table, memory_order_acquire);
+    const ptrdiff_t r_code = (find(_hash_map, table, hash, _key) != NULL) ? 1 : 0;
+
+    c_hash_map_lf_exit(_reader);
+
+    return r_code;
+}
+
+// Обращение к данным, аналогично c_hash_map_at.
+// Не берет блокировок и не пишет в общую память.
+// Если данные могут быть удалены другим потоком, работать с ними после возврата можно только
+// внутри явной секции чтения (c_hash_map_lf_enter / c_hash_map_lf_exit).
+void *c_hash_map_lf_at(c_hash_map_lf *const _hash_map,
+                       c_hash_map_lf_reader *const _reader,
+                       const void *const _key,
+                       size_t *const _error)
+{
+    if (_hash_map == NULL)
+    {
+        error_set(_error, 1);
+        return NULL;
+    }
+    if (_reader == NULL)
+    {
+        error_set(_error, 2);
+        return NULL;
+    }
+    if (_key == NULL)
+    {
+        error_set(_error, 3);
+        return NULL;
+    }
+
+    const size_t hash = _hash_map->hash_key(_key);
+
+    c_hash_map_lf_enter(_hash_map, _reader);
+
+    c_hash_map_lf_table *const table = atomic_load_explicit(&_hash_map->table, memory_order_acquire);
+    c_hash_map_lf_node *const node = find(_hash_map, table, hash, _key);
+    void *const data = (node != NULL) ? node->data : NULL;
+
+    c_hash_map_lf_exit(_reader);
+
+    return data;
+}
+
+// Пытается освободить всю исключенную память, которую уже не видят читатели.
+// Возвращает количество переводов эпохи (>= 0).
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_lf_reclaim(c_hash_map_lf *const _hash_map)
+{
+    if (_hash_map == NULL) return -1;
+
+    pthread_mutex_lock(&_hash_map->write_lock);
+
+    ptrdiff_t count = 0;
+    for (size_t i = 0; i < C_HASH_MAP_LF_LIMBOS; ++i)
+    {
+        if (epoch_try_advance(_hash_map) == 0)
+        {
+            break;
+        }
+        ++count;
+    }
+
+    pthread_mutex_unlock(&_hash_map->write_lock);
+
+    return count;
+}
+
+// Возвращает количество пар в хэш-отображении.
+// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+size_t c_hash_map_lf_pairs_count(c_hash_map_lf *const _hash_map,
+                                 size_t *const _error)
+{
+    if (_hash_map == NULL)
+    {
+        error_set(_error, 1);
+        return 0;
+    }
+
+    pthread_mutex_lock(&_hash_map->write_lock);
+    const size_t count = _hash_map->nodes_count;
+    pthread_mutex_unlock(&_hash_map->write_lock);
+
+    return count;
+}
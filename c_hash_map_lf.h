@@ -0,0 +1,64 @@
+﻿/*
+    Заголовочный файл хэш-отображения c_hash_map_lf с неблокирующим чтением
+    Читатели не берут блокировок и не пишут в общую память, писатели сериализуются мьютексом.
+    Удаленные узлы и старые массивы слотов освобождаются по эпохам (epoch-based reclamation),
+    когда все читатели гарантированно перестали их видеть.
+    Лицензия: GPLv3
+*/
+
+#ifndef C_HASH_MAP_LF_H
+#define C_HASH_MAP_LF_H
+
+#include <stddef.h>
+
+typedef struct s_c_hash_map_lf c_hash_map_lf;
+
+// Запись читателя. Каждый читающий поток регистрирует свою запись и использует ее только сам.
+typedef struct s_c_hash_map_lf_reader c_hash_map_lf_reader;
+
+c_hash_map_lf *c_hash_map_lf_create(size_t (*const _hash_key)(const void *const _key),
+                                    size_t (*const _comp_key)(const void *const _key_a,
+                                                              const void *const _key_b),
+                                    const size_t _slots_count,
+                                    const float _max_load_factor,
+                                    size_t *const _error);
+
+ptrdiff_t c_hash_map_lf_delete(c_hash_map_lf *const _hash_map,
+                               void (*const _del_key)(void *const _key),
+                               void (*const _del_data)(void *const _data));
+
+c_hash_map_lf_reader *c_hash_map_lf_reader_register(c_hash_map_lf *const _hash_map,
+                                                    size_t *const _error);
+
+ptrdiff_t c_hash_map_lf_reader_unregister(c_hash_map_lf *const _hash_map,
+                                          c_hash_map_lf_reader *const _reader);
+
+void c_hash_map_lf_enter(c_hash_map_lf *const _hash_map,
+                         c_hash_map_lf_reader *const _reader);
+
+void c_hash_map_lf_exit(c_hash_map_lf_reader *const _reader);
+
+ptrdiff_t c_hash_map_lf_insert(c_hash_map_lf *const _hash_map,
+                               const void *const _key,
+                               const void *const _data);
+
+ptrdiff_t c_hash_map_lf_erase(c_hash_map_lf *const _hash_map,
+                              const void *const _key,
+                              void (*const _del_key)(void *const _key),
+                              void (*const _del_data)(void *const _data));
+
+ptrdiff_t c_hash_map_lf_check(c_hash_map_lf *const _hash_map,
+                              c_hash_map_lf_reader *const _reader,
+                              const void *const _key);
+
+void *c_hash_map_lf_at(c_hash_map_lf *const _hash_map,
+                       c_hash_map_lf_reader *const _reader,
+                       const void *const _key,
+                       size_t *const _error);
+
+ptrdiff_t c_hash_map_lf_reclaim(c_hash_map_lf *const _hash_map);
+
+size_t c_hash_map_lf_pairs_count(c_hash_map_lf *const _hash_map,
+                                 size_t *const _error);
+
+#endif
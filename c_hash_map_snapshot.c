@@ -0,0 +1,1489 @@
+﻿/*
+    Файл реализации снимков хэш-отображения c_hash_map_snapshot
+    Лицензия: GPLv3
+*/
+
+// mmap, fsync и fileno.
+#if !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "c_hash_map_snapshot.h"
+#include "c_hash_map_group.h"
+#include "c_hash_map_hash.h"
+
+// Размер страницы, по которому выравниваются индекс и пары в файле (не зависит от системы,
+// чтобы файл открывался на любой).
+#define C_HASH_MAP_SNAPSHOT_PAGE ( (size_t) 4096 )
+
+// Размер блока записи; контрольная сумма тела считается цепочкой по блокам этого размера.
+#define C_HASH_MAP_SNAPSHOT_BLOCK ( (size_t) 65536 )
+
+// Признак порядка байтов, в котором записан файл.
+#define C_HASH_MAP_SNAPSHOT_ORDER ( (uint32_t) 0x01020304 )
+
+// Начальное значение контрольных сумм.
+#define C_HASH_MAP_SNAPSHOT_SEED ( (uint64_t) 0x43484D534E415031ULL )
+
+// Виды индекса файла.
+// Открытая адресация с линейным пробированием.
+#define C_HASH_MAP_SNAPSHOT_INDEX_OPEN ( (uint64_t) 0 )
+// Минимальное совершенное хэширование (c_hash_map_freeze).
+#define C_HASH_MAP_SNAPSHOT_INDEX_MPH ( (uint64_t) 1 )
+
+// Среднее количество ключей в корзине минимального совершенного хэширования.
+#define C_HASH_MAP_MPH_BUCKET ( (size_t) 4 )
+
+// Наибольший допустимый размер корзины.
+#define C_HASH_MAP_MPH_BUCKET_MAX ( (size_t) 255 )
+
+// Количество попыток построения минимального совершенного хэширования с разными затравками.
+#define C_HASH_MAP_MPH_SEEDS ( (size_t) 8 )
+
+// Фибоначчиев множитель (2^64 / золотое сечение).
+#define C_HASH_MAP_MPH_FIB ( (uint64_t) 0x9E3779B97F4A7C15ULL )
+
+// Сигнатура файла снимка.
+static const uint8_t snapshot_magic[8] = { 'C', 'H', 'M', 'S', 'N', 'A', 'P', 0 };
+
+typedef struct s_c_hash_map_snapshot_header c_hash_map_snapshot_header;
+
+// Заголовок файла (в начале первой страницы, остаток страницы заполнен нулями).
+// Все смещения отсчитываются от начала файла.
+struct s_c_hash_map_snapshot_header
+{
+    uint8_t magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t file_size;
+    uint64_t pairs_count;
+    // Вид индекса (C_HASH_MAP_SNAPSHOT_INDEX_*).
+    // Открытая адресация: index_slots слотов c_hash_map_snapshot_slot (количество - степень двойки).
+    // Минимальное совершенное хэширование: pairs_count смещений записей пар, mph_buckets 16-битных
+    // пилотов корзин и index_slots - pairs_count номеров слотов, заменяющих позиции за pairs_count.
+    uint64_t index_kind;
+    uint64_t index_offset;
+    uint64_t index_slots;
+    uint64_t mph_seed;
+    uint64_t mph_buckets;
+    uint64_t pilots_offset;
+    uint64_t remap_offset;
+    // Записи пар, следуют подряд.
+    uint64_t pairs_offset;
+    // Хэш ключа первой записи (по нему при открытии проверяется hash_key).
+    uint64_t first_hash;
+    // Контрольная сумма тела (от второй страницы до конца файла).
+    uint64_t body_checksum;
+    // Контрольная сумма предшествующих полей заголовка.
+    uint64_t header_checksum;
+};
+
+typedef struct s_c_hash_map_snapshot_slot c_hash_map_snapshot_slot;
+
+// Слот индекса: хэш ключа и смещение записи пары (0 - слот пуст).
+struct s_c_hash_map_snapshot_slot
+{
+    uint64_t hash;
+    uint64_t offset;
+};
+
+typedef struct s_c_hash_map_snapshot_record c_hash_map_snapshot_record;
+
+// Запись пары. За ней следуют ключ и данные, каждый дополнен нулями до 8 байт.
+struct s_c_hash_map_snapshot_record
+{
+    uint64_t key_size;
+    uint64_t data_size;
+};
+
+struct s_c_hash_map_snapshot
+{
+    size_t (*hash_key)(const void *const _key);
+    size_t (*comp_key)(const void *const _key_a,
+                       const void *const _key_b);
+
+    // Отображенный файл или образ файла в памяти (c_hash_map_freeze).
+    const uint8_t *base;
+    size_t size;
+    // Признак образа в памяти (освобождается free, а не munmap).
+    size_t in_memory;
+
+    size_t index_kind;
+    // Открытая адресация.
+    const c_hash_map_snapshot_slot *index;
+    size_t index_mask;
+    // Минимальное совершенное хэширование.
+    const uint64_t *mph_offsets;
+    const uint16_t *mph_pilots;
+    const uint64_t *mph_remap;
+    uint64_t mph_seed;
+    size_t mph_buckets,
+           mph_slots;
+
+    size_t pairs_count;
+    size_t pairs_offset;
+    uint64_t first_hash;
+};
+
+typedef struct s_c_hash_map_snapshot_writer c_hash_map_snapshot_writer;
+
+// Буферизованная запись тела файла с подсчетом контрольной суммы.
+struct s_c_hash_map_snapshot_writer
+{
+    FILE *file;
+    uint8_t *buffer;
+    size_t used;
+    // Смещение следующего записываемого байта от начала файла.
+    uint64_t offset;
+    uint64_t checksum;
+    size_t failed;
+};
+
+// Если расположение задано, в него помещается код.
+static void error_set(size_t *const _error,
+                      const size_t _code)
+{
+    if (_error != NULL)
+    {
+        *_error = _code;
+    }
+}
+
+// Дополняет размер до 8 байт.
+static inline uint64_t align8(const uint64_t _size)
+{
+    return (_size + 7) & ~(uint64_t)7;
+}
+
+// Дополняет размер до страницы.
+static inline uint64_t align_page(const uint64_t _size)
+{
+    return (_size + C_HASH_MAP_SNAPSHOT_PAGE - 1) & ~(uint64_t)(C_HASH_MAP_SNAPSHOT_PAGE - 1);
+}
+
+// Старшая половина 128-битного произведения.
+static inline uint64_t mulhi64(const uint64_t _a,
+                               const uint64_t _b)
+{
+#if defined(__SIZEOF_INT128__)
+    return (uint64_t)( ((unsigned __int128)_a * _b) >> 64 );
+#else
+    const uint64_t a_lo = (uint32_t)_a,
+                   a_hi = _a >> 32,
+                   b_lo = (uint32_t)_b,
+                   b_hi = _b >> 32;
+    const uint64_t lo_lo = a_lo * b_lo,
+                   hi_lo = a_hi * b_lo,
+                   lo_hi = a_lo * b_hi,
+                   hi_hi = a_hi * b_hi;
+    const uint64_t cross = (lo_lo >> 32) + (uint32_t)hi_lo + lo_hi;
+    return hi_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+// Контрольная сумма тела: цепочка хэшей блоков C_HASH_MAP_SNAPSHOT_BLOCK байт.
+static uint64_t body_checksum(const uint64_t _checksum,
+                              const uint8_t *const _block,
+                              const size_t _size)
+{
+    return c_hash_map_hash_bytes(_block, _size, _checksum);
+}
+
+// Контрольная сумма тела образа файла целиком.
+static uint64_t image_checksum(const uint8_t *const _base,
+                               const size_t _size)
+{
+    uint64_t checksum = C_HASH_MAP_SNAPSHOT_SEED;
+    for (size_t offset = C_HASH_MAP_SNAPSHOT_PAGE; offset < _size; offset += C_HASH_MAP_SNAPSHOT_BLOCK)
+    {
+        const size_t part = (_size - offset < C_HASH_MAP_SNAPSHOT_BLOCK) ? _size - offset : C_HASH_MAP_SNAPSHOT_BLOCK;
+        checksum = body_checksum(checksum, _base + offset, part);
+    }
+
+    return checksum;
+}
+
+// Заполняет служебные поля заголовка и его контрольную сумму.
+static void header_seal(c_hash_map_snapshot_header *const _header)
+{
+    memcpy(_header->magic, snapshot_magic, sizeof(snapshot_magic));
+    _header->version = (uint32_t)C_HASH_MAP_SNAPSHOT_VERSION;
+    _header->byte_order = C_HASH_MAP_SNAPSHOT_ORDER;
+    _header->header_checksum = c_hash_map_hash_bytes(_header, offsetof(c_hash_map_snapshot_header, header_checksum),
+                                                     C_HASH_MAP_SNAPSHOT_SEED);
+}
+
+// Количество слотов индекса с открытой адресацией: загрузка не больше 3/4, хотя бы один
+// слот остается пустым.
+// В случае переполнения возвращает 0.
+static size_t open_slots(const size_t _pairs_count)
+{
+    size_t index_slots = 1;
+    while (index_slots - index_slots / 4 <= _pairs_count)
+    {
+        if (index_slots > SIZE_MAX / 2 / sizeof(c_hash_map_snapshot_slot))
+        {
+            return 0;
+        }
+        index_slots *= 2;
+    }
+
+    return index_slots;
+}
+
+// Заносит запись пары в индекс с открытой адресацией.
+static void open_insert(c_hash_map_snapshot_slot *const _index,
+                        const size_t _index_slots,
+                        const uint64_t _hash,
+                        const uint64_t _offset)
+{
+    size_t s = (size_t)c_hash_map_mix((size_t)_hash) & (_index_slots - 1);
+    while (_index[s].offset != 0)
+    {
+        s = (s + 1) & (_index_slots - 1);
+    }
+    _index[s].hash = _hash;
+    _index[s].offset = _offset;
+}
+
+// Ключ минимального совершенного хэширования: хэш, перемешанный с затравкой.
+static inline uint64_t mph_key(const uint64_t _hash,
+                               const uint64_t _seed)
+{
+    return c_hash_map_hash_mix64(_hash ^ _seed);
+}
+
+// Номер корзины ключа.
+static inline size_t mph_bucket(const uint64_t _key,
+                                const size_t _buckets)
+{
+    return (size_t)mulhi64(_key, (uint64_t)_buckets);
+}
+
+// Позиция ключа при заданном пилоте корзины (< _slots).
+static inline size_t mph_position(const uint64_t _key,
+                                  const uint16_t _pilot,
+                                  const size_t _slots)
+{
+    return (size_t)mulhi64(c_hash_map_hash_mix64(_key ^ ((uint64_t)_pilot * C_HASH_MAP_MPH_FIB)), (uint64_t)_slots);
+}
+
+typedef struct s_c_hash_map_mph c_hash_map_mph;
+
+// Построенное минимальное совершенное хэширование.
+struct s_c_hash_map_mph
+{
+    uint64_t seed;
+    size_t buckets,
+           slots;
+    uint16_t *pilots;
+    // Номера слотов для позиций от количества ключей до slots.
+    uint64_t *remap;
+    // Номер слота каждого ключа.
+    size_t *slot_of;
+};
+
+// Освобождает память минимального совершенного хэширования.
+static void mph_free(c_hash_map_mph *const _mph)
+{
+    free(_mph->pilots);
+    free(_mph->remap);
+    free(_mph->slot_of);
+    _mph->pilots = NULL;
+    _mph->remap = NULL;
+    _mph->slot_of = NULL;
+}
+
+// Строит минимальное совершенное хэширование заданных хэшей (схема с пилотами корзин, как в PTHash):
+// корзины размещаются по убыванию размера, для каждой подбирается пилот, при котором позиции
+// всех ее ключей свободны. Позиций на 6% больше, чем ключей, занятые позиции за количеством
+// ключей заменяются оставшимися свободными слотами.
+// В случае успеха возвращает > 0.
+// Если построить не удалось (например, хэши совпадают), возвращает 0.
+// В случае ошибки выделения памяти возвращает < 0.
+static ptrdiff_t mph_build(const uint64_t *const _hashes,
+                           const size_t _count,
+                           c_hash_map_mph *const _mph)
+{
+    memset(_mph, 0, sizeof(c_hash_map_mph));
+
+    const size_t buckets = _count / C_HASH_MAP_MPH_BUCKET + 1;
+    const size_t slots = _count + _count / 16 + 1;
+
+    uint64_t *const keys = malloc(_count * sizeof(uint64_t) + 1);
+    size_t *const order = malloc(_count * sizeof(size_t) + 1);
+    size_t *const bucket_start = malloc((buckets + 1) * sizeof(size_t));
+    size_t *const bucket_order = malloc(buckets * sizeof(size_t));
+    uint64_t *const taken = malloc((slots / 64 + 1) * sizeof(uint64_t));
+    size_t *const positions = malloc(_count * sizeof(size_t) + 1);
+    _mph->pilots = malloc(buckets * sizeof(uint16_t));
+    _mph->remap = malloc((slots - _count) * sizeof(uint64_t));
+    _mph->slot_of = malloc(_count * sizeof(size_t) + 1);
+
+    ptrdiff_t result = 0;
+    if ( (keys == NULL) || (order == NULL) || (bucket_start == NULL) || (bucket_order == NULL) ||
+         (taken == NULL) || (positions == NULL) ||
+         (_mph->pilots == NULL) || (_mph->remap == NULL) || (_mph->slot_of == NULL) )
+    {
+        result = -1;
+    }
+
+    for (size_t attempt = 0; (attempt < C_HASH_MAP_MPH_SEEDS) && (result == 0); ++attempt)
+    {
+        const uint64_t seed = C_HASH_MAP_MPH_FIB * (attempt + 1);
+
+        // Раскладываем ключи по корзинам (сортировка подсчетом).
+        memset(bucket_start, 0, (buckets + 1) * sizeof(size_t));
+        for (size_t i = 0; i < _count; ++i)
+        {
+            keys[i] = mph_key(_hashes[i], seed);
+            ++bucket_start[mph_bucket(keys[i], buckets) + 1];
+        }
+        size_t max_size = 0;
+        for (size_t b = 0; b < buckets; ++b)
+        {
+            if (bucket_start[b + 1] > max_size)
+            {
+                max_size = bucket_start[b + 1];
+            }
+            bucket_start[b + 1] += bucket_start[b];
+        }
+        // Такая корзина возможна только при массово совпадающих хэшах.
+        if (max_size > C_HASH_MAP_MPH_BUCKET_MAX)
+        {
+            break;
+        }
+
+        // bucket_order временно служит счетчиком заполнения корзин.
+        memset(bucket_order, 0, buckets * sizeof(size_t));
+        for (size_t i = 0; i < _count; ++i)
+        {
+            const size_t b = mph_bucket(keys[i], buckets);
+            order[bucket_start[b] + bucket_order[b]] = i;
+            ++bucket_order[b];
+        }
+
+        // Упорядочиваем непустые корзины по убыванию размера (сортировка подсчетом по размеру).
+        size_t size_start[C_HASH_MAP_MPH_BUCKET_MAX + 2];
+        memset(size_start, 0, sizeof(size_start));
+        for (size_t b = 0; b < buckets; ++b)
+        {
+            ++size_start[C_HASH_MAP_MPH_BUCKET_MAX - (bucket_start[b + 1] - bucket_start[b]) + 1];
+        }
+        for (size_t size = 0; size <= C_HASH_MAP_MPH_BUCKET_MAX; ++size)
+        {
+            size_start[size + 1] += size_start[size];
+        }
+        const size_t placed = size_start[C_HASH_MAP_MPH_BUCKET_MAX];
+        for (size_t b = 0; b < buckets; ++b)
+        {
+            bucket_order[size_start[C_HASH_MAP_MPH_BUCKET_MAX - (bucket_start[b + 1] - bucket_start[b])]++] = b;
+        }
+
+        memset(taken, 0, (slots / 64 + 1) * sizeof(uint64_t));
+        memset(_mph->pilots, 0, buckets * sizeof(uint16_t));
+
+        size_t failed = 0;
+        for (size_t n = 0; (n < placed) && (failed == 0); ++n)
+        {
+            const size_t b = bucket_order[n];
+            const size_t first = bucket_start[b],
+                         size = bucket_start[b + 1] - first;
+
+            size_t pilot = 0;
+            for (; pilot <= UINT16_MAX; ++pilot)
+            {
+                size_t j = 0;
+                for (; j < size; ++j)
+                {
+                    const size_t p = mph_position(keys[order[first + j]], (uint16_t)pilot, slots);
+                    if ( (taken[p / 64] & ((uint64_t)1 << (p % 64))) != 0 )
+                    {
+                        break;
+                    }
+                    taken[p / 64] |= (uint64_t)1 << (p % 64);
+                    positions[j] = p;
+                }
+                if (j == size)
+                {
+                    break;
+                }
+
+                // Позиции пересеклись, освобождаем занятые этой попыткой.
+                for (size_t t = 0; t < j; ++t)
+                {
+                    taken[positions[t] / 64] &= ~((uint64_t)1 << (positions[t] % 64));
+                }
+            }
+
+            if (pilot > UINT16_MAX)
+            {
+                failed = 1;
+            } else {
+                _mph->pilots[b] = (uint16_t)pilot;
+            }
+        }
+        if (failed != 0)
+        {
+            continue;
+        }
+
+        // Занятые позиции за количеством ключей заменяются свободными слотами.
+        size_t free_slot = 0;
+        for (size_t p = _count; p < slots; ++p)
+        {
+            _mph->remap[p - _count] = 0;
+            if ( (taken[p / 64] & ((uint64_t)1 << (p % 64))) != 0 )
+            {
+                while ( (taken[free_slot / 64] & ((uint64_t)1 << (free_slot % 64))) != 0 )
+                {
+                    ++free_slot;
+                }
+                _mph->remap[p - _count] = free_slot;
+                ++free_slot;
+            }
+        }
+
+        for (size_t i = 0; i < _count; ++i)
+        {
+            size_t p = mph_position(keys[i], _mph->pilots[mph_bucket(keys[i], buckets)], slots);
+            if (p >= _count)
+            {
+                p = (size_t)_mph->remap[p - _count];
+            }
+            _mph->slot_of[i] = p;
+        }
+
+        _mph->seed = seed;
+        _mph->buckets = buckets;
+        _mph->slots = slots;
+        result = 1;
+    }
+
+    free(keys);
+    free(order);
+    free(bucket_start);
+    free(bucket_order);
+    free(taken);
+    free(positions);
+
+    if (result <= 0)
+    {
+        mph_free(_mph);
+    }
+
+    return result;
+}
+
+// Записывает заполненную часть буфера.
+static void writer_flush(c_hash_map_snapshot_writer *const _writer)
+{
+    if (_writer->used == 0)
+    {
+        return;
+    }
+
+    _writer->checksum = body_checksum(_writer->checksum, _writer->buffer, _writer->used);
+    if (fwrite(_writer->buffer, 1, _writer->used, _writer->file) != _writer->used)
+    {
+        _writer->failed = 1;
+    }
+    _writer->used = 0;
+}
+
+// Добавляет байты в тело файла (_bytes == NULL - нули).
+static void writer_put(c_hash_map_snapshot_writer *const _writer,
+                       const void *const _bytes,
+                       const uint64_t _size)
+{
+    uint64_t done = 0;
+    while (done < _size)
+    {
+        size_t part = C_HASH_MAP_SNAPSHOT_BLOCK - _writer->used;
+        if (part > _size - done)
+        {
+            part = (size_t)(_size - done);
+        }
+
+        if (_bytes != NULL)
+        {
+            memcpy(_writer->buffer + _writer->used, (const uint8_t*)_bytes + done, part);
+        } else {
+            memset(_writer->buffer + _writer->used, 0, part);
+        }
+
+        _writer->used += part;
+        _writer->offset += part;
+        done += part;
+
+        if (_writer->used == C_HASH_MAP_SNAPSHOT_BLOCK)
+        {
+            writer_flush(_writer);
+        }
+    }
+}
+
+// Дополняет тело файла нулями до заданного смещения.
+static void writer_pad(c_hash_map_snapshot_writer *const _writer,
+                       const uint64_t _offset)
+{
+    writer_put(_writer, NULL, _offset - _writer->offset);
+}
+
+// Имя временного файла, в который записывается снимок перед переименованием (_path с суффиксом .tmp).
+// В случае ошибки возвращает NULL.
+static char *temp_path_make(const char *const _path)
+{
+    const size_t path_length = strlen(_path);
+    char *const temp_path = malloc(path_length + sizeof(".tmp"));
+    if (temp_path == NULL)
+    {
+        return NULL;
+    }
+    memcpy(temp_path, _path, path_length);
+    memcpy(temp_path + path_length, ".tmp", sizeof(".tmp"));
+
+    return temp_path;
+}
+
+// Завершает запись временного файла: сбрасывает его на диск, закрывает и, если запись
+// успешна (_result > 0), переименовывает в _path, иначе удаляет. Освобождает _temp_path.
+// Возвращает _result или -6 при ошибке ввода-вывода.
+static ptrdiff_t file_commit(FILE *const _file,
+                             char *const _temp_path,
+                             const char *const _path,
+                             const ptrdiff_t _result)
+{
+    ptrdiff_t result = _result;
+    if ( (result > 0) && ( (fflush(_file) != 0) || (fsync(fileno(_file)) != 0) ) )
+    {
+        result = -6;
+    }
+    if (fclose(_file) != 0)
+    {
+        result = -6;
+    }
+
+    if ( (result > 0) && (rename(_temp_path, _path) != 0) )
+    {
+        result = -6;
+    }
+    if (result < 0)
+    {
+        remove(_temp_path);
+    }
+
+    free(_temp_path);
+
+    return result;
+}
+
+// Сериализатор строки вместе с завершающим нулем.
+size_t c_hash_map_serialize_str(const void *const _object,
+                                const void **const _bytes)
+{
+    *_bytes = _object;
+    if (_object == NULL)
+    {
+        return 0;
+    }
+
+    return strlen(_object) + 1;
+}
+
+// Сериализатор 64-битного значения (8 байт как есть).
+size_t c_hash_map_serialize_u64(const void *const _object,
+                                const void **const _bytes)
+{
+    *_bytes = _object;
+    if (_object == NULL)
+    {
+        return 0;
+    }
+
+    return sizeof(uint64_t);
+}
+
+// Сохраняет пары хэш-отображения в файл снимка.
+// Файл сначала записывается рядом (с суффиксом .tmp) и затем переименовывается, поэтому
+// процессы, отобразившие прежний файл, продолжают работать с ним.
+// Индекс файла строится по хэшам, сохраненным в хэш-отображении, поэтому при открытии
+// снимка должна использоваться та же hash_key. Хэш-отображение не должно меняться во время сохранения.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_save(c_hash_map *const _hash_map,
+                          const char *const _path,
+                          const c_hash_map_serializer _key_serializer,
+                          const c_hash_map_serializer _data_serializer)
+{
+    if (_hash_map == NULL) return -1;
+    if (_path == NULL) return -2;
+    if ( (_key_serializer == NULL) || (_data_serializer == NULL) ) return -3;
+
+    const size_t pairs_count = c_hash_map_pairs_count(_hash_map, NULL);
+
+    const size_t index_slots = open_slots(pairs_count);
+    if (index_slots == 0)
+    {
+        return -4;
+    }
+
+    c_hash_map_snapshot_slot *const index = calloc(index_slots, sizeof(c_hash_map_snapshot_slot));
+    if (index == NULL)
+    {
+        return -5;
+    }
+
+    const uint64_t pairs_offset = align_page(C_HASH_MAP_SNAPSHOT_PAGE + (uint64_t)index_slots * sizeof(c_hash_map_snapshot_slot));
+
+    // Первый проход: размещение записей и заполнение индекса.
+    uint64_t offset = pairs_offset;
+    uint64_t first_hash = 0;
+    c_hash_map_iter iter;
+    for (ptrdiff_t r = c_hash_map_iter_begin(_hash_map, &iter); r > 0; r = c_hash_map_iter_next(&iter))
+    {
+        const void *bytes;
+        const uint64_t key_size = _key_serializer(c_hash_map_iter_key(&iter), &bytes);
+        const uint64_t data_size = _data_serializer(c_hash_map_iter_data(&iter), &bytes);
+        if (key_size == 0)
+        {
+            free(index);
+            return -7;
+        }
+        if ( (key_size > UINT64_MAX / 4) || (data_size > UINT64_MAX / 4) ||
+             (offset > UINT64_MAX / 2) )
+        {
+            free(index);
+            return -4;
+        }
+
+        const uint64_t hash = (uint64_t)c_hash_map_iter_hash(&iter);
+        if (offset == pairs_offset)
+        {
+            first_hash = hash;
+        }
+        open_insert(index, index_slots, hash, offset);
+
+        offset += sizeof(c_hash_map_snapshot_record) + align8(key_size) + align8(data_size);
+    }
+    const uint64_t file_size = offset;
+
+    char *const temp_path = temp_path_make(_path);
+    uint8_t *const buffer = malloc(C_HASH_MAP_SNAPSHOT_BLOCK);
+    if ( (temp_path == NULL) || (buffer == NULL) )
+    {
+        free(temp_path);
+        free(buffer);
+        free(index);
+        return -5;
+    }
+
+    FILE *const file = fopen(temp_path, "wb");
+    if (file == NULL)
+    {
+        free(temp_path);
+        free(buffer);
+        free(index);
+        return -6;
+    }
+
+    // Место под заголовок занимаем нулями, заголовок записывается последним.
+    c_hash_map_snapshot_writer writer;
+    writer.file = file;
+    writer.buffer = buffer;
+    writer.used = 0;
+    writer.offset = C_HASH_MAP_SNAPSHOT_PAGE;
+    writer.checksum = C_HASH_MAP_SNAPSHOT_SEED;
+    writer.failed = 0;
+
+    memset(buffer, 0, C_HASH_MAP_SNAPSHOT_PAGE);
+    if (fwrite(buffer, 1, C_HASH_MAP_SNAPSHOT_PAGE, file) != C_HASH_MAP_SNAPSHOT_PAGE)
+    {
+        writer.failed = 1;
+    }
+
+    writer_put(&writer, index, (uint64_t)index_slots * sizeof(c_hash_map_snapshot_slot));
+    writer_pad(&writer, pairs_offset);
+
+    free(index);
+
+    // Второй проход: записи пар в том же порядке.
+    size_t written = 0;
+    for (ptrdiff_t r = c_hash_map_iter_begin(_hash_map, &iter); (r > 0) && (writer.failed == 0); r = c_hash_map_iter_next(&iter))
+    {
+        const void *key;
+        const void *data;
+        c_hash_map_snapshot_record record;
+        record.key_size = _key_serializer(c_hash_map_iter_key(&iter), &key);
+        record.data_size = _data_serializer(c_hash_map_iter_data(&iter), &data);
+
+        writer_put(&writer, &record, sizeof(c_hash_map_snapshot_record));
+        writer_put(&writer, key, record.key_size);
+        writer_pad(&writer, align8(writer.offset));
+        writer_put(&writer, data, record.data_size);
+        writer_pad(&writer, align8(writer.offset));
+
+        ++written;
+    }
+    writer_flush(&writer);
+
+    free(buffer);
+
+    // Сериализаторы должны возвращать при повторном вызове то же представление.
+    ptrdiff_t result = 1;
+    if (writer.failed != 0)
+    {
+        result = -6;
+    } else if ( (written != pairs_count) || (writer.offset != file_size) ) {
+        result = -7;
+    }
+
+    if (result > 0)
+    {
+        c_hash_map_snapshot_header header;
+        memset(&header, 0, sizeof(c_hash_map_snapshot_header));
+        header.file_size = file_size;
+        header.pairs_count = pairs_count;
+        header.index_kind = C_HASH_MAP_SNAPSHOT_INDEX_OPEN;
+        header.index_offset = C_HASH_MAP_SNAPSHOT_PAGE;
+        header.index_slots = index_slots;
+        header.pairs_offset = pairs_offset;
+        header.first_hash = first_hash;
+        header.body_checksum = writer.checksum;
+        header_seal(&header);
+
+        if ( (fseek(file, 0, SEEK_SET) != 0) ||
+             (fwrite(&header, 1, sizeof(c_hash_map_snapshot_header), file) != sizeof(c_hash_map_snapshot_header)) )
+        {
+            result = -6;
+        }
+    }
+
+    return file_commit(file, temp_path, _path, result);
+}
+
+// Проверяет, что запись пары по заданному смещению целиком лежит в файле.
+// Если запись корректна, возвращает > 0, иначе 0.
+static size_t record_valid(const c_hash_map_snapshot *const _snapshot,
+                           const uint64_t _offset)
+{
+    if ( (_offset < _snapshot->pairs_offset) || ( (_offset & 7) != 0 ) ||
+         (_offset > _snapshot->size - sizeof(c_hash_map_snapshot_record)) )
+    {
+        return 0;
+    }
+
+    const c_hash_map_snapshot_record *const record = (const c_hash_map_snapshot_record*)(_snapshot->base + _offset);
+    const uint64_t space = _snapshot->size - _offset - sizeof(c_hash_map_snapshot_record);
+    if ( (record->key_size == 0) || (record->key_size > space) || (align8(record->key_size) > space) ||
+         (record->data_size > space - align8(record->key_size)) )
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+// Ключ записи пары.
+static inline const void *record_key(const c_hash_map_snapshot_record *const _record)
+{
+    return _record + 1;
+}
+
+// Данные записи пары (NULL при нулевом размере).
+static inline const void *record_data(const c_hash_map_snapshot_record *const _record)
+{
+    if (_record->data_size == 0)
+    {
+        return NULL;
+    }
+
+    return (const uint8_t*)(_record + 1) + align8(_record->key_size);
+}
+
+// Сравнивает заданный ключ с ключом записи пары по заданному смещению.
+// Если ключи совпадают, возвращает запись, иначе NULL.
+// Если запись выходит за пределы файла, возвращает NULL и помещает 1 в _corrupt.
+static const c_hash_map_snapshot_record *record_match(const c_hash_map_snapshot *const _snapshot,
+                                                      const void *const _key,
+                                                      const uint64_t _offset,
+                                                      size_t *const _corrupt)
+{
+    if (record_valid(_snapshot, _offset) == 0)
+    {
+        *_corrupt = 1;
+        return NULL;
+    }
+
+    const c_hash_map_snapshot_record *const record = (const c_hash_map_snapshot_record*)(_snapshot->base + _offset);
+    if (_snapshot->comp_key != NULL)
+    {
+        if (_snapshot->comp_key(_key, record_key(record)) > 0)
+        {
+            return record;
+        }
+    } else {
+        if (memcmp(_key, record_key(record), (size_t)record->key_size) == 0)
+        {
+            return record;
+        }
+    }
+
+    return NULL;
+}
+
+// Ищет запись пары с заданным ключом.
+// Если запись не найдена, возвращает NULL.
+// Если встречена запись за пределами файла, возвращает NULL и помещает 1 в _corrupt.
+static const c_hash_map_snapshot_record *snapshot_find(const c_hash_map_snapshot *const _snapshot,
+                                                       const void *const _key,
+                                                       size_t *const _corrupt)
+{
+    if (_snapshot->pairs_count == 0)
+    {
+        return NULL;
+    }
+
+    const uint64_t hash = (uint64_t)_snapshot->hash_key(_key);
+
+    // Минимальное совершенное хэширование: ровно один слот на ключ.
+    if (_snapshot->index_kind == C_HASH_MAP_SNAPSHOT_INDEX_MPH)
+    {
+        const uint64_t key = mph_key(hash, _snapshot->mph_seed);
+        const uint16_t pilot = _snapshot->mph_pilots[mph_bucket(key, _snapshot->mph_buckets)];
+
+        size_t p = mph_position(key, pilot, _snapshot->mph_slots);
+        if (p >= _snapshot->pairs_count)
+        {
+            const uint64_t slot = _snapshot->mph_remap[p - _snapshot->pairs_count];
+            if (slot >= _snapshot->pairs_count)
+            {
+                *_corrupt = 1;
+                return NULL;
+            }
+            p = (size_t)slot;
+        }
+
+        return record_match(_snapshot, _key, _snapshot->mph_offsets[p], _corrupt);
+    }
+
+    size_t s = (size_t)c_hash_map_mix((size_t)hash) & _snapshot->index_mask;
+    for (size_t probes = 0; probes <= _snapshot->index_mask; ++probes)
+    {
+        const c_hash_map_snapshot_slot *const slot = &_snapshot->index[s];
+        if (slot->offset == 0)
+        {
+            return NULL;
+        }
+
+        if (slot->hash == hash)
+        {
+            const c_hash_map_snapshot_record *const record = record_match(_snapshot, _key, slot->offset, _corrupt);
+            if ( (record != NULL) || (*_corrupt != 0) )
+            {
+                return record;
+            }
+        }
+
+        s = (s + 1) & _snapshot->index_mask;
+    }
+
+    // Пустых слотов нет, в корректном файле так не бывает.
+    *_corrupt = 1;
+
+    return NULL;
+}
+
+// Проверяет заголовок файла размером _size.
+// Если заголовок корректен, возвращает 0, иначе код ошибки c_hash_map_open_mmap.
+static size_t header_check(const c_hash_map_snapshot_header *const _header,
+                           const size_t _size)
+{
+    if ( (memcmp(_header->magic, snapshot_magic, sizeof(snapshot_magic)) != 0) ||
+         (_header->byte_order != C_HASH_MAP_SNAPSHOT_ORDER) )
+    {
+        return 4;
+    }
+    if (_header->version != (uint32_t)C_HASH_MAP_SNAPSHOT_VERSION)
+    {
+        return 5;
+    }
+    if (_header->header_checksum != c_hash_map_hash_bytes(_header, offsetof(c_hash_map_snapshot_header, header_checksum),
+                                                          C_HASH_MAP_SNAPSHOT_SEED))
+    {
+        return 6;
+    }
+
+    // Области индекса и пар должны лежать в файле по порядку.
+    const uint64_t size = _size;
+    if ( (_header->file_size != size) ||
+         (_header->index_offset != C_HASH_MAP_SNAPSHOT_PAGE) ||
+         (_header->pairs_offset > size) ||
+         (_header->pairs_count > size / sizeof(c_hash_map_snapshot_record)) )
+    {
+        return 6;
+    }
+
+    if (_header->index_kind == C_HASH_MAP_SNAPSHOT_INDEX_OPEN)
+    {
+        if ( (_header->index_slots == 0) || ( (_header->index_slots & (_header->index_slots - 1)) != 0 ) ||
+             (_header->index_slots > size / sizeof(c_hash_map_snapshot_slot)) ||
+             (_header->pairs_offset < _header->index_offset + _header->index_slots * sizeof(c_hash_map_snapshot_slot)) ||
+             (_header->pairs_count >= _header->index_slots) )
+        {
+            return 6;
+        }
+    } else if (_header->index_kind == C_HASH_MAP_SNAPSHOT_INDEX_MPH) {
+        if ( (_header->index_slots < _header->pairs_count) ||
+             (_header->index_slots - _header->pairs_count > size / sizeof(uint64_t)) ||
+             (_header->mph_buckets > size / sizeof(uint16_t)) ||
+             ( (_header->pairs_count > 0) && (_header->mph_buckets == 0) ) ||
+             ( ((_header->pilots_offset | _header->remap_offset) & 7) != 0 ) ||
+             (_header->pilots_offset < _header->index_offset + _header->pairs_count * sizeof(uint64_t)) ||
+             (_header->remap_offset < _header->pilots_offset + _header->mph_buckets * sizeof(uint16_t)) ||
+             (_header->pairs_offset < _header->remap_offset + (_header->index_slots - _header->pairs_count) * sizeof(uint64_t)) )
+        {
+            return 6;
+        }
+    } else {
+        return 6;
+    }
+
+    return 0;
+}
+
+// Заполняет снимок по образу файла с проверенным заголовком.
+static void snapshot_setup(c_hash_map_snapshot *const _snapshot,
+                           const uint8_t *const _base,
+                           const size_t _size,
+                           const c_hash_map_snapshot_header *const _header)
+{
+    _snapshot->base = _base;
+    _snapshot->size = _size;
+    _snapshot->index_kind = (size_t)_header->index_kind;
+    _snapshot->pairs_count = (size_t)_header->pairs_count;
+    _snapshot->pairs_offset = (size_t)_header->pairs_offset;
+    _snapshot->first_hash = _header->first_hash;
+
+    _snapshot->index = (const c_hash_map_snapshot_slot*)(_base + _header->index_offset);
+    _snapshot->index_mask = (size_t)_header->index_slots - 1;
+
+    _snapshot->mph_offsets = (const uint64_t*)(_base + _header->index_offset);
+    _snapshot->mph_pilots = (const uint16_t*)(_base + _header->pilots_offset);
+    _snapshot->mph_remap = (const uint64_t*)(_base + _header->remap_offset);
+    _snapshot->mph_seed = _header->mph_seed;
+    _snapshot->mph_buckets = (size_t)_header->mph_buckets;
+    _snapshot->mph_slots = (size_t)_header->index_slots;
+}
+
+// Проверяет, что hash_key дает для первой пары снимка сохраненный хэш и что пара находится поиском:
+// так обнаруживается hash_key, отличающаяся от использованной при сохранении.
+// Если проверка пройдена, возвращает 0, иначе код ошибки c_hash_map_open_mmap.
+static size_t snapshot_probe(const c_hash_map_snapshot *const _snapshot)
+{
+    if (_snapshot->pairs_count == 0)
+    {
+        return 0;
+    }
+
+    if (record_valid(_snapshot, _snapshot->pairs_offset) == 0)
+    {
+        return 6;
+    }
+
+    size_t corrupt = 0;
+    const c_hash_map_snapshot_record *const first = (const c_hash_map_snapshot_record*)(_snapshot->base + _snapshot->pairs_offset);
+    if ((uint64_t)_snapshot->hash_key(record_key(first)) != _snapshot->first_hash)
+    {
+        return 8;
+    }
+    if (snapshot_find(_snapshot, record_key(first), &corrupt) != first)
+    {
+        return (corrupt != 0) ? 6 : 8;
+    }
+
+    return 0;
+}
+
+// Отображает в память файл снимка, сохраненный c_hash_map_save или c_hash_map_snapshot_save.
+// hash_key должна совпадать с использованной хэш-отображением при сохранении.
+// Если _comp_key == NULL, ключи сравниваются побайтно по размеру сохраненного ключа.
+// _flags - C_HASH_MAP_SNAPSHOT_*.
+// В случае ошибки возвращает NULL, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+c_hash_map_snapshot *c_hash_map_open_mmap(const char *const _path,
+                                          size_t (*const _hash_key)(const void *const _key),
+                                          size_t (*const _comp_key)(const void *const _key_a,
+                                                                    const void *const _key_b),
+                                          const size_t _flags,
+                                          size_t *const _error)
+{
+    if (_path == NULL)
+    {
+        error_set(_error, 1);
+        return NULL;
+    }
+    if (_hash_key == NULL)
+    {
+        error_set(_error, 2);
+        return NULL;
+    }
+
+    const int fd = open(_path, O_RDONLY);
+    if (fd < 0)
+    {
+        error_set(_error, 3);
+        return NULL;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0)
+    {
+        close(fd);
+        error_set(_error, 3);
+        return NULL;
+    }
+    if ( (file_stat.st_size < (off_t)C_HASH_MAP_SNAPSHOT_PAGE) ||
+         ((uint64_t)file_stat.st_size > (uint64_t)SIZE_MAX) )
+    {
+        close(fd);
+        error_set(_error, 4);
+        return NULL;
+    }
+    const size_t size = (size_t)file_stat.st_size;
+
+    // Отображение остается действительным и после закрытия файла.
+    void *const mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        error_set(_error, 3);
+        return NULL;
+    }
+    const uint8_t *const base = mapping;
+
+    c_hash_map_snapshot_header header;
+    memcpy(&header, base, sizeof(c_hash_map_snapshot_header));
+
+    size_t error = header_check(&header, size);
+
+    if ( (error == 0) && ( (_flags & C_HASH_MAP_SNAPSHOT_VERIFY) != 0 ) &&
+         (image_checksum(base, size) != header.body_checksum) )
+    {
+        error = 7;
+    }
+
+    c_hash_map_snapshot *new_snapshot = NULL;
+    if (error == 0)
+    {
+        new_snapshot = malloc(sizeof(c_hash_map_snapshot));
+        if (new_snapshot == NULL)
+        {
+            error = 9;
+        }
+    }
+
+    if (error == 0)
+    {
+        new_snapshot->hash_key = _hash_key;
+        new_snapshot->comp_key = _comp_key;
+        new_snapshot->in_memory = 0;
+        snapshot_setup(new_snapshot, base, size, &header);
+
+        error = snapshot_probe(new_snapshot);
+    }
+
+    if (error != 0)
+    {
+        free(new_snapshot);
+        munmap(mapping, size);
+        error_set(_error, error);
+        return NULL;
+    }
+
+    return new_snapshot;
+}
+
+// Замораживает хэш-отображение: строит неизменяемый снимок в памяти с индексом на основе
+// минимального совершенного хэширования (на каждую пару - 8 байт смещения и около 2 байт
+// служебных данных, поиск проверяет ровно одну запись).
+// Если хэши пар совпадают и минимальное совершенное хэширование построить нельзя, используется
+// индекс с открытой адресацией, как у c_hash_map_save.
+// Ключи и данные копируются в снимок сериализаторами, хэш-отображение не меняется и может
+// быть удалено. hash_key и comp_key используются для поиска в снимке, как в c_hash_map_open_mmap;
+// hash_key должна совпадать с hash_key хэш-отображения.
+// Снимок доступен функциям c_hash_map_snapshot_* и сохраняется в файл c_hash_map_snapshot_save.
+// В случае ошибки возвращает NULL, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+c_hash_map_snapshot *c_hash_map_freeze(c_hash_map *const _hash_map,
+                                       size_t (*const _hash_key)(const void *const _key),
+                                       size_t (*const _comp_key)(const void *const _key_a,
+                                                                 const void *const _key_b),
+                                       const c_hash_map_serializer _key_serializer,
+                                       const c_hash_map_serializer _data_serializer,
+                                       size_t *const _error)
+{
+    if (_hash_map == NULL)
+    {
+        error_set(_error, 1);
+        return NULL;
+    }
+    if (_hash_key == NULL)
+    {
+        error_set(_error, 2);
+        return NULL;
+    }
+    if ( (_key_serializer == NULL) || (_data_serializer == NULL) )
+    {
+        error_set(_error, 10);
+        return NULL;
+    }
+
+    const size_t pairs_count = c_hash_map_pairs_count(_hash_map, NULL);
+    if (pairs_count > SIZE_MAX / 2 / sizeof(uint64_t))
+    {
+        error_set(_error, 11);
+        return NULL;
+    }
+
+    // Хэши пар и смещения записей от начала области пар.
+    uint64_t *const hashes = malloc(pairs_count * sizeof(uint64_t) + 1);
+    uint64_t *const offsets = malloc(pairs_count * sizeof(uint64_t) + 1);
+    if ( (hashes == NULL) || (offsets == NULL) )
+    {
+        free(hashes);
+        free(offsets);
+        error_set(_error, 9);
+        return NULL;
+    }
+
+    // Первый проход: размеры записей.
+    size_t error = 0;
+    size_t n = 0;
+    uint64_t records_size = 0;
+    c_hash_map_iter iter;
+    for (ptrdiff_t r = c_hash_map_iter_begin(_hash_map, &iter); (r > 0) && (error == 0); r = c_hash_map_iter_next(&iter))
+    {
+        const void *bytes;
+        const uint64_t key_size = _key_serializer(c_hash_map_iter_key(&iter), &bytes);
+        const uint64_t data_size = _data_serializer(c_hash_map_iter_data(&iter), &bytes);
+        if (key_size == 0)
+        {
+            error = 12;
+        } else if ( (key_size > UINT64_MAX / 4) || (data_size > UINT64_MAX / 4) || (records_size > UINT64_MAX / 2) ) {
+            error = 11;
+        } else {
+            hashes[n] = (uint64_t)c_hash_map_iter_hash(&iter);
+            offsets[n] = records_size;
+            records_size += sizeof(c_hash_map_snapshot_record) + align8(key_size) + align8(data_size);
+            ++n;
+        }
+    }
+
+    // Строим индекс и размечаем образ файла.
+    c_hash_map_mph mph;
+    memset(&mph, 0, sizeof(c_hash_map_mph));
+    c_hash_map_snapshot_header header;
+    memset(&header, 0, sizeof(c_hash_map_snapshot_header));
+    header.pairs_count = pairs_count;
+    header.index_offset = C_HASH_MAP_SNAPSHOT_PAGE;
+    header.first_hash = (n > 0) ? hashes[0] : 0;
+
+    if (error == 0)
+    {
+        const ptrdiff_t built = mph_build(hashes, pairs_count, &mph);
+        if (built < 0)
+        {
+            error = 9;
+        } else if (built > 0) {
+            header.index_kind = C_HASH_MAP_SNAPSHOT_INDEX_MPH;
+            header.index_slots = mph.slots;
+            header.mph_seed = mph.seed;
+            header.mph_buckets = mph.buckets;
+            header.pilots_offset = align8(header.index_offset + (uint64_t)pairs_count * sizeof(uint64_t));
+            header.remap_offset = align8(header.pilots_offset + (uint64_t)mph.buckets * sizeof(uint16_t));
+            header.pairs_offset = align_page(header.remap_offset + (uint64_t)(mph.slots - pairs_count) * sizeof(uint64_t));
+        } else {
+            header.index_kind = C_HASH_MAP_SNAPSHOT_INDEX_OPEN;
+            header.index_slots = open_slots(pairs_count);
+            header.pairs_offset = align_page(header.index_offset + header.index_slots * sizeof(c_hash_map_snapshot_slot));
+        }
+    }
+
+    if ( (error == 0) && (records_size > (uint64_t)SIZE_MAX - header.pairs_offset) )
+    {
+        error = 11;
+    }
+
+    uint8_t *image = NULL;
+    if (error == 0)
+    {
+        header.file_size = header.pairs_offset + records_size;
+        image = calloc(1, (size_t)header.file_size);
+        if (image == NULL)
+        {
+            error = 9;
+        }
+    }
+
+    if (error == 0)
+    {
+        if (header.index_kind == C_HASH_MAP_SNAPSHOT_INDEX_MPH)
+        {
+            uint64_t *const slots = (uint64_t*)(image + header.index_offset);
+            for (size_t i = 0; i < pairs_count; ++i)
+            {
+                slots[mph.slot_of[i]] = header.pairs_offset + offsets[i];
+            }
+            memcpy(image + header.pilots_offset, mph.pilots, mph.buckets * sizeof(uint16_t));
+            memcpy(image + header.remap_offset, mph.remap, (mph.slots - pairs_count) * sizeof(uint64_t));
+        } else {
+            c_hash_map_snapshot_slot *const index = (c_hash_map_snapshot_slot*)(image + header.index_offset);
+            for (size_t i = 0; i < pairs_count; ++i)
+            {
+                open_insert(index, (size_t)header.index_slots, hashes[i], header.pairs_offset + offsets[i]);
+            }
+        }
+
+        // Второй проход: записи пар в том же порядке.
+        // Сериализаторы должны возвращать при повторном вызове то же представление.
+        n = 0;
+        for (ptrdiff_t r = c_hash_map_iter_begin(_hash_map, &iter); (r > 0) && (error == 0); r = c_hash_map_iter_next(&iter))
+        {
+            const void *key;
+            const void *data;
+            c_hash_map_snapshot_record record;
+            record.key_size = _key_serializer(c_hash_map_iter_key(&iter), &key);
+            record.data_size = _data_serializer(c_hash_map_iter_data(&iter), &data);
+
+            const uint64_t end = (n + 1 < pairs_count) ? offsets[n + 1] : records_size;
+            if ( (n >= pairs_count) ||
+                 (sizeof(c_hash_map_snapshot_record) + align8(record.key_size) + align8(record.data_size) != end - offsets[n]) )
+            {
+                error = 12;
+                break;
+            }
+
+            uint8_t *const place = image + header.pairs_offset + offsets[n];
+            memcpy(place, &record, sizeof(c_hash_map_snapshot_record));
+            memcpy(place + sizeof(c_hash_map_snapshot_record), key, (size_t)record.key_size);
+            if (record.data_size > 0)
+            {
+                memcpy(place + sizeof(c_hash_map_snapshot_record) + align8(record.key_size), data, (size_t)record.data_size);
+            }
+
+            ++n;
+        }
+    }
+
+    mph_free(&mph);
+    free(hashes);
+    free(offsets);
+
+    c_hash_map_snapshot *new_snapshot = NULL;
+    if (error == 0)
+    {
+        header.body_checksum = image_checksum(image, (size_t)header.file_size);
+        header_seal(&header);
+        memcpy(image, &header, sizeof(c_hash_map_snapshot_header));
+
+        new_snapshot = malloc(sizeof(c_hash_map_snapshot));
+        if (new_snapshot == NULL)
+        {
+            error = 9;
+        }
+    }
+
+    if (error == 0)
+    {
+        new_snapshot->hash_key = _hash_key;
+        new_snapshot->comp_key = _comp_key;
+        new_snapshot->in_memory = 1;
+        snapshot_setup(new_snapshot, image, (size_t)header.file_size, &header);
+
+        error = snapshot_probe(new_snapshot);
+    }
+
+    if (error != 0)
+    {
+        free(new_snapshot);
+        free(image);
+        error_set(_error, error);
+        return NULL;
+    }
+
+    return new_snapshot;
+}
+
+// Сохраняет снимок (в том числе замороженное хэш-отображение) в файл для c_hash_map_open_mmap.
+// Файл записывается рядом (с суффиксом .tmp) и затем переименовывается.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_snapshot_save(const c_hash_map_snapshot *const _snapshot,
+                                   const char *const _path)
+{
+    if (_snapshot == NULL) return -1;
+    if (_path == NULL) return -2;
+
+    char *const temp_path = temp_path_make(_path);
+    if (temp_path == NULL)
+    {
+        return -5;
+    }
+
+    FILE *const file = fopen(temp_path, "wb");
+    if (file == NULL)
+    {
+        free(temp_path);
+        return -6;
+    }
+
+    // Образ файла записывается как есть: в нем только смещения.
+    ptrdiff_t result = 1;
+    if (fwrite(_snapshot->base, 1, _snapshot->size, file) != _snapshot->size)
+    {
+        result = -6;
+    }
+
+    return file_commit(file, temp_path, _path, result);
+}
+
+// Закрывает снимок: снимает отображение файла (или освобождает образ замороженного
+// хэш-отображения) и освобождает память.
+// Указатели на ключи и данные снимка после этого недействительны.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_map_snapshot_close(c_hash_map_snapshot *const _snapshot)
+{
+    if (_snapshot == NULL) return -1;
+
+    if (_snapshot->in_memory != 0)
+    {
+        free((void*)_snapshot->base);
+    } else {
+        munmap((void*)_snapshot->base, _snapshot->size);
+    }
+    free(_snapshot);
+
+    return 1;
+}
+
+// Проверка существования в снимке пары с заданным ключом.
+// Если пара существует, возвращает > 0.
+// Если пары нет, возвращает 0.
+// В случае ошибки (в том числе поврежденной записи) возвращает < 0.
+ptrdiff_t c_hash_map_snapshot_check(const c_hash_map_snapshot *const _snapshot,
+                                    const void *const _key)
+{
+    if (_snapshot == NULL) return -1;
+    if (_key == NULL) return -2;
+
+    size_t corrupt = 0;
+    const c_hash_map_snapshot_record *const record = snapshot_find(_snapshot, _key, &corrupt);
+    if (corrupt != 0)
+    {
+        return -3;
+    }
+
+    return (record != NULL) ? 1 : 0;
+}
+
+// Обращение к данным с заданным ключом.
+// В случае успеха возвращает указатель на данные в отображенном файле (только для чтения).
+// Если данных нет, функция возвращает NULL, это не считается ошибкой.
+// В случае ошибки функция возвращает NULL, и если _error != NULL, то в заданное расположение помещается
+// код причины ошибки (> 0).
+// Так как функция может возвращать NULL и в случае успеха, и в случае ошибки, для детектирования ошибки
+// перед вызовом функции необходимо поместить 0 в заданное расположение ошибки.
+const void *c_hash_map_snapshot_at(const c_hash_map_snapshot *const _snapshot,
+                                   const void *const _key,
+                                   size_t *const _error)
+{
+    if (_snapshot == NULL)
+    {
+        error_set(_error, 1);
+        return NULL;
+    }
+    if (_key == NULL)
+    {
+        error_set(_error, 2);
+        return NULL;
+    }
+
+    size_t corrupt = 0;
+    const c_hash_map_snapshot_record *const record = snapshot_find(_snapshot, _key, &corrupt);
+    if (corrupt != 0)
+    {
+        error_set(_error, 3);
+        return NULL;
+    }
+    if (record == NULL)
+    {
+        return NULL;
+    }
+
+    return record_data(record);
+}
+
+// Обход пар снимка в порядке записей файла (последовательное чтение).
+// _action получает ключ, данные и _context; если она возвращает > 0, обход прекращается.
+// Если обход пройден целиком, возвращает 1.
+// Если обход прекращен функцией _action, возвращает 2.
+// Если пар нет, возвращает 0.
+// В случае ошибки (в том числе поврежденной записи) возвращает < 0.
+ptrdiff_t c_hash_map_snapshot_for_each(const c_hash_map_snapshot *const _snapshot,
+                                       size_t (*const _action)(const void *const _key,
+                                                               const void *const _data,
+                                                               void *const _context),
+                                       void *const _context)
+{
+    if (_snapshot == NULL) return -1;
+    if (_action == NULL) return -2;
+
+    if (_snapshot->pairs_count == 0) return 0;
+
+    uint64_t offset = _snapshot->pairs_offset;
+    for (size_t i = 0; i < _snapshot->pairs_count; ++i)
+    {
+        if (record_valid(_snapshot, offset) == 0)
+        {
+            return -3;
+        }
+
+        const c_hash_map_snapshot_record *const record = (const c_hash_map_snapshot_record*)(_snapshot->base + offset);
+        if (_action(record_key(record), record_data(record), _context) > 0)
+        {
+            return 2;
+        }
+
+        offset += sizeof(c_hash_map_snapshot_record) + align8(record->key_size) + align8(record->data_size);
+    }
+
+    return 1;
+}
+
+// Возвращает количество пар в снимке.
+// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение
+// помещается код причины ошибки (> 0).
+// Так как функция может возвращать 0 и в случае успеха, и в случае ошибки, для детектирования
+// ошибки перед вызовом функции необходимо поместить 0 в заданное расположение ошибки.
+size_t c_hash_map_snapshot_pairs_count(const c_hash_map_snapshot *const _snapshot,
+                                       size_t *const _error)
+{
+    if (_snapshot == NULL)
+    {
+        error_set(_error, 1);
+        return 0;
+    }
+
+    return _snapshot->pairs_count;
+}
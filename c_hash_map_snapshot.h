@@ -0,0 +1,86 @@
+﻿/*
+    Заголовочный файл снимков хэш-отображения c_hash_map_snapshot
+    c_hash_map_save записывает пары хэш-отображения в файл, который c_hash_map_open_mmap
+    отображает в память только для чтения: поиск выполняется прямо по отображенному файлу,
+    без разбора и копирования, страницы файла разделяются процессами.
+    c_hash_map_freeze строит такой же снимок в памяти с индексом на основе минимального
+    совершенного хэширования (неизменяемое хэш-отображение), c_hash_map_snapshot_save
+    записывает его в файл.
+    Файл не содержит указателей (только смещения от начала файла), индекс и пары выровнены
+    по страницам. Заголовок содержит версию формата и контрольные суммы.
+    Отображение файла выполняется средствами POSIX (mmap).
+    Лицензия: GPLv3
+*/
+
+#ifndef C_HASH_MAP_SNAPSHOT_H
+#define C_HASH_MAP_SNAPSHOT_H
+
+#include <stddef.h>
+
+#include "c_hash_map.h"
+
+// Версия формата файла снимка. Файлы других версий не открываются.
+#define C_HASH_MAP_SNAPSHOT_VERSION ( (size_t) 2 )
+
+// Флаги c_hash_map_open_mmap.
+// Проверить контрольную сумму всего файла (файл читается целиком), иначе проверяется только заголовок.
+#define C_HASH_MAP_SNAPSHOT_VERIFY ( (size_t) 1 )
+
+typedef struct s_c_hash_map_snapshot c_hash_map_snapshot;
+
+// Сериализатор ключа или данных для c_hash_map_save.
+// Помещает в _bytes расположение байтового представления объекта и возвращает его размер.
+// Представление ключа в файле передается в comp_key и hash_key как ключ, поэтому должно
+// быть пригодно для них (например, строка вместе с завершающим нулем).
+// Данные нулевого размера c_hash_map_snapshot_at возвращает как NULL.
+typedef size_t (*c_hash_map_serializer)(const void *const _object,
+                                        const void **const _bytes);
+
+size_t c_hash_map_serialize_str(const void *const _object,
+                                const void **const _bytes);
+
+size_t c_hash_map_serialize_u64(const void *const _object,
+                                const void **const _bytes);
+
+ptrdiff_t c_hash_map_save(c_hash_map *const _hash_map,
+                          const char *const _path,
+                          const c_hash_map_serializer _key_serializer,
+                          const c_hash_map_serializer _data_serializer);
+
+c_hash_map_snapshot *c_hash_map_open_mmap(const char *const _path,
+                                          size_t (*const _hash_key)(const void *const _key),
+                                          size_t (*const _comp_key)(const void *const _key_a,
+                                                                    const void *const _key_b),
+                                          const size_t _flags,
+                                          size_t *const _error);
+
+c_hash_map_snapshot *c_hash_map_freeze(c_hash_map *const _hash_map,
+                                       size_t (*const _hash_key)(const void *const _key),
+                                       size_t (*const _comp_key)(const void *const _key_a,
+                                                                 const void *const _key_b),
+                                       const c_hash_map_serializer _key_serializer,
+                                       const c_hash_map_serializer _data_serializer,
+                                       size_t *const _error);
+
+ptrdiff_t c_hash_map_snapshot_save(const c_hash_map_snapshot *const _snapshot,
+                                   const char *const _path);
+
+ptrdiff_t c_hash_map_snapshot_close(c_hash_map_snapshot *const _snapshot);
+
+ptrdiff_t c_hash_map_snapshot_check(const c_hash_map_snapshot *const _snapshot,
+                                    const void *const _key);
+
+const void *c_hash_map_snapshot_at(const c_hash_map_snapshot *const _snapshot,
+                                   const void *const _key,
+                                   size_t *const _error);
+
+ptrdiff_t c_hash_map_snapshot_for_each(const c_hash_map_snapshot *const _snapshot,
+                                       size_t (*const _action)(const void *const _key,
+                                                               const void *const _data,
+                                                               void *const _context),
+                                       void *const _context);
+
+size_t c_hash_map_snapshot_pairs_count(const c_hash_map_snapshot *const _snapshot,
+                                       size_t *const _error);
+
+#endif
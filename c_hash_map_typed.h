@@ -0,0 +1,444 @@
+﻿/*
+    Типизированные хэш-отображения (макрошаблоны)
+    C_HASH_MAP_DECLARE порождает хэш-отображение с ключами и данными заданных типов, хранящимися
+    в слотах по значению. Используется движок SWISS: пробирование, правила расширения и освобождения
+    слотов общие с c_hash_map.c (c_hash_map_group.h), функции хэширования и сравнения ключей
+    вызываются напрямую и встраиваются компилятором.
+    Лицензия: GPLv3
+*/
+
+#ifndef C_HASH_MAP_TYPED_H
+#define C_HASH_MAP_TYPED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c_hash_map_group.h"
+
+// Количество слотов, задаваемое типизированному хэш-отображению с нулем слотов при вставке.
+#define C_HASH_MAP_TYPED_0 ( (size_t) 1024 )
+
+// Максимально допустимое значение max_load_factor типизированного хэш-отображения.
+#define C_HASH_MAP_TYPED_MLF_MAX ( (float) 0.875f )
+
+// Порождает типизированное хэш-отображение _name с ключами типа _key_t и данными типа _value_t.
+// size_t _hash_fn(const _key_t _key) - хэш ключа;
+// int _eq_fn(const _key_t _key_a, const _key_t _key_b) - != 0, если ключи идентичны.
+// Порождаемые функции (коды возврата аналогичны одноименным функциям c_hash_map):
+// _name *_name_create(size_t slots_count, float max_load_factor, size_t *error);
+// ptrdiff_t _name_delete(_name *map);
+// ptrdiff_t _name_insert(_name *map, _key_t key, _value_t data);
+// ptrdiff_t _name_insert_or_assign(_name *map, _key_t key, _value_t data);
+// _value_t *_name_find_or_insert(_name *map, _key_t key, size_t *inserted) - NULL в случае ошибки;
+// ptrdiff_t _name_erase(_name *map, _key_t key);
+// ptrdiff_t _name_resize(_name *map, size_t slots_count);
+// ptrdiff_t _name_check(const _name *map, _key_t key);
+// _value_t *_name_at(const _name *map, _key_t key) - NULL, если ключа нет;
+// ptrdiff_t _name_for_each(_name *map, void (*action)(const _key_t *key, _value_t *data, void *context),
+//                          void *context);
+// ptrdiff_t _name_clear(_name *map);
+// size_t _name_slots_count(const _name *map);
+// size_t _name_pairs_count(const _name *map).
+// Указатели на данные действительны до следующей вставки, удаления или перестроения.
+#define C_HASH_MAP_DECLARE(_name, _key_t, _value_t, _hash_fn, _eq_fn) \
+\
+/* Типы с собственными именами, чтобы const относился к самим ключу и данным. */ \
+typedef _key_t _name##_key; \
+typedef _value_t _name##_value; \
+\
+typedef struct s_##_name##_entry \
+{ \
+    _name##_key key; \
+    _name##_value data; \
+} _name##_entry; \
+\
+typedef struct s_##_name \
+{ \
+    /* Управляющие байты (начало единого блока памяти, за ними следуют entries). */ \
+    uint8_t *ctrl; \
+    _name##_entry *entries; \
+    size_t slots_count, \
+           pairs_count, \
+           deleted_count; \
+    float max_load_factor; \
+} _name; \
+\
+/* Выделяет блок под управляющие байты и слоты, все слоты пустые. */ \
+static inline uint8_t *_name##_alloc_(const size_t _capacity) \
+{ \
+    const size_t entries_size = _capacity * sizeof(_name##_entry); \
+    if ( (entries_size / _capacity != sizeof(_name##_entry)) || \
+         (entries_size + _capacity < entries_size) ) \
+    { \
+        return NULL; \
+    } \
+    uint8_t *const new_ctrl = malloc(_capacity + entries_size); \
+    if (new_ctrl != NULL) \
+    { \
+        memset(new_ctrl, C_HASH_MAP_CTRL_EMPTY, _capacity); \
+    } \
+    return new_ctrl; \
+} \
+\
+/* Перестраивает слоты под заданное количество слотов (степень двойки). */ \
+static inline ptrdiff_t _name##_rehash_(_name *const _hash_map, \
+                                        const size_t _capacity) \
+{ \
+    uint8_t *const new_ctrl = _name##_alloc_(_capacity); \
+    if (new_ctrl == NULL) \
+    { \
+        return -1; \
+    } \
+    _name##_entry *const new_entries = (_name##_entry*)(new_ctrl + _capacity); \
+\
+    size_t count = _hash_map->pairs_count; \
+    for (size_t s = 0; (s < _hash_map->slots_count)&&(count > 0); ++s) \
+    { \
+        if ( (_hash_map->ctrl[s] & 0x80) == 0 ) \
+        { \
+            const uint64_t mixed = c_hash_map_mix(_hash_fn(_hash_map->entries[s].key)); \
+            const size_t new_s = c_hash_map_group_find_free(new_ctrl, _capacity, mixed); \
+            new_ctrl[new_s] = c_hash_map_h2(mixed); \
+            new_entries[new_s] = _hash_map->entries[s]; \
+            --count; \
+        } \
+    } \
+\
+    free(_hash_map->ctrl); \
+\
+    _hash_map->ctrl = new_ctrl; \
+    _hash_map->entries = new_entries; \
+    _hash_map->slots_count = _capacity; \
+    _hash_map->deleted_count = 0; \
+\
+    return 1; \
+} \
+\
+/* Искомый ключ пробирования (см. _name##_eq_). */ \
+typedef struct s_##_name##_probe_ \
+{ \
+    const _name *hash_map; \
+    const _name##_key *key; \
+} _name##_probe_; \
+\
+/* Проверка слота-кандидата для c_hash_map_group_find. */ \
+static inline size_t _name##_eq_(const void *const _context, \
+                                 const size_t _s) \
+{ \
+    const _name##_probe_ *const probe = (const _name##_probe_*)_context; \
+    return _eq_fn(*probe->key, probe->hash_map->entries[_s].key) ? 1 : 0; \
+} \
+\
+/* Ищет слот ключа (SIZE_MAX, если его нет); в _free_slot (если != NULL) помещается */ \
+/* первый свободный слот на пути поиска. */ \
+static inline size_t _name##_find_(const _name *const _hash_map, \
+                                   const _name##_key _key, \
+                                   const uint64_t _mixed, \
+                                   size_t *const _free_slot) \
+{ \
+    const _name##_probe_ probe = {_hash_map, &_key}; \
+    return c_hash_map_group_find(_hash_map->ctrl, _hash_map->slots_count, _mixed, \
+                                 _name##_eq_, &probe, _free_slot, NULL); \
+} \
+\
+/* Поиск ключа с вставкой при его отсутствии: > 0 - вставлен, 0 - уже был, < 0 - ошибка. */ \
+static inline ptrdiff_t _name##_emplace_(_name *const _hash_map, \
+                                         const _name##_key _key, \
+                                         size_t *const _slot) \
+{ \
+    const uint64_t mixed = c_hash_map_mix(_hash_fn(_key)); \
+\
+    size_t free_slot; \
+    const size_t s = _name##_find_(_hash_map, _key, mixed, &free_slot); \
+    if (s != SIZE_MAX) \
+    { \
+        *_slot = s; \
+        return 0; \
+    } \
+\
+    size_t new_capacity = 0; \
+    if (_hash_map->slots_count == 0) \
+    { \
+        new_capacity = c_hash_map_group_capacity(C_HASH_MAP_TYPED_0); \
+    } else if (c_hash_map_group_overloaded(_hash_map->slots_count, _hash_map->pairs_count, \
+                                           _hash_map->deleted_count, _hash_map->max_load_factor) != 0) \
+    { \
+        new_capacity = _hash_map->slots_count; \
+        if (c_hash_map_group_grow(_hash_map->slots_count, _hash_map->pairs_count, _hash_map->max_load_factor) != 0) \
+        { \
+            if (new_capacity > SIZE_MAX / 2) \
+            { \
+                return -5; \
+            } \
+            new_capacity *= 2; \
+        } \
+    } \
+    if (new_capacity > 0) \
+    { \
+        if (_name##_rehash_(_hash_map, new_capacity) < 0) \
+        { \
+            return -5; \
+        } \
+        free_slot = c_hash_map_group_find_free(_hash_map->ctrl, _hash_map->slots_count, mixed); \
+    } else if (free_slot == SIZE_MAX) \
+    { \
+        free_slot = c_hash_map_group_find_free(_hash_map->ctrl, _hash_map->slots_count, mixed); \
+    } \
+\
+    _hash_map->deleted_count -= c_hash_map_group_occupy(_hash_map->ctrl, free_slot, mixed); \
+    _hash_map->entries[free_slot].key = _key; \
+    ++_hash_map->pairs_count; \
+\
+    *_slot = free_slot; \
+    return 1; \
+} \
+\
+static inline _name *_name##_create(const size_t _slots_count, \
+                                    const float _max_load_factor, \
+                                    size_t *const _error) \
+{ \
+    if ( !(_max_load_factor >= 0.01f) || (_max_load_factor > C_HASH_MAP_TYPED_MLF_MAX) ) \
+    { \
+        if (_error != NULL) *_error = 3; \
+        return NULL; \
+    } \
+\
+    _name *const new_hash_map = malloc(sizeof(_name)); \
+    if (new_hash_map == NULL) \
+    { \
+        if (_error != NULL) *_error = 6; \
+        return NULL; \
+    } \
+\
+    new_hash_map->ctrl = NULL; \
+    new_hash_map->entries = NULL; \
+    new_hash_map->slots_count = 0; \
+    new_hash_map->pairs_count = 0; \
+    new_hash_map->deleted_count = 0; \
+    new_hash_map->max_load_factor = _max_load_factor; \
+\
+    if (_slots_count > 0) \
+    { \
+        const size_t capacity = c_hash_map_group_capacity(_slots_count); \
+        if (capacity == 0) \
+        { \
+            free(new_hash_map); \
+            if (_error != NULL) *_error = 4; \
+            return NULL; \
+        } \
+        if (_name##_rehash_(new_hash_map, capacity) < 0) \
+        { \
+            free(new_hash_map); \
+            if (_error != NULL) *_error = 5; \
+            return NULL; \
+        } \
+    } \
+\
+    return new_hash_map; \
+} \
+\
+static inline ptrdiff_t _name##_delete(_name *const _hash_map) \
+{ \
+    if (_hash_map == NULL) return -1; \
+\
+    free(_hash_map->ctrl); \
+    free(_hash_map); \
+\
+    return 1; \
+} \
+\
+static inline ptrdiff_t _name##_insert(_name *const _hash_map, \
+                                       const _name##_key _key, \
+                                       const _name##_value _data) \
+{ \
+    if (_hash_map == NULL) return -1; \
+\
+    size_t s; \
+    const ptrdiff_t r_code = _name##_emplace_(_hash_map, _key, &s); \
+    if (r_code > 0) \
+    { \
+        _hash_map->entries[s].data = _data; \
+    } \
+    return r_code; \
+} \
+\
+static inline ptrdiff_t _name##_insert_or_assign(_name *const _hash_map, \
+                                                 const _name##_key _key, \
+                                                 const _name##_value _data) \
+{ \
+    if (_hash_map == NULL) return -1; \
+\
+    size_t s; \
+    const ptrdiff_t r_code = _name##_emplace_(_hash_map, _key, &s); \
+    if (r_code >= 0) \
+    { \
+        _hash_map->entries[s].data = _data; \
+    } \
+    return r_code; \
+} \
+\
+static inline _name##_value *_name##_find_or_insert(_name *const _hash_map, \
+                                               const _name##_key _key, \
+                                               size_t *const _inserted) \
+{ \
+    if (_hash_map == NULL) return NULL; \
+\
+    size_t s; \
+    const ptrdiff_t r_code = _name##_emplace_(_hash_map, _key, &s); \
+    if (r_code < 0) return NULL; \
+\
+    if (r_code > 0) \
+    { \
+        memset(&_hash_map->entries[s].data, 0, sizeof(_name##_value)); \
+    } \
+    if (_inserted != NULL) \
+    { \
+        *_inserted = (r_code > 0) ? 1 : 0; \
+    } \
+    return &_hash_map->entries[s].data; \
+} \
+\
+static inline ptrdiff_t _name##_erase(_name *const _hash_map, \
+                                      const _name##_key _key) \
+{ \
+    if (_hash_map == NULL) return -1; \
+\
+    const size_t s = _name##_find_(_hash_map, _key, c_hash_map_mix(_hash_fn(_key)), NULL); \
+    if (s == SIZE_MAX) return 0; \
+\
+    _hash_map->deleted_count += c_hash_map_group_release(_hash_map->ctrl, s); \
+    --_hash_map->pairs_count; \
+\
+    return 1; \
+} \
+\
+static inline ptrdiff_t _name##_resize(_name *const _hash_map, \
+                                       const size_t _slots_count) \
+{ \
+    if (_hash_map == NULL) return -1; \
+\
+    if (_hash_map->slots_count == _slots_count) return 0; \
+\
+    if (_slots_count == 0) return -2; \
+\
+    size_t capacity = c_hash_map_group_capacity(_slots_count); \
+    if (capacity == 0) return -3; \
+\
+    while ( (float)_hash_map->pairs_count > _hash_map->max_load_factor * capacity ) \
+    { \
+        if (capacity > SIZE_MAX / 2) return -3; \
+        capacity *= 2; \
+    } \
+\
+    if ( (capacity == _hash_map->slots_count) && (_hash_map->deleted_count == 0) ) return 0; \
+\
+    if (_name##_rehash_(_hash_map, capacity) < 0) return -4; \
+\
+    return 2; \
+} \
+\
+static inline ptrdiff_t _name##_check(const _name *const _hash_map, \
+                                      const _name##_key _key) \
+{ \
+    if (_hash_map == NULL) return -1; \
+\
+    if (_hash_map->pairs_count == 0) return 0; \
+\
+    return (_name##_find_(_hash_map, _key, c_hash_map_mix(_hash_fn(_key)), NULL) != SIZE_MAX) ? 1 : 0; \
+} \
+\
+static inline _name##_value *_name##_at(const _name *const _hash_map, \
+                                   const _name##_key _key) \
+{ \
+    if ( (_hash_map == NULL) || (_hash_map->pairs_count == 0) ) return NULL; \
+\
+    const size_t s = _name##_find_(_hash_map, _key, c_hash_map_mix(_hash_fn(_key)), NULL); \
+\
+    return (s != SIZE_MAX) ? &_hash_map->entries[s].data : NULL; \
+} \
+\
+static inline ptrdiff_t _name##_for_each(_name *const _hash_map, \
+                                         void (*const _action)(const _name##_key *const _key, \
+                                                               _name##_value *const _data, \
+                                                               void *const _context), \
+                                         void *const _context) \
+{ \
+    if (_hash_map == NULL) return -1; \
+    if (_action == NULL) return -2; \
+\
+    size_t count = _hash_map->pairs_count; \
+    for (size_t s = 0; (s < _hash_map->slots_count)&&(count > 0); ++s) \
+    { \
+        if ( (_hash_map->ctrl[s] & 0x80) == 0 ) \
+        { \
+            _action(&_hash_map->entries[s].key, &_hash_map->entries[s].data, _context); \
+            --count; \
+        } \
+    } \
+\
+    return 1; \
+} \
+\
+static inline ptrdiff_t _name##_clear(_name *const _hash_map) \
+{ \
+    if (_hash_map == NULL) return -1; \
+\
+    if (_hash_map->slots_count > 0) \
+    { \
+        memset(_hash_map->ctrl, C_HASH_MAP_CTRL_EMPTY, _hash_map->slots_count); \
+    } \
+    _hash_map->pairs_count = 0; \
+    _hash_map->deleted_count = 0; \
+\
+    return 1; \
+} \
+\
+static inline size_t _name##_slots_count(const _name *const _hash_map) \
+{ \
+    return (_hash_map != NULL) ? _hash_map->slots_count : 0; \
+} \
+\
+static inline size_t _name##_pairs_count(const _name *const _hash_map) \
+{ \
+    return (_hash_map != NULL) ? _hash_map->pairs_count : 0; \
+}
+
+// Хэш ключа uint64_t (перемешивание выполняется самим хэш-отображением).
+static inline size_t c_hash_map_u64_hash(const uint64_t _key)
+{
+    return (size_t)(_key ^ (_key >> 32));
+}
+
+static inline int c_hash_map_u64_eq(const uint64_t _key_a,
+                                    const uint64_t _key_b)
+{
+    return _key_a == _key_b;
+}
+
+// Хэш-отображение uint64_t -> void*.
+C_HASH_MAP_DECLARE(c_hash_map_u64, uint64_t, void*, c_hash_map_u64_hash, c_hash_map_u64_eq)
+
+// Хэш строки, завершенной нулем (FNV-1a).
+static inline size_t c_hash_map_str_hash(const char *const _key)
+{
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (const unsigned char *c = (const unsigned char*)_key; *c != '\0'; ++c)
+    {
+        h ^= *c;
+        h *= 0x100000001B3ULL;
+    }
+    return (size_t)h;
+}
+
+static inline int c_hash_map_str_eq(const char *const _key_a,
+                                    const char *const _key_b)
+{
+    return strcmp(_key_a, _key_b) == 0;
+}
+
+// Хэш-отображение строк (не копируются и не захватываются) -> void*.
+C_HASH_MAP_DECLARE(c_hash_map_str, const char*, void*, c_hash_map_str_hash, c_hash_map_str_eq)
+
+#endif
@@ -3,22 +3,7 @@
 #include <string.h>
 
 #include "c_hash_map.h"
-
-// Функция генерации хэша из ключа-строки.
-size_t hash_key_s(const void *const _key)
-{
-    if (_key == NULL) return 0;
-
-    const char *c = (char*)_key;
-    size_t hash = 0;
-
-    while (*c != 0)
-    {
-        hash += *(c++);
-    }
-
-    return hash;
-}
+#include "c_hash_map_hash.h"
 
 // Функция детального сравнения ключей-строк.
 size_t comp_key_s(const void *const _key_a,
@@ -68,7 +53,7 @@ int main(int argc, char **argv)
     c_hash_map *hash_map;
 
     // Попытаемся создать хэш-отображение.
-    hash_map = c_hash_map_create(hash_key_s, comp_key_s, 10, 0.5f, &error);
+    hash_map = c_hash_map_create(c_hash_map_hash_str, comp_key_s, 10, 0.5f, &error);
     // Если произошла ошибка, покажем ее.
     if (hash_map == NULL)
     {
@@ -0,0 +1,1522 @@
+﻿/*
+    Проверки хэш-отображения c_hash_map
+    Каждая проверка выполняет сценарий над хэш-отображением и сверяет результат с ожидаемым,
+    о нарушенных условиях сообщается в stderr.
+    Запуск: test [--filter строка]
+    Лицензия: GPLv3
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "c_hash_map.h"
+#include "c_hash_map_hash.h"
+#include "c_hash_map_concurrent.h"
+#include "c_hash_map_lf.h"
+#include "c_hash_map_snapshot.h"
+
+// Файл снимков проверок (удаляется после каждой проверки).
+#define TEST_SNAPSHOT_PATH "test_run.snapshot"
+
+// Проверка условия: при нарушении сообщает место и условие, проверка считается проваленной.
+#define TEST_CHECK(_condition) test_check( (_condition) ? 1 : 0, #_condition, __LINE__ )
+
+static size_t test_checks_count,
+              test_failures_count;
+
+static void test_check(const int _passed,
+                       const char *const _condition,
+                       const int _line)
+{
+    ++test_checks_count;
+    if (!_passed)
+    {
+        ++test_failures_count;
+        fprintf(stderr, "test.c:%d: failed: %s\n", _line, _condition);
+    }
+}
+
+// Генератор псевдослучайных чисел splitmix64 (фиксированное зерно - воспроизводимые прогоны).
+static uint64_t test_random(uint64_t *const _state)
+{
+    *_state += 0x9E3779B97F4A7C15ULL;
+    return c_hash_map_hash_mix64(*_state);
+}
+
+static size_t comp_key_int(const void *const _key_a,
+                           const void *const _key_b)
+{
+    return *(const uint64_t*)_key_a == *(const uint64_t*)_key_b;
+}
+
+// Ключи проверки: различные целые значения.
+static uint64_t *test_keys_create(const size_t _count)
+{
+    uint64_t *const keys = malloc(_count * sizeof(uint64_t));
+    if (keys != NULL)
+    {
+        for (size_t i = 0; i < _count; ++i)
+        {
+            keys[i] = c_hash_map_hash_mix64((uint64_t)i + 1);
+        }
+    }
+    return keys;
+}
+
+static c_hash_map *test_map_create(const c_hash_map_options *const _options)
+{
+    size_t error = 0;
+    c_hash_map *const hash_map = c_hash_map_create_ex(c_hash_map_hash_u64, comp_key_int, 0, 0.75f,
+                                                      _options, &error);
+    if (hash_map == NULL)
+    {
+        fprintf(stderr, "test: create error: %lu\n", (unsigned long)error);
+    }
+    return hash_map;
+}
+
+static size_t test_deleted_keys,
+              test_deleted_datas;
+
+static void test_del_key(void *const _key)
+{
+    (void)_key;
+    ++test_deleted_keys;
+}
+
+static void test_del_data(void *const _data)
+{
+    (void)_data;
+    ++test_deleted_datas;
+}
+
+// Стоимость пары в режиме кэша - значение данных.
+static size_t test_cost(const void *const _key,
+                        const void *const _data)
+{
+    (void)_key;
+    return *(const uint64_t*)_data;
+}
+
+// Режим кэша с пределом количества пар: предел соблюдается после каждой вставки, вытесненные
+// пары передаются cache_del_key и cache_del_data, часто используемые пары не вытесняются.
+static void test_cache_capacity(void)
+{
+    enum {COUNT = 20000, CAPACITY = 1000, HOT = 100};
+
+    uint64_t *const keys = test_keys_create(COUNT);
+    TEST_CHECK(keys != NULL);
+    if (keys == NULL) return;
+
+    for (size_t inline_pairs = 0; inline_pairs < 2; ++inline_pairs)
+    {
+        c_hash_map_options options;
+        c_hash_map_options_init(&options);
+        options.cache_capacity = CAPACITY;
+        options.cache_del_key = test_del_key;
+        options.cache_del_data = test_del_data;
+        if (inline_pairs)
+        {
+            options.key_size = sizeof(uint64_t);
+            options.value_size = sizeof(uint64_t);
+        }
+
+        c_hash_map *const hash_map = test_map_create(&options);
+        TEST_CHECK(hash_map != NULL);
+        if (hash_map == NULL) continue;
+
+        test_deleted_keys = 0;
+        test_deleted_datas = 0;
+
+        size_t over_limit = 0;
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            TEST_CHECK(c_hash_map_insert(hash_map, &keys[i], &keys[i]) == 1);
+            over_limit += (c_hash_map_pairs_count(hash_map, NULL) > CAPACITY);
+
+            // Горячий набор ключей используется постоянно.
+            if (i >= HOT)
+            {
+                c_hash_map_at(hash_map, &keys[i % HOT], NULL);
+            }
+        }
+        TEST_CHECK(over_limit == 0);
+        TEST_CHECK(c_hash_map_pairs_count(hash_map, NULL) == CAPACITY);
+        TEST_CHECK(test_deleted_keys == COUNT - CAPACITY);
+        TEST_CHECK(test_deleted_datas == COUNT - CAPACITY);
+
+        size_t hot_present = 0;
+        for (size_t i = 0; i < HOT; ++i)
+        {
+            hot_present += (size_t)c_hash_map_check(hash_map, &keys[i]);
+        }
+        TEST_CHECK(hot_present == HOT);
+
+        c_hash_map_cache_statistics stats;
+        TEST_CHECK(c_hash_map_cache_stats(hash_map, &stats) == 1);
+        TEST_CHECK(stats.capacity == CAPACITY);
+        TEST_CHECK(stats.pairs_count == CAPACITY);
+        TEST_CHECK(stats.evictions_count == COUNT - CAPACITY);
+        TEST_CHECK(stats.hits_count > 0);
+
+        TEST_CHECK(c_hash_map_cache_reset_stats(hash_map) == 1);
+        TEST_CHECK(c_hash_map_cache_stats(hash_map, &stats) == 1);
+        TEST_CHECK( (stats.hits_count == 0) && (stats.misses_count == 0) && (stats.evictions_count == 0) );
+
+        // Пакетное построение также соблюдает предел.
+        TEST_CHECK(c_hash_map_clear(hash_map, NULL, NULL) == 1);
+        const void **const build_keys = malloc(5 * CAPACITY * sizeof(void*));
+        void **const build_datas = malloc(5 * CAPACITY * sizeof(void*));
+        if ( (build_keys != NULL) && (build_datas != NULL) )
+        {
+            for (size_t i = 0; i < 5 * CAPACITY; ++i)
+            {
+                build_keys[i] = &keys[i];
+                build_datas[i] = &keys[i];
+            }
+            TEST_CHECK(c_hash_map_build(hash_map, build_keys, build_datas, 5 * CAPACITY, 0, NULL, NULL) ==
+                       5 * CAPACITY);
+            TEST_CHECK(c_hash_map_pairs_count(hash_map, NULL) == CAPACITY);
+        }
+        free(build_keys);
+        free(build_datas);
+
+        c_hash_map_delete(hash_map, NULL, NULL);
+    }
+
+    free(keys);
+}
+
+// Режим кэша с пределом суммарной стоимости пар: предел соблюдается, замена данных пересчитывает
+// стоимость, пара дороже предела остается единственной.
+static void test_cache_bytes(void)
+{
+    enum {COUNT = 20000, BYTES = 1000};
+
+    uint64_t *const keys = test_keys_create(COUNT);
+    uint64_t *const costs = malloc(COUNT * sizeof(uint64_t));
+    TEST_CHECK( (keys != NULL) && (costs != NULL) );
+    if ( (keys == NULL) || (costs == NULL) )
+    {
+        free(keys);
+        free(costs);
+        return;
+    }
+
+    c_hash_map_options options;
+    c_hash_map_options_init(&options);
+    options.cache_bytes = BYTES;
+    options.cache_cost = test_cost;
+
+    c_hash_map *const hash_map = test_map_create(&options);
+    TEST_CHECK(hash_map != NULL);
+    if (hash_map != NULL)
+    {
+        c_hash_map_cache_statistics stats;
+
+        size_t over_limit = 0;
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            costs[i] = 1 + i % 20;
+            TEST_CHECK(c_hash_map_insert(hash_map, &keys[i], &costs[i]) == 1);
+            c_hash_map_cache_stats(hash_map, &stats);
+            over_limit += (stats.used_bytes > BYTES);
+        }
+        TEST_CHECK(over_limit == 0);
+
+        uint64_t big = 900;
+        TEST_CHECK(c_hash_map_insert_or_assign(hash_map, &keys[COUNT - 1], &big, NULL) == 0);
+        c_hash_map_cache_stats(hash_map, &stats);
+        TEST_CHECK(stats.used_bytes <= BYTES);
+        TEST_CHECK(c_hash_map_check(hash_map, &keys[COUNT - 1]) == 1);
+
+        uint64_t huge = 5 * BYTES;
+        TEST_CHECK(c_hash_map_insert(hash_map, &keys[0], &huge) == 1);
+        c_hash_map_cache_stats(hash_map, &stats);
+        TEST_CHECK( (stats.pairs_count == 1) && (stats.used_bytes == huge) );
+
+        uint64_t one = 1;
+        TEST_CHECK(c_hash_map_insert(hash_map, &keys[1], &one) == 1);
+        c_hash_map_cache_stats(hash_map, &stats);
+        TEST_CHECK( (stats.pairs_count == 1) && (stats.used_bytes == one) );
+
+        TEST_CHECK(c_hash_map_erase(hash_map, &keys[1], NULL, NULL) == 1);
+        c_hash_map_cache_stats(hash_map, &stats);
+        TEST_CHECK(stats.used_bytes == 0);
+
+        c_hash_map_delete(hash_map, NULL, NULL);
+    }
+
+    free(keys);
+    free(costs);
+}
+
+// Режим кэша доступен только движку CHAIN без постепенного перестроения.
+static void test_cache_errors(void)
+{
+    c_hash_map_options options;
+    size_t error = 0;
+
+    c_hash_map_options_init(&options);
+    options.engine = C_HASH_MAP_ENGINE_SWISS;
+    options.cache_capacity = 5;
+    TEST_CHECK(c_hash_map_create_ex(c_hash_map_hash_u64, comp_key_int, 0, 0.75f, &options, &error) == NULL);
+    TEST_CHECK(error == 17);
+
+    c_hash_map_options_init(&options);
+    options.rehash_step = 2;
+    options.cache_bytes = 5;
+    TEST_CHECK(c_hash_map_create_ex(c_hash_map_hash_u64, comp_key_int, 0, 0.75f, &options, &error) == NULL);
+    TEST_CHECK(error == 17);
+
+    c_hash_map *const hash_map = test_map_create(NULL);
+    TEST_CHECK(hash_map != NULL);
+    if (hash_map != NULL)
+    {
+        c_hash_map_cache_statistics stats;
+        TEST_CHECK(c_hash_map_cache_stats(hash_map, &stats) == -3);
+        TEST_CHECK(c_hash_map_cache_reset_stats(hash_map) == -2);
+        c_hash_map_delete(hash_map, NULL, NULL);
+    }
+}
+
+// Эталон режима срока жизни для test_ttl_random: состояние каждого ключа.
+typedef struct s_test_ttl_model test_ttl_model;
+
+struct s_test_ttl_model
+{
+    size_t present,
+           has_ttl;
+    uint64_t expire;
+};
+
+static const uint64_t *test_ttl_keys;
+static test_ttl_model *test_ttl_models;
+static uint64_t test_ttl_now;
+static size_t test_ttl_wrong;
+
+// Удаляемая по сроку пара должна быть в эталоне и иметь наступивший срок.
+static void test_ttl_del_key(void *const _key)
+{
+    const size_t i = (size_t)((const uint64_t*)_key - test_ttl_keys);
+    test_ttl_model *const model = &test_ttl_models[i];
+
+    if ( !model->present || !model->has_ttl || (model->expire > test_ttl_now) )
+    {
+        ++test_ttl_wrong;
+    }
+    model->present = 0;
+}
+
+// Режим срока жизни: случайные вставки со сроком, продления, удаления, вставки без срока,
+// сдвиги времени от нуля тиков до 2^37 и удаление истекших пар с ограничением и без
+// сверяются с эталоном. Между шагами выполняются shrink_to_fit и clear.
+static void test_ttl_random(void)
+{
+    enum {COUNT = 5000, ROUNDS = 200, OPS = 200};
+
+    uint64_t *const keys = malloc(COUNT * sizeof(uint64_t));
+    test_ttl_model *const models = calloc(COUNT, sizeof(test_ttl_model));
+    TEST_CHECK( (keys != NULL) && (models != NULL) );
+    if ( (keys == NULL) || (models == NULL) )
+    {
+        free(keys);
+        free(models);
+        return;
+    }
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+        keys[i] = i;
+    }
+    test_ttl_keys = keys;
+    test_ttl_models = models;
+
+    for (size_t variant = 0; variant < 2; ++variant)
+    {
+        c_hash_map_options options;
+        c_hash_map_options_init(&options);
+        options.ttl_mode = 1;
+        if (variant == 1)
+        {
+            options.key_size = sizeof(uint64_t);
+            options.value_size = sizeof(uint64_t);
+        }
+
+        c_hash_map *const hash_map = test_map_create(&options);
+        TEST_CHECK(hash_map != NULL);
+        if (hash_map == NULL) continue;
+
+        memset(models, 0, COUNT * sizeof(test_ttl_model));
+        test_ttl_wrong = 0;
+
+        uint64_t state = 0x2545F4914F6CDD1DULL + variant;
+        uint64_t now = (variant == 0) ? 0 : 1700000000000000000ULL;
+
+        for (size_t round = 0; round < ROUNDS; ++round)
+        {
+            for (size_t op = 0; op < OPS; ++op)
+            {
+                const uint64_t r = test_random(&state);
+                const size_t i = (size_t)(r % COUNT);
+                const uint64_t spans[4] = {64, 5000, 300000, (uint64_t)1 << 38};
+                const uint64_t ttl = (r >> 20) % spans[(r >> 16) & 3];
+
+                switch ( (r >> 8) % 8 )
+                {
+                case 0: case 1: case 2: case 3:
+                {
+                    const ptrdiff_t r_code = c_hash_map_insert_ttl(hash_map, &keys[i], &keys[i], now, ttl);
+                    TEST_CHECK(r_code == (models[i].present ? 0 : 1));
+                    if (r_code == 1)
+                    {
+                        models[i].present = 1;
+                        models[i].has_ttl = 1;
+                        models[i].expire = now + ttl;
+                    }
+                    break;
+                }
+                case 4: case 5:
+                {
+                    const ptrdiff_t r_code = c_hash_map_touch(hash_map, &keys[i], now, ttl);
+                    TEST_CHECK(r_code == (ptrdiff_t)models[i].present);
+                    if (r_code == 1)
+                    {
+                        models[i].has_ttl = 1;
+                        models[i].expire = now + ttl;
+                    }
+                    break;
+                }
+                case 6:
+                    TEST_CHECK(c_hash_map_erase(hash_map, &keys[i], NULL, NULL) == (ptrdiff_t)models[i].present);
+                    models[i].present = 0;
+                    break;
+                default:
+                    TEST_CHECK(c_hash_map_insert(hash_map, &keys[i], &keys[i]) == (models[i].present ? 0 : 1));
+                    if (!models[i].present)
+                    {
+                        models[i].present = 1;
+                        models[i].has_ttl = 0;
+                    }
+                    break;
+                }
+            }
+
+            const uint64_t r = test_random(&state);
+            const uint64_t spans[4] = {16, 1000, 100000, (uint64_t)1 << 37};
+            now += (r >> 8) % spans[r & 3];
+            test_ttl_now = now;
+
+            const size_t budget = (r % 3 == 0) ? (size_t)((r >> 40) % 50) : SIZE_MAX;
+
+            // Встроенные ключи передаются функции удаления копиями, поэтому для них эталон
+            // обновляется по результату поиска.
+            const ptrdiff_t removed = c_hash_map_expire(hash_map, now, budget,
+                                                        (variant == 0) ? test_ttl_del_key : NULL, NULL);
+            TEST_CHECK( (removed >= 0) && ((size_t)removed <= budget) );
+
+            size_t present_count = 0,
+                   overdue = 0;
+            for (size_t i = 0; i < COUNT; ++i)
+            {
+                if (variant == 1)
+                {
+                    models[i].present = (size_t)c_hash_map_check(hash_map, &keys[i]);
+                } else {
+                    TEST_CHECK((size_t)c_hash_map_check(hash_map, &keys[i]) == models[i].present);
+                }
+                present_count += models[i].present;
+                overdue += (models[i].present && models[i].has_ttl && (models[i].expire <= now));
+            }
+            TEST_CHECK(c_hash_map_pairs_count(hash_map, NULL) == present_count);
+
+            // Если ограничение не исчерпано, истекших пар не остается.
+            if ( (size_t)removed < budget )
+            {
+                TEST_CHECK(overdue == 0);
+            }
+
+            if (round % 37 == 5)
+            {
+                TEST_CHECK(c_hash_map_shrink_to_fit(hash_map) >= 0);
+            }
+            if (round == ROUNDS / 2)
+            {
+                TEST_CHECK(c_hash_map_clear(hash_map, NULL, NULL) >= 0);
+                memset(models, 0, COUNT * sizeof(test_ttl_model));
+            }
+        }
+        TEST_CHECK(test_ttl_wrong == 0);
+
+        c_hash_map_delete(hash_map, NULL, NULL);
+    }
+
+    free(keys);
+    free(models);
+}
+
+// Режим срока жизни: после shrink_to_fit (узлы переносятся в новый блок) колесо продолжает
+// работать с перенесенными узлами.
+static void test_ttl_shrink(void)
+{
+    enum {COUNT = 2000, LEFT = 10};
+
+    uint64_t *const keys = test_keys_create(COUNT);
+    TEST_CHECK(keys != NULL);
+    if (keys == NULL) return;
+
+    c_hash_map_options options;
+    c_hash_map_options_init(&options);
+    options.ttl_mode = 1;
+
+    c_hash_map *const hash_map = test_map_create(&options);
+    TEST_CHECK(hash_map != NULL);
+    if (hash_map != NULL)
+    {
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            TEST_CHECK(c_hash_map_insert_ttl(hash_map, &keys[i], &keys[i], 0, (i * 37) % 5000 + 10) == 1);
+        }
+        for (size_t i = 0; i < COUNT - LEFT; ++i)
+        {
+            TEST_CHECK(c_hash_map_erase(hash_map, &keys[i], NULL, NULL) == 1);
+        }
+        TEST_CHECK(c_hash_map_shrink_to_fit(hash_map) > 0);
+
+        TEST_CHECK(c_hash_map_touch(hash_map, &keys[COUNT - 1], 0, 7) == 1);
+        TEST_CHECK(c_hash_map_insert_ttl(hash_map, &keys[0], &keys[0], 0, 3) == 1);
+        TEST_CHECK(c_hash_map_expire(hash_map, 7, SIZE_MAX, NULL, NULL) == 2);
+        TEST_CHECK(c_hash_map_expire(hash_map, UINT64_MAX, SIZE_MAX, NULL, NULL) == LEFT - 1);
+        TEST_CHECK(c_hash_map_pairs_count(hash_map, NULL) == 0);
+
+        c_hash_map_delete(hash_map, NULL, NULL);
+    }
+
+    free(keys);
+}
+
+// Режим срока жизни: далекие сроки находятся в списке переполнения, и сдвиг времени на много
+// окон верхнего уровня (2^36 тиков) переходит сразу к окну ближайшего срока. Сдвиги ниже
+// (наносекунды, год, 2^61, предел uint64_t) с пошаговым переходом выполнялись бы часами.
+static void test_ttl_overflow(void)
+{
+    enum {COUNT = 10000};
+    const uint64_t day = 86400ULL * 1000000000ULL;
+
+    uint64_t *const keys = test_keys_create(COUNT);
+    TEST_CHECK(keys != NULL);
+    if (keys == NULL) return;
+
+    c_hash_map_options options;
+    c_hash_map_options_init(&options);
+    options.ttl_mode = 1;
+
+    c_hash_map *const hash_map = test_map_create(&options);
+    TEST_CHECK(hash_map != NULL);
+    if (hash_map != NULL)
+    {
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            const uint64_t ttl = (i == 0) ? 29 * day : 365 * day + i;
+            TEST_CHECK(c_hash_map_insert_ttl(hash_map, &keys[i], &keys[i], 0, ttl) == 1);
+        }
+
+        TEST_CHECK(c_hash_map_expire(hash_map, 30 * day, SIZE_MAX, NULL, NULL) == 1);
+        TEST_CHECK(c_hash_map_expire(hash_map, 364 * day, SIZE_MAX, NULL, NULL) == 0);
+        TEST_CHECK(c_hash_map_expire(hash_map, 365 * day + COUNT / 2, SIZE_MAX, NULL, NULL) == COUNT / 2);
+
+        TEST_CHECK(c_hash_map_insert_ttl(hash_map, &keys[0], &keys[0], 365 * day, (uint64_t)1 << 61) == 1);
+        TEST_CHECK(c_hash_map_expire(hash_map, (uint64_t)1 << 60, SIZE_MAX, NULL, NULL) == COUNT / 2 - 1);
+        TEST_CHECK(c_hash_map_expire(hash_map, ((uint64_t)1 << 61) + 364 * day, SIZE_MAX, NULL, NULL) == 0);
+        TEST_CHECK(c_hash_map_expire(hash_map, ((uint64_t)1 << 61) + 365 * day, SIZE_MAX, NULL, NULL) == 1);
+
+        // Срок жизни, выходящий за предел времени, насыщается.
+        TEST_CHECK(c_hash_map_insert_ttl(hash_map, &keys[1], &keys[1], 0, UINT64_MAX) == 1);
+        TEST_CHECK(c_hash_map_expire(hash_map, UINT64_MAX - 1, SIZE_MAX, NULL, NULL) == 0);
+        TEST_CHECK(c_hash_map_expire(hash_map, UINT64_MAX, SIZE_MAX, NULL, NULL) == 1);
+        TEST_CHECK(c_hash_map_pairs_count(hash_map, NULL) == 0);
+
+        c_hash_map_delete(hash_map, NULL, NULL);
+    }
+
+    free(keys);
+}
+
+// Режим срока жизни доступен только движку CHAIN без постепенного перестроения; функции срока
+// жизни без него возвращают ошибку.
+static void test_ttl_errors(void)
+{
+    c_hash_map_options options;
+    size_t error = 0;
+
+    c_hash_map_options_init(&options);
+    options.engine = C_HASH_MAP_ENGINE_SWISS;
+    options.ttl_mode = 1;
+    TEST_CHECK(c_hash_map_create_ex(c_hash_map_hash_u64, comp_key_int, 0, 0.75f, &options, &error) == NULL);
+    TEST_CHECK(error == 18);
+
+    c_hash_map_options_init(&options);
+    options.rehash_step = 2;
+    options.ttl_mode = 1;
+    TEST_CHECK(c_hash_map_create_ex(c_hash_map_hash_u64, comp_key_int, 0, 0.75f, &options, &error) == NULL);
+    TEST_CHECK(error == 18);
+
+    c_hash_map *const hash_map = test_map_create(NULL);
+    TEST_CHECK(hash_map != NULL);
+    if (hash_map != NULL)
+    {
+        const uint64_t key = 1;
+        TEST_CHECK(c_hash_map_insert_ttl(hash_map, &key, &key, 0, 1) == -4);
+        TEST_CHECK(c_hash_map_touch(hash_map, &key, 0, 1) == -3);
+        TEST_CHECK(c_hash_map_expire(hash_map, 1, SIZE_MAX, NULL, NULL) == -2);
+        c_hash_map_delete(hash_map, NULL, NULL);
+    }
+}
+
+// Хэш, принимающий только 7 значений: корзины всех ключей совпадают.
+static size_t test_hash_degenerate(const void *const _key)
+{
+    return (size_t)(*(const uint64_t*)_key % 7);
+}
+
+// Движок CUCKOO: заполнение до высокого max_load_factor требует вытеснения пар во вторые корзины
+// и перестроений; все пары остаются доступны, в том числе после удалений, resize и shrink_to_fit.
+static void test_cuckoo_fill(void)
+{
+    enum {COUNT = 100000};
+    const float max_load_factors[3] = {0.5f, 0.9f, 0.97f};
+
+    uint64_t *const keys = test_keys_create(COUNT);
+    TEST_CHECK(keys != NULL);
+    if (keys == NULL) return;
+
+    for (size_t inline_pairs = 0; inline_pairs < 2; ++inline_pairs)
+    {
+        for (size_t m = 0; m < 3; ++m)
+        {
+            c_hash_map_options options;
+            c_hash_map_options_init(&options);
+            options.engine = C_HASH_MAP_ENGINE_CUCKOO;
+            if (inline_pairs)
+            {
+                options.key_size = sizeof(uint64_t);
+                options.value_size = sizeof(uint64_t);
+            }
+
+            size_t error = 0;
+            c_hash_map *const hash_map = c_hash_map_create_ex(c_hash_map_hash_u64, comp_key_int, 0,
+                                                              max_load_factors[m], &options, &error);
+            TEST_CHECK(hash_map != NULL);
+            if (hash_map == NULL) continue;
+
+            for (size_t i = 0; i < COUNT; ++i)
+            {
+                TEST_CHECK(c_hash_map_insert(hash_map, &keys[i], &keys[i]) == 1);
+            }
+            TEST_CHECK(c_hash_map_insert(hash_map, &keys[5], &keys[5]) == 0);
+
+            c_hash_map_statistics stats;
+            TEST_CHECK(c_hash_map_stats(hash_map, &stats) == 1);
+            TEST_CHECK(stats.pairs_count == COUNT);
+            TEST_CHECK((float)COUNT / stats.slots_count <= max_load_factors[m]);
+            TEST_CHECK(stats.resizes_count > 0);
+            TEST_CHECK(stats.max_chain <= 2);
+            TEST_CHECK(stats.histogram[1] + stats.histogram[2] == COUNT);
+            // Часть пар вытеснена во вторые корзины.
+            TEST_CHECK(stats.histogram[2] > 0);
+
+            size_t found = 0;
+            for (size_t i = 0; i < COUNT; ++i)
+            {
+                const uint64_t *const data = c_hash_map_at(hash_map, &keys[i], NULL);
+                found += ( (data != NULL) && (*data == keys[i]) );
+            }
+            TEST_CHECK(found == COUNT);
+
+            // Удаление каждой третьей пары и повторная вставка.
+            for (size_t i = 0; i < COUNT; i += 3)
+            {
+                TEST_CHECK(c_hash_map_erase(hash_map, &keys[i], NULL, NULL) == 1);
+            }
+            size_t present = 0;
+            for (size_t i = 0; i < COUNT; ++i)
+            {
+                present += (size_t)c_hash_map_check(hash_map, &keys[i]);
+            }
+            TEST_CHECK(present == COUNT - (COUNT + 2) / 3);
+            for (size_t i = 0; i < COUNT; i += 3)
+            {
+                TEST_CHECK(c_hash_map_insert(hash_map, &keys[i], &keys[i]) == 1);
+            }
+
+            TEST_CHECK(c_hash_map_resize(hash_map, 16) >= 0);
+            TEST_CHECK((float)COUNT / c_hash_map_slots_count(hash_map, NULL) <= max_load_factors[m]);
+            TEST_CHECK(c_hash_map_resize(hash_map, c_hash_map_slots_count(hash_map, NULL) * 4) == 2);
+            TEST_CHECK(c_hash_map_shrink_to_fit(hash_map) >= 0);
+
+            present = 0;
+            for (size_t i = 0; i < COUNT; ++i)
+            {
+                present += (size_t)c_hash_map_check(hash_map, &keys[i]);
+            }
+            TEST_CHECK(present == COUNT);
+
+            test_deleted_keys = 0;
+            test_deleted_datas = 0;
+            TEST_CHECK(c_hash_map_clear(hash_map, test_del_key, test_del_data) == 1);
+            TEST_CHECK( (test_deleted_keys == COUNT) && (test_deleted_datas == COUNT) );
+            TEST_CHECK(c_hash_map_pairs_count(hash_map, NULL) == 0);
+
+            c_hash_map_delete(hash_map, NULL, NULL);
+        }
+    }
+
+    free(keys);
+}
+
+// Движок CUCKOO с вырожденным хэшем: вставка рано или поздно завершается ошибкой, а уже
+// вставленные пары остаются доступны.
+static void test_cuckoo_degenerate(void)
+{
+    enum {COUNT = 1000};
+
+    uint64_t *const keys = test_keys_create(COUNT);
+    TEST_CHECK(keys != NULL);
+    if (keys == NULL) return;
+
+    c_hash_map_options options;
+    c_hash_map_options_init(&options);
+    options.engine = C_HASH_MAP_ENGINE_CUCKOO;
+
+    c_hash_map *const hash_map = c_hash_map_create_ex(test_hash_degenerate, comp_key_int, 0, 0.9f,
+                                                      &options, NULL);
+    TEST_CHECK(hash_map != NULL);
+    if (hash_map != NULL)
+    {
+        size_t inserted = 0;
+        ptrdiff_t r_code = 1;
+        for (size_t i = 0; (i < COUNT) && (r_code >= 0); ++i)
+        {
+            r_code = c_hash_map_insert(hash_map, &keys[i], &keys[i]);
+            inserted += (r_code == 1);
+        }
+        TEST_CHECK(r_code < 0);
+        TEST_CHECK(c_hash_map_pairs_count(hash_map, NULL) == inserted);
+
+        size_t present = 0;
+        for (size_t i = 0; i < inserted; ++i)
+        {
+            present += (size_t)c_hash_map_check(hash_map, &keys[i]);
+        }
+        TEST_CHECK(present == inserted);
+
+        c_hash_map_delete(hash_map, NULL, NULL);
+    }
+
+    free(keys);
+}
+
+// Ограничения параметров движка CUCKOO.
+static void test_cuckoo_errors(void)
+{
+    c_hash_map_options options;
+    size_t error = 0;
+
+    c_hash_map_options_init(&options);
+    options.engine = C_HASH_MAP_ENGINE_CUCKOO;
+    TEST_CHECK(c_hash_map_create_ex(c_hash_map_hash_u64, comp_key_int, 0, 0.98f, &options, &error) == NULL);
+    TEST_CHECK(error == 3);
+
+    options.rehash_step = 2;
+    TEST_CHECK(c_hash_map_create_ex(c_hash_map_hash_u64, comp_key_int, 0, 0.9f, &options, &error) == NULL);
+    TEST_CHECK(error == 12);
+}
+
+// c_hash_map_at_batch и c_hash_map_check_batch всех движков совпадают с поштучным поиском,
+// в том числе для удаленных пар (в движке DENSE они остаются в массиве пар) и отсутствующих ключей.
+static void test_batch_engines(void)
+{
+    enum {COUNT = 30000, QUERIES = 2 * COUNT};
+    const size_t engines[4] = {C_HASH_MAP_ENGINE_CHAIN, C_HASH_MAP_ENGINE_SWISS,
+                               C_HASH_MAP_ENGINE_DENSE, C_HASH_MAP_ENGINE_CUCKOO};
+
+    uint64_t *const keys = test_keys_create(COUNT);
+    const void **const queries = malloc(QUERIES * sizeof(void*));
+    void **const datas = malloc(QUERIES * sizeof(void*));
+    size_t *const results = malloc(QUERIES * sizeof(size_t));
+    TEST_CHECK( (keys != NULL) && (queries != NULL) && (datas != NULL) && (results != NULL) );
+    if ( (keys == NULL) || (queries == NULL) || (datas == NULL) || (results == NULL) )
+    {
+        free(keys);
+        free(queries);
+        free(datas);
+        free(results);
+        return;
+    }
+
+    // Запросы - ключи в случайном порядке, в том числе повторяющиеся.
+    uint64_t state = 7;
+    for (size_t i = 0; i < QUERIES; ++i)
+    {
+        queries[i] = &keys[test_random(&state) % COUNT];
+    }
+
+    for (size_t e = 0; e < 4; ++e)
+    {
+        c_hash_map_options options;
+        c_hash_map_options_init(&options);
+        options.engine = engines[e];
+        c_hash_map *const hash_map = test_map_create(&options);
+        TEST_CHECK(hash_map != NULL);
+        if (hash_map == NULL) continue;
+
+        // Пустое хэш-отображение, затем вставлены все ключи, затем удалена каждая третья пара.
+        for (size_t stage = 0; stage < 3; ++stage)
+        {
+            if (stage == 1)
+            {
+                for (size_t i = 0; i < COUNT; ++i)
+                {
+                    c_hash_map_insert(hash_map, &keys[i], &keys[i]);
+                }
+            } else if (stage == 2) {
+                for (size_t i = 0; i < COUNT; i += 3)
+                {
+                    c_hash_map_erase(hash_map, &keys[i], NULL, NULL);
+                }
+            }
+
+            size_t expected = 0,
+                   wrong = 0;
+            const ptrdiff_t found = c_hash_map_at_batch(hash_map, queries, QUERIES, datas);
+            const ptrdiff_t checked = c_hash_map_check_batch(hash_map, queries, QUERIES, results);
+            for (size_t i = 0; i < QUERIES; ++i)
+            {
+                const void *const data = c_hash_map_at(hash_map, queries[i], NULL);
+                expected += (data != NULL);
+                wrong += (datas[i] != data) || (results[i] != (data != NULL));
+            }
+            TEST_CHECK( (found == (ptrdiff_t)expected) && (checked == (ptrdiff_t)expected) );
+            TEST_CHECK(wrong == 0);
+        }
+
+        queries[QUERIES / 2] = NULL;
+        TEST_CHECK(c_hash_map_at_batch(hash_map, queries, QUERIES, datas) == -3);
+        queries[QUERIES / 2] = &keys[0];
+
+        c_hash_map_delete(hash_map, NULL, NULL);
+    }
+
+    free(keys);
+    free(queries);
+    free(datas);
+    free(results);
+}
+
+typedef struct s_test_counter test_counter;
+
+// Данные пары счетчика: ключ и количество вызовов compute, изменивших пару.
+struct s_test_counter
+{
+    uint64_t key;
+    uint64_t count;
+};
+
+// Увеличивает счетчик пары, создавая его при первом вызове; на третьем увеличении удаляет пару.
+// Новые данные берутся из контекста (при встроенных данных копируются в пару).
+static void test_counter_compute(const void *const _key,
+                                 void **const _data,
+                                 void *const _context)
+{
+    test_counter *counter = *_data;
+    if (counter == NULL)
+    {
+        counter = _context;
+        counter->key = *(const uint64_t*)_key;
+        counter->count = 1;
+        *_data = counter;
+    } else if (++counter->count == 3) {
+        *_data = NULL;
+    }
+}
+
+static void test_counter_skip(const void *const _key,
+                              void **const _data,
+                              void *const _context)
+{
+    (void)_key;
+    (void)_data;
+    (void)_context;
+}
+
+// c_hash_map_concurrent_compute с данными-указателями и со встроенными данными: новая пара
+// получает NULL, существующая - свои данные, возвращаемые коды одинаковы в обоих режимах.
+static void test_concurrent_compute(void)
+{
+    enum {COUNT = 1000};
+
+    uint64_t *const keys = test_keys_create(COUNT);
+    test_counter *const counters = calloc(COUNT, sizeof(test_counter));
+    TEST_CHECK( (keys != NULL) && (counters != NULL) );
+    if ( (keys == NULL) || (counters == NULL) )
+    {
+        free(keys);
+        free(counters);
+        return;
+    }
+
+    for (size_t inline_pairs = 0; inline_pairs < 2; ++inline_pairs)
+    {
+        c_hash_map_options options;
+        c_hash_map_options_init(&options);
+        if (inline_pairs)
+        {
+            options.key_size = sizeof(uint64_t);
+            options.value_size = sizeof(test_counter);
+        }
+
+        size_t error = 0;
+        c_hash_map_concurrent *const hash_map = c_hash_map_concurrent_create(c_hash_map_hash_u64, comp_key_int,
+                                                                             8, 0, 0.75f, &options, &error);
+        TEST_CHECK(hash_map != NULL);
+        if (hash_map == NULL) continue;
+
+        // Встроенным данным передается общий временный счетчик, он копируется в пару.
+        test_counter scratch;
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            void *const context = inline_pairs ? (void*)&scratch : (void*)&counters[i];
+            TEST_CHECK(c_hash_map_concurrent_compute(hash_map, &keys[i], test_counter_skip, context, NULL) == 0);
+            TEST_CHECK(c_hash_map_concurrent_compute(hash_map, &keys[i], test_counter_compute, context, NULL) == 1);
+            TEST_CHECK(c_hash_map_concurrent_compute(hash_map, &keys[i], test_counter_compute, context, NULL) == 2);
+        }
+        TEST_CHECK(c_hash_map_concurrent_pairs_count(hash_map, NULL) == COUNT);
+
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            const test_counter *const counter = c_hash_map_concurrent_at(hash_map, &keys[i], NULL);
+            TEST_CHECK( (counter != NULL) && (counter->key == keys[i]) && (counter->count == 2) );
+            TEST_CHECK( (counter != &scratch) && ( (counter == &counters[i]) == !inline_pairs ) );
+        }
+
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            TEST_CHECK(c_hash_map_concurrent_compute(hash_map, &keys[i], test_counter_compute, &scratch, NULL) == 3);
+        }
+        TEST_CHECK(c_hash_map_concurrent_pairs_count(hash_map, NULL) == 0);
+
+        c_hash_map_concurrent_delete(hash_map, NULL, NULL);
+    }
+
+    free(keys);
+    free(counters);
+}
+
+static size_t test_allocs_count,
+              test_live_count;
+
+static void *test_alloc(void *const _context,
+                        const size_t _size)
+{
+    ++*(size_t*)_context;
+    ++test_allocs_count;
+    ++test_live_count;
+    return malloc(_size);
+}
+
+static void test_free(void *const _context,
+                      void *const _memory)
+{
+    (void)_context;
+    if (_memory != NULL)
+    {
+        --test_live_count;
+    }
+    free(_memory);
+}
+
+// Хэш-отображение, шарды и их память выделяются функциями из параметров создания.
+static void test_concurrent_memory(void)
+{
+    uint64_t *const keys = test_keys_create(1000);
+    TEST_CHECK(keys != NULL);
+    if (keys == NULL) return;
+
+    size_t context_count = 0;
+    c_hash_map_options options;
+    c_hash_map_options_init(&options);
+    options.mem_alloc = test_alloc;
+    options.mem_free = test_free;
+    options.mem_context = &context_count;
+
+    test_allocs_count = 0;
+    test_live_count = 0;
+    size_t error = 0;
+    c_hash_map_concurrent *const hash_map = c_hash_map_concurrent_create(c_hash_map_hash_u64, comp_key_int,
+                                                                         4, 0, 0.75f, &options, &error);
+    TEST_CHECK(hash_map != NULL);
+    if (hash_map != NULL)
+    {
+        // Хэш-отображение, массив шардов и хотя бы по одному блоку на шард.
+        TEST_CHECK(test_allocs_count >= 2 + 4);
+        for (size_t i = 0; i < 1000; ++i)
+        {
+            TEST_CHECK(c_hash_map_concurrent_insert(hash_map, &keys[i], &keys[i]) > 0);
+        }
+        TEST_CHECK(c_hash_map_concurrent_delete(hash_map, NULL, NULL) > 0);
+    }
+    TEST_CHECK(test_live_count == 0);
+    TEST_CHECK(context_count == test_allocs_count);
+
+    options.mem_free = NULL;
+    TEST_CHECK(c_hash_map_concurrent_create(c_hash_map_hash_u64, comp_key_int, 4, 0, 0.75f, &options, &error) == NULL);
+    TEST_CHECK(error == 8);
+
+    TEST_CHECK(c_hash_map_concurrent_create(c_hash_map_hash_u64, comp_key_int, 0, 0, 0.75f, NULL, &error) == NULL);
+    TEST_CHECK(error == 20);
+
+    free(keys);
+}
+
+typedef struct s_test_thread test_thread;
+
+// Поток проверки: вставляет свою часть ключей и увеличивает общие счетчики.
+struct s_test_thread
+{
+    c_hash_map_concurrent *hash_map;
+    const uint64_t *keys;
+    size_t begin,
+           end;
+    size_t failures;
+};
+
+enum {TEST_THREADS_COUNT = 4, TEST_THREAD_KEYS = 20000, TEST_SHARED_KEYS = 16};
+
+static uint64_t test_shared_counts[TEST_SHARED_KEYS];
+
+static void test_shared_compute(const void *const _key,
+                                void **const _data,
+                                void *const _context)
+{
+    (void)_context;
+    uint64_t *const count = &test_shared_counts[*(const uint64_t*)_key];
+    if (*_data == NULL)
+    {
+        *_data = count;
+    }
+    ++*count;
+}
+
+static void *test_thread_run(void *const _thread)
+{
+    test_thread *const thread = _thread;
+
+    for (size_t i = thread->begin; i < thread->end; ++i)
+    {
+        thread->failures += (c_hash_map_concurrent_insert(thread->hash_map, &thread->keys[i], &thread->keys[i]) <= 0);
+        thread->failures += (c_hash_map_concurrent_at(thread->hash_map, &thread->keys[i], NULL) != &thread->keys[i]);
+
+        // Общие ключи (малые числа не совпадают с ключами потоков) изменяет каждый поток.
+        const uint64_t shared_key = i % TEST_SHARED_KEYS;
+        thread->failures += (c_hash_map_concurrent_compute(thread->hash_map, &shared_key, test_shared_compute,
+                                                           NULL, NULL) <= 0);
+    }
+
+    return NULL;
+}
+
+// Параллельные вставки в разные шарды и read-modify-write общих пар через compute.
+static void test_concurrent_threads(void)
+{
+    enum {COUNT = TEST_THREADS_COUNT * TEST_THREAD_KEYS};
+
+    uint64_t *const keys = test_keys_create(COUNT);
+    TEST_CHECK(keys != NULL);
+    if (keys == NULL) return;
+
+    // Ключи общих пар - числа 0..TEST_SHARED_KEYS-1, ключи встроенные.
+    static const uint64_t shared_keys[TEST_SHARED_KEYS] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    memset(test_shared_counts, 0, sizeof(test_shared_counts));
+
+    c_hash_map_options options;
+    c_hash_map_options_init(&options);
+    options.key_size = sizeof(uint64_t);
+
+    size_t error = 0;
+    c_hash_map_concurrent *const hash_map = c_hash_map_concurrent_create(c_hash_map_hash_u64, comp_key_int,
+                                                                         16, 0, 0.75f, &options, &error);
+    TEST_CHECK(hash_map != NULL);
+    if (hash_map == NULL)
+    {
+        free(keys);
+        return;
+    }
+
+    pthread_t threads[TEST_THREADS_COUNT];
+    test_thread states[TEST_THREADS_COUNT];
+    size_t started = 0;
+    for (; started < TEST_THREADS_COUNT; ++started)
+    {
+        test_thread *const state = &states[started];
+        state->hash_map = hash_map;
+        state->keys = keys;
+        state->begin = started * TEST_THREAD_KEYS;
+        state->end = state->begin + TEST_THREAD_KEYS;
+        state->failures = 0;
+        if (pthread_create(&threads[started], NULL, test_thread_run, state) != 0)
+        {
+            break;
+        }
+    }
+    TEST_CHECK(started == TEST_THREADS_COUNT);
+
+    size_t failures = 0;
+    for (size_t t = 0; t < started; ++t)
+    {
+        pthread_join(threads[t], NULL);
+        failures += states[t].failures;
+    }
+    TEST_CHECK(failures == 0);
+
+    TEST_CHECK(c_hash_map_concurrent_pairs_count(hash_map, NULL) == started * TEST_THREAD_KEYS + TEST_SHARED_KEYS);
+    size_t total = 0;
+    for (size_t k = 0; k < TEST_SHARED_KEYS; ++k)
+    {
+        TEST_CHECK(c_hash_map_concurrent_at(hash_map, &shared_keys[k], NULL) == &test_shared_counts[k]);
+        total += test_shared_counts[k];
+    }
+    TEST_CHECK(total == started * TEST_THREAD_KEYS);
+
+    c_hash_map_concurrent_delete(hash_map, NULL, NULL);
+    free(keys);
+}
+
+typedef struct s_test_lf_reader test_lf_reader;
+
+// Читатель проверки c_hash_map_lf: ищет постоянные ключи, пока писатель изменяет остальные.
+struct s_test_lf_reader
+{
+    c_hash_map_lf *hash_map;
+    const uint64_t *keys;
+    size_t count;
+    atomic_int *stop;
+    size_t lookups,
+           failures;
+};
+
+static void *test_lf_reader_run(void *const _state)
+{
+    test_lf_reader *const state = _state;
+
+    c_hash_map_lf_reader *const reader = c_hash_map_lf_reader_register(state->hash_map, NULL);
+    if (reader == NULL)
+    {
+        ++state->failures;
+        return NULL;
+    }
+
+    uint64_t random_state = (uint64_t)(uintptr_t)state;
+    while ( (atomic_load(state->stop) == 0) || (state->lookups < state->count) )
+    {
+        const size_t i = (size_t)(test_random(&random_state) % state->count);
+        state->failures += (c_hash_map_lf_at(state->hash_map, reader, &state->keys[i], NULL) != &state->keys[i]);
+        ++state->lookups;
+    }
+
+    c_hash_map_lf_reader_unregister(state->hash_map, reader);
+
+    return NULL;
+}
+
+// Неблокирующее чтение c_hash_map_lf: постоянные пары видны читателям при любых вставках,
+// удалениях и расширениях писателя.
+static void test_lf_threads(void)
+{
+    enum {STABLE = 1000, CHURN = 50000, READERS = 3};
+
+    uint64_t *const keys = test_keys_create(STABLE + CHURN);
+    TEST_CHECK(keys != NULL);
+    if (keys == NULL) return;
+
+    c_hash_map_lf *const hash_map = c_hash_map_lf_create(c_hash_map_hash_u64, comp_key_int, 0, 0.75f, NULL);
+    TEST_CHECK(hash_map != NULL);
+    if (hash_map == NULL)
+    {
+        free(keys);
+        return;
+    }
+
+    for (size_t i = 0; i < STABLE; ++i)
+    {
+        TEST_CHECK(c_hash_map_lf_insert(hash_map, &keys[i], &keys[i]) > 0);
+    }
+
+    atomic_int stop = 0;
+    pthread_t threads[READERS];
+    test_lf_reader states[READERS];
+    size_t started = 0;
+    for (; started < READERS; ++started)
+    {
+        test_lf_reader *const state = &states[started];
+        state->hash_map = hash_map;
+        state->keys = keys;
+        state->count = STABLE;
+        state->stop = &stop;
+        state->lookups = 0;
+        state->failures = 0;
+        if (pthread_create(&threads[started], NULL, test_lf_reader_run, state) != 0)
+        {
+            break;
+        }
+    }
+    TEST_CHECK(started == READERS);
+
+    // Писатель: вставки с расширениями, затем удаление каждой второй пары.
+    size_t write_failures = 0;
+    for (size_t i = STABLE; i < STABLE + CHURN; ++i)
+    {
+        write_failures += (c_hash_map_lf_insert(hash_map, &keys[i], &keys[i]) <= 0);
+    }
+    for (size_t i = STABLE; i < STABLE + CHURN; i += 2)
+    {
+        write_failures += (c_hash_map_lf_erase(hash_map, &keys[i], NULL, NULL) <= 0);
+    }
+    TEST_CHECK(write_failures == 0);
+
+    atomic_store(&stop, 1);
+    size_t read_failures = 0;
+    for (size_t t = 0; t < started; ++t)
+    {
+        pthread_join(threads[t], NULL);
+        read_failures += states[t].failures;
+    }
+    TEST_CHECK(read_failures == 0);
+
+    TEST_CHECK(c_hash_map_lf_pairs_count(hash_map, NULL) == STABLE + CHURN / 2);
+    c_hash_map_lf_reader *const reader = c_hash_map_lf_reader_register(hash_map, NULL);
+    TEST_CHECK(reader != NULL);
+    for (size_t i = STABLE; (reader != NULL) && (i < STABLE + CHURN); ++i)
+    {
+        const void *const data = ((i - STABLE) % 2 == 0) ? NULL : &keys[i];
+        TEST_CHECK(c_hash_map_lf_at(hash_map, reader, &keys[i], NULL) == data);
+    }
+    c_hash_map_lf_reader_unregister(hash_map, reader);
+
+    TEST_CHECK(c_hash_map_lf_delete(hash_map, NULL, NULL) > 0);
+    free(keys);
+}
+
+static size_t test_snapshot_pairs;
+
+static size_t test_snapshot_count(const void *const _key,
+                                  const void *const _data,
+                                  void *const _context)
+{
+    (void)_context;
+    test_snapshot_pairs += (memcmp(_key, _data, sizeof(uint64_t)) == 0);
+    return 0;
+}
+
+// Сверяет снимок с ключами: первые _count ключей находятся с данными, равными ключу,
+// остальные _misses ключей отсутствуют.
+static void test_snapshot_verify(const c_hash_map_snapshot *const _snapshot,
+                                 const uint64_t *const _keys,
+                                 const size_t _count,
+                                 const size_t _misses)
+{
+    TEST_CHECK(c_hash_map_snapshot_pairs_count(_snapshot, NULL) == _count);
+
+    size_t wrong = 0;
+    for (size_t i = 0; i < _count; ++i)
+    {
+        const void *const data = c_hash_map_snapshot_at(_snapshot, &_keys[i], NULL);
+        wrong += (data == NULL) || (memcmp(data, &_keys[i], sizeof(uint64_t)) != 0);
+        wrong += (c_hash_map_snapshot_check(_snapshot, &_keys[i]) <= 0);
+    }
+    for (size_t i = _count; i < _count + _misses; ++i)
+    {
+        wrong += (c_hash_map_snapshot_at(_snapshot, &_keys[i], NULL) != NULL);
+        wrong += (c_hash_map_snapshot_check(_snapshot, &_keys[i]) != 0);
+    }
+    TEST_CHECK(wrong == 0);
+
+    test_snapshot_pairs = 0;
+    TEST_CHECK(c_hash_map_snapshot_for_each(_snapshot, test_snapshot_count, NULL) == ( (_count > 0) ? 1 : 0 ));
+    TEST_CHECK(test_snapshot_pairs == _count);
+}
+
+// Хэш-отображение с первыми _count ключами, данные пары - ее ключ.
+static c_hash_map *test_snapshot_map(const size_t _engine,
+                                     size_t (*const _hash_key)(const void *const _key),
+                                     const uint64_t *const _keys,
+                                     const size_t _count)
+{
+    c_hash_map_options options;
+    c_hash_map_options_init(&options);
+    options.engine = _engine;
+
+    size_t error = 0;
+    c_hash_map *const hash_map = c_hash_map_create_ex(_hash_key, comp_key_int, 0, 0.75f, &options, &error);
+    TEST_CHECK(hash_map != NULL);
+    for (size_t i = 0; (hash_map != NULL) && (i < _count); ++i)
+    {
+        TEST_CHECK(c_hash_map_insert(hash_map, &_keys[i], &_keys[i]) > 0);
+    }
+    return hash_map;
+}
+
+// c_hash_map_save и c_hash_map_open_mmap: пары всех движков находятся по отображенному файлу,
+// в том числе после удаления хэш-отображения и без побайтного сравнения ключей.
+static void test_snapshot_save(void)
+{
+    enum {COUNT = 20000, MISSES = 1000};
+    const size_t engines[4] = {C_HASH_MAP_ENGINE_CHAIN, C_HASH_MAP_ENGINE_SWISS,
+                               C_HASH_MAP_ENGINE_DENSE, C_HASH_MAP_ENGINE_CUCKOO};
+
+    uint64_t *const keys = test_keys_create(COUNT + MISSES);
+    TEST_CHECK(keys != NULL);
+    if (keys == NULL) return;
+
+    for (size_t e = 0; e < 4; ++e)
+    {
+        // Пустое хэш-отображение тоже сохраняется.
+        const size_t counts[2] = {0, COUNT};
+        for (size_t c = 0; c < 2; ++c)
+        {
+            c_hash_map *const hash_map = test_snapshot_map(engines[e], c_hash_map_hash_u64, keys, counts[c]);
+            if (hash_map == NULL) continue;
+
+            TEST_CHECK(c_hash_map_save(hash_map, TEST_SNAPSHOT_PATH, c_hash_map_serialize_u64,
+                                       c_hash_map_serialize_u64) > 0);
+            c_hash_map_delete(hash_map, NULL, NULL);
+
+            size_t error = 0;
+            c_hash_map_snapshot *const snapshot = c_hash_map_open_mmap(TEST_SNAPSHOT_PATH, c_hash_map_hash_u64, comp_key_int,
+                                                                       C_HASH_MAP_SNAPSHOT_VERIFY, &error);
+            TEST_CHECK(snapshot != NULL);
+            if (snapshot != NULL)
+            {
+                test_snapshot_verify(snapshot, keys, counts[c], MISSES);
+                TEST_CHECK(c_hash_map_snapshot_close(snapshot) > 0);
+            }
+
+            c_hash_map_snapshot *const bytewise = c_hash_map_open_mmap(TEST_SNAPSHOT_PATH, c_hash_map_hash_u64, NULL,
+                                                                       0, &error);
+            TEST_CHECK(bytewise != NULL);
+            if (bytewise != NULL)
+            {
+                test_snapshot_verify(bytewise, keys, counts[c], MISSES);
+                c_hash_map_snapshot_close(bytewise);
+            }
+        }
+    }
+
+    remove(TEST_SNAPSHOT_PATH);
+    free(keys);
+}
+
+// Изменяет байт файла снимка по смещению _offset от начала (< 0 - от конца).
+static int test_snapshot_damage(const long _offset)
+{
+    FILE *const file = fopen(TEST_SNAPSHOT_PATH, "r+b");
+    if (file == NULL) return -1;
+
+    int r_code = -1;
+    if (fseek(file, _offset, (_offset < 0) ? SEEK_END : SEEK_SET) == 0)
+    {
+        const int byte = fgetc(file);
+        if ( (byte != EOF) && (fseek(file, -1, SEEK_CUR) == 0) && (fputc(byte ^ 0x5A, file) != EOF) )
+        {
+            r_code = 0;
+        }
+    }
+    return (fclose(file) == 0) ? r_code : -1;
+}
+
+// Ошибки c_hash_map_open_mmap: отсутствующий файл, поврежденные заголовок и тело,
+// hash_key, отличающаяся от использованной при сохранении.
+static void test_snapshot_errors(void)
+{
+    enum {COUNT = 1000};
+
+    uint64_t *const keys = test_keys_create(COUNT);
+    TEST_CHECK(keys != NULL);
+    if (keys == NULL) return;
+
+    size_t error = 0;
+    remove(TEST_SNAPSHOT_PATH);
+    TEST_CHECK(c_hash_map_open_mmap(TEST_SNAPSHOT_PATH, c_hash_map_hash_u64, comp_key_int, 0, &error) == NULL);
+    TEST_CHECK(error == 3);
+
+    c_hash_map *const hash_map = test_snapshot_map(C_HASH_MAP_ENGINE_CHAIN, c_hash_map_hash_u64, keys, COUNT);
+    if (hash_map == NULL)
+    {
+        free(keys);
+        return;
+    }
+    TEST_CHECK(c_hash_map_save(hash_map, TEST_SNAPSHOT_PATH, c_hash_map_serialize_u64, c_hash_map_serialize_u64) > 0);
+
+    TEST_CHECK(c_hash_map_open_mmap(TEST_SNAPSHOT_PATH, test_hash_degenerate, comp_key_int, 0, &error) == NULL);
+    TEST_CHECK(error == 8);
+
+    // Тело проверяется только с C_HASH_MAP_SNAPSHOT_VERIFY.
+    TEST_CHECK(test_snapshot_damage(-1) == 0);
+    c_hash_map_snapshot *const snapshot = c_hash_map_open_mmap(TEST_SNAPSHOT_PATH, c_hash_map_hash_u64, comp_key_int,
+                                                               0, &error);
+    TEST_CHECK(snapshot != NULL);
+    c_hash_map_snapshot_close(snapshot);
+    TEST_CHECK(c_hash_map_open_mmap(TEST_SNAPSHOT_PATH, c_hash_map_hash_u64, comp_key_int,
+                                    C_HASH_MAP_SNAPSHOT_VERIFY, &error) == NULL);
+    TEST_CHECK(error == 7);
+
+    // Первые байты заголовка - сигнатура.
+    TEST_CHECK(test_snapshot_damage(0) == 0);
+    TEST_CHECK(c_hash_map_open_mmap(TEST_SNAPSHOT_PATH, c_hash_map_hash_u64, comp_key_int, 0, &error) == NULL);
+    TEST_CHECK(error == 4);
+
+    c_hash_map_delete(hash_map, NULL, NULL);
+    remove(TEST_SNAPSHOT_PATH);
+    free(keys);
+}
+
+// c_hash_map_freeze и c_hash_map_snapshot_save: замороженное хэш-отображение находит все пары
+// и после удаления исходного, а сохраненный из него файл открывается c_hash_map_open_mmap.
+// Вырожденный хэш проверяет запасной индекс с открытой адресацией.
+static void test_snapshot_freeze(void)
+{
+    enum {COUNT = 20000, MISSES = 1000, DEGENERATE = 200};
+
+    uint64_t *const keys = test_keys_create(COUNT + MISSES);
+    TEST_CHECK(keys != NULL);
+    if (keys == NULL) return;
+
+    const struct
+    {
+        size_t engine;
+        size_t (*hash_key)(const void *const _key);
+        size_t count;
+    } variants[6] =
+    {
+        {C_HASH_MAP_ENGINE_CHAIN,  c_hash_map_hash_u64,  0},
+        {C_HASH_MAP_ENGINE_CHAIN,  c_hash_map_hash_u64,  COUNT},
+        {C_HASH_MAP_ENGINE_SWISS,  c_hash_map_hash_u64,  COUNT},
+        {C_HASH_MAP_ENGINE_DENSE,  c_hash_map_hash_u64,  COUNT},
+        {C_HASH_MAP_ENGINE_CUCKOO, c_hash_map_hash_u64,  COUNT},
+        {C_HASH_MAP_ENGINE_CHAIN,  test_hash_degenerate, DEGENERATE}
+    };
+
+    for (size_t v = 0; v < 6; ++v)
+    {
+        c_hash_map *const hash_map = test_snapshot_map(variants[v].engine, variants[v].hash_key, keys,
+                                                       variants[v].count);
+        if (hash_map == NULL) continue;
+
+        size_t error = 0;
+        c_hash_map_snapshot *const frozen = c_hash_map_freeze(hash_map, variants[v].hash_key, comp_key_int,
+                                                              c_hash_map_serialize_u64, c_hash_map_serialize_u64,
+                                                              &error);
+        c_hash_map_delete(hash_map, NULL, NULL);
+        TEST_CHECK(frozen != NULL);
+        if (frozen == NULL) continue;
+
+        test_snapshot_verify(frozen, keys, variants[v].count, MISSES);
+
+        TEST_CHECK(c_hash_map_snapshot_save(frozen, TEST_SNAPSHOT_PATH) > 0);
+        TEST_CHECK(c_hash_map_snapshot_close(frozen) > 0);
+
+        c_hash_map_snapshot *const snapshot = c_hash_map_open_mmap(TEST_SNAPSHOT_PATH, variants[v].hash_key,
+                                                                   comp_key_int, C_HASH_MAP_SNAPSHOT_VERIFY, &error);
+        TEST_CHECK(snapshot != NULL);
+        if (snapshot != NULL)
+        {
+            test_snapshot_verify(snapshot, keys, variants[v].count, MISSES);
+
+            // Снимок открытого файла сохраняется повторно без изменений.
+            TEST_CHECK(c_hash_map_snapshot_save(snapshot, TEST_SNAPSHOT_PATH) > 0);
+            c_hash_map_snapshot_close(snapshot);
+        }
+
+        c_hash_map_snapshot *const reopened = c_hash_map_open_mmap(TEST_SNAPSHOT_PATH, variants[v].hash_key,
+                                                                   comp_key_int, C_HASH_MAP_SNAPSHOT_VERIFY, &error);
+        TEST_CHECK(reopened != NULL);
+        if (reopened != NULL)
+        {
+            test_snapshot_verify(reopened, keys, variants[v].count, MISSES);
+            c_hash_map_snapshot_close(reopened);
+        }
+    }
+
+    remove(TEST_SNAPSHOT_PATH);
+    free(keys);
+}
+
+static const struct
+{
+    const char *name;
+    void (*run)(void);
+} test_cases[] =
+{
+    {"cache/capacity",     test_cache_capacity},
+    {"cache/bytes",        test_cache_bytes},
+    {"cache/errors",       test_cache_errors},
+    {"ttl/random",         test_ttl_random},
+    {"ttl/shrink",         test_ttl_shrink},
+    {"ttl/overflow",       test_ttl_overflow},
+    {"ttl/errors",         test_ttl_errors},
+    {"cuckoo/fill",        test_cuckoo_fill},
+    {"cuckoo/degenerate",  test_cuckoo_degenerate},
+    {"cuckoo/errors",      test_cuckoo_errors},
+    {"batch/engines",      test_batch_engines},
+    {"concurrent/compute", test_concurrent_compute},
+    {"concurrent/memory",  test_concurrent_memory},
+    {"concurrent/threads", test_concurrent_threads},
+    {"lf/threads",         test_lf_threads},
+    {"snapshot/save",      test_snapshot_save},
+    {"snapshot/freeze",    test_snapshot_freeze},
+    {"snapshot/errors",    test_snapshot_errors}
+};
+#define TEST_CASES_COUNT ( sizeof(test_cases) / sizeof(test_cases[0]) )
+
+int main(int argc, char **argv)
+{
+    const char *filter = NULL;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if ( (strcmp(argv[i], "--filter") == 0) && (i + 1 < argc) )
+        {
+            filter = argv[++i];
+        } else {
+            fprintf(stderr, "usage: test [--filter SUBSTRING]\n");
+            return 2;
+        }
+    }
+
+    size_t failed_cases = 0,
+           run_cases = 0;
+
+    for (size_t c = 0; c < TEST_CASES_COUNT; ++c)
+    {
+        if ( (filter != NULL) && (strstr(test_cases[c].name, filter) == NULL) )
+        {
+            continue;
+        }
+
+        const size_t failures_begin = test_failures_count;
+        test_cases[c].run();
+        ++run_cases;
+
+        const int passed = (test_failures_count == failures_begin);
+        failed_cases += (size_t)!passed;
+        printf("%-28s %s\n", test_cases[c].name, passed ? "ok" : "FAILED");
+        fflush(stdout);
+    }
+
+    printf("test: %lu case(s), %lu check(s), %lu failure(s)\n", (unsigned long)run_cases,
+           (unsigned long)test_checks_count, (unsigned long)test_failures_count);
+
+    return (failed_cases > 0) ? 1 : 0;
+}